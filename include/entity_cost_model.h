@@ -0,0 +1,57 @@
+#pragma once
+#include "space_cells.h"
+
+namespace spiritsaway::distributed_space
+{
+	// 根据entity的位置估计每个entity在所在cell上的开销
+	// 设置到space_cells之后 update_cell_load时会用估计的开销代替汇报的entity load与cell load
+	// split方向 shrink位置 以及split/merge/shrink的候选选择都会使用估计的开销
+	// T与D为对应basic_space_cells的坐标类型与维度 默认参数在space_cells.h的前置声明中
+	template <typename T, std::uint32_t D>
+	class basic_entity_cost_model
+	{
+	public:
+		using entity_load = basic_entity_load<T, D>;
+		virtual ~basic_entity_cost_model() = default;
+		// out_costs与entity_loads一一对应
+		virtual void estimate(const std::vector<entity_load>& entity_loads, std::vector<float>& out_costs) const = 0;
+	};
+	using entity_cost_model = basic_entity_cost_model<double>;
+
+	// 开销与汇报的load相同 即与entity数量线性相关
+	template <typename T, std::uint32_t D = 2>
+	class basic_linear_cost_model : public basic_entity_cost_model<T, D>
+	{
+	public:
+		using entity_load = basic_entity_load<T, D>;
+		void estimate(const std::vector<entity_load>& entity_loads, std::vector<float>& out_costs) const override;
+	};
+	using linear_cost_model = basic_linear_cost_model<double>;
+
+	// aoi广播的开销与局部密度的平方相关
+	// 每个entity的开销为 load * (1 + neighbor_weight * aoi_radius内的其他entity数量)
+	// 一个cell内的总开销因此随着人群密度平方增长 使用网格统计邻居数量 三维时使用三维距离
+	template <typename T, std::uint32_t D = 2>
+	class basic_aoi_density_cost_model : public basic_entity_cost_model<T, D>
+	{
+		double m_aoi_radius;
+		float m_neighbor_weight;
+	public:
+		using entity_load = basic_entity_load<T, D>;
+		basic_aoi_density_cost_model(double aoi_radius, float neighbor_weight);
+		void estimate(const std::vector<entity_load>& entity_loads, std::vector<float>& out_costs) const override;
+
+		// 每个entity在aoi_radius之内的其他entity数量
+		void count_neighbors(const std::vector<entity_load>& entity_loads, std::vector<std::uint32_t>& out_neighbor_nums) const;
+	};
+	using aoi_density_cost_model = basic_aoi_density_cost_model<double>;
+
+	extern template class basic_linear_cost_model<double>;
+	extern template class basic_linear_cost_model<float>;
+	extern template class basic_aoi_density_cost_model<double>;
+	extern template class basic_aoi_density_cost_model<float>;
+	extern template class basic_linear_cost_model<double, 3>;
+	extern template class basic_linear_cost_model<float, 3>;
+	extern template class basic_aoi_density_cost_model<double, 3>;
+	extern template class basic_aoi_density_cost_model<float, 3>;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "space_cells.h"
+#include "thread_pool.h"
+#include <limits>
+
+namespace spiritsaway::distributed_space
+{
+	// 一次ghost计算的结果 所有的cell下标都指向cells
+	struct ghost_compute_result
+	{
+		static constexpr std::uint32_t invalid_cell_idx = std::numeric_limits<std::uint32_t>::max();
+		// 计算时的所有叶子节点 拓扑修改之后这些指针会失效 需要重新计算
+		std::vector<const space_cells::space_node*> cells;
+		// 与输入的entity一一对应 没有可用的real cell时为invalid_cell_idx 此时这个entity也不会产生ghost
+		std::vector<std::uint32_t> real_cell_idxes;
+		// entity i的ghost cell为ghost_cell_idxes[ghost_begins[i], ghost_begins[i + 1]) 长度为entity数量加1
+		std::vector<std::uint32_t> ghost_begins;
+		std::vector<std::uint32_t> ghost_cell_idxes;
+		// 与cells一一对应 每个cell上的real与ghost按照输入的entity顺序排列 可以直接用于update_cell_load
+		std::vector<std::vector<entity_load>> cell_entity_loads;
+		// cell_entity_loads中load的总和 不包括cell自身的基础负载
+		std::vector<float> cell_loads;
+		std::uint32_t ghost_num() const
+		{
+			return std::uint32_t(ghost_cell_idxes.size());
+		}
+	};
+
+	// entity的ghost区域 square为边长2*ghost_radius的正方形 circle为半径ghost_radius的圆
+	// 正方形会多出只与角落相交的cell 这些cell中的ghost不在任何entity的视野内
+	enum class ghost_shape
+	{
+		square,
+		circle,
+	};
+
+	// 根据entity的位置与当前的space_cells 计算每个entity的real cell以及所有能看到这个entity的ghost cell
+	// ghost区域的半径为entity的ghost_class在space_cells中对应的半径 没有设置时为space_cells::ghost_radius()
+	// 每个entity沿着kd树向下查找 ghost区域完全在real cell内的entity不需要再查询相交的叶子
+	// 因此总的开销为O(entity数量 * 树高) 而不是每个entity与每个cell都做一次相交测试
+	// 提供thread_pool时entity会被切分为thread_num段并行计算 结果与串行计算完全相同
+	class ghost_engine
+	{
+		float m_ghost_load_ratio;
+		ghost_shape m_ghost_shape;
+	public:
+		// ghost entity在所在cell上的负载为real负载乘以ghost_load_ratio
+		explicit ghost_engine(float ghost_load_ratio, ghost_shape in_ghost_shape = ghost_shape::square);
+
+		// entities中的is_real会被忽略 输出中的real与ghost会重新设置
+		// real cell与query_leaf_for_point的规则相同: 所在叶子没有ready时使用其兄弟叶子
+		void compute(const space_cells& cur_space, const std::vector<entity_load>& entities, thread_pool* pool, ghost_compute_result& result) const;
+
+		// 调用者自己维护real cell时使用 例如迁移有数量限制时entity可能暂时不在位置所在的cell
+		// real_cells与entities一一对应 需要是cur_space的叶子节点 为nullptr的entity会被忽略
+		void compute(const space_cells& cur_space, const std::vector<entity_load>& entities, const std::vector<const space_cells::space_node*>& real_cells, thread_pool* pool, ghost_compute_result& result) const;
+
+	private:
+		void compute_impl(const space_cells& cur_space, const std::vector<entity_load>& entities, const std::vector<const space_cells::space_node*>* real_cells, thread_pool* pool, ghost_compute_result& result) const;
+	};
+}
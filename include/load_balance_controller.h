@@ -0,0 +1,95 @@
+#pragma once
+#include "space_cells.h"
+#include <deque>
+
+namespace spiritsaway::distributed_space
+{
+	// 抑制split/merge/shrink来回震荡的参数
+	// 单纯使用cell_load_balance_param的阈值时 一个负载在min_cell_load_when_split附近的cell
+	// 可能刚被split就被merge 然后又被split 每一次都会引发大量的迁移
+	struct load_balance_hysteresis_param
+	{
+		std::uint32_t cell_cooldown_ticks; // 同一个cell两次负载均衡操作之间的最小间隔
+		std::uint32_t game_cooldown_ticks; // 同一个game上两次负载均衡操作之间的最小间隔
+		std::uint32_t min_cell_lifetime_ticks; // 新创建的cell至少存活这么多tick之后才能被删除
+		// 双阈值 删除一个cell之后 接收负载的兄弟cell的利用率不能超过 min_cell_load_when_split * 这个比例
+		// 这个比例小于1 保证合并之后的cell不会立即满足split条件
+		float max_merged_load_ratio_when_remove;
+		std::uint32_t oscillation_window_ticks; // 一个操作在这么多tick之内被反向操作抵消时 记录为一次震荡
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(load_balance_hysteresis_param, cell_cooldown_ticks, game_cooldown_ticks, min_cell_lifetime_ticks, max_merged_load_ratio_when_remove, oscillation_window_ticks)
+	};
+
+	struct load_balance_decision
+	{
+		cell_load_balance_operation op = cell_load_balance_operation::nothing;
+		const space_cells::space_node* node = nullptr;
+	};
+
+	// 带状态的负载均衡控制器 记录每个cell与game最近一次被操作的时间
+	// 在space_cells的候选节点选择上加上冷却时间 最小存活时间与双阈值的过滤
+	// 使用方式:
+	// 1. 每次负载均衡之前调用tick
+	// 2. 通过decide或者get_best_xxx来获取候选节点
+	// 3. 执行完对应的space_cells操作之后调用on_split/on_shrink/on_start_merge记录
+	class load_balance_controller
+	{
+		struct operation_record
+		{
+			std::uint64_t tick;
+			cell_load_balance_operation op;
+			std::string space_id; // split时为原cell shrink时为父节点 remove时为被删除的cell
+			std::string related_id; // split时为新cell shrink时为缩容的子节点序号 remove时为接收区域的兄弟节点
+		};
+		cell_load_balance_param m_lb_param;
+		load_balance_hysteresis_param m_hysteresis_param;
+		std::uint64_t m_tick = 0;
+		std::unordered_map<std::string, std::uint64_t> m_cell_last_op_ticks;
+		std::unordered_map<std::string, std::uint64_t> m_game_last_op_ticks;
+		std::unordered_map<std::string, std::uint64_t> m_cell_create_ticks;
+		std::deque<operation_record> m_recent_operations;
+		std::uint64_t m_operation_count = 0;
+		std::uint64_t m_oscillation_count = 0;
+	public:
+		load_balance_controller(const cell_load_balance_param& lb_param, const load_balance_hysteresis_param& hysteresis_param);
+
+		void tick();
+		std::uint64_t current_tick() const
+		{
+			return m_tick;
+		}
+		const cell_load_balance_param& lb_param() const
+		{
+			return m_lb_param;
+		}
+
+		// 按照shrink split remove的顺序选择一个操作 每个tick最多一个
+		load_balance_decision decide(space_cells& cur_space, const std::unordered_map<std::string, float>& game_loads) const;
+
+		const space_cells::space_node* get_best_cell_to_split(const space_cells& cur_space, const std::unordered_map<std::string, float>& game_loads) const;
+		const space_cells::space_node* get_best_node_to_shrink(space_cells& cur_space) const;
+		const space_cells::space_node* get_best_cell_to_merge(space_cells& cur_space) const;
+
+		void on_split(const space_cells::space_node* origin_cell, const space_cells::space_node* new_cell);
+		void on_shrink(const space_cells::space_node* shrink_node);
+		void on_start_merge(const space_cells::space_node* merge_cell);
+
+		// 累计执行的操作数量
+		std::uint64_t operation_count() const
+		{
+			return m_operation_count;
+		}
+		// 在oscillation_window_ticks之内被反向操作抵消的操作数量
+		// split之后新cell或者原cell被remove 或者remove之后接收区域的cell被split 或者同一个父节点的两个子节点先后shrink
+		std::uint64_t oscillation_count() const
+		{
+			return m_oscillation_count;
+		}
+	private:
+		bool check_cooldown(const space_cells::space_node* cur_node) const;
+		bool check_game_cooldown(const std::string& game_id) const;
+		void mark_operation(const space_cells::space_node* cur_node);
+		// 删除冷却已经结束的记录
+		void erase_expired_ticks(std::unordered_map<std::string, std::uint64_t>& last_op_ticks, std::uint32_t cooldown_ticks) const;
+		void add_record(const operation_record& new_record);
+	};
+}
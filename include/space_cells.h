@@ -3,32 +3,67 @@
 #include <vector>
 #include <array>
 #include <unordered_map>
+#include <functional>
+#include <memory>
 #include <nlohmann/json.hpp>
+#include "thread_pool.h"
 using json = nlohmann::json;
 namespace spiritsaway::distributed_space
 {
-	struct point_xz
+	// 坐标的数值类型T为模板参数 例如float可以减少entity_load与cell区域的内存 默认使用double
+	// 维度D为2或3 默认的二维只有水平面上的x与z 三维时增加竖直方向的y 用于多层的地下城与高层建筑
+	// 三维时y的下标为2 这样按照下标遍历坐标轴时前两个坐标轴与二维相同
+	template <typename T, std::uint32_t D = 2>
+	struct basic_point_xz
 	{
+		static_assert(D == 2, "only 2d and 3d are supported");
+		static constexpr std::uint32_t dim = 2;
 		union
 		{
 			struct {
-				double x;
-				double z;
+				T x;
+				T z;
 			};
-			double val[2];
+			T val[2];
 		};
 		
-		double& operator[](int index)
+		T& operator[](int index)
 		{
 			return val[index];
 		}
-		double operator[](int index) const
+		T operator[](int index) const
 		{
 			return val[index];
 		}
-		NLOHMANN_DEFINE_TYPE_INTRUSIVE(point_xz, x, z)
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(basic_point_xz, x, z)
 	};
 
+	template <typename T>
+	struct basic_point_xz<T, 3>
+	{
+		static constexpr std::uint32_t dim = 3;
+		union
+		{
+			struct {
+				T x;
+				T z;
+				T y;
+			};
+			T val[3];
+		};
+
+		T& operator[](int index)
+		{
+			return val[index];
+		}
+		T operator[](int index) const
+		{
+			return val[index];
+		}
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(basic_point_xz, x, z, y)
+	};
+	using point_xz = basic_point_xz<double>;
+
 	enum class cell_load_balance_operation
 	{
 		nothing,
@@ -43,6 +78,8 @@ namespace spiritsaway::distributed_space
 		right_x, // 从右侧x切分出 4*ghost_radius的范围
 		low_z, // 从下方z切分出 4*ghost_radius的范围
 		high_z, // 从上方的z切分出 4*ghost_radius的范围
+		low_y, // 从底部的y切分出 4*ghost_radius的范围 只用于三维
+		high_y, // 从顶部的y切分出 4*ghost_radius的范围 只用于三维
 	};
 
 	// 负载均衡相关参数
@@ -51,6 +88,7 @@ namespace spiritsaway::distributed_space
 	// remove的周期要比split大一倍
 	// 执行负载均衡时 优先执行split操作 因为这样平摊负载最快，
 	// 然后是 shrink操作 最后的remove操作相当于gc
+	// 所有的负载阈值都是相对于容量为1的基准game 比较时使用负载除以所在game的容量 即利用率
 	struct cell_load_balance_param
 	{
 		float max_cell_load_when_remove; // 在考虑remove时 一个cell的最大负载
@@ -59,32 +97,48 @@ namespace spiritsaway::distributed_space
 		float min_cell_load_when_shrink; // 在shrink时 当前cell的load 的最小阈值
 		std::uint32_t min_cell_load_report_counter_when_shrink; // 在考虑shrink时 一个cell的最小负载汇报次数
 
-		float min_sibling_game_load_diff_when_shrink; // 在缩容时 当前节点的game平均负载起码要比邻居节点的平均game负载高这个值
+		float min_sibling_game_load_diff_when_shrink; // 在缩容时 当前节点的game平均利用率起码要比邻居节点的平均game利用率高这个值
 		float min_game_load_when_split; // 在split时 当前cell所在game的最小负载
 		float min_cell_load_when_split; // 在split时 当前cell的最小load
 		std::uint32_t min_cell_load_report_counter_when_split; // 在考虑split时 一个cell的最小负载汇报次数
 		
 		float load_to_offset; // 在考虑shrink的时候 每次缩小的load
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(cell_load_balance_param, max_cell_load_when_remove, min_cell_load_report_counter_when_remove, min_cell_load_when_shrink, min_cell_load_report_counter_when_shrink, min_sibling_game_load_diff_when_shrink, min_game_load_when_split, min_cell_load_when_split, min_cell_load_report_counter_when_split, load_to_offset)
+	};
+
+	// 为新切分出来的cell选择game时的参数
+	// game的容量是相对于基准机器的处理能力 没有设置的game容量为1
+	struct game_assign_param
+	{
+		float max_game_load_per_capacity; // 分配之后 game的负载除以容量不能超过这个值
+		float adjacent_game_weight; // 相邻cell所在game的优先系数 乘以与相邻cell的ghost区域占比之后从负载比例中扣除
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(game_assign_param, max_game_load_per_capacity, adjacent_game_weight)
 	};
-	struct entity_load
+	template <typename T, std::uint32_t D = 2>
+	struct basic_entity_load
 	{
-		point_xz pos; // (x,z)
+		basic_point_xz<T, D> pos; // (x,z) 三维时为(x,z,y)
 		float load;
 		bool is_real;
 		std::string name;
-		NLOHMANN_DEFINE_TYPE_INTRUSIVE(entity_load, pos, load, name, is_real)
+		// ghost半径的类别 半径为space_cells::ghost_class_radius(ghost_class) 只用于计算ghost 不会encode
+		std::uint8_t ghost_class = 0;
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(basic_entity_load, pos, load, name, is_real)
 
 		json encode() const;
 		bool decode(const json& data);
 	};
+	using entity_load = basic_entity_load<double>;
 
 
-	struct cell_bound
+	template <typename T, std::uint32_t D = 2>
+	struct basic_cell_bound
 	{
-		point_xz min;
-		point_xz max;
-		NLOHMANN_DEFINE_TYPE_INTRUSIVE(cell_bound, min, max);
+		basic_point_xz<T, D> min;
+		basic_point_xz<T, D> max;
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(basic_cell_bound, min, max);
 
+		// 三维时只检查水平面 即整个竖直方向的柱体
 		bool cover(const double x, const double z) const
 		{
 			if (min.x > x || max.x < x)
@@ -97,12 +151,98 @@ namespace spiritsaway::distributed_space
 			}
 			return true;
 		}
-		bool intersect(const cell_bound& other) const;
+		bool cover(const basic_point_xz<T, D>& pos) const
+		{
+			for (std::uint32_t i = 0; i < D; i++)
+			{
+				if (min[i] > pos[i] || max[i] < pos[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		// 点到区域的距离的平方 点在区域内时为0 三维时包括y
+		double distance_sq(const basic_point_xz<T, D>& pos) const
+		{
+			double result = 0;
+			for (std::uint32_t i = 0; i < D; i++)
+			{
+				double diff = 0;
+				if (pos[i] < min[i])
+				{
+					diff = double(min[i]) - pos[i];
+				}
+				else if (pos[i] > max[i])
+				{
+					diff = double(pos[i]) - max[i];
+				}
+				result += diff * diff;
+			}
+			return result;
+		}
+		bool intersect(const basic_cell_bound& other) const;
+		// 转换为其他坐标类型的区域
+		template <typename U>
+		basic_cell_bound<U, D> cast() const
+		{
+			basic_cell_bound<U, D> result;
+			for (std::uint32_t i = 0; i < D; i++)
+			{
+				result.min[i] = U(min[i]);
+				result.max[i] = U(max[i]);
+			}
+			return result;
+		}
+	};
+	using cell_bound = basic_cell_bound<double>;
+	// space_cells自身执行的拓扑操作的累计次数 以及外部记录的entity迁移数量 不会encode
+	struct space_op_counters
+	{
+		std::uint64_t split = 0; // split_x与split_z成功的次数 split_k每新增一个cell计一次
+		std::uint64_t shrink = 0; // balance成功的次数
+		std::uint64_t start_merge = 0;
+		std::uint64_t finish_merge = 0;
+		std::uint64_t rebuild = 0;
+		std::uint64_t migrated_entities = 0; // 通过record_migrated_entities记录
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(space_op_counters, split, shrink, start_merge, finish_merge, rebuild, migrated_entities)
+
+		space_op_counters operator-(const space_op_counters& other) const;
 	};
-	class space_cells
+	template <typename T, std::uint32_t D = 2>
+	class basic_entity_cost_model;
+	struct space_metrics;
+	class space_journal_writer;
+	class space_journal_replayer;
+	class space_snapshot_view;
+	class space_topology_replica;
+	// 坐标使用T类型存储 区域 entity_load以及entity_cost_model都使用对应T的版本
+	// 切分位置 ghost_radius等接口参数以及内部的计算仍然使用double
+	// 只有double与float两个显式实例化 journal snapshot中的坐标总是double 写入时转换
+	// D为3时可以沿竖直的y切分 有(double, 3)与(float, 3)两个显式实例化 坐标轴的循环次数在编译期确定 二维没有额外开销
+	// 三维时只支持json的encode/decode 二进制快照 journal与拓扑增量的格式是二维的 对应接口返回失败或者不记录
+	template <typename T, std::uint32_t D = 2>
+	class basic_space_cells
 	{
 	public:
-		
+		static_assert(D == 2 || D == 3, "only 2d and 3d are supported");
+		static constexpr std::uint32_t dim = D;
+		using coord_type = T;
+		using point_xz = basic_point_xz<T, D>;
+		using cell_bound = basic_cell_bound<T, D>;
+		using entity_load = basic_entity_load<T, D>;
+		using entity_cost_model = basic_entity_cost_model<T, D>;
+		class space_node;
+		// 选择负载均衡节点时的额外过滤条件 返回false的节点不会被选中
+		using node_filter = std::function<bool(const space_node*)>;
+		// query_ghost_entities的结果 一个叶子上的所有ghost
+		struct leaf_ghost_entities
+		{
+			const space_node* leaf;
+			std::vector<std::uint32_t> entity_indexes; // entity_loads中的下标
+		};
+	private:
+		class space_node_pool;
 	public:
 		class space_node
 		{
@@ -116,17 +256,24 @@ namespace spiritsaway::distributed_space
 			space_node* m_parent = nullptr;
 			bool m_ready = false;
 			bool m_is_merging = false;
-			bool m_is_split_x = false;
+			std::string m_host_space_id; // 没有ready的叶子区域内的entity所在的cell 即切分出这个叶子的cell ready之后清空
+			std::uint8_t m_split_axis = 1; // 内部节点的分割轴 0为x 1为z 2为y 叶子节点保持为1
 			std::array<float, 4> m_cell_loads;
 			std::vector<entity_load> m_entity_loads;
-			std::array<std::vector<std::uint16_t>,2> m_sorted_entity_load_idx_by_axis; // 存储m_entity_load数组的索引 使得这个数组对应的元素的pos按照坐标轴升序排列
+			std::vector<float> m_entity_costs; // 与m_entity_loads一一对应的开销 没有设置entity_cost_model时等于load
+			std::array<std::vector<std::uint32_t>, D> m_sorted_entity_load_idx_by_axis; // 存储m_entity_load数组的索引 使得这个数组对应的元素的pos按照坐标轴升序排列
+			std::array<std::vector<double>, D> m_sorted_entity_load_prefix_by_axis; // 按照m_sorted_entity_load_idx_by_axis顺序的负载前缀和 长度为entity数量加1
 			std::uint32_t m_cell_load_report_counter = 0; // 汇报负载的次数 每次boundary改变之后都要重置为0
+			std::uint32_t m_real_entity_num = 0; // m_entity_loads中real entity的数量 其余为ghost
 		private:
-			float m_total_cell_load; // 当前节点所有叶子节点的load总和
-			float m_total_game_load; // 当前节点所有叶子节点的的game load总和
+			float m_total_cell_load = 0; // 当前节点所有叶子节点的load总和
+			float m_total_game_load = 0; // 当前节点所有叶子节点的的game load总和
+			float m_total_game_capacity = 0; // 当前节点所有叶子节点的game容量总和 与m_total_game_load一样按照叶子节点重复计算
 			std::vector<const space_node*> m_child_leaf;
-			std::vector<std::string> m_child_games;
-			std::uint32_t m_min_cell_load_report_counter;
+			std::vector<const std::string*> m_child_games; // 指向叶子节点的m_game_id 与m_child_leaf一样只在update_load_stat之后到下一次拓扑修改之前有效
+			std::uint32_t m_min_cell_load_report_counter = 0;
+			// 缓存calc_max_boundary_move_length的结果 下标为axis * 2 + is_split_pos_smaller 在update_load_stat时更新
+			std::array<double, 2 * D> m_max_boundary_move_lengths;
 		public:
 			space_node(const cell_bound& in_bound, const std::string& in_game_id, const std::string& in_space_id, space_node* in_parent)
 			: m_space_id(in_space_id)
@@ -137,8 +284,8 @@ namespace spiritsaway::distributed_space
 			{
 				std::fill(m_cell_loads.begin(), m_cell_loads.end(), 0.0f);
 			}
-			space_node* split_x(double x, const std::string& new_space_game_id, const std::string& left_space_id, const std::string& right_space_id, const std::string& new_parent_space_id);
-			space_node* split_z(double z, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& up_space_id, const std::string& new_parent_space_id);
+			// 沿axis坐标轴在split_pos处切分 children[0]为坐标较小的一侧 新的子节点从node_pool中获取
+			space_node* split(space_node_pool& node_pool, int axis, double split_pos, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& high_space_id, const std::string& new_parent_space_id);
 			// 将两个子节点的分界线调整为split_v
 			bool balance(double split_v);
 			bool is_leaf_cell() const
@@ -158,10 +305,26 @@ namespace spiritsaway::distributed_space
 			{
 				return m_entity_loads;
 			}
+			const auto& get_entity_costs() const
+			{
+				return m_entity_costs;
+			}
+			std::uint32_t real_entity_num() const
+			{
+				return m_real_entity_num;
+			}
+			std::uint32_t ghost_entity_num() const
+			{
+				return std::uint32_t(m_entity_loads.size()) - m_real_entity_num;
+			}
 
 			bool is_split_x() const
 			{
-				return m_is_split_x;
+				return m_split_axis == 0;
+			}
+			int split_axis() const
+			{
+				return m_split_axis;
 			}
 			const std::string& space_id() const
 			{
@@ -172,6 +335,10 @@ namespace spiritsaway::distributed_space
 			{
 				return m_game_id;
 			}
+			const std::string& host_space_id() const
+			{
+				return m_host_space_id;
+			}
 			const cell_bound& boundary() const
 			{
 				return m_boundary;
@@ -190,50 +357,96 @@ namespace spiritsaway::distributed_space
 			{
 				return m_parent;
 			}
-			// 当前节点的两个子节点合并 
-			void merge_to_child(const std::string& dest);
+			// 当前节点的两个子节点合并 删除的子节点放回node_pool
+			void merge_to_child(const std::string& dest, space_node_pool& node_pool);
 
 			json encode() const;
 			float get_smoothed_load() const;
+			// 所有叶子节点所在game的平均利用率 即game负载总和除以容量总和 在update_load_stat时更新
+			float avg_game_utilization() const
+			{
+				return m_total_game_load / m_total_game_capacity;
+			}
 			float get_latest_load() const;
 			std::uint32_t cell_load_report_counter() const
 			{
 				return m_cell_load_report_counter;
 			}
-			void update_load(float cur_load, const std::vector<entity_load>& new_entity_loads);
+			// new_entity_costs为空时 使用entity_load中的load作为开销
+			// 非空时与节点中原来的开销交换 调用方可以继续使用交换出来的容量
+			void update_load(float cur_load, const std::vector<entity_load>& new_entity_loads, std::vector<float>& new_entity_costs);
 			// 计算如果需要减少load_to_offset的负载，应该切分的位置
 			// 保留长宽都要大于4*ghost_radius
 			bool calc_offset_axis(float load_to_offset, double& out_split_axis, float& offseted_load, float ghost_radius) const;
 			// 计算split时的最佳分割方向 每次都切分一个4*ghost_radius的区域 选择这个区域内负载最大的
 			cell_split_direction calc_best_split_direction(float ghost_radius) const;
 
-			// 计算当前节点的某个边界朝指定方向移动移动时的最大长度
+			// 计算当前节点的某个边界朝指定方向移动移动时的最大长度 axis为坐标轴的下标
 			// 要求移动后任意子节点仍然有面积 这里暂时不考虑ghost_radius
 
-			double calc_max_boundary_move_length(bool is_x, bool is_split_pos_smaller) const;
+			double calc_max_boundary_move_length(int axis, bool is_split_pos_smaller) const;
 
-			// 递归的移动当前区域的某个边界 is_x代表坐标轴 is_split_pos_smaller代表是缩小还是放大
+			// 递归的移动当前区域的某个边界 axis代表坐标轴 is_split_pos_smaller代表是缩小还是放大
 			// is_changing_max代表是否修改boundary.max还是min
-			void update_boundary_with_new_split(double new_split_pos, bool is_x, bool is_split_pos_smaller, bool is_changing_max);
+			void update_boundary_with_new_split(double new_split_pos, int axis, bool is_split_pos_smaller, bool is_changing_max);
 
 			// 计算在以这个新的分割轴进行分割的时候 能够缩小的entity_load总和
-			float calc_move_split_offload(double new_split_pos, bool is_x, bool is_split_pos_smaller) const;
-
-			bool check_can_shrink(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param, const double ghost_radius) const;
+			float calc_move_split_offload(double new_split_pos, int axis, bool is_split_pos_smaller) const;
+			// 这三个接口之前使用bool is_x作为第一个坐标参数 true会被隐式转换为axis 1即z轴 删除bool版本使得旧的调用无法编译
+			double calc_max_boundary_move_length(bool is_x, bool is_split_pos_smaller) const = delete;
+			void update_boundary_with_new_split(double new_split_pos, bool is_x, bool is_split_pos_smaller, bool is_changing_max) = delete;
+			float calc_move_split_offload(double new_split_pos, bool is_x, bool is_split_pos_smaller) const = delete;
 
-			const space_node* calc_shrink_node(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param, const double ghost_radius) const;
+			bool check_can_shrink(const cell_load_balance_param& lb_param, const double ghost_radius) const;
 
+			// 计算shrink时新的分割位置 使得移出的entity_load总和刚好超过min_sibling_game_load_diff_when_shrink / 2 乘以叶子节点的平均game容量
+			// 边界移动距离限制在[ghost_radius, 最大移动距离 - 4 * ghost_radius]之间
+			// 利用叶子节点的负载前缀和 在边界上所有叶子节点的entity_load中二分查找 分割线放在刚好满足条件的entity与下一个entity之间
 			double calc_best_shrink_new_split_pos(const cell_load_balance_param& lb_param, const double ghost_radius) const;
+
+			// 收集calc_move_split_offload会统计的所有叶子节点 即边界移动时会移出entity_load的叶子节点
+			void collect_move_split_leafs(int axis, bool is_split_pos_smaller, std::vector<const space_node*>& out_leafs) const;
 		private:
+			// check_can_shrink与calc_shrink_score共用的负载判定 不包括边界移动长度的检查
+			// 满足时返回true 并通过out_score返回当前节点与兄弟节点的平均game利用率差
+			bool check_shrink_load(const cell_load_balance_param& lb_param, float& out_score) const;
+			// 与check_can_shrink的判定条件相同 但是使用update_load_stat时缓存的边界移动长度
+			// 可以shrink时返回true 并通过out_score返回当前节点与兄弟节点的平均game利用率差
+			bool calc_shrink_score(const cell_load_balance_param& lb_param, const double ghost_radius, float& out_score) const;
+			double cached_max_boundary_move_length(int axis, bool is_split_pos_smaller) const
+			{
+				return m_max_boundary_move_lengths[axis * 2 + int(is_split_pos_smaller)];
+			}
 			bool set_child(int index, space_node* new_child);
 			void set_ready();
 			void set_is_merging();
 			void on_split(int master_child_index);
 			void make_sorted_loads();
-			friend class space_cells;
-			void update_load_stat(const std::unordered_map<std::string, float>& game_loads);
+			// 恢复为构造函数之后的状态 所有vector只清空不释放
+			void reset(const cell_bound& in_bound, const std::string& in_game_id, const std::string& in_space_id, space_node* in_parent);
+			friend class basic_space_cells;
+			friend class space_topology_replica;
+			friend class space_journal_replayer;
+			// 按照后序遍历把子树中的所有节点添加到out_nodes
+			void update_load_stat(const std::unordered_map<std::string, float>& game_loads, const std::unordered_map<std::string, float>& game_capacities, std::vector<const space_node*>& out_nodes);
 		};
 	private:
+		// split与merge时节点的分配与回收 回收的节点保留其中所有vector的容量
+		// 再次split时直接复用 拓扑修改与之后的负载汇报都不需要重新申请内存
+		// 最多保留max_free_num个节点 decode以及析构时释放的节点不经过这里
+		class space_node_pool
+		{
+			std::vector<space_node*> m_free_nodes;
+		public:
+			static constexpr std::size_t max_free_num = 64;
+			space_node_pool() = default;
+			space_node_pool(const space_node_pool& other) = delete;
+			space_node_pool& operator=(const space_node_pool& other) = delete;
+			~space_node_pool();
+			space_node* create(const cell_bound& in_bound, const std::string& in_game_id, const std::string& in_space_id, space_node* in_parent);
+			void recycle(space_node* cur_node);
+		};
+		space_node_pool m_node_pool;
 		std::unordered_map<std::string, space_node*> m_leaf_nodes;
 		std::unordered_map<std::string, space_node*> m_internal_nodes;
 		// split与merge不会影响root_node
@@ -248,46 +461,224 @@ namespace spiritsaway::distributed_space
 		// 任何一个cell的长和宽必须大于等于四倍的ghost_radius
 		// removing状态下的除外
 		double m_ghost_radius;
+		// 下标为entity_load::ghost_class 超出范围的类别使用m_ghost_radius
+		std::vector<double> m_ghost_class_radiuses;
+		struct ghost_radius_region
+		{
+			cell_bound bound;
+			double ghost_radius;
+		};
+		// 完全在这些区域内的节点使用更小的ghost_radius 因此可以切分出更小的cell
+		std::vector<ghost_radius_region> m_ghost_radius_regions;
+
+		// update_load_stat时按照后序遍历记录的所有节点 供get_best_node_to_shrink_parallel使用
+		std::vector<const space_node*> m_load_stat_nodes;
+
+		// 每个game相对于基准机器的容量 不在这里的game容量为1
+		std::unordered_map<std::string, float> m_game_capacities;
+
+		// 为空时直接使用汇报的load
+		std::shared_ptr<const entity_cost_model> m_entity_cost_model;
+		// entity_cost_model的输出 与叶子节点中的开销交换 之后作为下一次汇报的输出
+		std::vector<float> m_entity_cost_buffer;
+
+		space_op_counters m_op_counters;
+
+		// 非空时所有修改状态的公开接口在执行前写入journal
+		space_journal_writer* m_journal = nullptr;
+		// 公开接口之间的嵌套调用深度 只有最外层的调用需要写入journal
+		std::uint32_t m_journal_depth = 0;
+		class journal_scope;
+		friend class space_topology_replica;
+		friend class space_journal_replayer;
+		// 叶子的entity_load被整体替换之后调用 清空entity开销并重新排序 然后写入journal
+		// load_entity_loads与journal回放共用 不修改cell负载
+		void on_entity_loads_replaced(space_node* cur_node);
+		// 释放所有节点 之后m_root_node为空
+		void destroy_nodes();
+
+		// decode时一个节点的数据 json与流式解析共用 内部节点只使用前面的几个字段
+		struct decode_cell
+		{
+			cell_bound bound;
+			std::string space_id;
+			std::string game_id;
+			std::string parent;
+			std::array<std::string, 2> children;
+			bool ready = false;
+			bool is_merging = false;
+			std::string host; // 只有没有ready的叶子才有
+			bool is_split_x = false;
+			int split_axis = -1; // 三维的内部节点通过split_axis记录分割轴 没有时由is_split_x决定
+			std::array<float, 4> cell_loads;
+			std::uint32_t cell_load_counter = 0;
+			std::vector<entity_load> entity_loads;
+		};
+		// 按照encode输出的顺序逐个添加节点 构建一棵新的树 全部成功之后通过install替换space_cells的当前状态
+		// 没有install时析构会释放已经创建的节点
+		class decode_builder
+		{
+			// 还有空闲子节点的内部节点 前序遍历中下一个节点的父节点就是最后一个
+			struct open_internal_node
+			{
+				space_node* node;
+				std::array<std::string, 2> children_ids;
+			};
+			std::vector<space_node*> m_nodes;
+			std::unordered_map<std::string, space_node*> m_leaf_nodes;
+			std::unordered_map<std::string, space_node*> m_internal_nodes;
+			std::vector<open_internal_node> m_open_nodes;
+			std::uint64_t m_max_internal_id = 0;
+		public:
+			decode_builder() = default;
+			decode_builder(const decode_builder& other) = delete;
+			decode_builder& operator=(const decode_builder& other) = delete;
+			~decode_builder();
+			// 叶子节点的entity_loads会被移走
+			bool add_cell(decode_cell& cur_cell);
+			// temp_node_counter会与所有数字id的内部节点取最大值
+			bool install(basic_space_cells& cur_space, std::string&& master_cell_id, double ghost_radius, std::uint64_t temp_node_counter, std::unordered_map<std::string, float>&& game_capacities);
+		};
+		class decode_sax_handler;
+
+		// 重建内部节点时不会被修改的单元 node为空时代表一个待创建的merge节点
+		struct rebuild_unit
+		{
+			cell_bound bound;
+			space_node* node;
+		};
+		// 重建内部节点时的一次分割 按照前序遍历排列
+		// units[begin, mid)与units[mid, end)分别为两个子节点
+		struct rebuild_split_step
+		{
+			std::size_t begin;
+			std::size_t mid;
+			std::size_t end;
+			int axis;
+			cell_bound bound;
+		};
+		// 一个需要重建的子树 region_root的节点对象与id保持不变
+		struct rebuild_plan
+		{
+			space_node* region_root = nullptr;
+			std::vector<rebuild_unit> units;
+			std::vector<space_node*> recycle_nodes; // 可以重新使用的内部节点 region_root总是第一个
+			std::vector<rebuild_split_step> split_steps;
+		};
+		// 收集region_root子树内的单元与内部节点 正在merge或者没有ready的cell的父节点作为一个整体单元
+		// 这个父节点下面的内部子节点会被放入nested_roots
+		void collect_rebuild_units(space_node* region_root, rebuild_plan& out_plan, std::vector<space_node*>& nested_roots) const;
+		bool plan_rebuild_split(std::vector<rebuild_unit>& units, std::size_t begin, std::size_t end, const cell_bound& bound, std::vector<rebuild_split_step>& out_steps) const;
+		void apply_rebuild_plan(const rebuild_plan& cur_plan);
+		// 计算将cur_node与dest_node调整为兄弟节点时需要的重建计划 两个节点已经是兄弟节点时units为空
+		bool plan_merge_to(space_node* cur_node, space_node* dest_node, rebuild_plan& out_plan) const;
+
+		// split_k时的一次二分 将编号为low_piece的cell切分 高的一侧分配给编号为high_piece的cell 按照前序遍历排列
+		struct split_k_step
+		{
+			std::size_t low_piece;
+			std::size_t high_piece;
+			int axis;
+			double split_pos;
+		};
+		// 将bound区域切分为[begin, end)这些编号的cell 负载使用origin_node的entity_load中位于bound内的部分
+		bool plan_split_k(const space_node* origin_node, const cell_bound& bound, std::size_t begin, std::size_t end, std::vector<split_k_step>& out_steps) const;
+		// split_x split_z split_y共用的实现 不写入journal
+		const space_node* split_at_axis(int axis, double split_pos, const std::string& origin_space_id, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& high_space_id);
+		// 后序遍历cur_node的子树 返回第一个可以shrink的节点 每个节点使用父节点所在区域的ghost_radius
+		const space_node* calc_shrink_node(const space_node* cur_node, const cell_load_balance_param& lb_param, const node_filter& filter) const;
+		// radius_sqs为空时所有entity都使用max_radius 否则为每个entity半径的平方 max_radius为其中最大的半径
+		bool query_ghost_entities_impl(const std::string& cell_id, const std::vector<entity_load>& entity_loads, double max_radius, const std::vector<T>& radius_sqs, std::vector<leaf_ghost_entities>& out_ghosts) const;
 
 	public:
 		// 选择一个合适的cell来分割 分割要求
-		// 1. 这个cell所在的game load 要大于指定阈值
-		// 2. 这个cell的load要大于指定阈值
+		// 1. 这个cell所在的game 利用率要大于指定阈值
+		// 2. 这个cell的利用率要大于指定阈值
 		// 3. 长和宽至少有一个要大于8倍的ghost_radius 这样才能保证分割后的两个cell都有4倍radius
-		// 选取cell load最大的
-		const space_node* get_best_cell_to_split(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param) const;
-		~space_cells();
+		// 选取cell利用率最大的
+		// filter非空时 只考虑filter返回true的cell 下面的几个接口相同
+		const space_node* get_best_cell_to_split(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param, const node_filter& filter = {}) const;
+		~basic_space_cells();
 
 		// 选择一个合适的cell来删除 删除要求
-		// 1. 这个cell的负载要小于指定阈值 max_cell_load
-		// 2. 选取其中 cell load最小的
-		const space_node* get_best_cell_to_merge(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param);
+		// 1. 这个cell的利用率要小于指定阈值 max_cell_load
+		// 2. 选取其中 cell利用率最小的
+		const space_node* get_best_cell_to_merge(const cell_load_balance_param& lb_param, const node_filter& filter = {});
+
+		// 与get_best_cell_to_merge类似 但是不要求被删除的cell与接收区域的cell是兄弟节点
+		// 接收区域的cell需要与被删除的cell共享一条完整的边 并且两者可以在最近公共祖先的子树内重新组织为兄弟节点
+		// 接收区域的cell也需要满足汇报次数的要求 并且没有在merge 多个候选时选择利用率最小的
+		// 返回被删除的cell 通过out_dest_cell_id返回接收区域的cell 之后使用start_merge_to执行
+		const space_node* get_best_cell_to_merge_adjacent(const cell_load_balance_param& lb_param, std::string& out_dest_cell_id, const node_filter& filter = {}) const;
 
 		// 选择一个合适的node来缩容
-		// 1. 这个node的平均game负载起码要大于指定阈值
-		// 2. 这个node的平均game 负载起码要比其兄弟节点的平均负载大于指定阈值
-		// 3. 这个cell的负载转移到兄弟节点之后 兄弟节点game的平均load 不能比当前game的平均load高
+		// 1. 这个node的平均game利用率起码要大于指定阈值
+		// 2. 这个node的平均game利用率起码要比其兄弟节点的平均利用率大于指定阈值
+		// 3. 这个cell的负载转移到兄弟节点之后 兄弟节点game的平均利用率 不能比当前game的平均利用率高
 		// 优先选取底部节点
-		const space_node* get_best_node_to_shrink(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param);
+		const space_node* get_best_node_to_shrink(const cell_load_balance_param& lb_param, const node_filter& filter = {});
+
+		// 与get_best_node_to_shrink的判定条件相同 但是会评估所有的节点 返回平均game利用率差最大的节点
+		// 评估使用update_load_stat时缓存的节点列表与子树边界 切分 合并 balance与重建都会清空这个缓存 此时返回nullptr 需要重新调用update_load_stat
+		// pool非空时将所有节点分段放到线程池里并行评估 filter只会在调用线程执行
+		const space_node* get_best_node_to_shrink_parallel(const cell_load_balance_param& lb_param, thread_pool* pool, const node_filter& filter = {}) const;
 
 		
 
+		// 重建所有的内部节点 使得树的深度最小 叶子节点的id 区域以及节点对象都保持不变
+		// 正在merge或者没有ready的cell与其兄弟节点的父节点保持不变 保证start_merge finish_merge以及没有host时的点查询依赖的兄弟关系不变
+		// 其他内部节点会按照能够将剩余单元对半分的完整分割线重新组织 并分配新的内部节点id
+		// 根节点以及这些cell的兄弟内部节点保留原来的id 其他内部节点id全部失效
+		// 调用之后需要重新执行update_load_stat
+		// 无法找到合法的分割线时返回false 此时树不会被修改
+		bool rebuild_internal_nodes();
+
+		// 根节点到最深叶子节点的距离 只有根节点时为0
+		std::uint32_t calc_max_depth() const;
+
 		// 计算一个节点 最大可能的shrink大小 这个节点可以是内部节点
 		// shrink后需要保证里面所有的叶子节点的长宽都要有4*ghost_radius
 		double calc_max_shrink_length(const space_node* shrink_node) const;
 
+		// 计算某个叶子节点按照指定方向切分出来的新cell的区域
+		bool calc_split_bound(const std::string& origin_space_id, cell_split_direction split_direction, cell_bound& out_bound) const;
+
+		// 为按照split_direction从origin_space_id切分出来的新cell选择一个game
+		// 1. 不能选择原来cell所在的game 否则切分无法降低game负载
+		// 2. 加上新cell的预估负载之后 game负载除以容量不能超过max_game_load_per_capacity
+		// 3. 优先选择负载比例低的game 同时优先选择已经承载了相邻cell的game 以减少跨进程的ghost同步
+		// 所有game都超过上限时选择负载比例最小的game 没有其他game时返回空字符串
+		std::string choose_game_for_new_cell(const std::string& origin_space_id, cell_split_direction split_direction, const std::unordered_map<std::string, float>& game_loads, const game_assign_param& assign_param) const;
+
+		void set_game_capacity(const std::string& game_id, float capacity);
+		// 删除game的容量 之后这个game按照默认容量1计算 game不存在时返回false
+		bool remove_game_capacity(const std::string& game_id);
+		float game_capacity(const std::string& game_id) const;
+		// cell的平滑负载除以所在game的容量
+		float cell_utilization(const space_node* cur_cell) const;
+		const std::unordered_map<std::string, float>& game_capacities() const
+		{
+			return m_game_capacities;
+		}
 
-		
 	public:
 		
-		space_cells(const cell_bound& bound, const std::string& game_id, const std::string& space_id, const double in_ghost_radius);
+		basic_space_cells(const cell_bound& bound, const std::string& game_id, const std::string& space_id, const double in_ghost_radius);
 		const space_node* split_x(double x, const std::string& origin_space_id, const std::string& new_space_game_id, const std::string& left_space_id, const std::string& right_space_id);
 		const space_node* split_z(double z, const std::string& origin_space_id, const std::string& new_space_game_id,const std::string& low_space_id, const std::string& high_space_id);
+		// 沿竖直方向切分 只有三维时可用 二维时返回空
+		const space_node* split_y(double y, const std::string& origin_space_id, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& high_space_id);
 		const space_node* split_at_direction(const std::string& origin_space_id, cell_split_direction split_direction, const std::string& new_space_id, const std::string& new_space_game_id);
+		// 一次性把一个叶子节点切分为new_space_ids.size() + 1个cell 这些cell构成一个平衡子树
+		// 每次二分时优先切分较长的边 分割线放在对应的负载分位数上 同时保证所有cell的长宽都不小于4*ghost_radius
+		// origin_space_id保留坐标最小的区域 其他区域按照坐标顺序依次分配给new_space_ids 对应的game为new_game_ids中相同下标
+		// 新的cell与split_x一样处于未ready状态 host都为origin_space_id 在set_ready之前这些区域内的点都查询到origin_space_id
+		// 返回按照new_space_ids顺序排列的新cell 失败时返回空 此时树不会被修改
+		std::vector<const space_node*> split_k(const std::string& origin_space_id, const std::vector<std::string>& new_space_ids, const std::vector<std::string>& new_game_ids);
 		// 将cell_id对应的cell 与其兄弟节点的分界线调整为split_v
 		bool balance(double split_v, const std::string& cell_id);
 
-		// 将某个内部节点的分割线移动到split_v
+		// 将某个内部节点的分割线移动到split_v 分割线越过缩小一侧子树中平行的分割线时返回false 此时树不会被修改
 		bool balance(double split_v, const space_node* cur_node);
 
 		// 将当前节点的boundary缩小到0.5*ghost_radius 并设置为is_merging 
@@ -297,8 +688,31 @@ namespace spiritsaway::distributed_space
 		// 返回对应要删除node的game_id
 		// 失败的情况下返回值都是空
 		std::string finish_merge(const std::string& space_id);
+
+		// 与cell_id对应的叶子节点共享一条完整边的所有叶子节点
+		std::vector<const space_node*> query_full_edge_neighbors(const std::string& cell_id) const;
+		// 检查cell_id对应的cell能否通过start_merge_to将区域交给dest_cell_id对应的cell
+		bool check_can_merge_to(const std::string& cell_id, const std::string& dest_cell_id) const;
+		// 先在两个cell的最近公共祖先子树内重新组织内部节点 使得两个cell成为兄弟节点 然后执行start_merge
+		// 与rebuild_internal_nodes一样 正在merge或者没有ready的cell与其兄弟节点的父节点保持不变 两个cell不是兄弟节点并且其中之一在这样的父节点下时无法合并
+		// 被修改的子树中除了最近公共祖先之外的内部节点id都会失效 之后同样使用finish_merge(cell_id)完成合并
+		bool start_merge_to(const std::string& cell_id, const std::string& dest_cell_id);
 		std::vector<const space_node*> query_intersect_leafs(const cell_bound& bound) const;
+		// 到pos的距离小于radius的所有叶子 即与圆相交的叶子 三维时为球 只在边界上接触的叶子不算
+		// 把pos扩展为边长2*radius的正方形再调用query_intersect_leafs时 会多出只与正方形角落相交的叶子
+		std::vector<const space_node*> query_leafs_in_radius(const point_xz& pos, double radius) const;
+		// cell_id中的entity在其他叶子中的ghost 即到其他叶子的距离小于radius的entity 按照叶子分组
+		// entity_loads需要都在cell_id的区域内 没有ghost的叶子不会出现在out_ghosts中 cell_id不是叶子时返回false
+		// 坐标按照坐标轴转换为连续数组之后 每个候选叶子对所有entity计算一次距离 这个循环没有分支可以被编译器向量化
+		bool query_ghost_entities(const std::string& cell_id, const std::vector<entity_load>& entity_loads, double radius, std::vector<leaf_ghost_entities>& out_ghosts) const;
+		// 每个entity使用自己ghost_class对应的半径
+		bool query_ghost_entities(const std::string& cell_id, const std::vector<entity_load>& entity_loads, std::vector<leaf_ghost_entities>& out_ghosts) const;
+		// 三维时只使用水平面坐标 返回对应柱体中最先找到的叶子 叶子没有ready时返回get_real_leaf的结果
 		const space_node* query_leaf_for_point(double x, double z) const;
+		const space_node* query_leaf_for_point(const point_xz& pos) const;
+		// 叶子区域内的entity当前所在的叶子 ready时为自己 没有ready时为host_space_id对应的叶子
+		// 没有记录host时(例如解码了不带host的json)使用同为叶子的兄弟节点 host已经不是ready的叶子时返回nullptr
+		const space_node* get_real_leaf(const space_node* leaf) const;
 		const std::unordered_map<std::string, space_node*>& cells() const
 		{
 			return m_leaf_nodes;
@@ -342,9 +756,29 @@ namespace spiritsaway::distributed_space
 		{
 			return m_ghost_radius;
 		}
+		// 节点所在区域的ghost_radius 节点完全在add_ghost_radius_region的区域内时为这些区域中最小的半径 且不超过ghost_radius()
+		// 节点的最小边长 split与shrink的步长 start_merge之后的宽度都使用这个半径 shrink时需要传入被移动分割线所在的父节点
+		// cur_node为空时返回ghost_radius()
+		double ghost_radius(const space_node* cur_node) const;
+		// 添加一个使用更小ghost_radius的区域 例如只有小视野npc的密集区域 区域内可以切分出边长为4 * region_ghost_radius的cell
+		// 与entity_cost_model一样不会encode 也不会写入journal decode与回放之前需要重新设置 region_ghost_radius不大于0时返回false
+		bool add_ghost_radius_region(const cell_bound& bound, double region_ghost_radius);
+		void clear_ghost_radius_regions();
+		// 所有区域与ghost_radius()中最小的半径
+		double min_ghost_radius() const;
+		// 设置某个ghost_class的半径 例如boss与载具使用比ghost_radius()更大的视野 没有设置的类别使用ghost_radius()
+		// 只影响ghost的计算 不影响cell的最小边长 与add_ghost_radius_region一样不会encode
+		bool set_ghost_class_radius(std::uint8_t ghost_class, double class_radius);
+		double ghost_class_radius(std::uint8_t ghost_class) const
+		{
+			return ghost_class < m_ghost_class_radiuses.size() ? m_ghost_class_radiuses[ghost_class] : m_ghost_radius;
+		}
 		bool set_ready(const std::string& space_id);
 		json encode() const;
 		bool decode(const json& data);
+		// 与decode的数据格式相同 边读取边构建节点 不需要先解析出完整的json 内存占用只与树的大小相关
+		// 失败时当前状态不变
+		bool decode_stream(std::istream& is);
 		// 传入的cell id不能是数字
 		bool check_valid_space_id(const std::string& cell_id) const;
 		std::vector<std::string> all_child_space_except(const std::string& except_space) const;
@@ -352,8 +786,52 @@ namespace spiritsaway::distributed_space
 		{
 			return m_master_cell_id;
 		}
+		// 设置了entity_cost_model时 cell_load会被替换为所有real entity的估计开销之和
 		void update_cell_load(const std::string& cell_space_id, float cell_load, const std::vector<entity_load>& new_entity_loads);
+		// 设置之后的update_cell_load才会生效 传入空指针恢复为直接使用汇报的load
+		void set_entity_cost_model(std::shared_ptr<const entity_cost_model> cost_model);
+		const std::shared_ptr<const entity_cost_model>& get_entity_cost_model() const
+		{
+			return m_entity_cost_model;
+		}
 
 		void update_load_stat(const std::unordered_map<std::string, float>& game_loads);
+
+		const space_op_counters& op_counters() const
+		{
+			return m_op_counters;
+		}
+		// entity的迁移由game执行 space_cells无法感知 需要外部在迁移之后记录
+		void record_migrated_entities(std::uint64_t migrated_num)
+		{
+			m_op_counters.migrated_entities += migrated_num;
+		}
+		// 计算当前布局的负载分布 树的形状与ghost比例 只遍历节点而不遍历entity 可以每个tick调用
+		// cell负载使用最近一次汇报的负载 只统计ready的叶子 game负载来自game_loads 没有的game负载为0
+		// 窗口内的操作数量需要通过space_metrics_window填充
+		void calc_metrics(const std::unordered_map<std::string, float>& game_loads, space_metrics& out_metrics) const;
+
+		// 设置之后先写入一条当前状态的snapshot 然后记录所有修改状态的调用 传入nullptr停止记录
+		// journal的生命周期由调用者管理 需要覆盖设置期间
+		// journal只支持二维的space_cells 三维时不会记录任何内容 返回false
+		bool set_journal(space_journal_writer* journal);
+
+		// 二进制快照 格式见space_snapshot.h 比encode得到的json小并且不需要解析
+		void encode_binary(std::string& out_data) const;
+		// snapshot需要是init成功的 失败时返回false并且当前状态不变
+		// with_entity_loads为false时只恢复拓扑与cell负载 之后通过load_entity_loads按需加载单个cell的entity_load
+		bool decode_binary(const space_snapshot_view& snapshot, bool with_entity_loads = true);
+		bool load_entity_loads(const space_snapshot_view& snapshot, const std::string& cell_id);
+		space_journal_writer* journal() const
+		{
+			return m_journal;
+		}
 	};
-}
\ No newline at end of file
+
+	using space_cells = basic_space_cells<double>;
+	using space_cells_3d = basic_space_cells<double, 3>;
+	extern template class basic_space_cells<double>;
+	extern template class basic_space_cells<float>;
+	extern template class basic_space_cells<double, 3>;
+	extern template class basic_space_cells<float, 3>;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include "space_cells.h"
+#include <ostream>
+#include <string_view>
+
+namespace spiritsaway::distributed_space
+{
+	// journal中的记录类型 数值会写入文件 只能在末尾追加
+	enum class space_journal_op : std::uint8_t
+	{
+		snapshot = 1, // set_journal与decode之后的完整状态
+		tick, // 之后的记录属于这个tick
+		split_x,
+		split_z,
+		split_k,
+		balance_cell,
+		balance_node,
+		start_merge,
+		start_merge_to,
+		finish_merge,
+		set_ready,
+		update_cell_load,
+		update_load_stat,
+		rebuild_internal_nodes,
+		set_game_capacity,
+		load_entity_loads,
+		remove_game_capacity,
+	};
+
+	// 只追加的二进制journal 记录space_cells上所有修改状态的调用以及调用参数
+	// 文件以magic开头 之后每条记录为 1字节的op 4字节的payload长度 payload
+	// 数值使用本机字节序 只能在相同字节序的机器上回放 字符串长度与数组长度使用LEB128变长编码
+	// 记录在调用执行之前写入 失败的调用回放时同样会失败 因此回放得到的状态与原来完全相同
+	// entity_cost_model ghost_class的半径以及ghost_radius的区域无法记录 回放时通过space_journal_replayer::set_space_setup设置相同的值
+	class space_journal_writer
+	{
+		std::ostream& m_os;
+		std::string m_buffer;
+		std::size_t m_flush_size;
+		std::uint64_t m_record_num = 0;
+	public:
+		static constexpr char magic[4] = { 'D', 'S', 'J', '1' };
+		// os为空文件时写入magic 否则认为是在已有的journal后面追加
+		// 记录先缓存在内存里 超过flush_size之后写入os
+		explicit space_journal_writer(std::ostream& os, std::size_t flush_size = 64 * 1024);
+		~space_journal_writer();
+		space_journal_writer(const space_journal_writer& other) = delete;
+		space_journal_writer& operator=(const space_journal_writer& other) = delete;
+
+		void flush();
+		std::uint64_t record_num() const
+		{
+			return m_record_num;
+		}
+		// 由使用者在每个tick开始时调用 回放时可以停在任意tick结束的状态
+		void write_tick(std::uint32_t tick);
+
+		// 以下接口由space_cells调用
+		// 不同坐标类型的space_cells写入的坐标都是double 可以回放到space_cells
+		template <typename T>
+		void write_snapshot(const basic_space_cells<T>& cur_space);
+		void write_split(space_journal_op op, double split_pos, const std::string& origin_space_id, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& high_space_id);
+		void write_split_k(const std::string& origin_space_id, const std::vector<std::string>& new_space_ids, const std::vector<std::string>& new_game_ids);
+		void write_balance(space_journal_op op, double split_v, const std::string& space_id);
+		// start_merge finish_merge set_ready rebuild_internal_nodes这些只有cell_id或者没有参数的操作
+		void write_cell_op(space_journal_op op, const std::string& cell_id);
+		void write_start_merge_to(const std::string& cell_id, const std::string& dest_cell_id);
+		template <typename T>
+		void write_update_cell_load(const std::string& cell_id, float cell_load, const std::vector<basic_entity_load<T>>& new_entity_loads);
+		// load_entity_loads从快照加载之后的entity_load 格式与update_cell_load相同 但是没有cell负载
+		template <typename T>
+		void write_load_entity_loads(const std::string& cell_id, const std::vector<basic_entity_load<T>>& entity_loads);
+		void write_update_load_stat(const std::unordered_map<std::string, float>& game_loads);
+		void write_set_game_capacity(const std::string& game_id, float capacity);
+		void write_remove_game_capacity(const std::string& game_id);
+
+	private:
+		// 写入op与长度占位 返回payload的起始位置
+		std::size_t begin_record(space_journal_op op);
+		void end_record(std::size_t payload_begin);
+	};
+
+	// 回放space_journal_writer写入的journal 记录的数据需要在回放期间一直有效
+	class space_journal_replayer
+	{
+		std::string_view m_data;
+		std::size_t m_offset = 0;
+		std::unique_ptr<space_cells> m_space;
+		std::uint32_t m_tick = 0;
+		bool m_has_tick = false;
+		std::uint64_t m_record_num = 0;
+		std::uint64_t m_failed_num = 0;
+		bool m_corrupted = false;
+		// 回放update_cell_load load_entity_loads与update_load_stat时复用的缓冲区
+		std::vector<entity_load> m_entity_loads;
+		std::unordered_map<std::string, float> m_game_loads;
+		std::function<void(space_cells&)> m_space_setup;
+	public:
+		// data不是以magic开头时 valid返回false
+		explicit space_journal_replayer(std::string_view data);
+		bool valid() const;
+		// 每条snapshot记录都会创建新的space_cells 在decode成功之后调用setup 用来设置journal没有记录的cost model与ghost半径
+		// 需要在第一次step之前设置 decode得到的entity开销等于load 直到对应的cell下一次update_cell_load
+		void set_space_setup(std::function<void(space_cells&)> setup)
+		{
+			m_space_setup = std::move(setup);
+		}
+		// 回放一条记录 到达末尾或者记录不完整时返回false 不完整的记录一般是写入时进程崩溃导致的
+		bool step();
+		// 回放到tick结束时的状态 即停在第一个大于tick的tick记录之前 没有tick记录时回放所有记录
+		// 返回是否到达了这个tick
+		bool replay_until(std::uint32_t tick);
+		// 第一条snapshot记录之前为nullptr
+		const space_cells* space() const
+		{
+			return m_space.get();
+		}
+		// 最近一条tick记录的值
+		std::uint32_t current_tick() const
+		{
+			return m_tick;
+		}
+		std::uint64_t record_num() const
+		{
+			return m_record_num;
+		}
+		// 回放时返回失败的调用数量 原来的调用同样失败时也会计入
+		std::uint64_t failed_num() const
+		{
+			return m_failed_num;
+		}
+		bool corrupted() const
+		{
+			return m_corrupted;
+		}
+	private:
+		// 下一条记录的op与tick值 不修改状态 没有完整的下一条记录时返回false
+		bool peek_tick(std::uint32_t& out_tick) const;
+		bool apply(space_journal_op op, std::string_view payload);
+	};
+}
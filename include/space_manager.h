@@ -0,0 +1,95 @@
+#pragma once
+#include "load_balance_controller.h"
+#include <memory>
+
+namespace spiritsaway::distributed_space
+{
+	struct space_manager_param
+	{
+		cell_load_balance_param lb_param;
+		load_balance_hysteresis_param hysteresis_param;
+		game_assign_param assign_param;
+		std::uint32_t max_operations_per_tick; // 所有space在一个tick内最多执行的负载均衡操作数量
+	};
+
+	// space_manager在一个tick内执行的一次负载均衡操作
+	struct space_balance_operation
+	{
+		std::string space_id;
+		cell_load_balance_operation op = cell_load_balance_operation::nothing;
+		// split时为被切分的cell shrink时为缩容的节点 remove时为被删除的cell
+		std::string cell_id;
+		// split时为新cell shrink时为接收区域的兄弟节点 remove时为接收区域的兄弟节点
+		std::string related_cell_id;
+		// split时新cell所在的game
+		std::string game_id;
+	};
+
+	// 管理共享同一个game池的多个space 例如大量的副本与战场实例
+	// 所有space共用一张game负载表与容量表 每个tick在全局的操作预算内调度负载均衡
+	// 每个space先通过自己的load_balance_controller选出一个候选操作 然后按照操作所涉及的game利用率从高到低执行
+	// 同一个space在一个tick内最多执行一个操作 remove操作只在预算有剩余时执行
+	// 使用方式:
+	// 1. register_game注册所有可以承载cell的game 之后每个tick通过update_game_load汇报game负载
+	// 2. 通过update_cell_load汇报每个cell的负载
+	// 3. 调用tick执行负载均衡 返回的split操作中的新cell需要在对应game创建完成之后通过get_space(space_id)->set_ready设置
+	// remove操作开始之后 cell内的real entity都迁移走之后需要调用finish_merge
+	class space_manager
+	{
+		struct space_info
+		{
+			std::unique_ptr<space_cells> cells;
+			std::unique_ptr<load_balance_controller> controller;
+			std::uint64_t cell_counter = 0;
+		};
+		space_manager_param m_param;
+		std::unordered_map<std::string, space_info> m_spaces;
+		std::unordered_map<std::string, float> m_game_loads;
+		std::unordered_map<std::string, float> m_game_capacities;
+		std::uint64_t m_tick = 0;
+		std::uint64_t m_operation_count = 0;
+	public:
+		explicit space_manager(const space_manager_param& in_param);
+		space_manager(const space_manager& other) = delete;
+		space_manager& operator=(const space_manager& other) = delete;
+
+		// 创建一个只有一个master cell的space master cell会被直接设置为ready
+		// space_id已经存在或者cell_id不合法时返回nullptr
+		space_cells* create_space(const std::string& space_id, const cell_bound& bound, const std::string& game_id, const std::string& cell_id, double ghost_radius);
+		bool destroy_space(const std::string& space_id);
+		space_cells* get_space(const std::string& space_id);
+		const space_cells* get_space(const std::string& space_id) const;
+		std::size_t space_num() const
+		{
+			return m_spaces.size();
+		}
+
+		// 注册或者更新一个game 容量会同步到所有的space
+		void register_game(const std::string& game_id, float capacity);
+		// 删除一个game 同时删除所有space中记录的容量 game没有注册时返回false
+		bool unregister_game(const std::string& game_id);
+		void update_game_load(const std::string& game_id, float game_load);
+		const std::unordered_map<std::string, float>& game_loads() const
+		{
+			return m_game_loads;
+		}
+		float game_utilization(const std::string& game_id) const;
+
+		bool update_cell_load(const std::string& space_id, const std::string& cell_id, float cell_load, const std::vector<entity_load>& new_entity_loads);
+		// 对应cell内已经没有real entity时调用 完成remove
+		bool finish_merge(const std::string& space_id, const std::string& cell_id);
+
+		// 执行一轮负载均衡 返回这个tick内执行的所有操作 数量不超过max_operations_per_tick
+		std::vector<space_balance_operation> tick();
+
+		std::uint64_t operation_count() const
+		{
+			return m_operation_count;
+		}
+	private:
+		// 候选操作的优先级 split为cell所在game的利用率 shrink为节点内所有game的平均利用率 remove为0
+		float calc_decision_priority(const load_balance_decision& cur_decision) const;
+		// 执行一个候选操作 失败时返回false
+		bool execute_decision(const std::string& space_id, space_info& cur_space_info, const load_balance_decision& cur_decision, space_balance_operation& out_operation);
+	};
+}
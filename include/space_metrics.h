@@ -0,0 +1,64 @@
+#pragma once
+#include "space_cells.h"
+#include <deque>
+
+namespace spiritsaway::distributed_space
+{
+	// 一组数值的最大值 平均值与标准差 数量为0时全部为0
+	struct load_summary
+	{
+		float max = 0;
+		float mean = 0;
+		float stddev = 0;
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(load_summary, max, mean, stddev)
+
+		static load_summary calc(const std::vector<float>& values);
+	};
+
+	struct cell_metrics
+	{
+		std::string cell_id;
+		std::string game_id;
+		float load = 0; // 最近一次汇报的负载
+		std::uint32_t real_num = 0;
+		std::uint32_t ghost_num = 0;
+		float ghost_ratio = 0; // ghost_num / real_num 没有real时为0
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(cell_metrics, cell_id, game_id, load, real_num, ghost_num, ghost_ratio)
+	};
+
+	// 一个space当前布局的质量 由space_cells::calc_metrics计算
+	struct space_metrics
+	{
+		std::uint32_t leaf_num = 0;
+		std::uint32_t ready_leaf_num = 0;
+		std::uint32_t max_depth = 0;
+		std::uint32_t game_num = 0; // 承载了叶子的game数量
+		load_summary cell_load;
+		load_summary game_load;
+		load_summary game_utilization; // game负载除以容量
+		std::uint64_t real_num = 0;
+		std::uint64_t ghost_num = 0;
+		float ghost_ratio = 0; // 所有cell的ghost总数除以real总数
+		std::vector<cell_metrics> cells; // 按照cell_id排序
+		space_op_counters total_ops; // 创建以来的累计数量
+		std::uint32_t window_ticks = 0; // window_ops覆盖的tick数量 没有使用space_metrics_window时为0
+		space_op_counters window_ops;
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(space_metrics, leaf_num, ready_leaf_num, max_depth, game_num, cell_load, game_load, game_utilization, real_num, ghost_num, ghost_ratio, cells, total_ops, window_ticks, window_ops)
+
+		json encode() const;
+		// prometheus的文本格式 所有指标以distributed_space_为前缀 并带上space=space_name的标签
+		// 累计的操作数量为counter 其他都是gauge 每个cell的指标额外带上cell与game标签
+		std::string to_prometheus(const std::string& space_name) const;
+	};
+
+	// 记录最近window_ticks个tick的累计操作数量 用来计算窗口内的操作与迁移数量
+	class space_metrics_window
+	{
+		std::uint32_t m_window_ticks;
+		std::deque<space_op_counters> m_history;
+	public:
+		explicit space_metrics_window(std::uint32_t window_ticks);
+		// 每个tick调用一次 记录cur_space当前的累计数量 然后填充metrics的window_ticks与window_ops
+		void on_tick(const space_cells& cur_space, space_metrics& metrics);
+	};
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include "space_cells.h"
+#include <string_view>
+#include <unordered_map>
+#include <limits>
+
+namespace spiritsaway::distributed_space
+{
+	// space_cells的二进制快照格式 所有结构都是定长的 文件可以直接mmap之后原地访问
+	// 布局为 header 节点数组 entity_load数组 game容量数组 字符串索引数组 字符串数据
+	// 所有偏移都相对于文件开头 并且按照8字节对齐 数值使用本机字节序
+	// 节点按照前序排列 父节点总是在子节点之前 每个叶子的entity_load在entity_load数组中是连续的一段
+	// 格式修改时需要增加space_snapshot_header::current_version
+	struct space_snapshot_header
+	{
+		static constexpr char magic_value[4] = { 'D', 'S', 'S', '1' };
+		static constexpr std::uint32_t current_version = 2;
+		char magic[4];
+		std::uint32_t version;
+		std::uint64_t total_size;
+		double ghost_radius;
+		std::uint64_t temp_node_counter;
+		std::uint32_t master_cell_id; // 字符串下标
+		std::uint32_t node_num;
+		std::uint64_t node_offset;
+		std::uint64_t entity_num;
+		std::uint64_t entity_offset;
+		std::uint32_t capacity_num;
+		std::uint32_t string_num;
+		std::uint64_t capacity_offset;
+		std::uint64_t string_index_offset;
+		std::uint64_t string_data_offset;
+	};
+
+	struct space_snapshot_node
+	{
+		static constexpr std::uint32_t invalid_idx = std::numeric_limits<std::uint32_t>::max();
+		cell_bound bound;
+		std::uint32_t space_id; // 字符串下标
+		std::uint32_t game_id; // 字符串下标
+		std::uint32_t parent; // 节点下标 根节点为invalid_idx
+		std::array<std::uint32_t, 2> children; // 节点下标 叶子节点为invalid_idx
+		std::uint8_t ready;
+		std::uint8_t is_merging;
+		std::uint8_t is_split_x;
+		std::uint8_t padding;
+		std::uint32_t host; // 字符串下标 只有没有ready的叶子才有 没有时为invalid_idx
+		std::array<float, 4> cell_loads;
+		std::uint32_t cell_load_counter;
+		std::uint32_t entity_num;
+		std::uint64_t entity_begin; // 在entity_load数组中的起始下标
+		bool is_leaf() const
+		{
+			return children[0] == invalid_idx;
+		}
+	};
+
+	struct space_snapshot_entity_load
+	{
+		point_xz pos;
+		float load;
+		std::uint32_t name; // 字符串下标
+		std::uint8_t is_real;
+		std::uint8_t padding[7];
+	};
+
+	struct space_snapshot_capacity
+	{
+		std::uint32_t game_id; // 字符串下标
+		float capacity;
+	};
+
+	struct space_snapshot_string
+	{
+		std::uint32_t offset; // 相对于string_data_offset
+		std::uint32_t size;
+	};
+
+	// 对一段快照数据的只读访问 不会复制数据 数据的生命周期需要覆盖这个view
+	class space_snapshot_view
+	{
+		const char* m_data = nullptr;
+		std::size_t m_size = 0;
+		const space_snapshot_header* m_header = nullptr;
+		const space_snapshot_node* m_nodes = nullptr;
+		const space_snapshot_entity_load* m_entity_loads = nullptr;
+		const space_snapshot_capacity* m_capacities = nullptr;
+		const space_snapshot_string* m_strings = nullptr;
+		// space_id到节点下标 key指向快照数据中的字符串 init时建立
+		std::unordered_map<std::string_view, std::uint32_t> m_node_idxes;
+	public:
+		// 检查magic 版本 对齐以及所有的下标与偏移 任何一项不合法时返回false
+		// data需要8字节对齐 mmap与new分配的内存都满足
+		bool init(const char* data, std::size_t size);
+		const space_snapshot_header& header() const
+		{
+			return *m_header;
+		}
+		std::uint32_t node_num() const
+		{
+			return m_header->node_num;
+		}
+		const space_snapshot_node& node(std::uint32_t idx) const
+		{
+			return m_nodes[idx];
+		}
+		// 叶子节点的entity_load 数量为node.entity_num
+		const space_snapshot_entity_load* entity_loads(const space_snapshot_node& cur_node) const
+		{
+			return m_entity_loads + cur_node.entity_begin;
+		}
+		std::uint32_t capacity_num() const
+		{
+			return m_header->capacity_num;
+		}
+		const space_snapshot_capacity& capacity(std::uint32_t idx) const
+		{
+			return m_capacities[idx];
+		}
+		std::string_view str(std::uint32_t idx) const
+		{
+			return std::string_view(m_data + m_header->string_data_offset + m_strings[idx].offset, m_strings[idx].size);
+		}
+		// 查找space_id对应的节点下标 找不到时返回invalid_idx
+		std::uint32_t find_node(std::string_view space_id) const;
+		// 坐标转换为T类型 double与float有显式实例化
+		template <typename T>
+		void to_entity_loads(const space_snapshot_node& cur_node, std::vector<basic_entity_load<T>>& out_entity_loads) const;
+	};
+
+	// 只读的把整个文件映射到内存 不支持mmap的平台上退化为把文件读到内存
+	class space_snapshot_file
+	{
+		const char* m_data = nullptr;
+		std::size_t m_size = 0;
+		std::string m_buffer;
+		bool m_is_mapped = false;
+	public:
+		space_snapshot_file() = default;
+		~space_snapshot_file();
+		space_snapshot_file(const space_snapshot_file& other) = delete;
+		space_snapshot_file& operator=(const space_snapshot_file& other) = delete;
+		bool open(const std::string& file_path);
+		void close();
+		const char* data() const
+		{
+			return m_data;
+		}
+		std::size_t size() const
+		{
+			return m_size;
+		}
+	};
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "space_cells.h"
+
+namespace spiritsaway::distributed_space
+{
+	// 拓扑增量中的记录类型 数值会发送给其他进程 只能在末尾追加
+	// 每条记录为一个json数组 第一个元素为op 后面为参数
+	enum class space_topology_op : std::uint8_t
+	{
+		create = 1, // [op, space_id, game_id, min_x, min_z, max_x, max_z, ready, is_merging] 新建一个还没有父节点的叶子节点
+		children, // [op, space_id, is_split_x, child_0, child_1] 设置子节点 split与内部节点重建 子节点为空字符串时变为叶子节点 即finish_merge
+		bound, // [op, space_id, min_x, min_z, max_x, max_z] 区域变化 即balance与start_merge
+		state, // [op, space_id, ready, is_merging] set_ready与start_merge
+		game, // [op, space_id, game_id] 所在game变化
+		remove, // [op, space_id] 删除节点 这个节点已经不在任何节点的子节点中
+		host, // [op, space_id, host_space_id] 没有ready的叶子的host变化 ready之后为空字符串
+	};
+
+	// 把space_cells的拓扑变化编码为增量 用来同步给只需要cell布局的game
+	// 增量只包含节点的区域 game 状态 host与父子关系 不包含entity_load与cell负载
+	// 通过与上一次发布的拓扑对比得到 因此不依赖具体的修改接口 两次发布之间的多个修改会合并为一个增量
+	// 增量格式为 {"version": v, "base_version": v - 1, "records": [...]}
+	// 根节点变化时(例如decode了另外一个space) 以及make_full的结果 会带有"reset": true 以及root master_cell_id ghost_radius
+	class space_topology_encoder
+	{
+		struct topology_node
+		{
+			cell_bound bound;
+			std::string game_id;
+			bool ready = false;
+			bool is_merging = false;
+			bool is_split_x = false;
+			std::array<std::string, 2> children; // 叶子节点为空字符串
+			std::string host;
+		};
+		std::unordered_map<std::string, topology_node> m_nodes;
+		std::vector<std::string> m_node_order; // 前序遍历的节点id 保证输出的记录顺序确定
+		std::string m_root_id;
+		std::string m_master_cell_id;
+		double m_ghost_radius = 0;
+		std::uint64_t m_version = 0;
+	public:
+		// 与上一次发布的拓扑对比 有变化时version加1并输出增量 没有变化时返回false
+		bool make_delta(const space_cells& cur_space, json& out_delta);
+		// 最近一次发布的完整拓扑 version与最近一次的增量相同 用于新加入的replica以及replica发现丢失增量之后的重新同步
+		json make_full() const;
+		std::uint64_t version() const
+		{
+			return m_version;
+		}
+	private:
+		static void collect(const space_cells& cur_space, std::unordered_map<std::string, topology_node>& out_nodes, std::vector<std::string>& out_order);
+		// 从空的拓扑创建出nodes需要的所有记录
+		static void add_full_records(const std::unordered_map<std::string, topology_node>& nodes, const std::vector<std::string>& order, json::array_t& out_records);
+		json make_reset(json::array_t&& records) const;
+	};
+
+	enum class space_topology_apply_result
+	{
+		ok,
+		stale, // version不大于当前version 重复或者乱序到达的增量 直接忽略
+		gap, // base_version与当前version不一致 中间有增量丢失 需要重新同步
+		invalid, // 增量格式错误或者与当前拓扑不一致 需要重新同步
+	};
+
+	// 通过space_topology_encoder的增量维护一个只有拓扑的space_cells副本
+	// 副本的叶子节点没有entity_load 可以用于query_leaf_for_point query_intersect_leafs等查询
+	// 创建之后以及返回gap或invalid之后 need_resync为true 此时只接受reset增量 即encoder的make_full
+	// 返回invalid时副本已经被部分修改 会被直接丢弃 space()在重新同步之前为nullptr
+	class space_topology_replica
+	{
+		std::unique_ptr<space_cells> m_space;
+		std::uint64_t m_version = 0;
+		bool m_need_resync = true;
+	public:
+		space_topology_apply_result apply(const json& delta);
+		// 第一次reset之前以及返回invalid之后为nullptr
+		const space_cells* space() const
+		{
+			return m_space.get();
+		}
+		std::uint64_t version() const
+		{
+			return m_version;
+		}
+		bool need_resync() const
+		{
+			return m_need_resync;
+		}
+	private:
+		bool apply_reset(const json& delta);
+		// reset_root_id非空时 执行完记录之后把这个节点作为根节点
+		bool apply_records(const json& records, const std::string& reset_root_id);
+		// 从根节点遍历 检查父子关系以及叶子与内部节点的索引 并且所有节点都可以从根节点到达
+		bool check_tree() const;
+	};
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+namespace spiritsaway::distributed_space
+{
+	// 固定线程数的简单线程池 用于并行的评估负载均衡候选节点以及计算ghost
+	class thread_pool
+	{
+		std::vector<std::thread> m_workers;
+		std::queue<std::function<void()>> m_tasks;
+		std::mutex m_task_mutex;
+		std::condition_variable m_task_cv;
+		bool m_stopped = false;
+	public:
+		explicit thread_pool(std::uint32_t thread_num);
+		~thread_pool();
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		std::uint32_t thread_num() const
+		{
+			return std::uint32_t(m_workers.size());
+		}
+
+		template <typename F>
+		std::future<std::invoke_result_t<F>> submit(F&& task)
+		{
+			using result_type = std::invoke_result_t<F>;
+			auto cur_task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(task));
+			auto result = cur_task->get_future();
+			{
+				std::lock_guard<std::mutex> cur_lock(m_task_mutex);
+				m_tasks.emplace([cur_task]()
+					{
+						(*cur_task)();
+					});
+			}
+			m_task_cv.notify_one();
+			return result;
+		}
+
+		// 将[0, total)切分为最多thread_num段 并行执行func(begin, end) 返回时所有段都已经执行完
+		void parallel_for(std::size_t total, const std::function<void(std::size_t, std::size_t)>& func);
+	private:
+		void worker_loop();
+	};
+}
@@ -0,0 +1,158 @@
+#include "entity_cost_model.h"
+#include <algorithm>
+#include <cmath>
+
+namespace spiritsaway::distributed_space
+{
+	template <typename T, std::uint32_t D>
+	void basic_linear_cost_model<T, D>::estimate(const std::vector<entity_load>& entity_loads, std::vector<float>& out_costs) const
+	{
+		out_costs.resize(entity_loads.size());
+		for (std::size_t i = 0; i < entity_loads.size(); i++)
+		{
+			out_costs[i] = entity_loads[i].load;
+		}
+	}
+
+	template <typename T, std::uint32_t D>
+	basic_aoi_density_cost_model<T, D>::basic_aoi_density_cost_model(double aoi_radius, float neighbor_weight)
+		: m_aoi_radius(aoi_radius)
+		, m_neighbor_weight(neighbor_weight)
+	{
+
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_aoi_density_cost_model<T, D>::count_neighbors(const std::vector<entity_load>& entity_loads, std::vector<std::uint32_t>& out_neighbor_nums) const
+	{
+		out_neighbor_nums.assign(entity_loads.size(), 0);
+		if (entity_loads.size() < 2 || m_aoi_radius <= 0)
+		{
+			return;
+		}
+		basic_point_xz<T, D> min_pos = entity_loads[0].pos;
+		basic_point_xz<T, D> max_pos = entity_loads[0].pos;
+		for (const auto& one_entity_load : entity_loads)
+		{
+			min_pos.x = std::min(min_pos.x, one_entity_load.pos.x);
+			min_pos.z = std::min(min_pos.z, one_entity_load.pos.z);
+			max_pos.x = std::max(max_pos.x, one_entity_load.pos.x);
+			max_pos.z = std::max(max_pos.z, one_entity_load.pos.z);
+		}
+		// 格子边长不小于aoi_radius 这样只需要检查周围3*3个格子 三维时格子仍然只划分水平面 比较距离时加上y
+		// entity分布稀疏时放大格子 使得格子数量不超过entity数量的量级
+		auto grid_size = std::max(m_aoi_radius, std::sqrt(double(max_pos.x - min_pos.x) * double(max_pos.z - min_pos.z) / entity_loads.size()));
+		auto grid_x_num = std::size_t((max_pos.x - min_pos.x) / grid_size) + 1;
+		auto grid_z_num = std::size_t((max_pos.z - min_pos.z) / grid_size) + 1;
+		auto grid_idx = [&](const basic_point_xz<T, D>& pos)
+		{
+			return std::size_t((pos.z - min_pos.z) / grid_size) * grid_x_num + std::size_t((pos.x - min_pos.x) / grid_size);
+		};
+		// 按照格子做计数排序 grid_begins[i]为第i个格子在sorted_entity_idxes中的起始位置
+		std::vector<std::uint32_t> grid_begins(grid_x_num * grid_z_num + 1, 0);
+		for (const auto& one_entity_load : entity_loads)
+		{
+			grid_begins[grid_idx(one_entity_load.pos) + 1]++;
+		}
+		for (std::size_t i = 1; i < grid_begins.size(); i++)
+		{
+			grid_begins[i] += grid_begins[i - 1];
+		}
+		std::vector<std::uint32_t> sorted_entity_idxes(entity_loads.size());
+		std::vector<std::uint32_t> grid_fill_pos(grid_begins.begin(), grid_begins.end() - 1);
+		for (std::uint32_t i = 0; i < entity_loads.size(); i++)
+		{
+			sorted_entity_idxes[grid_fill_pos[grid_idx(entity_loads[i].pos)]++] = i;
+		}
+		// 按照格子顺序拷贝坐标 让同一个格子内的entity在内存中连续
+		std::vector<basic_point_xz<T, D>> sorted_poses(entity_loads.size());
+		for (std::size_t i = 0; i < entity_loads.size(); i++)
+		{
+			sorted_poses[i] = entity_loads[sorted_entity_idxes[i]].pos;
+		}
+		std::vector<std::uint32_t> sorted_neighbor_nums(entity_loads.size(), 0);
+		auto aoi_radius_sq = m_aoi_radius * m_aoi_radius;
+		auto is_neighbor = [&](std::uint32_t i, std::uint32_t j)
+		{
+			auto diff_x = sorted_poses[i].x - sorted_poses[j].x;
+			auto diff_z = sorted_poses[i].z - sorted_poses[j].z;
+			auto dist_sq = diff_x * diff_x + diff_z * diff_z;
+			if constexpr (D == 3)
+			{
+				auto diff_y = sorted_poses[i].y - sorted_poses[j].y;
+				dist_sq += diff_y * diff_y;
+			}
+			return dist_sq <= aoi_radius_sq;
+		};
+		// 每一对entity只检查一次 同时给两边计数 因此每个格子只需要与自身以及一半的相邻格子比较
+		const std::array<std::array<int, 2>, 4> half_neighbor_offsets = { { {1, 0}, {-1, 1}, {0, 1}, {1, 1} } };
+		for (std::size_t grid_z = 0; grid_z < grid_z_num; grid_z++)
+		{
+			for (std::size_t grid_x = 0; grid_x < grid_x_num; grid_x++)
+			{
+				auto cur_grid_idx = grid_z * grid_x_num + grid_x;
+				auto cur_begin = grid_begins[cur_grid_idx];
+				auto cur_end = grid_begins[cur_grid_idx + 1];
+				for (auto i = cur_begin; i < cur_end; i++)
+				{
+					for (auto j = i + 1; j < cur_end; j++)
+					{
+						if (is_neighbor(i, j))
+						{
+							sorted_neighbor_nums[i]++;
+							sorted_neighbor_nums[j]++;
+						}
+					}
+				}
+				for (const auto& one_offset : half_neighbor_offsets)
+				{
+					auto other_grid_x = std::int64_t(grid_x) + one_offset[0];
+					auto other_grid_z = grid_z + one_offset[1];
+					if (other_grid_x < 0 || other_grid_x >= std::int64_t(grid_x_num) || other_grid_z >= grid_z_num)
+					{
+						continue;
+					}
+					auto other_grid_idx = other_grid_z * grid_x_num + std::size_t(other_grid_x);
+					auto other_begin = grid_begins[other_grid_idx];
+					auto other_end = grid_begins[other_grid_idx + 1];
+					for (auto i = cur_begin; i < cur_end; i++)
+					{
+						for (auto j = other_begin; j < other_end; j++)
+						{
+							if (is_neighbor(i, j))
+							{
+								sorted_neighbor_nums[i]++;
+								sorted_neighbor_nums[j]++;
+							}
+						}
+					}
+				}
+			}
+		}
+		for (std::size_t i = 0; i < entity_loads.size(); i++)
+		{
+			out_neighbor_nums[sorted_entity_idxes[i]] = sorted_neighbor_nums[i];
+		}
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_aoi_density_cost_model<T, D>::estimate(const std::vector<entity_load>& entity_loads, std::vector<float>& out_costs) const
+	{
+		std::vector<std::uint32_t> neighbor_nums;
+		count_neighbors(entity_loads, neighbor_nums);
+		out_costs.resize(entity_loads.size());
+		for (std::size_t i = 0; i < entity_loads.size(); i++)
+		{
+			out_costs[i] = entity_loads[i].load * (1 + m_neighbor_weight * neighbor_nums[i]);
+		}
+	}
+
+	template class basic_linear_cost_model<double>;
+	template class basic_linear_cost_model<float>;
+	template class basic_aoi_density_cost_model<double>;
+	template class basic_aoi_density_cost_model<float>;
+	template class basic_linear_cost_model<double, 3>;
+	template class basic_linear_cost_model<float, 3>;
+	template class basic_aoi_density_cost_model<double, 3>;
+	template class basic_aoi_density_cost_model<float, 3>;
+}
@@ -0,0 +1,255 @@
+#include "ghost_engine.h"
+
+namespace spiritsaway::distributed_space
+{
+	namespace
+	{
+		// 与query_leaf_for_point相同的规则 但是只沿着一条路径向下 不需要分配内存
+		// 点在两个子节点的分界线上时与query_leaf_for_point一样使用children[1]
+		const space_cells::space_node* find_real_leaf(const space_cells& cur_space, double x, double z)
+		{
+			auto cur_node = cur_space.root_node();
+			if (!cur_node->boundary().cover(x, z))
+			{
+				return nullptr;
+			}
+			while (!cur_node->is_leaf_cell())
+			{
+				const auto& cur_children = cur_node->children();
+				if (cur_children[1]->boundary().cover(x, z))
+				{
+					cur_node = cur_children[1];
+				}
+				else if (cur_children[0]->boundary().cover(x, z))
+				{
+					cur_node = cur_children[0];
+				}
+				else
+				{
+					return nullptr;
+				}
+			}
+			return cur_space.get_real_leaf(cur_node);
+		}
+
+		// 每一段entity的中间结果 段内按照entity顺序排列
+		struct ghost_segment
+		{
+			std::size_t begin = 0;
+			std::size_t end = 0;
+			std::vector<std::uint32_t> ghost_nums; // 段内每个entity的ghost cell数量
+			std::vector<std::uint32_t> ghost_cell_idxes;
+			std::vector<std::uint32_t> cell_offsets; // 先记录段内每个cell的entity数量 之后转换为在cell_entity_loads中的写入位置
+			std::vector<const space_cells::space_node*> query_buffer;
+		};
+	}
+
+	ghost_engine::ghost_engine(float ghost_load_ratio, ghost_shape in_ghost_shape)
+		: m_ghost_load_ratio(ghost_load_ratio)
+		, m_ghost_shape(in_ghost_shape)
+	{
+
+	}
+
+	void ghost_engine::compute(const space_cells& cur_space, const std::vector<entity_load>& entities, thread_pool* pool, ghost_compute_result& result) const
+	{
+		compute_impl(cur_space, entities, nullptr, pool, result);
+	}
+
+	void ghost_engine::compute(const space_cells& cur_space, const std::vector<entity_load>& entities, const std::vector<const space_cells::space_node*>& real_cells, thread_pool* pool, ghost_compute_result& result) const
+	{
+		if (real_cells.size() != entities.size())
+		{
+			result = ghost_compute_result{};
+			return;
+		}
+		compute_impl(cur_space, entities, &real_cells, pool, result);
+	}
+
+	void ghost_engine::compute_impl(const space_cells& cur_space, const std::vector<entity_load>& entities, const std::vector<const space_cells::space_node*>* real_cells, thread_pool* pool, ghost_compute_result& result) const
+	{
+		result.cells.clear();
+		std::unordered_map<const space_cells::space_node*, std::uint32_t> cell_idxes;
+		cell_idxes.reserve(cur_space.all_leafs().size());
+		for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+		{
+			cell_idxes[one_cell] = std::uint32_t(result.cells.size());
+			result.cells.push_back(one_cell);
+		}
+		auto cell_num = result.cells.size();
+		auto root = cur_space.root_node();
+		// 每个ghost_class的半径 避免在每个entity上查询
+		std::array<double, 256> class_radiuses;
+		for (std::size_t i = 0; i < class_radiuses.size(); i++)
+		{
+			class_radiuses[i] = cur_space.ghost_class_radius(std::uint8_t(i));
+		}
+		const bool is_circle = m_ghost_shape == ghost_shape::circle;
+
+		std::size_t segment_num = pool ? std::max<std::size_t>(1, std::min<std::size_t>(pool->thread_num(), entities.size())) : 1;
+		std::vector<ghost_segment> segments(segment_num);
+		auto segment_size = (entities.size() + segment_num - 1) / segment_num;
+		for (std::size_t i = 0; i < segment_num; i++)
+		{
+			segments[i].begin = std::min(entities.size(), i * segment_size);
+			segments[i].end = std::min(entities.size(), segments[i].begin + segment_size);
+		}
+		auto run_parallel = [pool](std::size_t total, const std::function<void(std::size_t)>& func)
+		{
+			if (!pool)
+			{
+				for (std::size_t i = 0; i < total; i++)
+				{
+					func(i);
+				}
+				return;
+			}
+			pool->parallel_for(total, [&func](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t i = begin; i < end; i++)
+					{
+						func(i);
+					}
+				});
+		};
+
+		// 第一遍 计算每个entity的real cell与ghost cell 并统计每一段在每个cell上的entity数量
+		result.real_cell_idxes.resize(entities.size());
+		run_parallel(segment_num, [&](std::size_t segment_idx)
+			{
+				auto& cur_segment = segments[segment_idx];
+				cur_segment.ghost_nums.assign(cur_segment.end - cur_segment.begin, 0);
+				cur_segment.cell_offsets.assign(cell_num, 0);
+				for (auto i = cur_segment.begin; i < cur_segment.end; i++)
+				{
+					const auto& cur_pos = entities[i].pos;
+					auto cur_real = real_cells ? (*real_cells)[i] : find_real_leaf(cur_space, cur_pos.x, cur_pos.z);
+					auto cur_real_iter = cur_real ? cell_idxes.find(cur_real) : cell_idxes.end();
+					if (cur_real_iter == cell_idxes.end())
+					{
+						result.real_cell_idxes[i] = ghost_compute_result::invalid_cell_idx;
+						continue;
+					}
+					auto cur_real_idx = cur_real_iter->second;
+					result.real_cell_idxes[i] = cur_real_idx;
+					cur_segment.cell_offsets[cur_real_idx]++;
+					const auto cur_ghost_radius = class_radiuses[entities[i].ghost_class];
+					const auto ghost_radius_sq = cur_ghost_radius * cur_ghost_radius;
+					cell_bound ghost_bound;
+					ghost_bound.min.x = cur_pos.x - cur_ghost_radius;
+					ghost_bound.min.z = cur_pos.z - cur_ghost_radius;
+					ghost_bound.max.x = cur_pos.x + cur_ghost_radius;
+					ghost_bound.max.z = cur_pos.z + cur_ghost_radius;
+					// ghost区域完全在real cell之内时不会与其他叶子相交 绝大部分entity都在这里返回
+					const auto& real_bound = cur_real->boundary();
+					if (ghost_bound.min.x >= real_bound.min.x && ghost_bound.max.x <= real_bound.max.x && ghost_bound.min.z >= real_bound.min.z && ghost_bound.max.z <= real_bound.max.z)
+					{
+						continue;
+					}
+					auto& cur_buffer = cur_segment.query_buffer;
+					cur_buffer.clear();
+					cur_buffer.push_back(root);
+					std::uint32_t cur_ghost_num = 0;
+					while (!cur_buffer.empty())
+					{
+						auto temp_top = cur_buffer.back();
+						cur_buffer.pop_back();
+						if (!temp_top->boundary().intersect(ghost_bound))
+						{
+							continue;
+						}
+						// 圆在正方形之内 先用正方形剪枝 再精确判断圆与区域是否相交
+						if (is_circle && !(temp_top->boundary().distance_sq(cur_pos) < ghost_radius_sq))
+						{
+							continue;
+						}
+						if (!temp_top->is_leaf_cell())
+						{
+							cur_buffer.push_back(temp_top->children()[0]);
+							cur_buffer.push_back(temp_top->children()[1]);
+							continue;
+						}
+						if (temp_top == cur_real)
+						{
+							continue;
+						}
+						auto cur_ghost_idx = cell_idxes.find(temp_top)->second;
+						cur_segment.ghost_cell_idxes.push_back(cur_ghost_idx);
+						cur_segment.cell_offsets[cur_ghost_idx]++;
+						cur_ghost_num++;
+					}
+					cur_segment.ghost_nums[i - cur_segment.begin] = cur_ghost_num;
+				}
+			});
+
+		// 合并每一段的ghost cell 同时把每一段的cell entity数量转换为写入位置 保证结果与串行计算相同
+		result.ghost_begins.resize(entities.size() + 1);
+		result.ghost_cell_idxes.clear();
+		std::uint32_t cur_ghost_begin = 0;
+		for (auto& one_segment : segments)
+		{
+			for (auto i = one_segment.begin; i < one_segment.end; i++)
+			{
+				result.ghost_begins[i] = cur_ghost_begin;
+				cur_ghost_begin += one_segment.ghost_nums[i - one_segment.begin];
+			}
+			result.ghost_cell_idxes.insert(result.ghost_cell_idxes.end(), one_segment.ghost_cell_idxes.begin(), one_segment.ghost_cell_idxes.end());
+		}
+		result.ghost_begins[entities.size()] = cur_ghost_begin;
+		result.cell_entity_loads.resize(cell_num);
+		for (std::size_t i = 0; i < cell_num; i++)
+		{
+			std::uint32_t cur_cell_entity_num = 0;
+			for (auto& one_segment : segments)
+			{
+				auto cur_segment_num = one_segment.cell_offsets[i];
+				one_segment.cell_offsets[i] = cur_cell_entity_num;
+				cur_cell_entity_num += cur_segment_num;
+			}
+			result.cell_entity_loads[i].resize(cur_cell_entity_num);
+		}
+
+		// 第二遍 每一段写入自己在每个cell上的区间 不同段之间没有重叠
+		run_parallel(segment_num, [&](std::size_t segment_idx)
+			{
+				auto& cur_segment = segments[segment_idx];
+				for (auto i = cur_segment.begin; i < cur_segment.end; i++)
+				{
+					auto cur_real_idx = result.real_cell_idxes[i];
+					if (cur_real_idx == ghost_compute_result::invalid_cell_idx)
+					{
+						continue;
+					}
+					const auto& cur_entity = entities[i];
+					auto& cur_real_load = result.cell_entity_loads[cur_real_idx][cur_segment.cell_offsets[cur_real_idx]++];
+					cur_real_load.pos = cur_entity.pos;
+					cur_real_load.load = cur_entity.load;
+					cur_real_load.is_real = true;
+					cur_real_load.name = cur_entity.name;
+					cur_real_load.ghost_class = cur_entity.ghost_class;
+					for (auto j = result.ghost_begins[i]; j < result.ghost_begins[i + 1]; j++)
+					{
+						auto cur_ghost_idx = result.ghost_cell_idxes[j];
+						auto& cur_ghost_load = result.cell_entity_loads[cur_ghost_idx][cur_segment.cell_offsets[cur_ghost_idx]++];
+						cur_ghost_load.pos = cur_entity.pos;
+						cur_ghost_load.load = cur_entity.load * m_ghost_load_ratio;
+						cur_ghost_load.is_real = false;
+						cur_ghost_load.name = cur_entity.name;
+						cur_ghost_load.ghost_class = cur_entity.ghost_class;
+					}
+				}
+			});
+
+		// 按照cell内的entity顺序求和 不受分段的影响
+		result.cell_loads.assign(cell_num, 0);
+		run_parallel(cell_num, [&](std::size_t cell_idx)
+			{
+				float cur_load = 0;
+				for (const auto& one_entity_load : result.cell_entity_loads[cell_idx])
+				{
+					cur_load += one_entity_load.load;
+				}
+				result.cell_loads[cell_idx] = cur_load;
+			});
+	}
+}
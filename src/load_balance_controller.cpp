@@ -0,0 +1,244 @@
+#include "load_balance_controller.h"
+
+namespace spiritsaway::distributed_space
+{
+	load_balance_controller::load_balance_controller(const cell_load_balance_param& lb_param, const load_balance_hysteresis_param& hysteresis_param)
+		: m_lb_param(lb_param)
+		, m_hysteresis_param(hysteresis_param)
+	{
+
+	}
+
+	void load_balance_controller::tick()
+	{
+		m_tick++;
+		while (!m_recent_operations.empty() && m_recent_operations.front().tick + m_hysteresis_param.oscillation_window_ticks < m_tick)
+		{
+			m_recent_operations.pop_front();
+		}
+		// 冷却已经结束的记录与没有记录等价 内部节点的id不会复用 不清理的话这两个map会一直增长
+		erase_expired_ticks(m_cell_last_op_ticks, m_hysteresis_param.cell_cooldown_ticks);
+		erase_expired_ticks(m_game_last_op_ticks, m_hysteresis_param.game_cooldown_ticks);
+	}
+
+	void load_balance_controller::erase_expired_ticks(std::unordered_map<std::string, std::uint64_t>& last_op_ticks, std::uint32_t cooldown_ticks) const
+	{
+		for (auto cur_iter = last_op_ticks.begin(); cur_iter != last_op_ticks.end();)
+		{
+			if (cur_iter->second + cooldown_ticks <= m_tick)
+			{
+				cur_iter = last_op_ticks.erase(cur_iter);
+			}
+			else
+			{
+				cur_iter++;
+			}
+		}
+	}
+
+	bool load_balance_controller::check_game_cooldown(const std::string& game_id) const
+	{
+		auto cur_iter = m_game_last_op_ticks.find(game_id);
+		if (cur_iter == m_game_last_op_ticks.end())
+		{
+			return true;
+		}
+		return cur_iter->second + m_hysteresis_param.game_cooldown_ticks <= m_tick;
+	}
+
+	bool load_balance_controller::check_cooldown(const space_cells::space_node* cur_node) const
+	{
+		if (!cur_node)
+		{
+			return false;
+		}
+		std::vector<const space_cells::space_node*> temp_query_buffer;
+		temp_query_buffer.push_back(cur_node);
+		while (!temp_query_buffer.empty())
+		{
+			auto temp_top = temp_query_buffer.back();
+			temp_query_buffer.pop_back();
+			auto cur_iter = m_cell_last_op_ticks.find(temp_top->space_id());
+			if (cur_iter != m_cell_last_op_ticks.end() && cur_iter->second + m_hysteresis_param.cell_cooldown_ticks > m_tick)
+			{
+				return false;
+			}
+			if (temp_top->is_leaf_cell())
+			{
+				if (!check_game_cooldown(temp_top->game_id()))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				temp_query_buffer.push_back(temp_top->children()[0]);
+				temp_query_buffer.push_back(temp_top->children()[1]);
+			}
+		}
+		return true;
+	}
+
+	void load_balance_controller::mark_operation(const space_cells::space_node* cur_node)
+	{
+		if (!cur_node)
+		{
+			return;
+		}
+		std::vector<const space_cells::space_node*> temp_query_buffer;
+		temp_query_buffer.push_back(cur_node);
+		while (!temp_query_buffer.empty())
+		{
+			auto temp_top = temp_query_buffer.back();
+			temp_query_buffer.pop_back();
+			m_cell_last_op_ticks[temp_top->space_id()] = m_tick;
+			if (temp_top->is_leaf_cell())
+			{
+				m_game_last_op_ticks[temp_top->game_id()] = m_tick;
+			}
+			else
+			{
+				temp_query_buffer.push_back(temp_top->children()[0]);
+				temp_query_buffer.push_back(temp_top->children()[1]);
+			}
+		}
+	}
+
+	const space_cells::space_node* load_balance_controller::get_best_cell_to_split(const space_cells& cur_space, const std::unordered_map<std::string, float>& game_loads) const
+	{
+		return cur_space.get_best_cell_to_split(game_loads, m_lb_param, [this](const space_cells::space_node* cur_node)
+			{
+				return check_cooldown(cur_node);
+			});
+	}
+
+	const space_cells::space_node* load_balance_controller::get_best_node_to_shrink(space_cells& cur_space) const
+	{
+		return cur_space.get_best_node_to_shrink(m_lb_param, [this](const space_cells::space_node* cur_node)
+			{
+				return check_cooldown(cur_node) && check_cooldown(cur_node->sibling());
+			});
+	}
+
+	const space_cells::space_node* load_balance_controller::get_best_cell_to_merge(space_cells& cur_space) const
+	{
+		return cur_space.get_best_cell_to_merge(m_lb_param, [this, &cur_space](const space_cells::space_node* cur_node)
+			{
+				auto cur_create_iter = m_cell_create_ticks.find(cur_node->space_id());
+				if (cur_create_iter != m_cell_create_ticks.end() && cur_create_iter->second + m_hysteresis_param.min_cell_lifetime_ticks > m_tick)
+				{
+					return false;
+				}
+				auto cur_sibling = cur_node->sibling();
+				if (!check_cooldown(cur_node) || !check_cooldown(cur_sibling))
+				{
+					return false;
+				}
+				if (cur_sibling->is_leaf_cell())
+				{
+					// 合并之后的负载由兄弟节点所在的game承担
+					auto merged_load = (cur_node->get_smoothed_load() + cur_sibling->get_smoothed_load()) / cur_space.game_capacity(cur_sibling->game_id());
+					if (merged_load >= m_lb_param.min_cell_load_when_split * m_hysteresis_param.max_merged_load_ratio_when_remove)
+					{
+						return false;
+					}
+				}
+				return true;
+			});
+	}
+
+	load_balance_decision load_balance_controller::decide(space_cells& cur_space, const std::unordered_map<std::string, float>& game_loads) const
+	{
+		load_balance_decision result;
+		result.node = get_best_node_to_shrink(cur_space);
+		if (result.node)
+		{
+			result.op = cell_load_balance_operation::shrink;
+			return result;
+		}
+		result.node = get_best_cell_to_split(cur_space, game_loads);
+		if (result.node)
+		{
+			result.op = cell_load_balance_operation::split;
+			return result;
+		}
+		result.node = get_best_cell_to_merge(cur_space);
+		if (result.node)
+		{
+			result.op = cell_load_balance_operation::remove;
+			return result;
+		}
+		return result;
+	}
+
+	void load_balance_controller::add_record(const operation_record& new_record)
+	{
+		m_operation_count++;
+		for (auto cur_iter = m_recent_operations.begin(); cur_iter != m_recent_operations.end(); cur_iter++)
+		{
+			bool is_reversed = false;
+			switch (new_record.op)
+			{
+			case cell_load_balance_operation::split:
+				// 之前被合并进来的区域又被split出去
+				is_reversed = cur_iter->op == cell_load_balance_operation::remove && cur_iter->related_id == new_record.space_id;
+				break;
+			case cell_load_balance_operation::remove:
+				// 之前split出来的cell或者被split的原cell被删除
+				is_reversed = cur_iter->op == cell_load_balance_operation::split && (cur_iter->related_id == new_record.space_id || cur_iter->space_id == new_record.space_id);
+				break;
+			case cell_load_balance_operation::shrink:
+				// 同一个分割线先后朝两个方向移动
+				is_reversed = cur_iter->op == cell_load_balance_operation::shrink && cur_iter->space_id == new_record.space_id && cur_iter->related_id != new_record.related_id;
+				break;
+			default:
+				break;
+			}
+			if (is_reversed)
+			{
+				m_oscillation_count++;
+				m_recent_operations.erase(cur_iter);
+				return;
+			}
+		}
+		m_recent_operations.push_back(new_record);
+	}
+
+	void load_balance_controller::on_split(const space_cells::space_node* origin_cell, const space_cells::space_node* new_cell)
+	{
+		if (!origin_cell || !new_cell)
+		{
+			return;
+		}
+		m_cell_create_ticks[new_cell->space_id()] = m_tick;
+		mark_operation(origin_cell);
+		mark_operation(new_cell);
+		add_record(operation_record{ m_tick, cell_load_balance_operation::split, origin_cell->space_id(), new_cell->space_id() });
+	}
+
+	void load_balance_controller::on_shrink(const space_cells::space_node* shrink_node)
+	{
+		if (!shrink_node || !shrink_node->parent())
+		{
+			return;
+		}
+		auto cur_parent = shrink_node->parent();
+		mark_operation(cur_parent);
+		add_record(operation_record{ m_tick, cell_load_balance_operation::shrink, cur_parent->space_id(), cur_parent->children()[0] == shrink_node ? "0" : "1" });
+	}
+
+	void load_balance_controller::on_start_merge(const space_cells::space_node* merge_cell)
+	{
+		if (!merge_cell || !merge_cell->sibling())
+		{
+			return;
+		}
+		auto cur_sibling = merge_cell->sibling();
+		mark_operation(merge_cell);
+		mark_operation(cur_sibling);
+		// 被删除的cell不会再被查询 只保留其所在game的冷却记录
+		m_cell_last_op_ticks.erase(merge_cell->space_id());
+		m_cell_create_ticks.erase(merge_cell->space_id());
+		add_record(operation_record{ m_tick, cell_load_balance_operation::remove, merge_cell->space_id(), cur_sibling->space_id() });
+	}
+}
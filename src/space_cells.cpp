@@ -1,4 +1,13 @@
 #include "space_cells.h"
+#include "entity_cost_model.h"
+#include "space_metrics.h"
+#include "space_journal.h"
+#include "space_snapshot.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
 
 namespace 
 {
@@ -37,15 +46,93 @@ namespace
 			}
 		}
 	};
+
+	// 从根节点开始查找被covers覆盖的叶子节点 query_leaf_for_point的二维与三维版本共用 不检查叶子是否ready
+	template <typename N, typename F>
+	const N* query_leaf_by_cover(const N* root_node, F&& covers)
+	{
+		std::vector<const N*> temp_query_buffer;
+		temp_query_buffer.push_back(root_node);
+		while(!temp_query_buffer.empty())
+		{
+			auto temp_top = temp_query_buffer.back();
+			temp_query_buffer.pop_back();
+			if(!covers(temp_top->boundary()))
+			{
+				continue;
+			}
+			if(temp_top->is_leaf_cell())
+			{
+				return temp_top;
+			}
+			else
+			{
+				temp_query_buffer.push_back(temp_top->children()[0]);
+				temp_query_buffer.push_back(temp_top->children()[1]);
+			}
+		}
+		return nullptr;
+	}
+
+	// 从根节点开始收集所有满足filter的叶子节点 filter同时用来剪枝内部节点
+	template <typename N, typename F>
+	std::vector<const N*> query_leafs_by_filter(const N* root_node, F&& filter)
+	{
+		std::vector<const N*> temp_query_buffer;
+		temp_query_buffer.push_back(root_node);
+		std::vector<const N*> result;
+		while(!temp_query_buffer.empty())
+		{
+			auto temp_top = temp_query_buffer.back();
+			temp_query_buffer.pop_back();
+			if(!filter(temp_top->boundary()))
+			{
+				continue;
+			}
+			if(temp_top->is_leaf_cell())
+			{
+				result.push_back(temp_top);
+			}
+			else
+			{
+				temp_query_buffer.push_back(temp_top->children()[0]);
+				temp_query_buffer.push_back(temp_top->children()[1]);
+			}
+		}
+		return result;
+	}
+
+	// 所有点到bound的距离的平方 coords[i]为所有点第i个坐标轴的连续数组
+	// 按坐标轴逐个累加 内层循环没有分支 float时可以一次处理更多的点
+	template <typename B, typename T, std::size_t D>
+	void calc_distance_sq(const B& bound, const std::array<std::vector<T>, D>& coords, std::vector<T>& out_distance_sq)
+	{
+		const auto point_num = coords[0].size();
+		out_distance_sq.assign(point_num, T(0));
+		T* result_data = out_distance_sq.data();
+		for (std::size_t i = 0; i < D; i++)
+		{
+			const T* cur_coords = coords[i].data();
+			const T cur_min = bound.min[i];
+			const T cur_max = bound.max[i];
+			for (std::size_t j = 0; j < point_num; j++)
+			{
+				T diff = std::max(std::max(cur_min - cur_coords[j], cur_coords[j] - cur_max), T(0));
+				result_data[j] += diff * diff;
+			}
+		}
+	}
 }
 namespace spiritsaway::distributed_space
 {
-	json entity_load::encode() const
+	template <typename T, std::uint32_t D>
+	json basic_entity_load<T, D>::encode() const
 	{
 		return json(*this);
 	}
 
-	bool entity_load::decode(const json& data)
+	template <typename T, std::uint32_t D>
+	bool basic_entity_load<T, D>::decode(const json& data)
 	{
 		try
 		{
@@ -57,27 +144,45 @@ namespace spiritsaway::distributed_space
 			return false;
 		}
 	}
-	bool cell_bound::intersect(const cell_bound& other) const
+	template <typename T, std::uint32_t D>
+	bool basic_cell_bound<T, D>::intersect(const basic_cell_bound& other) const
 	{
-		if(min.x >= other.max.x)
+		for (std::uint32_t i = 0; i < D; i++)
 		{
-			return false;
-		}
-		if(max.x <= other.min.x)
-		{
-			return false;
+			if (min[i] >= other.max[i])
+			{
+				return false;
+			}
+			if (max[i] <= other.min[i])
+			{
+				return false;
+			}
 		}
-		if(min.z >= other.max.z)
+		return true;
+	}
+	// 进入一个公开接口时构造 只有最外层的调用会拿到非空的journal
+	// 例如split_k内部调用的split_x不需要记录 回放split_k时会重新执行
+	// journal的格式是二维的 三维时m_journal总是为空
+	template <typename T, std::uint32_t D>
+	class basic_space_cells<T, D>::journal_scope
+	{
+		basic_space_cells& m_space;
+	public:
+		space_journal_writer* const journal;
+		explicit journal_scope(basic_space_cells& cur_space)
+			: m_space(cur_space)
+			, journal(cur_space.m_journal_depth++ == 0 ? cur_space.m_journal : nullptr)
 		{
-			return false;
+
 		}
-		if(max.z <= other.min.z)
+		~journal_scope()
 		{
-			return false;
+			m_space.m_journal_depth--;
 		}
-		return true;
-	}
-	space_cells::space_cells(const cell_bound& bound, const std::string& game_id, const std::string& space_id, double in_ghost_radius)
+	};
+
+	template <typename T, std::uint32_t D>
+	basic_space_cells<T, D>::basic_space_cells(const cell_bound& bound, const std::string& game_id, const std::string& space_id, double in_ghost_radius)
 	: m_root_node(new space_node(bound, game_id, space_id, nullptr))
 	{
 		m_leaf_nodes[space_id] = m_root_node;
@@ -85,7 +190,8 @@ namespace spiritsaway::distributed_space
 		m_ghost_radius = in_ghost_radius;
 	}
 
-	const space_cells::space_node* space_cells::space_node::sibling() const
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::space_node::sibling() const
 	{
 		if(!m_parent)
 		{
@@ -100,15 +206,19 @@ namespace spiritsaway::distributed_space
 			return m_parent->m_children[0];
 		}
 	}
-	void space_cells::space_node::set_ready()
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::set_ready()
 	{
 		m_ready = true;
+		m_host_space_id.clear();
 	}
-	void space_cells::space_node::set_is_merging()
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::set_is_merging()
 	{
 		m_is_merging = true;
 	}
-	float space_cells::space_node::get_smoothed_load() const
+	template <typename T, std::uint32_t D>
+	float basic_space_cells<T, D>::space_node::get_smoothed_load() const
 	{
 		float square_sum = 0;
 		float total_weights = 0.01f;
@@ -130,81 +240,156 @@ namespace spiritsaway::distributed_space
 		return std::sqrt(square_sum/total_weights);
 	}
 	
-	void space_cells::space_node::update_load(float cur_load, const std::vector<entity_load>& new_entity_loads)
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::update_load(float cur_load, const std::vector<entity_load>& new_entity_loads, std::vector<float>& new_entity_costs)
 	{
 		m_cell_load_report_counter++;
 		m_cell_loads[m_cell_load_report_counter % m_cell_loads.size()] = cur_load;
+		// 拷贝赋值在容量不足时只会申请刚好够用的大小 这里按倍数扩容 entity数量缓慢增长时不需要每次汇报都重新申请
+		if (new_entity_loads.size() > m_entity_loads.capacity())
+		{
+			m_entity_loads.clear();
+			m_entity_loads.reserve(std::max(new_entity_loads.size(), m_entity_loads.capacity() * 2));
+		}
 		m_entity_loads = new_entity_loads;
+		// 拷贝赋值与clear都会保留原来的容量 汇报的entity数量稳定时不需要重新申请内存
+		if (new_entity_costs.empty())
+		{
+			m_entity_costs.clear();
+		}
+		else
+		{
+			m_entity_costs.swap(new_entity_costs);
+		}
 		make_sorted_loads();
 	}
 
-	void space_cells::space_node::make_sorted_loads()
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::reset(const cell_bound& in_bound, const std::string& in_game_id, const std::string& in_space_id, space_node* in_parent)
 	{
-		m_sorted_entity_load_idx_by_axis[0].resize(m_entity_loads.size(), 0);
-		m_sorted_entity_load_idx_by_axis[1].resize(m_entity_loads.size(), 0);
-		for (std::uint16_t i = 0; i < m_entity_loads.size(); i++)
-		{
-			m_sorted_entity_load_idx_by_axis[0][i] = i;
-			m_sorted_entity_load_idx_by_axis[1][i] = i;
-		}
-		std::sort(m_sorted_entity_load_idx_by_axis[0].begin(), m_sorted_entity_load_idx_by_axis[0].end(), [this](std::uint16_t a, std::uint16_t b)
-			{
-				return this->get_entity_loads()[a].pos.x < this->get_entity_loads()[b].pos.x;
-			});
-		std::sort(m_sorted_entity_load_idx_by_axis[1].begin(), m_sorted_entity_load_idx_by_axis[1].end(), [this](std::uint16_t a, std::uint16_t b)
-			{
-				return this->get_entity_loads()[a].pos.z < this->get_entity_loads()[b].pos.z;
-			});
+		m_space_id = in_space_id;
+		m_game_id = in_game_id;
+		m_boundary = in_bound;
+		m_children = { nullptr, nullptr };
+		m_parent = in_parent;
+		m_ready = false;
+		m_is_merging = false;
+		m_host_space_id.clear();
+		m_split_axis = 1;
+		std::fill(m_cell_loads.begin(), m_cell_loads.end(), 0.0f);
+		m_entity_loads.clear();
+		m_entity_costs.clear();
+		for (std::uint32_t i = 0; i < D; i++)
+		{
+			m_sorted_entity_load_idx_by_axis[i].clear();
+			m_sorted_entity_load_prefix_by_axis[i].clear();
+		}
+		m_cell_load_report_counter = 0;
+		m_real_entity_num = 0;
+		m_child_leaf.clear();
+		m_child_games.clear();
+		m_total_cell_load = 0;
+		m_total_game_load = 0;
+		m_total_game_capacity = 0;
+		m_min_cell_load_report_counter = 0;
 	}
-	space_cells::space_node* space_cells::space_node::split_x(double x, const std::string& new_space_game_id, const std::string& left_space_id, const std::string& right_space_id, const std::string& new_parent_space_id)
+
+	template <typename T, std::uint32_t D>
+	basic_space_cells<T, D>::space_node_pool::~space_node_pool()
 	{
-		if(!is_leaf_cell())
+		for (auto one_node : m_free_nodes)
 		{
-			return nullptr;
+			delete one_node;
 		}
-		if(x <= m_boundary.min.x || x >= m_boundary.max.x)
+	}
+
+	template <typename T, std::uint32_t D>
+	typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::space_node_pool::create(const cell_bound& in_bound, const std::string& in_game_id, const std::string& in_space_id, space_node* in_parent)
+	{
+		if (m_free_nodes.empty())
 		{
-			return nullptr;
+			return new space_node(in_bound, in_game_id, in_space_id, in_parent);
 		}
-		if(m_space_id != left_space_id && m_space_id != right_space_id)
+		auto result = m_free_nodes.back();
+		m_free_nodes.pop_back();
+		result->reset(in_bound, in_game_id, in_space_id, in_parent);
+		return result;
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node_pool::recycle(space_node* cur_node)
+	{
+		if (m_free_nodes.size() >= max_free_num)
 		{
-			return nullptr;
+			delete cur_node;
+			return;
 		}
-		cell_bound left_boundary, right_boundary;
-		left_boundary = right_boundary = m_boundary;
-		left_boundary.max.x = x;
-		right_boundary.min.x = x;
-		m_is_split_x = true;
-		m_children[0] = new space_node(left_boundary, m_game_id, left_space_id, this);
-		m_children[1] = new space_node(right_boundary, m_game_id, right_space_id, this);
-		auto pre_space_id = m_space_id;
-		
-		int master_cell_idx = 0;
-		if (pre_space_id != left_space_id)
+		// 提前申请好容量 避免回收时push_back申请内存
+		if (m_free_nodes.capacity() < max_free_num)
 		{
-			master_cell_idx = 1;
+			m_free_nodes.reserve(max_free_num);
 		}
-		on_split(master_cell_idx);
-		m_children[1 - master_cell_idx]->m_game_id = new_space_game_id;
-		m_space_id = new_parent_space_id;
-		return m_children[1 - master_cell_idx];
+		m_free_nodes.push_back(cur_node);
 	}
 
-	void space_cells::space_node::on_split(int master_child_index)
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::make_sorted_loads()
 	{
-		m_children[master_child_index]->m_cell_loads[1] = get_latest_load();
-		m_children[master_child_index]->m_cell_load_report_counter = 1;
-		m_children[master_child_index]->m_entity_loads = std::move(m_entity_loads);
-		m_children[master_child_index]->m_sorted_entity_load_idx_by_axis = std::move(m_sorted_entity_load_idx_by_axis);
-		m_children[master_child_index]->set_ready();
+		m_real_entity_num = std::uint32_t(std::count_if(m_entity_loads.begin(), m_entity_loads.end(), [](const entity_load& one_entity_load)
+			{
+				return one_entity_load.is_real;
+			}));
+		// 其他数组的容量跟随m_entity_loads 与其一起按倍数扩容
+		auto cur_capacity = m_entity_loads.capacity();
+		m_entity_costs.reserve(cur_capacity);
+		for (std::uint32_t i = 0; i < D; i++)
+		{
+			m_sorted_entity_load_idx_by_axis[i].reserve(cur_capacity);
+			m_sorted_entity_load_prefix_by_axis[i].reserve(cur_capacity + 1);
+		}
+		if (m_entity_costs.size() != m_entity_loads.size())
+		{
+			m_entity_costs.resize(m_entity_loads.size());
+			for (std::size_t i = 0; i < m_entity_loads.size(); i++)
+			{
+				m_entity_costs[i] = m_entity_loads[i].load;
+			}
+		}
+		for (std::uint32_t i = 0; i < D; i++)
+		{
+			auto& cur_sorted_idx = m_sorted_entity_load_idx_by_axis[i];
+			cur_sorted_idx.resize(m_entity_loads.size(), 0);
+			for (std::uint32_t j = 0; j < m_entity_loads.size(); j++)
+			{
+				cur_sorted_idx[j] = j;
+			}
+			std::sort(cur_sorted_idx.begin(), cur_sorted_idx.end(), [this, i](std::uint32_t a, std::uint32_t b)
+				{
+					return this->get_entity_loads()[a].pos[i] < this->get_entity_loads()[b].pos[i];
+				});
+		}
+		for (std::uint32_t i = 0; i < D; i++)
+		{
+			m_sorted_entity_load_prefix_by_axis[i].resize(m_entity_loads.size() + 1);
+			m_sorted_entity_load_prefix_by_axis[i][0] = 0;
+			for (std::size_t j = 0; j < m_entity_loads.size(); j++)
+			{
+				m_sorted_entity_load_prefix_by_axis[i][j + 1] = m_sorted_entity_load_prefix_by_axis[i][j] + m_entity_costs[m_sorted_entity_load_idx_by_axis[i][j]];
+			}
+		}
 	}
-	space_cells::space_node* space_cells::space_node::split_z(double z, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& high_space_id, const std::string& new_parent_space_id)
+	template <typename T, std::uint32_t D>
+	typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::space_node::split(space_node_pool& node_pool, int axis, double split_pos, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& high_space_id, const std::string& new_parent_space_id)
 	{
 		if(!is_leaf_cell())
 		{
 			return nullptr;
 		}
-		if(z <= m_boundary.min.z || z >= m_boundary.max.z)
+		if(axis < 0 || axis >= int(D))
+		{
+			return nullptr;
+		}
+		if(split_pos <= m_boundary.min[axis] || split_pos >= m_boundary.max[axis])
 		{
 			return nullptr;
 		}
@@ -212,13 +397,13 @@ namespace spiritsaway::distributed_space
 		{
 			return nullptr;
 		}
-		m_is_split_x = false;
 		cell_bound low_boundary, high_boundary;
 		low_boundary = high_boundary = m_boundary;
-		low_boundary.max.z = z;
-		high_boundary.min.z = z;
-		m_children[0] = new space_node(low_boundary, m_game_id, low_space_id, this);
-		m_children[1] = new space_node(high_boundary, m_game_id, high_space_id, this);
+		low_boundary.max[axis] = T(split_pos);
+		high_boundary.min[axis] = T(split_pos);
+		m_split_axis = std::uint8_t(axis);
+		m_children[0] = node_pool.create(low_boundary, m_game_id, low_space_id, this);
+		m_children[1] = node_pool.create(high_boundary, m_game_id, high_space_id, this);
 		auto pre_space_id = m_space_id;
 		
 		int master_cell_idx = 0;
@@ -228,10 +413,29 @@ namespace spiritsaway::distributed_space
 		}
 		on_split(master_cell_idx);
 		m_children[1 - master_cell_idx]->m_game_id = new_space_game_id;
+		m_children[1 - master_cell_idx]->m_host_space_id = pre_space_id;
+		m_host_space_id.clear();
 		m_space_id = new_parent_space_id;
 		return m_children[1 - master_cell_idx];
 	}
-	json space_cells::space_node::encode() const
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::on_split(int master_child_index)
+	{
+		m_children[master_child_index]->m_cell_loads[1] = get_latest_load();
+		m_children[master_child_index]->m_cell_load_report_counter = 1;
+		// 新的子节点中是清空的vector 交换之后当前节点保留这些容量 merge时再交换回来
+		auto master_child = m_children[master_child_index];
+		master_child->m_entity_loads.swap(m_entity_loads);
+		master_child->m_real_entity_num = m_real_entity_num;
+		m_real_entity_num = 0;
+		master_child->m_entity_costs.swap(m_entity_costs);
+		master_child->m_sorted_entity_load_idx_by_axis.swap(m_sorted_entity_load_idx_by_axis);
+		master_child->m_sorted_entity_load_prefix_by_axis.swap(m_sorted_entity_load_prefix_by_axis);
+		m_children[master_child_index]->set_ready();
+	}
+	template <typename T, std::uint32_t D>
+	json basic_space_cells<T, D>::space_node::encode() const
 	{
 		json result;
 		result["space_id"] = m_space_id;
@@ -253,18 +457,27 @@ namespace spiritsaway::distributed_space
 		result["is_merging"] = m_is_merging;
 		if (!is_leaf_cell())
 		{
-			result["is_split_x"] = m_is_split_x;
+			result["is_split_x"] = is_split_x();
+			if constexpr (D == 3)
+			{
+				result["split_axis"] = m_split_axis;
+			}
 		}
 		else
 		{
 			result["entity_loads"] = m_entity_loads;
 			result["cell_loads"] = m_cell_loads;
 			result["cell_load_counter"] = m_cell_load_report_counter;
+			if (!m_host_space_id.empty())
+			{
+				result["host"] = m_host_space_id;
+			}
 		}
 		
 		return result;
 	}
-	bool space_cells::space_node::set_child(int index, space_node* new_child)
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::space_node::set_child(int index, space_node* new_child)
 	{
 		if(index != 0 && index != 1)
 		{
@@ -278,42 +491,29 @@ namespace spiritsaway::distributed_space
 		return true;
 	}
 
-	float space_cells::space_node::get_latest_load() const
+	template <typename T, std::uint32_t D>
+	float basic_space_cells<T, D>::space_node::get_latest_load() const
 	{
 		return m_cell_loads[m_cell_load_report_counter % m_cell_loads.size()];
 	}
-	bool space_cells::space_node::balance(double split_v)
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::space_node::balance(double split_v)
 	{
 		if(is_leaf_cell())
 		{
 			return false;
 		}
-		if(m_is_split_x)
+		int axis = m_split_axis;
+		if(m_children[0]->m_boundary.min[axis] == m_children[1]->m_boundary.min[axis])
 		{
-			if(m_children[0]->m_boundary.min.x == m_children[1]->m_boundary.min.x)
-			{
-				return false;
-			}
-			if(split_v <= m_children[0]->m_boundary.min.x || split_v >= m_children[1]->m_boundary.max.x)
-			{
-				return false;
-			}
-			m_children[0]->m_boundary.max.x = split_v;
-			m_children[1]->m_boundary.min.x = split_v;
+			return false;
 		}
-		else
+		if(split_v <= m_children[0]->m_boundary.min[axis] || split_v >= m_children[1]->m_boundary.max[axis])
 		{
-			if(m_children[0]->m_boundary.min.z == m_children[1]->m_boundary.min.z)
-			{
-				return false;
-			}
-			if(split_v <= m_children[0]->m_boundary.min.z || split_v >= m_children[1]->m_boundary.max.z)
-			{
-				return false;
-			}
-			m_children[0]->m_boundary.max.z = split_v;
-			m_children[1]->m_boundary.min.z = split_v;
+			return false;
 		}
+		m_children[0]->m_boundary.max[axis] = T(split_v);
+		m_children[1]->m_boundary.min[axis] = T(split_v);
 		m_children[0]->m_cell_loads[1] = m_children[0]->get_latest_load();
 		m_children[0]->m_cell_load_report_counter = 1;
 		
@@ -323,9 +523,12 @@ namespace spiritsaway::distributed_space
 		return true;
 	}
 	
-	void space_cells::space_node::merge_to_child(const std::string& dest)
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::merge_to_child(const std::string& dest, space_node_pool& node_pool)
 	{
 		m_entity_loads.clear();
+		m_entity_costs.clear();
+		m_real_entity_num = 0;
 		m_cell_load_report_counter = 1;
 		m_space_id = dest;
 		space_node* dest_cell = nullptr;
@@ -335,14 +538,17 @@ namespace spiritsaway::distributed_space
 			if (m_children[0]->is_leaf_cell())
 			{
 				m_game_id = m_children[0]->game_id();
-				m_entity_loads = std::move(m_children[0]->m_entity_loads);
-				m_sorted_entity_load_idx_by_axis = std::move(m_children[0]->m_sorted_entity_load_idx_by_axis);
+				m_entity_loads.swap(m_children[0]->m_entity_loads);
+				m_real_entity_num = m_children[0]->m_real_entity_num;
+				m_entity_costs.swap(m_children[0]->m_entity_costs);
+				m_sorted_entity_load_idx_by_axis.swap(m_children[0]->m_sorted_entity_load_idx_by_axis);
+				m_sorted_entity_load_prefix_by_axis.swap(m_children[0]->m_sorted_entity_load_prefix_by_axis);
 				m_cell_loads[1] = m_children[0]->get_latest_load();
 			}
 			else
 			{
-				double new_split_pos = m_is_split_x ? m_boundary.max.x : m_boundary.max.z;
-				m_children[0]->update_boundary_with_new_split(new_split_pos, m_is_split_x, false, true);
+				double new_split_pos = m_boundary.max[m_split_axis];
+				m_children[0]->update_boundary_with_new_split(new_split_pos, m_split_axis, false, true);
 
 			}
 			
@@ -353,22 +559,25 @@ namespace spiritsaway::distributed_space
 			if (m_children[1]->is_leaf_cell())
 			{
 				m_game_id = m_children[1]->game_id();
-				m_entity_loads = std::move(m_children[1]->m_entity_loads);
-				m_sorted_entity_load_idx_by_axis = std::move(m_children[1]->m_sorted_entity_load_idx_by_axis);
+				m_entity_loads.swap(m_children[1]->m_entity_loads);
+				m_real_entity_num = m_children[1]->m_real_entity_num;
+				m_entity_costs.swap(m_children[1]->m_entity_costs);
+				m_sorted_entity_load_idx_by_axis.swap(m_children[1]->m_sorted_entity_load_idx_by_axis);
+				m_sorted_entity_load_prefix_by_axis.swap(m_children[1]->m_sorted_entity_load_prefix_by_axis);
 				m_cell_loads[1] = m_children[1]->get_latest_load();
 			}
 			else
 			{
-				double new_split_pos = m_is_split_x ? m_boundary.min.x : m_boundary.min.z;
-				m_children[1]->update_boundary_with_new_split(new_split_pos, m_is_split_x, true, false);
+				double new_split_pos = m_boundary.min[m_split_axis];
+				m_children[1]->update_boundary_with_new_split(new_split_pos, m_split_axis, true, false);
 			}
 			
 		}
 		m_ready = true;
 		if (dest_cell->is_leaf_cell())
 		{
-			delete m_children[0];
-			delete m_children[1];
+			node_pool.recycle(m_children[0]);
+			node_pool.recycle(m_children[1]);
 			m_children[0] = nullptr;
 			m_children[1] = nullptr;
 		}
@@ -376,21 +585,27 @@ namespace spiritsaway::distributed_space
 		{
 			auto old_children = m_children;
 			m_children = dest_cell->children();
-			m_is_split_x = dest_cell->is_split_x();
+			m_split_axis = dest_cell->m_split_axis;
 			for (auto one_child : m_children)
 			{
 				one_child->m_parent = this;
 			}
-			delete old_children[0];
-			delete old_children[1];
+			node_pool.recycle(old_children[0]);
+			node_pool.recycle(old_children[1]);
 			
 		}
 		
 	}
 
 	
-	std::string space_cells::finish_merge(const std::string& space_id)
+	template <typename T, std::uint32_t D>
+	std::string basic_space_cells<T, D>::finish_merge(const std::string& space_id)
 	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
+		{
+			cur_scope.journal->write_cell_op(space_journal_op::finish_merge, space_id);
+		}
 		auto remove_node_iter = m_leaf_nodes.find(space_id);
 		if(remove_node_iter == m_leaf_nodes.end())
 		{
@@ -429,9 +644,10 @@ namespace spiritsaway::distributed_space
 			return {};
 		}
 		std::string remove_node_game_id = remove_node->game_id();
+		m_load_stat_nodes.clear();
 		m_internal_nodes.erase(cur_parent->space_id());
 		auto dest_space_id = sibling_node->space_id();
-		cur_parent->merge_to_child(dest_space_id);
+		cur_parent->merge_to_child(dest_space_id, m_node_pool);
 		m_leaf_nodes.erase(remove_node_iter);
 		if (is_sibling_leaf)
 		{
@@ -442,10 +658,11 @@ namespace spiritsaway::distributed_space
 		{
 			m_internal_nodes[dest_space_id] = cur_parent;
 		}
-		
+		m_op_counters.finish_merge++;
 		return remove_node_game_id;
 	}
-	bool space_cells::check_valid_space_id(const std::string& space_id) const
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::check_valid_space_id(const std::string& space_id) const
 	{
 		if (space_id.empty())
 		{
@@ -454,39 +671,44 @@ namespace spiritsaway::distributed_space
 		return !std::all_of(space_id.begin(), space_id.end(), ::isdigit);
 	}
 
-	const space_cells::space_node* space_cells::split_x(double x, const std::string& origin_space_id, const std::string& new_space_game_id, const std::string& left_space_id, const std::string& right_space_id)
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::split_x(double x, const std::string& origin_space_id, const std::string& new_space_game_id, const std::string& left_space_id, const std::string& right_space_id)
 	{
-		if(!check_valid_space_id(left_space_id) || ! check_valid_space_id(right_space_id))
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
 		{
-			return nullptr;
+			cur_scope.journal->write_split(space_journal_op::split_x, x, origin_space_id, new_space_game_id, left_space_id, right_space_id);
 		}
-		auto dest_node_iter = m_leaf_nodes.find(origin_space_id);
-		if(dest_node_iter == m_leaf_nodes.end())
+		return split_at_axis(0, x, origin_space_id, new_space_game_id, left_space_id, right_space_id);
+	}
+
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::split_z(double z, const std::string& origin_space_id, const std::string& new_space_game_id,  const std::string& low_space_id, const std::string& high_space_id)
+	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
 		{
-			return nullptr;
+			cur_scope.journal->write_split(space_journal_op::split_z, z, origin_space_id, new_space_game_id, low_space_id, high_space_id);
 		}
-		auto dest_node = dest_node_iter->second;
-		if(!dest_node->is_leaf_cell())
+		return split_at_axis(1, z, origin_space_id, new_space_game_id, low_space_id, high_space_id);
+	}
+
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::split_y(double y, const std::string& origin_space_id, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& high_space_id)
+	{
+		if constexpr (D == 3)
 		{
-			return nullptr;
+			journal_scope cur_scope(*this);
+			return split_at_axis(2, y, origin_space_id, new_space_game_id, low_space_id, high_space_id);
 		}
-		m_temp_node_counter++;
-		auto result = dest_node->split_x(x, new_space_game_id, left_space_id, right_space_id, std::to_string(m_temp_node_counter));
-		if(!result)
+		else
 		{
 			return nullptr;
 		}
-		m_leaf_nodes.erase(dest_node_iter);
-		for(auto one_child: dest_node->children())
-		{
-			m_leaf_nodes[one_child->space_id()] = one_child;
-		}
-		m_internal_nodes[dest_node->space_id()] = dest_node;
-		return result;
-		
 	}
 
-	const space_cells::space_node* space_cells::split_z(double z, const std::string& origin_space_id, const std::string& new_space_game_id,  const std::string& low_space_id, const std::string& high_space_id)
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::split_at_axis(int axis, double split_pos, const std::string& origin_space_id, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& high_space_id)
 	{
 		if(!check_valid_space_id(low_space_id) || ! check_valid_space_id(high_space_id))
 		{
@@ -503,216 +725,737 @@ namespace spiritsaway::distributed_space
 			return nullptr;
 		}
 		m_temp_node_counter++;
-		auto result = dest_node->split_z(z, new_space_game_id, low_space_id, high_space_id, std::to_string(m_temp_node_counter));
+		auto result = dest_node->split(m_node_pool, axis, split_pos, new_space_game_id, low_space_id, high_space_id, std::to_string(m_temp_node_counter));
 		if(!result)
 		{
 			return nullptr;
 		}
+		m_load_stat_nodes.clear();
 		m_leaf_nodes.erase(dest_node_iter);
 		for(auto one_child: dest_node->children())
 		{
 			m_leaf_nodes[one_child->space_id()] = one_child;
 		}
 		m_internal_nodes[dest_node->space_id()] = dest_node;
+		m_op_counters.split++;
 		return result;
-		
 	}
 
-	std::vector<const space_cells::space_node*> space_cells::query_intersect_leafs(const cell_bound& bound) const
+	template <typename T, std::uint32_t D>
+	std::vector<const typename basic_space_cells<T, D>::space_node*> basic_space_cells<T, D>::query_intersect_leafs(const cell_bound& bound) const
 	{
-		std::vector<const space_node*> temp_query_buffer;
-		temp_query_buffer.push_back(m_root_node);
-		std::vector<const space_cells::space_node*> result;
-		while(!temp_query_buffer.empty())
-		{
-			auto temp_top = temp_query_buffer.back();
-			temp_query_buffer.pop_back();
-			if(!temp_top->boundary().intersect(bound))
-			{
-				continue;
-			}
-			if(temp_top->is_leaf_cell())
+		return query_leafs_by_filter(m_root_node, [&bound](const cell_bound& cur_bound)
 			{
-				result.push_back(temp_top);
-			}
-			else
+				return cur_bound.intersect(bound);
+			});
+	}
+
+	template <typename T, std::uint32_t D>
+	std::vector<const typename basic_space_cells<T, D>::space_node*> basic_space_cells<T, D>::query_leafs_in_radius(const point_xz& pos, double radius) const
+	{
+		const double radius_sq = radius * radius;
+		return query_leafs_by_filter(m_root_node, [&pos, radius_sq](const cell_bound& cur_bound)
 			{
-				temp_query_buffer.push_back(temp_top->children()[0]);
-				temp_query_buffer.push_back(temp_top->children()[1]);
-			}
+				return cur_bound.distance_sq(pos) < radius_sq;
+			});
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::query_ghost_entities(const std::string& cell_id, const std::vector<entity_load>& entity_loads, double radius, std::vector<leaf_ghost_entities>& out_ghosts) const
+	{
+		return query_ghost_entities_impl(cell_id, entity_loads, radius, {}, out_ghosts);
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::query_ghost_entities(const std::string& cell_id, const std::vector<entity_load>& entity_loads, std::vector<leaf_ghost_entities>& out_ghosts) const
+	{
+		std::vector<T> radius_sqs(entity_loads.size());
+		double max_radius = 0;
+		for (std::size_t i = 0; i < entity_loads.size(); i++)
+		{
+			auto cur_radius = ghost_class_radius(entity_loads[i].ghost_class);
+			max_radius = std::max(max_radius, cur_radius);
+			radius_sqs[i] = T(cur_radius * cur_radius);
 		}
-		return result;
+		return query_ghost_entities_impl(cell_id, entity_loads, max_radius, radius_sqs, out_ghosts);
 	}
 
-	const space_cells::space_node* space_cells::query_leaf_for_point(double x, double z) const
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::query_ghost_entities_impl(const std::string& cell_id, const std::vector<entity_load>& entity_loads, double max_radius, const std::vector<T>& radius_sqs, std::vector<leaf_ghost_entities>& out_ghosts) const
 	{
-		std::vector<const space_node*> temp_query_buffer;
-		temp_query_buffer.push_back(m_root_node);
-		while(!temp_query_buffer.empty())
+		out_ghosts.clear();
+		auto cur_leaf = get_leaf(cell_id);
+		if (!cur_leaf)
 		{
-			auto temp_top = temp_query_buffer.back();
-			temp_query_buffer.pop_back();
-			if(!temp_top->boundary().cover(x, z))
+			return false;
+		}
+		if (entity_loads.empty())
+		{
+			return true;
+		}
+		// 扩展max_radius之后相交的叶子才可能有ghost
+		auto ghost_bound = cur_leaf->boundary();
+		for (std::uint32_t i = 0; i < D; i++)
+		{
+			ghost_bound.min[i] = T(ghost_bound.min[i] - max_radius);
+			ghost_bound.max[i] = T(ghost_bound.max[i] + max_radius);
+		}
+		auto candidate_leafs = query_intersect_leafs(ghost_bound);
+		std::array<std::vector<T>, D> entity_coords;
+		for (std::uint32_t i = 0; i < D; i++)
+		{
+			entity_coords[i].resize(entity_loads.size());
+			for (std::size_t j = 0; j < entity_loads.size(); j++)
+			{
+				entity_coords[i][j] = entity_loads[j].pos[i];
+			}
+		}
+		const T max_radius_sq = T(max_radius * max_radius);
+		std::vector<T> distance_sq;
+		for (auto one_leaf : candidate_leafs)
+		{
+			if (one_leaf == cur_leaf)
 			{
 				continue;
 			}
-			if(temp_top->is_leaf_cell())
+			calc_distance_sq(one_leaf->boundary(), entity_coords, distance_sq);
+			leaf_ghost_entities cur_ghosts;
+			cur_ghosts.leaf = one_leaf;
+			for (std::uint32_t j = 0; j < distance_sq.size(); j++)
 			{
-				// 在还没有ready的情况下 使用其sibling节点
-				if(temp_top->ready())
-				{
-					return temp_top;
-				}
-				else
+				if (distance_sq[j] < (radius_sqs.empty() ? max_radius_sq : radius_sqs[j]))
 				{
-					auto cur_sibling = temp_top->sibling();
-					if(cur_sibling->is_leaf_cell())
-					{
-						return cur_sibling;
-					}
-					else
-					{
-						return nullptr;
-					}
+					cur_ghosts.entity_indexes.push_back(j);
 				}
 			}
-			else
+			if (!cur_ghosts.entity_indexes.empty())
 			{
-				temp_query_buffer.push_back(temp_top->children()[0]);
-				temp_query_buffer.push_back(temp_top->children()[1]);
+				out_ghosts.push_back(std::move(cur_ghosts));
 			}
 		}
-		return nullptr;
+		return true;
 	}
 
-	json space_cells::encode() const
+	template <typename T, std::uint32_t D>
+	double basic_space_cells<T, D>::ghost_radius(const space_node* cur_node) const
 	{
-		json result;
-		json::array_t cell_jsons;
-		cell_jsons.reserve(8);
-		std::vector<const space_node*> temp_query_buffer;
-		temp_query_buffer.push_back(m_root_node);
-		while(!temp_query_buffer.empty())
+		auto result = m_ghost_radius;
+		if (!cur_node)
 		{
-			auto temp_top = temp_query_buffer.back();
-			temp_query_buffer.pop_back();
-			cell_jsons.push_back(temp_top->encode());
-			if(temp_top->is_leaf_cell())
+			return result;
+		}
+		const auto& cur_bound = cur_node->boundary();
+		for (const auto& one_region : m_ghost_radius_regions)
+		{
+			bool is_inside = true;
+			for (std::uint32_t i = 0; i < D; i++)
 			{
-				continue;
+				is_inside = is_inside && cur_bound.min[i] >= one_region.bound.min[i] && cur_bound.max[i] <= one_region.bound.max[i];
 			}
-			else
+			if (is_inside)
 			{
-				temp_query_buffer.push_back(temp_top->children()[0]);
-				temp_query_buffer.push_back(temp_top->children()[1]);
+				result = std::min(result, one_region.ghost_radius);
 			}
 		}
-		result["master_cell_id"] = m_master_cell_id;
+		return result;
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::add_ghost_radius_region(const cell_bound& bound, double region_ghost_radius)
+	{
+		if (!(region_ghost_radius > 0))
+		{
+			return false;
+		}
+		m_ghost_radius_regions.push_back(ghost_radius_region{ bound, region_ghost_radius });
+		return true;
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::clear_ghost_radius_regions()
+	{
+		m_ghost_radius_regions.clear();
+	}
+
+	template <typename T, std::uint32_t D>
+	double basic_space_cells<T, D>::min_ghost_radius() const
+	{
+		auto result = m_ghost_radius;
+		for (const auto& one_region : m_ghost_radius_regions)
+		{
+			result = std::min(result, one_region.ghost_radius);
+		}
+		return result;
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::set_ghost_class_radius(std::uint8_t ghost_class, double class_radius)
+	{
+		if (!(class_radius > 0))
+		{
+			return false;
+		}
+		if (m_ghost_class_radiuses.size() <= ghost_class)
+		{
+			m_ghost_class_radiuses.resize(std::size_t(ghost_class) + 1, m_ghost_radius);
+		}
+		m_ghost_class_radiuses[ghost_class] = class_radius;
+		return true;
+	}
+
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::query_leaf_for_point(double x, double z) const
+	{
+		return get_real_leaf(query_leaf_by_cover(m_root_node, [x, z](const cell_bound& cur_bound)
+			{
+				return cur_bound.cover(x, z);
+			}));
+	}
+
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::query_leaf_for_point(const point_xz& pos) const
+	{
+		return get_real_leaf(query_leaf_by_cover(m_root_node, [&pos](const cell_bound& cur_bound)
+			{
+				return cur_bound.cover(pos);
+			}));
+	}
+
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::get_real_leaf(const space_node* leaf) const
+	{
+		if (!leaf || leaf->ready())
+		{
+			return leaf;
+		}
+		if (leaf->m_host_space_id.empty())
+		{
+			auto cur_sibling = leaf->sibling();
+			if (cur_sibling && cur_sibling->is_leaf_cell())
+			{
+				return cur_sibling;
+			}
+			return nullptr;
+		}
+		auto host_iter = m_leaf_nodes.find(leaf->m_host_space_id);
+		if (host_iter == m_leaf_nodes.end() || !host_iter->second->ready())
+		{
+			return nullptr;
+		}
+		return host_iter->second;
+	}
+
+	template <typename T, std::uint32_t D>
+	json basic_space_cells<T, D>::encode() const
+	{
+		json result;
+		json::array_t cell_jsons;
+		cell_jsons.reserve(8);
+		std::vector<const space_node*> temp_query_buffer;
+		temp_query_buffer.push_back(m_root_node);
+		while(!temp_query_buffer.empty())
+		{
+			auto temp_top = temp_query_buffer.back();
+			temp_query_buffer.pop_back();
+			cell_jsons.push_back(temp_top->encode());
+			if(temp_top->is_leaf_cell())
+			{
+				continue;
+			}
+			else
+			{
+				temp_query_buffer.push_back(temp_top->children()[0]);
+				temp_query_buffer.push_back(temp_top->children()[1]);
+			}
+		}
+		result["master_cell_id"] = m_master_cell_id;
 		result["cells"] = cell_jsons;
 		result["ghost_radius"] = m_ghost_radius;
+		result["temp_node_counter"] = m_temp_node_counter;
+		result["game_capacities"] = m_game_capacities;
 		return result;
 	}
 
-	bool space_cells::decode(const json& data)
+	template <typename T, std::uint32_t D>
+	basic_space_cells<T, D>::decode_builder::~decode_builder()
 	{
-		std::string parent_space_id;
-		std::array<std::string, 2> children_ids;
-		cell_bound temp_bound;
-		std::string temp_space_id;
-		std::string temp_game_id;
-		std::unordered_map<std::string, int> children_indexes;
-		bool temp_ready;
-		bool temp_merging;
-		json::array_t cell_jsons;
-		m_leaf_nodes.clear();
-		if (m_root_node)
+		for (auto one_node : m_nodes)
 		{
-			delete m_root_node;
-			m_root_node = nullptr;
+			delete one_node;
 		}
-		try
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::decode_builder::add_cell(decode_cell& cur_cell)
+	{
+		// 只有第一个节点可以是根节点
+		if (cur_cell.parent.empty() != m_nodes.empty() || cur_cell.children[0].empty() != cur_cell.children[1].empty())
 		{
-			data.at("cells").get_to(cell_jsons);
-			data.at("master_cell_id").get_to(m_master_cell_id);
-			data.at("ghost_radius").get_to(m_ghost_radius);
+			return false;
 		}
-		catch(const std::exception& e)
+		if (m_leaf_nodes.count(cur_cell.space_id) || m_internal_nodes.count(cur_cell.space_id))
 		{
-			(void)e;
 			return false;
 		}
-		
-		for(const auto& one_node: cell_jsons)
+		space_node* parent_node = nullptr;
+		int child_index = 0;
+		if (!cur_cell.parent.empty())
+		{
+			while (!m_open_nodes.empty() && m_open_nodes.back().node->m_children[0] && m_open_nodes.back().node->m_children[1])
+			{
+				m_open_nodes.pop_back();
+			}
+			// 不是encode输出的顺序时 在所有还有空闲子节点的内部节点中查找
+			auto parent_iter = std::find_if(m_open_nodes.rbegin(), m_open_nodes.rend(), [&cur_cell](const open_internal_node& one_open_node)
+			{
+				return one_open_node.node->m_space_id == cur_cell.parent;
+			});
+			if (parent_iter == m_open_nodes.rend())
+			{
+				return false;
+			}
+			parent_node = parent_iter->node;
+			if (parent_iter->children_ids[0] == cur_cell.space_id)
+			{
+				child_index = 0;
+			}
+			else if (parent_iter->children_ids[1] == cur_cell.space_id)
+			{
+				child_index = 1;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		auto new_node = new space_node(cur_cell.bound, cur_cell.game_id, cur_cell.space_id, parent_node);
+		m_nodes.push_back(new_node);
+		if (parent_node && !parent_node->set_child(child_index, new_node))
+		{
+			return false;
+		}
+		new_node->m_ready = cur_cell.ready;
+		new_node->m_is_merging = cur_cell.is_merging;
+		if (cur_cell.children[0].empty())
+		{
+			if (!cur_cell.ready)
+			{
+				new_node->m_host_space_id = cur_cell.host;
+			}
+			new_node->m_cell_loads = cur_cell.cell_loads;
+			new_node->m_entity_loads = std::move(cur_cell.entity_loads);
+			new_node->m_cell_load_report_counter = cur_cell.cell_load_counter;
+			new_node->make_sorted_loads();
+			m_leaf_nodes[cur_cell.space_id] = new_node;
+		}
+		else
+		{
+			auto cur_axis = cur_cell.split_axis >= 0 ? cur_cell.split_axis : (cur_cell.is_split_x ? 0 : 1);
+			if (cur_axis >= int(D))
+			{
+				return false;
+			}
+			new_node->m_split_axis = std::uint8_t(cur_axis);
+			m_internal_nodes[cur_cell.space_id] = new_node;
+			m_open_nodes.push_back(open_internal_node{ new_node, cur_cell.children });
+			if (std::all_of(cur_cell.space_id.begin(), cur_cell.space_id.end(), ::isdigit) && !cur_cell.space_id.empty())
+			{
+				m_max_internal_id = std::max<std::uint64_t>(m_max_internal_id, std::stoull(cur_cell.space_id));
+			}
+		}
+		return true;
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::decode_builder::install(basic_space_cells& cur_space, std::string&& master_cell_id, double ghost_radius, std::uint64_t temp_node_counter, std::unordered_map<std::string, float>&& game_capacities)
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+		// 所有内部节点的两个子节点都需要出现
+		for (const auto& one_pair : m_internal_nodes)
+		{
+			if (!one_pair.second->m_children[0] || !one_pair.second->m_children[1])
+			{
+				return false;
+			}
+		}
+		cur_space.destroy_nodes();
+		cur_space.m_root_node = m_nodes[0];
+		cur_space.m_leaf_nodes = std::move(m_leaf_nodes);
+		cur_space.m_internal_nodes = std::move(m_internal_nodes);
+		cur_space.m_master_cell_id = std::move(master_cell_id);
+		cur_space.m_ghost_radius = ghost_radius;
+		cur_space.m_temp_node_counter = std::max(temp_node_counter, m_max_internal_id);
+		cur_space.m_game_capacities = std::move(game_capacities);
+		m_nodes.clear();
+		m_open_nodes.clear();
+		if constexpr (D == 2)
 		{
-			try
+			journal_scope cur_scope(cur_space);
+			if (cur_scope.journal)
 			{
-				one_node.at("bound").get_to(temp_bound);
-				one_node.at("children").get_to(children_ids);
-				one_node.at("parent").get_to(parent_space_id);
-				one_node.at("space_id").get_to(temp_space_id);
-				one_node.at("game_id").get_to(temp_game_id);
-				one_node.at("ready").get_to(temp_ready);
-				one_node.at("is_merging").get_to(temp_merging);
-				space_node* parent_node = nullptr;
+				cur_scope.journal->write_snapshot(cur_space);
+			}
+		}
+		return true;
+	}
 
-				if(!parent_space_id.empty())
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::decode(const json& data)
+	{
+		// encode按照前序遍历输出节点 父节点总是在子节点之前
+		// 先在新的索引里构建整棵树 全部成功之后再替换当前状态 失败时当前状态不变
+		std::string new_master_cell_id;
+		double new_ghost_radius;
+		std::uint64_t new_temp_node_counter;
+		std::unordered_map<std::string, float> new_game_capacities;
+		decode_builder cur_builder;
+		try
+		{
+			data.at("master_cell_id").get_to(new_master_cell_id);
+			data.at("ghost_radius").get_to(new_ghost_radius);
+			// 旧版本的数据没有下面两项
+			// 内部节点的id由m_temp_node_counter生成 需要恢复 否则之后的split会生成重复的内部节点id
+			new_temp_node_counter = data.value("temp_node_counter", std::uint64_t(0));
+			if (data.contains("game_capacities"))
+			{
+				data.at("game_capacities").get_to(new_game_capacities);
+			}
+			const auto& cell_jsons = data.at("cells");
+			if (!cell_jsons.is_array())
+			{
+				return false;
+			}
+			decode_cell cur_cell;
+			for (const auto& one_node : cell_jsons)
+			{
+				one_node.at("bound").get_to(cur_cell.bound);
+				one_node.at("children").get_to(cur_cell.children);
+				one_node.at("parent").get_to(cur_cell.parent);
+				one_node.at("space_id").get_to(cur_cell.space_id);
+				one_node.at("game_id").get_to(cur_cell.game_id);
+				one_node.at("ready").get_to(cur_cell.ready);
+				one_node.at("is_merging").get_to(cur_cell.is_merging);
+				if (cur_cell.children[0].empty())
+				{
+					one_node.at("cell_loads").get_to(cur_cell.cell_loads);
+					one_node.at("entity_loads").get_to(cur_cell.entity_loads);
+					one_node.at("cell_load_counter").get_to(cur_cell.cell_load_counter);
+					cur_cell.host = one_node.value("host", std::string());
+				}
+				else
 				{
-					auto temp_iter = m_leaf_nodes.find(parent_space_id);
-					if(temp_iter == m_leaf_nodes.end())
+					one_node.at("is_split_x").get_to(cur_cell.is_split_x);
+					if constexpr (D == 3)
 					{
-						return false;
+						cur_cell.split_axis = one_node.value("split_axis", -1);
 					}
-					parent_node = temp_iter->second;
 				}
-				
-				auto new_node = new space_node(temp_bound, temp_game_id, temp_space_id, parent_node);
-				if (children_ids[0].empty())
+				if (!cur_builder.add_cell(cur_cell))
+				{
+					return false;
+				}
+			}
+		}
+		catch(const std::exception& e)
+		{
+			(void)e;
+			return false;
+		}
+		return cur_builder.install(*this, std::move(new_master_cell_id), new_ghost_radius, new_temp_node_counter, std::move(new_game_capacities));
+	}
+
+	namespace
+	{
+		// 收集快照中的字符串 相同的字符串只存一份
+		class snapshot_string_table
+		{
+			std::unordered_map<std::string_view, std::uint32_t> m_indexes;
+			std::vector<std::string_view> m_strings;
+		public:
+			// str需要在写入完成之前一直有效
+			std::uint32_t add(std::string_view str)
+			{
+				auto cur_iter = m_indexes.find(str);
+				if (cur_iter != m_indexes.end())
+				{
+					return cur_iter->second;
+				}
+				auto result = std::uint32_t(m_strings.size());
+				m_indexes.emplace(str, result);
+				m_strings.push_back(str);
+				return result;
+			}
+			const std::vector<std::string_view>& strings() const
+			{
+				return m_strings;
+			}
+		};
+
+		std::uint64_t align_snapshot_offset(std::uint64_t offset)
+		{
+			return (offset + 7) / 8 * 8;
+		}
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::encode_binary(std::string& out_data) const
+	{
+		// 二进制快照的格式是二维的 三维时输出为空
+		if constexpr (D != 2)
+		{
+			out_data.clear();
+		}
+		else
+		{
+			// 先前序遍历一次得到节点数量与entity数量 之后直接写到out_data里
+			std::vector<const space_node*> sorted_nodes;
+			std::uint64_t total_entity_num = 0;
+			std::vector<const space_node*> temp_query_buffer;
+			temp_query_buffer.push_back(m_root_node);
+			while (!temp_query_buffer.empty())
+			{
+				auto temp_top = temp_query_buffer.back();
+				temp_query_buffer.pop_back();
+				sorted_nodes.push_back(temp_top);
+				if (temp_top->is_leaf_cell())
 				{
-					one_node.at("cell_loads").get_to(new_node->m_cell_loads);
-					one_node.at("entity_loads").get_to(new_node->m_entity_loads);
-					one_node.at("cell_load_counter").get_to(new_node->m_cell_load_report_counter);
+					total_entity_num += temp_top->m_entity_loads.size();
 				}
 				else
 				{
-					one_node.at("is_split_x").get_to(new_node->m_is_split_x);
+					temp_query_buffer.push_back(temp_top->m_children[1]);
+					temp_query_buffer.push_back(temp_top->m_children[0]);
+				}
+			}
+			std::unordered_map<const space_node*, std::uint32_t> node_indexes;
+			node_indexes.reserve(sorted_nodes.size());
+			for (std::uint32_t i = 0; i < sorted_nodes.size(); i++)
+			{
+				node_indexes[sorted_nodes[i]] = i;
+			}
+
+			space_snapshot_header cur_header;
+			std::memset(&cur_header, 0, sizeof(cur_header));
+			std::memcpy(cur_header.magic, space_snapshot_header::magic_value, sizeof(cur_header.magic));
+			cur_header.version = space_snapshot_header::current_version;
+			cur_header.ghost_radius = m_ghost_radius;
+			cur_header.temp_node_counter = m_temp_node_counter;
+			cur_header.node_num = std::uint32_t(sorted_nodes.size());
+			cur_header.node_offset = align_snapshot_offset(sizeof(space_snapshot_header));
+			cur_header.entity_num = total_entity_num;
+			cur_header.entity_offset = align_snapshot_offset(cur_header.node_offset + sizeof(space_snapshot_node) * cur_header.node_num);
+			cur_header.capacity_num = std::uint32_t(m_game_capacities.size());
+			cur_header.capacity_offset = align_snapshot_offset(cur_header.entity_offset + sizeof(space_snapshot_entity_load) * total_entity_num);
+			out_data.assign(cur_header.capacity_offset + sizeof(space_snapshot_capacity) * cur_header.capacity_num, '\0');
+
+			snapshot_string_table cur_strings;
+			cur_header.master_cell_id = cur_strings.add(m_master_cell_id);
+			auto cur_nodes = reinterpret_cast<space_snapshot_node*>(out_data.data() + cur_header.node_offset);
+			auto cur_entity_loads = reinterpret_cast<space_snapshot_entity_load*>(out_data.data() + cur_header.entity_offset);
+			std::uint64_t entity_begin = 0;
+			for (std::uint32_t i = 0; i < sorted_nodes.size(); i++)
+			{
+				auto one_node = sorted_nodes[i];
+				auto& cur_node = cur_nodes[i];
+				cur_node.bound = one_node->m_boundary.template cast<double>();
+				cur_node.space_id = cur_strings.add(one_node->m_space_id);
+				cur_node.game_id = cur_strings.add(one_node->m_game_id);
+				cur_node.parent = one_node->m_parent ? node_indexes[one_node->m_parent] : space_snapshot_node::invalid_idx;
+				cur_node.ready = one_node->m_ready;
+				cur_node.is_merging = one_node->m_is_merging;
+				cur_node.is_split_x = one_node->is_split_x();
+				cur_node.host = one_node->m_host_space_id.empty() ? space_snapshot_node::invalid_idx : cur_strings.add(one_node->m_host_space_id);
+				cur_node.entity_begin = entity_begin;
+				if (!one_node->is_leaf_cell())
+				{
+					cur_node.children[0] = node_indexes[one_node->m_children[0]];
+					cur_node.children[1] = node_indexes[one_node->m_children[1]];
+					continue;
 				}
-				if(temp_ready)
+				cur_node.children[0] = space_snapshot_node::invalid_idx;
+				cur_node.children[1] = space_snapshot_node::invalid_idx;
+				cur_node.cell_loads = one_node->m_cell_loads;
+				cur_node.cell_load_counter = one_node->m_cell_load_report_counter;
+				cur_node.entity_num = std::uint32_t(one_node->m_entity_loads.size());
+				for (const auto& one_entity_load : one_node->m_entity_loads)
 				{
-					new_node->set_ready();
+					auto& cur_entity_load = cur_entity_loads[entity_begin++];
+					cur_entity_load.pos.x = double(one_entity_load.pos.x);
+					cur_entity_load.pos.z = double(one_entity_load.pos.z);
+					cur_entity_load.load = one_entity_load.load;
+					cur_entity_load.name = cur_strings.add(one_entity_load.name);
+					cur_entity_load.is_real = one_entity_load.is_real;
 				}
-				if (temp_merging)
+			}
+			auto cur_capacities = reinterpret_cast<space_snapshot_capacity*>(out_data.data() + cur_header.capacity_offset);
+			for (const auto& one_pair : m_game_capacities)
+			{
+				cur_capacities->game_id = cur_strings.add(one_pair.first);
+				cur_capacities->capacity = one_pair.second;
+				cur_capacities++;
+			}
+
+			// 字符串放在最后 数量在写完节点之后才能确定
+			const auto& all_strings = cur_strings.strings();
+			cur_header.string_num = std::uint32_t(all_strings.size());
+			cur_header.string_index_offset = align_snapshot_offset(out_data.size());
+			cur_header.string_data_offset = cur_header.string_index_offset + sizeof(space_snapshot_string) * cur_header.string_num;
+			std::uint64_t string_data_size = 0;
+			for (auto one_str : all_strings)
+			{
+				string_data_size += one_str.size();
+			}
+			cur_header.total_size = cur_header.string_data_offset + string_data_size;
+			out_data.resize(cur_header.total_size, '\0');
+			auto cur_string_indexes = reinterpret_cast<space_snapshot_string*>(out_data.data() + cur_header.string_index_offset);
+			std::uint32_t string_offset = 0;
+			for (auto one_str : all_strings)
+			{
+				cur_string_indexes->offset = string_offset;
+				cur_string_indexes->size = std::uint32_t(one_str.size());
+				cur_string_indexes++;
+				std::memcpy(out_data.data() + cur_header.string_data_offset + string_offset, one_str.data(), one_str.size());
+				string_offset += std::uint32_t(one_str.size());
+			}
+			std::memcpy(out_data.data(), &cur_header, sizeof(cur_header));
+		}
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::decode_binary(const space_snapshot_view& snapshot, bool with_entity_loads)
+	{
+		if constexpr (D != 2)
+		{
+			(void)snapshot;
+			(void)with_entity_loads;
+			return false;
+		}
+		else
+		{
+			// view::init已经检查过所有的下标 这里只需要检查节点id不重复
+			std::unordered_map<std::string, space_node*> new_leaf_nodes;
+			std::unordered_map<std::string, space_node*> new_internal_nodes;
+			std::vector<space_node*> new_nodes(snapshot.node_num(), nullptr);
+			for (std::uint32_t i = 0; i < snapshot.node_num(); i++)
+			{
+				const auto& cur_node = snapshot.node(i);
+				auto parent_node = cur_node.parent == space_snapshot_node::invalid_idx ? nullptr : new_nodes[cur_node.parent];
+				auto new_node = new space_node(cur_node.bound.template cast<T>(), std::string(snapshot.str(cur_node.game_id)), std::string(snapshot.str(cur_node.space_id)), parent_node);
+				new_nodes[i] = new_node;
+				if (parent_node)
 				{
-					new_node->set_is_merging();
+					parent_node->m_children[snapshot.node(cur_node.parent).children[0] == i ? 0 : 1] = new_node;
 				}
-				new_node->make_sorted_loads();
-				m_leaf_nodes[temp_space_id] = new_node;
-				children_indexes[children_ids[0]] = 0;
-				children_indexes[children_ids[1]] = 1;
-				auto temp_iter = children_indexes.find(temp_space_id);
-				if(temp_iter != children_indexes.end())
+				new_node->m_ready = cur_node.ready;
+				new_node->m_is_merging = cur_node.is_merging;
+				bool is_inserted;
+				if (cur_node.is_leaf())
 				{
-					if(!parent_node->set_child(temp_iter->second, new_node))
+					if (!cur_node.ready && cur_node.host != space_snapshot_node::invalid_idx)
+					{
+						new_node->m_host_space_id = std::string(snapshot.str(cur_node.host));
+					}
+					new_node->m_cell_loads = cur_node.cell_loads;
+					new_node->m_cell_load_report_counter = cur_node.cell_load_counter;
+					if (with_entity_loads)
 					{
-						return false;
+						snapshot.to_entity_loads(cur_node, new_node->m_entity_loads);
 					}
+					new_node->make_sorted_loads();
+					is_inserted = new_leaf_nodes.emplace(new_node->m_space_id, new_node).second && !new_internal_nodes.count(new_node->m_space_id);
+				}
+				else
+				{
+					new_node->m_split_axis = cur_node.is_split_x ? 0 : 1;
+					is_inserted = new_internal_nodes.emplace(new_node->m_space_id, new_node).second && !new_leaf_nodes.count(new_node->m_space_id);
 				}
-				if(parent_node == nullptr)
+				if (!is_inserted)
 				{
-					m_root_node = new_node;
+					for (auto one_node : new_nodes)
+					{
+						delete one_node;
+					}
+					return false;
 				}
 			}
-			catch(const std::exception& e)
+			destroy_nodes();
+			m_leaf_nodes = std::move(new_leaf_nodes);
+			m_internal_nodes = std::move(new_internal_nodes);
+			m_root_node = new_nodes[0];
+			const auto& cur_header = snapshot.header();
+			m_master_cell_id = std::string(snapshot.str(cur_header.master_cell_id));
+			m_ghost_radius = cur_header.ghost_radius;
+			m_temp_node_counter = cur_header.temp_node_counter;
+			m_game_capacities.clear();
+			for (std::uint32_t i = 0; i < snapshot.capacity_num(); i++)
+			{
+				const auto& one_capacity = snapshot.capacity(i);
+				m_game_capacities[std::string(snapshot.str(one_capacity.game_id))] = one_capacity.capacity;
+			}
+			journal_scope cur_scope(*this);
+			if (cur_scope.journal)
+			{
+				cur_scope.journal->write_snapshot(*this);
+			}
+			return true;
+		}
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::load_entity_loads(const space_snapshot_view& snapshot, const std::string& cell_id)
+	{
+		if constexpr (D != 2)
+		{
+			(void)snapshot;
+			(void)cell_id;
+			return false;
+		}
+		else
+		{
+			auto cur_node_iter = m_leaf_nodes.find(cell_id);
+			if (cur_node_iter == m_leaf_nodes.end())
+			{
+				return false;
+			}
+			auto node_idx = snapshot.find_node(cell_id);
+			if (node_idx == space_snapshot_node::invalid_idx || !snapshot.node(node_idx).is_leaf())
 			{
-				(void)e;
 				return false;
 			}
-			
+			auto cur_node = cur_node_iter->second;
+			snapshot.to_entity_loads(snapshot.node(node_idx), cur_node->m_entity_loads);
+			on_entity_loads_replaced(cur_node);
+			return true;
 		}
-		return true;
+	}
 
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::on_entity_loads_replaced(space_node* cur_node)
+	{
+		cur_node->m_entity_costs.clear();
+		cur_node->make_sorted_loads();
+		// 记录的是加载之后的结果 回放时不需要快照数据
+		journal_scope cur_scope(*this);
+		if constexpr (D == 2)
+		{
+			if (cur_scope.journal)
+			{
+				cur_scope.journal->write_load_entity_loads(cur_node->space_id(), cur_node->m_entity_loads);
+			}
+		}
 	}
-	bool space_cells::balance(double split_v, const std::string& cell_id)
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::balance(double split_v, const std::string& cell_id)
 	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
+		{
+			cur_scope.journal->write_balance(space_journal_op::balance_cell, split_v, cell_id);
+		}
 		auto cur_node_iter = m_leaf_nodes.find(cell_id);
 		if(cur_node_iter == m_leaf_nodes.end())
 		{
@@ -723,11 +1466,16 @@ namespace spiritsaway::distributed_space
 		{
 			return false;
 		}
-		cur_node_iter->second->m_parent->balance(split_v);
+		if (!cur_node_iter->second->m_parent->balance(split_v))
+		{
+			return false;
+		}
+		m_load_stat_nodes.clear();
+		m_op_counters.shrink++;
 		return true;
-		
 	}
-	std::vector<std::string> space_cells::all_child_space_except(const std::string& except_space) const
+	template <typename T, std::uint32_t D>
+	std::vector<std::string> basic_space_cells<T, D>::all_child_space_except(const std::string& except_space) const
 	{
 		std::vector<std::string> result;
 		result.reserve(m_leaf_nodes.size() /2 + 2);
@@ -746,8 +1494,14 @@ namespace spiritsaway::distributed_space
 		return result;
 	}
 
-	bool space_cells::set_ready(const std::string& cell_id)
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::set_ready(const std::string& cell_id)
 	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
+		{
+			cur_scope.journal->write_cell_op(space_journal_op::set_ready, cell_id);
+		}
 		auto cur_node_iter = m_leaf_nodes.find(cell_id);
 		if(cur_node_iter == m_leaf_nodes.end())
 		{
@@ -757,31 +1511,75 @@ namespace spiritsaway::distributed_space
 		return true;
 	}
 
-	space_cells::~space_cells()
+	template <typename T, std::uint32_t D>
+	basic_space_cells<T, D>::~basic_space_cells()
+	{
+		destroy_nodes();
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::destroy_nodes()
 	{
 		for(auto one_pair: m_leaf_nodes)
 		{
 			delete one_pair.second;
 		}
 		m_leaf_nodes.clear();
+		for (auto one_pair : m_internal_nodes)
+		{
+			delete one_pair.second;
+		}
+		m_internal_nodes.clear();
+		m_load_stat_nodes.clear();
 		m_root_node = nullptr;
 	}
 
-	void space_cells::update_cell_load(const std::string& cell_space_id, float cell_load, const std::vector<entity_load>& new_entity_loads)
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::update_cell_load(const std::string& cell_space_id, float cell_load, const std::vector<entity_load>& new_entity_loads)
 	{
+		journal_scope cur_scope(*this);
+		if constexpr (D == 2)
+		{
+			if (cur_scope.journal)
+			{
+				cur_scope.journal->write_update_cell_load(cell_space_id, cell_load, new_entity_loads);
+			}
+		}
 		auto cur_node_iter = m_leaf_nodes.find(cell_space_id);
 		if(cur_node_iter == m_leaf_nodes.end())
 		{
 			return;
 		}
-		if (cur_node_iter->second->is_leaf_cell())
+		if (!cur_node_iter->second->is_leaf_cell())
+		{
+			return;
+		}
+		if (!m_entity_cost_model)
+		{
+			m_entity_cost_buffer.clear();
+			cur_node_iter->second->update_load(cell_load, new_entity_loads, m_entity_cost_buffer);
+			return;
+		}
+		m_entity_cost_model->estimate(new_entity_loads, m_entity_cost_buffer);
+		float estimated_cell_load = 0;
+		for (std::size_t i = 0; i < new_entity_loads.size(); i++)
 		{
-			cur_node_iter->second->update_load(cell_load, new_entity_loads);
+			if (new_entity_loads[i].is_real)
+			{
+				estimated_cell_load += m_entity_cost_buffer[i];
+			}
 		}
+		cur_node_iter->second->update_load(estimated_cell_load, new_entity_loads, m_entity_cost_buffer);
+	}
 
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::set_entity_cost_model(std::shared_ptr<const entity_cost_model> cost_model)
+	{
+		m_entity_cost_model = std::move(cost_model);
 	}
 
-	bool space_cells::space_node::calc_offset_axis(float load_to_offset,  double& out_split_axis, float& offseted_load, float ghost_radius) const
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::space_node::calc_offset_axis(float load_to_offset,  double& out_split_axis, float& offseted_load, float ghost_radius) const
 	{
 		if (!is_leaf_cell())
 		{
@@ -797,40 +1595,27 @@ namespace spiritsaway::distributed_space
 		{
 			return false;
 		}
-		bool is_x = m_parent->m_is_split_x;
-
-		int axis = 0; // 0 for x 1 for z
+		int axis = m_parent->m_split_axis; // 0 for x 1 for z 2 for y
 		bool should_reverse = false;
 		double split_boundary = 0;
-		if (is_x)
+		if (m_boundary.min[axis] < cur_sibling->boundary().min[axis])
 		{
-			if (m_boundary.min.x < cur_sibling->boundary().min.x)
-			{
-				should_reverse = true;
-				split_boundary = m_boundary.max.x - 4* ghost_radius;
-			}
-			else
-			{
-				split_boundary = m_boundary.min.x + 4 * ghost_radius;
-			}
+			should_reverse = true;
+			split_boundary = m_boundary.max[axis] - 4 * ghost_radius;
 		}
 		else
 		{
-			axis = 1;
-			if (m_boundary.min.z < cur_sibling->boundary().min.z)
-			{
-				should_reverse = true;
-				split_boundary = m_boundary.max.z - 4 * ghost_radius;
-			}
-			else
-			{
-				split_boundary = m_boundary.min.z + 4 * ghost_radius;
-			}
+			split_boundary = m_boundary.min[axis] + 4 * ghost_radius;
 		}
-		auto temp_sorted_indexes = vec_iter_wrapper(m_sorted_entity_load_idx_by_axis[is_x ? 0 : 1], should_reverse);
+		auto temp_sorted_indexes = vec_iter_wrapper(m_sorted_entity_load_idx_by_axis[axis], should_reverse);
 		
 		float accumulated_load = 0;
-		double pre_split_candidate = std::min(m_boundary.min.x, m_boundary.min.z) - 100;
+		double pre_split_candidate = m_boundary.min[0];
+		for (std::uint32_t i = 1; i < D; i++)
+		{
+			pre_split_candidate = std::min(pre_split_candidate, double(m_boundary.min[i]));
+		}
+		pre_split_candidate -= 100;
 		
 		while(temp_sorted_indexes.valid())
 		{
@@ -857,14 +1642,16 @@ namespace spiritsaway::distributed_space
 				}
 				pre_split_candidate = one_entity_load.pos[axis];
 			}
-			accumulated_load += one_entity_load.load;
+			accumulated_load += m_entity_costs[one_entity_load_idx];
 		}
 		return false;
 	}
 
-	const space_cells::space_node* space_cells::get_best_cell_to_split(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param) const
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::get_best_cell_to_split(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param, const node_filter& filter) const
 	{
-		const space_cells::space_node* best_result = nullptr;
+		const space_node* best_result = nullptr;
+		float best_utilization = 0;
 		for (const auto& [one_cell_id, one_cell_node] : m_leaf_nodes)
 		{
 			if (!one_cell_node->is_leaf_cell())
@@ -875,12 +1662,19 @@ namespace spiritsaway::distributed_space
 			{
 				continue;
 			}
-			auto cur_boundary = one_cell_node->boundary();
-			if ((cur_boundary.max.x - cur_boundary.min.x < 8 * m_ghost_radius) && (cur_boundary.max.z - cur_boundary.min.z < 8 * m_ghost_radius))
+			const auto& cur_boundary = one_cell_node->boundary();
+			auto cur_ghost_radius = ghost_radius(one_cell_node);
+			bool can_split = false;
+			for (std::uint32_t i = 0; i < D; i++)
+			{
+				can_split = can_split || cur_boundary.max[i] - cur_boundary.min[i] >= 8 * cur_ghost_radius;
+			}
+			if (!can_split)
 			{
 				continue;
 			}
-			if (one_cell_node->get_smoothed_load() < lb_param.min_cell_load_when_split)
+			auto cur_utilization = cell_utilization(one_cell_node);
+			if (cur_utilization < lb_param.min_cell_load_when_split)
 			{
 				continue;
 			}
@@ -889,22 +1683,29 @@ namespace spiritsaway::distributed_space
 			{
 				continue;
 			}
-			if (temp_game_iter->second < lb_param.min_game_load_when_split)
+			if (temp_game_iter->second / game_capacity(one_cell_node->game_id()) < lb_param.min_game_load_when_split)
 			{
 				continue;
 			}
-			if (!best_result || one_cell_node->get_smoothed_load() >= best_result->get_smoothed_load())
+			if (filter && !filter(one_cell_node))
+			{
+				continue;
+			}
+			if (!best_result || cur_utilization >= best_utilization)
 			{
 				best_result = one_cell_node;
+				best_utilization = cur_utilization;
 			}
 
 		}
 		return best_result;
 	}
 
-	const space_cells::space_node* space_cells::get_best_cell_to_merge(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param)
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::get_best_cell_to_merge(const cell_load_balance_param& lb_param, const node_filter& filter)
 	{
-		const space_cells::space_node* best_result = nullptr;
+		const space_node* best_result = nullptr;
+		float best_utilization = 0;
 		for (const auto& [one_cell_id, one_cell_node] : m_leaf_nodes)
 		{
 			if (!one_cell_node->is_leaf_cell())
@@ -932,21 +1733,28 @@ namespace spiritsaway::distributed_space
 			{
 				continue;
 			}
-			if (one_cell_node->get_smoothed_load() > lb_param.max_cell_load_when_remove)
+			auto cur_utilization = cell_utilization(one_cell_node);
+			if (cur_utilization > lb_param.max_cell_load_when_remove)
+			{
+				continue;
+			}
+			if (filter && !filter(one_cell_node))
 			{
 				continue;
 			}
 			
-			if (!best_result || one_cell_node->get_smoothed_load() < best_result->get_smoothed_load())
+			if (!best_result || cur_utilization < best_utilization)
 			{
 				best_result = one_cell_node;
+				best_utilization = cur_utilization;
 			}
 
 		}
 		return best_result;
 	}
 
-	bool space_cells::space_node::check_can_shrink(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param, const double ghost_radius) const
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::space_node::check_shrink_load(const cell_load_balance_param& lb_param, float& out_score) const
 	{
 		if (!m_parent)
 		{
@@ -965,19 +1773,31 @@ namespace spiritsaway::distributed_space
 		{
 			return false;
 		}
-		auto avg_game_load = m_total_game_load / m_child_games.size();
+		auto avg_game_load = avg_game_utilization();
 		if (avg_game_load < lb_param.min_cell_load_when_shrink)
 		{
 			return false;
 		}
-		auto sibling_game_load = cur_sibling->m_total_game_load / cur_sibling->m_child_games.size();
+		auto sibling_game_load = cur_sibling->avg_game_utilization();
 		if (avg_game_load - sibling_game_load < lb_param.min_sibling_game_load_diff_when_shrink)
 		{
 			return false;
 		}
+		out_score = avg_game_load - sibling_game_load;
+		return true;
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::space_node::check_can_shrink(const cell_load_balance_param& lb_param, const double ghost_radius) const
+	{
+		float temp_score = 0;
+		if (!check_shrink_load(lb_param, temp_score))
+		{
+			return false;
+		}
 
 		// 缩容时最小步长为 ghost_radius 同时由于要保证每个cell的边长要大于4*ghost_radius 所以这里需要大于5倍的ghost_radius
-		if (calc_max_boundary_move_length(m_parent->is_split_x(), m_parent->m_children[0] == this) < 5* ghost_radius)
+		if (calc_max_boundary_move_length(m_parent->m_split_axis, m_parent->m_children[0] == this) < 5* ghost_radius)
 		{
 			return false;
 		}
@@ -985,56 +1805,128 @@ namespace spiritsaway::distributed_space
 
 	}
 
-	const space_cells::space_node* space_cells::space_node::calc_shrink_node(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param, const double ghost_radius) const
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::space_node::calc_shrink_score(const cell_load_balance_param& lb_param, const double ghost_radius, float& out_score) const
 	{
-		for (auto one_child : m_children)
+		if (!check_shrink_load(lb_param, out_score))
 		{
-			if (one_child)
+			return false;
+		}
+		if (cached_max_boundary_move_length(m_parent->m_split_axis, m_parent->m_children[0] == this) < 5 * ghost_radius)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::get_best_node_to_shrink_parallel(const cell_load_balance_param& lb_param, thread_pool* pool, const node_filter& filter) const
+	{
+		const auto& all_nodes = m_load_stat_nodes;
+		std::vector<float> node_scores(all_nodes.size(), 0);
+		std::vector<std::uint8_t> node_can_shrink(all_nodes.size(), 0);
+		auto eval_func = [&](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t i = begin; i < end; i++)
+			{
+				node_can_shrink[i] = all_nodes[i]->calc_shrink_score(lb_param, ghost_radius(all_nodes[i]->parent()), node_scores[i]) ? 1 : 0;
+			}
+		};
+		if (pool)
+		{
+			pool->parallel_for(all_nodes.size(), eval_func);
+		}
+		else
+		{
+			eval_func(0, all_nodes.size());
+		}
+		std::vector<std::uint32_t> candidates;
+		for (std::uint32_t i = 0; i < all_nodes.size(); i++)
+		{
+			if (node_can_shrink[i])
+			{
+				candidates.push_back(i);
+			}
+		}
+		// 负载差大的优先 相同时按照后序遍历的顺序 优先选择底部节点
+		// 一般第一个候选就能通过filter 所以这里每次取最优的 而不是整体排序
+		auto score_cmp = [&](std::uint32_t a, std::uint32_t b)
+		{
+			if (node_scores[a] != node_scores[b])
 			{
-				auto cur_child_result = one_child->calc_shrink_node(game_loads, lb_param, ghost_radius);
+				return node_scores[a] > node_scores[b];
+			}
+			return a < b;
+		};
+		while (!candidates.empty())
+		{
+			auto best_iter = std::min_element(candidates.begin(), candidates.end(), score_cmp);
+			auto best_node = all_nodes[*best_iter];
+			if (!filter || filter(best_node))
+			{
+				return best_node;
+			}
+			*best_iter = candidates.back();
+			candidates.pop_back();
+		}
+		return nullptr;
+	}
+
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::get_best_node_to_shrink(const cell_load_balance_param& lb_param, const node_filter& filter)
+	{
+		return calc_shrink_node(m_root_node, lb_param, filter);
+	}
+
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::calc_shrink_node(const space_node* cur_node, const cell_load_balance_param& lb_param, const node_filter& filter) const
+	{
+		if (!cur_node->is_leaf_cell())
+		{
+			for (auto one_child : cur_node->children())
+			{
+				auto cur_child_result = calc_shrink_node(one_child, lb_param, filter);
 				if (cur_child_result)
 				{
 					return cur_child_result;
 				}
 			}
 		}
-		if (check_can_shrink(game_loads, lb_param, ghost_radius))
+		if (cur_node->check_can_shrink(lb_param, ghost_radius(cur_node->parent())) && (!filter || filter(cur_node)))
 		{
-			return this;
+			return cur_node;
 		}
 		return nullptr;
 	}
 
-	const space_cells::space_node* space_cells::get_best_node_to_shrink(const std::unordered_map<std::string, float>& game_loads, const cell_load_balance_param& lb_param)
-	{
-		return m_root_node->calc_shrink_node(game_loads, lb_param, m_ghost_radius);
-	}
-
-	cell_split_direction space_cells::space_node::calc_best_split_direction(float ghost_radius) const
+	template <typename T, std::uint32_t D>
+	cell_split_direction basic_space_cells<T, D>::space_node::calc_best_split_direction(float ghost_radius) const
 	{
 		
 		if (m_entity_loads.empty())
 		{
-			// 选择最长边的一个方向
+			// 选择最长边的一个方向 长度相同时优先z
 
-			if (m_boundary.max.x - m_boundary.min.x > m_boundary.max.z - m_boundary.min.z)
-			{
-				return cell_split_direction::left_x;
-			}
-			else
+			int best_axis = 1;
+			for (std::uint32_t i = 0; i < D; i++)
 			{
-				return cell_split_direction::low_z;
+				if (m_boundary.max[i] - m_boundary.min[i] > m_boundary.max[best_axis] - m_boundary.min[best_axis])
+				{
+					best_axis = int(i);
+				}
 			}
+			return cell_split_direction(best_axis * 2);
 
 		}
 		else
 		{
-			std::array<float, 4> split_gains;
+			// 下标为axis * 2 + is_high 与cell_split_direction的顺序相同
+			std::array<float, 2 * D> split_gains;
 			std::fill(split_gains.begin(), split_gains.end(), 0);
 			
-			float temp_acc_loads = 0;
-			for (int i = 0; i < 1; i++)
+			for (std::uint32_t i = 0; i < D; i++)
 			{
+				float temp_acc_loads = 0;
 				auto cur_sorted_load_idx_copy = vec_iter_wrapper(m_sorted_entity_load_idx_by_axis[i], false);
 
 				while (cur_sorted_load_idx_copy.valid())
@@ -1047,7 +1939,7 @@ namespace spiritsaway::distributed_space
 					}
 					else
 					{
-						temp_acc_loads += one_load.load;
+						temp_acc_loads += m_entity_costs[one_index];
 					}
 				}
 				split_gains[i*2] = temp_acc_loads;
@@ -1065,40 +1957,37 @@ namespace spiritsaway::distributed_space
 					}
 					else
 					{
-						temp_acc_loads += one_load.load;
+						temp_acc_loads += m_entity_costs[one_index];
 					}
 				}
 				split_gains[i*2 + 1] = temp_acc_loads;
 			}
 			// 避免新的子节点与原来的兄弟节点划分方向相同 以免出现连续多个同方向划分
+			// 即在父节点的分割轴上 不切分靠近兄弟节点的一侧
 			if (m_parent)
 			{
-				if (m_parent->is_split_x())
+				int parent_axis = m_parent->m_split_axis;
+				if (this == m_parent->m_children[0])
 				{
-					if (this == m_parent->m_children[0])
-					{
-						split_gains[int(cell_split_direction::right_x)] *= 0.5f;
-					}
-					else
-					{
-						split_gains[int(cell_split_direction::left_x)] *= 0.5f;
-					}
+					split_gains[parent_axis * 2 + 1] *= 0.5f;
 				}
 				else
 				{
-					if (this == m_parent->m_children[0])
-					{
-						split_gains[int(cell_split_direction::high_z)] *= 0.5f;
-					}
-					else
-					{
-						split_gains[int(cell_split_direction::low_z)] *= 0.5f;
-					}
+					split_gains[parent_axis * 2] *= 0.5f;
+				}
+			}
+			// 长度不足8 * ghost_radius的轴切分之后会出现小于4 * ghost_radius的cell
+			for (std::uint32_t i = 0; i < D; i++)
+			{
+				if (m_boundary.max[i] - m_boundary.min[i] < 8 * ghost_radius)
+				{
+					split_gains[i * 2] = -1;
+					split_gains[i * 2 + 1] = -1;
 				}
 			}
 			int best_dir = 0;
 			float best_gain = split_gains[0];
-			for (int i = 1; i < 4; i++)
+			for (int i = 1; i < int(2 * D); i++)
 			{
 				if (split_gains[i] > best_gain)
 				{
@@ -1110,7 +1999,8 @@ namespace spiritsaway::distributed_space
 		}
 	}
 
-	const space_cells::space_node* space_cells::split_at_direction(const std::string& origin_space_id, cell_split_direction split_direction, const std::string& new_space_id, const std::string& new_space_game_id)
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::split_at_direction(const std::string& origin_space_id, cell_split_direction split_direction, const std::string& new_space_id, const std::string& new_space_game_id)
 	{
 		auto cur_cell_iter = m_leaf_nodes.find(origin_space_id);
 		if (cur_cell_iter == m_leaf_nodes.end())
@@ -1122,84 +2012,425 @@ namespace spiritsaway::distributed_space
 		{
 			return nullptr;
 		}
-		switch (split_direction)
+		int axis = int(split_direction) / 2;
+		if (axis >= int(D))
 		{
-		case cell_split_direction::left_x:
-			return split_x(cur_cell->boundary().min.x + 4 * m_ghost_radius, origin_space_id, new_space_game_id, new_space_id, origin_space_id);
-		case cell_split_direction::right_x:
-			return split_x(cur_cell->boundary().max.x - 4 * m_ghost_radius, origin_space_id, new_space_game_id, origin_space_id, new_space_id);
-		case cell_split_direction::low_z:
-			return split_z(cur_cell->boundary().min.z + 4 * m_ghost_radius, origin_space_id, new_space_game_id, new_space_id, origin_space_id);
-		case cell_split_direction::high_z:
-			return split_z(cur_cell->boundary().max.z - 4 * m_ghost_radius, origin_space_id, new_space_game_id, origin_space_id, new_space_id);
-		default:
 			return nullptr;
 		}
+		// 新的cell在切分方向的一侧 原来的cell保留剩余的部分
+		bool is_high = int(split_direction) % 2 == 1;
+		auto cur_ghost_radius = ghost_radius(cur_cell);
+		double split_pos = is_high ? cur_cell->boundary().max[axis] - 4 * cur_ghost_radius : cur_cell->boundary().min[axis] + 4 * cur_ghost_radius;
+		const auto& low_space_id = is_high ? origin_space_id : new_space_id;
+		const auto& high_space_id = is_high ? new_space_id : origin_space_id;
+		switch (axis)
+		{
+		case 0:
+			return split_x(split_pos, origin_space_id, new_space_game_id, low_space_id, high_space_id);
+		case 1:
+			return split_z(split_pos, origin_space_id, new_space_game_id, low_space_id, high_space_id);
+		default:
+			return split_y(split_pos, origin_space_id, new_space_game_id, low_space_id, high_space_id);
+		}
 
 	}
 
-	double space_cells::space_node::calc_max_boundary_move_length(bool is_x, bool is_split_pos_smaller) const
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::plan_split_k(const space_node* origin_node, const cell_bound& bound, std::size_t begin, std::size_t end, std::vector<split_k_step>& out_steps) const
 	{
-		auto cur_axis = is_x ? 0 : 1;
-		if (is_leaf_cell())
+		if (end - begin <= 1)
 		{
-			return m_boundary.max[is_x] - m_boundary.min[is_x];
+			return true;
 		}
-		else
+		auto min_length = 4 * ghost_radius(origin_node);
+		auto low_piece_num = (end - begin) / 2;
+		auto high_piece_num = end - begin - low_piece_num;
+		// 优先切分较长的边 长度相同时按照坐标轴的顺序
+		std::array<int, D> axis_order;
+		for (std::uint32_t i = 0; i < D; i++)
+		{
+			axis_order[i] = int(i);
+		}
+		std::stable_sort(axis_order.begin(), axis_order.end(), [&bound](int a, int b)
+			{
+				return bound.max[a] - bound.min[a] > bound.max[b] - bound.min[b];
+			});
+		for (auto cur_axis : axis_order)
 		{
-			if (is_x)
+			// 子区域在其他轴上最多能放下的cell数量 用来计算每一侧需要的最小长度
+			double row_num = 1;
+			for (std::uint32_t i = 0; i < D; i++)
+			{
+				if (int(i) != cur_axis)
+				{
+					row_num *= std::floor((bound.max[i] - bound.min[i]) / min_length);
+				}
+			}
+			if (row_num < 1)
+			{
+				return false;
+			}
+			auto min_split_pos = bound.min[cur_axis] + min_length * std::ceil(low_piece_num / row_num);
+			auto max_split_pos = bound.max[cur_axis] - min_length * std::ceil(high_piece_num / row_num);
+			if (min_split_pos > max_split_pos)
+			{
+				continue;
+			}
+			// 按照坐标顺序累加区域内的负载 找到对应分位数的位置
+			const auto& cur_sorted_idx = origin_node->m_sorted_entity_load_idx_by_axis[cur_axis];
+			const auto& cur_entity_loads = origin_node->m_entity_loads;
+			const auto& cur_entity_costs = origin_node->m_entity_costs;
+			float total_load = 0;
+			for (std::size_t i = 0; i < cur_entity_loads.size(); i++)
+			{
+				if (bound.cover(cur_entity_loads[i].pos))
+				{
+					total_load += cur_entity_costs[i];
+				}
+			}
+			double split_pos = bound.min[cur_axis] + (bound.max[cur_axis] - bound.min[cur_axis]) * low_piece_num / (end - begin);
+			if (total_load > 0)
 			{
-				if (m_is_split_x)
+				auto target_load = total_load * low_piece_num / (end - begin);
+				float accumulated_load = 0;
+				double pre_pos = bound.min[cur_axis];
+				bool is_target_reached = false;
+				for (auto one_idx : cur_sorted_idx)
 				{
-					if (is_split_pos_smaller)
+					const auto& one_entity_load = cur_entity_loads[one_idx];
+					if (!bound.cover(one_entity_load.pos))
 					{
-						return m_children[1]->calc_max_boundary_move_length(is_x, is_split_pos_smaller);
+						continue;
 					}
-					else
+					auto cur_pos = one_entity_load.pos[cur_axis];
+					if (is_target_reached && cur_pos != pre_pos)
 					{
-						return m_children[0]->calc_max_boundary_move_length(is_x, is_split_pos_smaller);
+						split_pos = (pre_pos + cur_pos) / 2;
+						break;
+					}
+					accumulated_load += cur_entity_costs[one_idx];
+					pre_pos = cur_pos;
+					if (accumulated_load >= target_load)
+					{
+						is_target_reached = true;
 					}
-					
-				}
-				else
-				{
-					return std::min(m_children[0]->calc_max_boundary_move_length(is_x, is_split_pos_smaller), m_children[1]->calc_max_boundary_move_length(is_x, is_split_pos_smaller));
 				}
 			}
-			else
+			split_pos = std::max(min_split_pos, std::min(split_pos, max_split_pos));
+			out_steps.push_back(split_k_step{ begin, begin + low_piece_num, cur_axis, split_pos });
+			auto low_bound = bound;
+			low_bound.max[cur_axis] = split_pos;
+			auto high_bound = bound;
+			high_bound.min[cur_axis] = split_pos;
+			return plan_split_k(origin_node, low_bound, begin, begin + low_piece_num, out_steps) && plan_split_k(origin_node, high_bound, begin + low_piece_num, end, out_steps);
+		}
+		return false;
+	}
+
+	template <typename T, std::uint32_t D>
+	std::vector<const typename basic_space_cells<T, D>::space_node*> basic_space_cells<T, D>::split_k(const std::string& origin_space_id, const std::vector<std::string>& new_space_ids, const std::vector<std::string>& new_game_ids)
+	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
+		{
+			cur_scope.journal->write_split_k(origin_space_id, new_space_ids, new_game_ids);
+		}
+		std::vector<const space_node*> result;
+		if (new_space_ids.empty() || new_space_ids.size() != new_game_ids.size())
+		{
+			return result;
+		}
+		auto cur_cell_iter = m_leaf_nodes.find(origin_space_id);
+		if (cur_cell_iter == m_leaf_nodes.end())
+		{
+			return result;
+		}
+		auto cur_cell = cur_cell_iter->second;
+		if (!cur_cell->ready() || cur_cell->is_merging() || cur_cell->cell_load_report_counter() == 0)
+		{
+			return result;
+		}
+		std::unordered_set<std::string> temp_space_ids;
+		temp_space_ids.insert(origin_space_id);
+		for (const auto& one_space_id : new_space_ids)
+		{
+			if (!check_valid_space_id(one_space_id) || m_leaf_nodes.count(one_space_id) || m_internal_nodes.count(one_space_id))
 			{
-				if (m_is_split_x)
-				{
-					return std::min(m_children[0]->calc_max_boundary_move_length(is_x, is_split_pos_smaller), m_children[1]->calc_max_boundary_move_length(is_x, is_split_pos_smaller));
-					
+				return result;
+			}
+			if (!temp_space_ids.insert(one_space_id).second)
+			{
+				return result;
+			}
+		}
+		std::vector<split_k_step> split_steps;
+		split_steps.reserve(new_space_ids.size());
+		if (!plan_split_k(cur_cell, cur_cell->boundary(), 0, new_space_ids.size() + 1, split_steps))
+		{
+			return result;
+		}
+		// 编号0为原来的cell 编号i对应new_space_ids[i - 1]
+		auto piece_space_id = [&](std::size_t piece_idx) -> const std::string&
+		{
+			return piece_idx == 0 ? origin_space_id : new_space_ids[piece_idx - 1];
+		};
+		for (const auto& one_step : split_steps)
+		{
+			const auto& low_space_id = piece_space_id(one_step.low_piece);
+			const auto& high_space_id = piece_space_id(one_step.high_piece);
+			const auto& high_game_id = new_game_ids[one_step.high_piece - 1];
+			// plan_split_k已经检查过每一步的分割位置与id 这里只会在树的状态不一致时失败
+			auto cur_split_result = split_at_axis(one_step.axis, one_step.split_pos, low_space_id, high_game_id, low_space_id, high_space_id);
+			assert(cur_split_result);
+			if (!cur_split_result)
+			{
+				return result;
+			}
+		}
+		// 新cell再次切分时会被当作master cell设置为ready 这里统一恢复为与split_x新建cell相同的状态
+		// 从新cell中切分出来的cell的host也是新cell 统一改为origin_space_id 因为这些区域的entity都还在origin_space_id上
+		std::vector<const space_node*> new_cells;
+		new_cells.reserve(new_space_ids.size());
+		for (const auto& one_space_id : new_space_ids)
+		{
+			auto cur_new_iter = m_leaf_nodes.find(one_space_id);
+			assert(cur_new_iter != m_leaf_nodes.end());
+			if (cur_new_iter == m_leaf_nodes.end())
+			{
+				return result;
+			}
+			auto cur_new_cell = cur_new_iter->second;
+			cur_new_cell->m_ready = false;
+			cur_new_cell->m_host_space_id = origin_space_id;
+			cur_new_cell->m_cell_load_report_counter = 0;
+			new_cells.push_back(cur_new_cell);
+		}
+		result.swap(new_cells);
+		return result;
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::calc_split_bound(const std::string& origin_space_id, cell_split_direction split_direction, cell_bound& out_bound) const
+	{
+		auto cur_cell = get_leaf(origin_space_id);
+		if (!cur_cell || !cur_cell->is_leaf_cell())
+		{
+			return false;
+		}
+		int axis = int(split_direction) / 2;
+		if (axis >= int(D))
+		{
+			return false;
+		}
+		out_bound = cur_cell->boundary();
+		if (int(split_direction) % 2 == 1)
+		{
+			out_bound.min[axis] = T(out_bound.max[axis] - 4 * ghost_radius(cur_cell));
+		}
+		else
+		{
+			out_bound.max[axis] = T(out_bound.min[axis] + 4 * ghost_radius(cur_cell));
+		}
+		return true;
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::set_journal(space_journal_writer* journal)
+	{
+		// journal只记录二维的space_cells
+		if constexpr (D == 2)
+		{
+			m_journal = journal;
+			if (m_journal)
+			{
+				m_journal->write_snapshot(*this);
+			}
+			return true;
+		}
+		else
+		{
+			(void)journal;
+			return false;
+		}
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::set_game_capacity(const std::string& game_id, float capacity)
+	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
+		{
+			cur_scope.journal->write_set_game_capacity(game_id, capacity);
+		}
+		if (capacity <= 0)
+		{
+			return;
+		}
+		m_game_capacities[game_id] = capacity;
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::remove_game_capacity(const std::string& game_id)
+	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
+		{
+			cur_scope.journal->write_remove_game_capacity(game_id);
+		}
+		return m_game_capacities.erase(game_id) != 0;
+	}
+
+	template <typename T, std::uint32_t D>
+	float basic_space_cells<T, D>::game_capacity(const std::string& game_id) const
+	{
+		auto cur_iter = m_game_capacities.find(game_id);
+		if (cur_iter == m_game_capacities.end())
+		{
+			return 1.0f;
+		}
+		return cur_iter->second;
+	}
+
+	template <typename T, std::uint32_t D>
+	float basic_space_cells<T, D>::cell_utilization(const space_node* cur_cell) const
+	{
+		return cur_cell->get_smoothed_load() / game_capacity(cur_cell->game_id());
+	}
+
+	template <typename T, std::uint32_t D>
+	std::string basic_space_cells<T, D>::choose_game_for_new_cell(const std::string& origin_space_id, cell_split_direction split_direction, const std::unordered_map<std::string, float>& game_loads, const game_assign_param& assign_param) const
+	{
+		cell_bound new_bound;
+		if (!calc_split_bound(origin_space_id, split_direction, new_bound))
+		{
+			return {};
+		}
+		auto origin_cell = get_leaf(origin_space_id);
+		// 新cell的预估负载为落在新区域内的real entity负载
+		float new_cell_load = 0;
+		const auto& origin_entity_loads = origin_cell->get_entity_loads();
+		for (std::size_t i = 0; i < origin_entity_loads.size(); i++)
+		{
+			if (origin_entity_loads[i].is_real && new_bound.cover(origin_entity_loads[i].pos))
+			{
+				new_cell_load += origin_cell->get_entity_costs()[i];
+			}
+		}
+		// 与新cell距离在ghost_radius之内的区域都会产生ghost 按照这部分的面积统计每个game的相邻占比 三维时为体积
+		auto cur_ghost_radius = ghost_radius(origin_cell);
+		cell_bound ghost_bound = new_bound;
+		for (std::uint32_t i = 0; i < D; i++)
+		{
+			ghost_bound.min[i] = T(ghost_bound.min[i] - cur_ghost_radius);
+			ghost_bound.max[i] = T(ghost_bound.max[i] + cur_ghost_radius);
+		}
+		std::unordered_map<std::string, double> game_ghost_areas;
+		double total_ghost_area = 0;
+		for (auto one_neighbor : query_intersect_leafs(ghost_bound))
+		{
+			const auto& cur_neighbor_bound = one_neighbor->boundary();
+			std::array<double, D> overlaps;
+			for (std::uint32_t i = 0; i < D; i++)
+			{
+				overlaps[i] = std::min(cur_neighbor_bound.max[i], ghost_bound.max[i]) - std::max(cur_neighbor_bound.min[i], ghost_bound.min[i]);
+			}
+			if (one_neighbor == origin_cell)
+			{
+				// 原cell在切分之后只剩下新区域之外的部分
+				overlaps[int(split_direction) / 2] = cur_ghost_radius;
+			}
+			double overlap_area = 1;
+			for (auto one_overlap : overlaps)
+			{
+				overlap_area = one_overlap > 0 ? overlap_area * one_overlap : 0;
+			}
+			if (overlap_area <= 0)
+			{
+				continue;
+			}
+			game_ghost_areas[one_neighbor->game_id()] += overlap_area;
+			total_ghost_area += overlap_area;
+		}
 
+		std::string best_game;
+		double best_score = 0;
+		// 所有game都会超过上限的时候 退化为选择负载比例最小的game
+		std::string min_load_game;
+		float min_load_per_capacity = 0;
+		for (const auto& [one_game_id, one_game_load] : game_loads)
+		{
+			if (one_game_id == origin_cell->game_id())
+			{
+				continue;
+			}
+			auto cur_load_per_capacity = (one_game_load + new_cell_load) / game_capacity(one_game_id);
+			if (min_load_game.empty() || cur_load_per_capacity < min_load_per_capacity || (cur_load_per_capacity == min_load_per_capacity && one_game_id < min_load_game))
+			{
+				min_load_game = one_game_id;
+				min_load_per_capacity = cur_load_per_capacity;
+			}
+			if (cur_load_per_capacity > assign_param.max_game_load_per_capacity)
+			{
+				continue;
+			}
+			double cur_score = cur_load_per_capacity / std::max(assign_param.max_game_load_per_capacity, 0.0001f);
+			auto cur_area_iter = game_ghost_areas.find(one_game_id);
+			if (cur_area_iter != game_ghost_areas.end() && total_ghost_area > 0)
+			{
+				cur_score -= assign_param.adjacent_game_weight * cur_area_iter->second / total_ghost_area;
+			}
+			// 分数相同的时候按照game_id排序 保证结果稳定
+			if (best_game.empty() || cur_score < best_score || (cur_score == best_score && one_game_id < best_game))
+			{
+				best_game = one_game_id;
+				best_score = cur_score;
+			}
+		}
+		if (best_game.empty())
+		{
+			return min_load_game;
+		}
+		return best_game;
+	}
+
+	template <typename T, std::uint32_t D>
+	double basic_space_cells<T, D>::space_node::calc_max_boundary_move_length(int axis, bool is_split_pos_smaller) const
+	{
+		if (is_leaf_cell())
+		{
+			return m_boundary.max[axis] - m_boundary.min[axis];
+		}
+		else
+		{
+			// 分割轴与移动的坐标轴相同时只有一个子节点在边界上 否则两个子节点都在边界上
+			if (axis == m_split_axis)
+			{
+				if (is_split_pos_smaller)
+				{
+					return m_children[1]->calc_max_boundary_move_length(axis, is_split_pos_smaller);
 				}
 				else
 				{
-					if (is_split_pos_smaller)
-					{
-						return m_children[1]->calc_max_boundary_move_length(is_x, is_split_pos_smaller);
-					}
-					else
-					{
-						return m_children[0]->calc_max_boundary_move_length(is_x, is_split_pos_smaller);
-					}
+					return m_children[0]->calc_max_boundary_move_length(axis, is_split_pos_smaller);
 				}
 			}
-			
+			else
+			{
+				return std::min(m_children[0]->calc_max_boundary_move_length(axis, is_split_pos_smaller), m_children[1]->calc_max_boundary_move_length(axis, is_split_pos_smaller));
+			}
 		}
 		
 	}
-	void space_cells::space_node::update_boundary_with_new_split(double new_split_pos, bool is_x, bool is_split_pos_smaller, bool is_changing_max)
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::update_boundary_with_new_split(double new_split_pos, int axis, bool is_split_pos_smaller, bool is_changing_max)
 	{
-		auto cur_axis = is_x ? 0 : 1;
 		if (is_changing_max)
 		{
-			m_boundary.max[cur_axis] = new_split_pos;
+			m_boundary.max[axis] = T(new_split_pos);
 		}
 		else
 		{
-			m_boundary.min[cur_axis] = new_split_pos;
+			m_boundary.min[axis] = T(new_split_pos);
 		}
 		if (is_leaf_cell())
 		{
@@ -1209,268 +2440,866 @@ namespace spiritsaway::distributed_space
 		}
 		else
 		{
-			if (is_x)
+			if (axis == m_split_axis)
+			{
+				if (is_changing_max)
+				{
+					return m_children[1]->update_boundary_with_new_split(new_split_pos, axis, is_split_pos_smaller, is_changing_max);
+				}
+				else
+				{
+					return m_children[0]->update_boundary_with_new_split(new_split_pos, axis, is_split_pos_smaller, is_changing_max);
+				}
+			}
+			else
+			{
+				m_children[1]->update_boundary_with_new_split(new_split_pos, axis, is_split_pos_smaller, is_changing_max);
+				m_children[0]->update_boundary_with_new_split(new_split_pos, axis, is_split_pos_smaller, is_changing_max);
+			}
+		}
+	}
+	template <typename T, std::uint32_t D>
+	double basic_space_cells<T, D>::calc_max_shrink_length(const space_node* shrink_node) const
+	{
+		auto cur_parent = shrink_node->parent();
+		if (!cur_parent)
+		{
+			return -4*m_ghost_radius;
+		}
+		else
+		{
+			// 第二个子节点缩小时分割线朝坐标较小的方向移动
+			bool is_split_pos_smaller = shrink_node != cur_parent->children()[0];
+			return shrink_node->calc_max_boundary_move_length(cur_parent->split_axis(), is_split_pos_smaller) - 4 * ghost_radius(cur_parent);
+		}
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::balance(double split_v, const space_node* cur_node)
+	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
+		{
+			cur_scope.journal->write_balance(space_journal_op::balance_node, split_v, cur_node ? cur_node->space_id() : std::string());
+		}
+		if (!cur_node || cur_node->is_leaf_cell())
+		{
+			return false;
+		}
+		auto cur_axis = cur_node->split_axis();
+		double pre_split_pos = cur_node->m_children[0]->boundary().max[cur_axis];
+		bool is_split_pos_smaller = split_v < pre_split_pos;
+		// 分割线不能越过缩小一侧子树中平行的分割线
+		auto cur_shrink_node = cur_node->m_children[is_split_pos_smaller ? 0 : 1];
+		if (!(std::abs(split_v - pre_split_pos) < cur_shrink_node->calc_max_boundary_move_length(cur_axis, is_split_pos_smaller)))
+		{
+			return false;
+		}
+		auto mutable_cur_node = m_internal_nodes[cur_node->space_id()];
+		assert(mutable_cur_node);
+		m_load_stat_nodes.clear();
+		mutable_cur_node->children()[0]->update_boundary_with_new_split(split_v, cur_axis, is_split_pos_smaller, true);
+		mutable_cur_node->children()[1]->update_boundary_with_new_split(split_v, cur_axis, is_split_pos_smaller, false);
+		m_op_counters.shrink++;
+		return true;
+	}
+
+	template <typename T, std::uint32_t D>
+	float basic_space_cells<T, D>::space_node::calc_move_split_offload(double new_split_pos, int axis, bool is_split_pos_smaller) const
+	{
+		auto cur_axis = axis;
+		if (is_leaf_cell())
+		{
+			auto cur_sorted_load_idx_copy = vec_iter_wrapper(m_sorted_entity_load_idx_by_axis[cur_axis], is_split_pos_smaller);
+			
+			float temp_gain = 0;
+			while (cur_sorted_load_idx_copy.valid())
+			{
+				auto one_index = cur_sorted_load_idx_copy.get_and_next();
+				if (is_split_pos_smaller)
+				{
+					if (m_entity_loads[one_index].pos[cur_axis] < new_split_pos)
+					{
+						break;
+					}
+				}
+				else
+				{
+					if (m_entity_loads[one_index].pos[cur_axis] > new_split_pos)
+					{
+						break;
+					}
+				}
+				temp_gain += m_entity_costs[one_index];
+			}
+			return temp_gain;
+		}
+		else
+		{
+			if (axis == m_split_axis)
 			{
-				if (m_is_split_x)
+				if (is_split_pos_smaller)
+				{
+					return m_children[1]->calc_move_split_offload(new_split_pos, axis, is_split_pos_smaller);
+				}
+				else
 				{
-					if (is_changing_max)
+					return m_children[0]->calc_move_split_offload(new_split_pos, axis, is_split_pos_smaller);
+				}
+			}
+			else
+			{
+				return m_children[1]->calc_move_split_offload(new_split_pos, axis, is_split_pos_smaller) + m_children[0]->calc_move_split_offload(new_split_pos, axis, is_split_pos_smaller);
+			}
+		}
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::update_load_stat(const std::unordered_map<std::string, float>& game_loads, const std::unordered_map<std::string, float>& game_capacities, std::vector<const space_node*>& out_nodes)
+	{
+		if (is_leaf_cell())
+		{
+			m_min_cell_load_report_counter = m_cell_load_report_counter;
+			m_total_cell_load = get_smoothed_load();
+			auto temp_game_iter = game_loads.find(m_game_id);
+			if (temp_game_iter == game_loads.end())
+			{
+				m_total_game_load = 0;
+			}
+			else
+			{
+				m_total_game_load = temp_game_iter->second;
+			}
+			auto temp_capacity_iter = game_capacities.find(m_game_id);
+			m_total_game_capacity = temp_capacity_iter == game_capacities.end() ? 1.0f : temp_capacity_iter->second;
+			m_child_games.clear();
+			m_child_leaf.clear();
+			m_child_games.push_back(&m_game_id);
+			m_child_leaf.push_back(this);
+			for (std::uint32_t i = 0; i < D; i++)
+			{
+				auto cur_length = m_boundary.max[i] - m_boundary.min[i];
+				m_max_boundary_move_lengths[i * 2] = cur_length;
+				m_max_boundary_move_lengths[i * 2 + 1] = cur_length;
+			}
+		}
+		else
+		{
+			m_children[0]->update_load_stat(game_loads, game_capacities, out_nodes);
+			m_children[1]->update_load_stat(game_loads, game_capacities, out_nodes);
+			m_total_cell_load = m_children[0]->m_total_cell_load + m_children[1]->m_total_cell_load;
+			m_total_game_load = m_children[0]->m_total_game_load + m_children[1]->m_total_game_load;
+			m_total_game_capacity = m_children[0]->m_total_game_capacity + m_children[1]->m_total_game_capacity;
+			m_child_games.clear();
+			m_child_leaf.clear();
+			m_min_cell_load_report_counter = std::min(m_children[0]->m_min_cell_load_report_counter, m_children[1]->m_min_cell_load_report_counter);
+			for (const auto& one_node : m_children[0]->m_child_leaf)
+			{
+				m_child_leaf.push_back(one_node);
+			}
+			for (const auto& one_game : m_children[0]->m_child_games)
+			{
+				m_child_games.push_back(one_game);
+			}
+			for (const auto& one_node : m_children[1]->m_child_leaf)
+			{
+				m_child_leaf.push_back(one_node);
+			}
+			for (const auto& one_game : m_children[1]->m_child_games)
+			{
+				m_child_games.push_back(one_game);
+			}
+			// 与calc_max_boundary_move_length的递归规则相同
+			for (int i = 0; i < int(D); i++)
+			{
+				for (int j = 0; j < 2; j++)
+				{
+					bool is_split_pos_smaller = j == 1;
+					double cur_length = 0;
+					if (i == m_split_axis)
 					{
-						return m_children[1]->update_boundary_with_new_split(new_split_pos, is_x, is_split_pos_smaller, is_changing_max);
+						cur_length = m_children[is_split_pos_smaller ? 1 : 0]->cached_max_boundary_move_length(i, is_split_pos_smaller);
 					}
 					else
 					{
-						return m_children[0]->update_boundary_with_new_split(new_split_pos, is_x, is_split_pos_smaller, is_changing_max);
+						cur_length = std::min(m_children[0]->cached_max_boundary_move_length(i, is_split_pos_smaller), m_children[1]->cached_max_boundary_move_length(i, is_split_pos_smaller));
 					}
+					m_max_boundary_move_lengths[i * 2 + j] = cur_length;
+				}
+			}
+		}
+		out_nodes.push_back(this);
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::space_node::collect_move_split_leafs(int axis, bool is_split_pos_smaller, std::vector<const space_node*>& out_leafs) const
+	{
+		if (is_leaf_cell())
+		{
+			out_leafs.push_back(this);
+			return;
+		}
+		// 与calc_move_split_offload的递归规则相同 分割方向与移动方向相同时只有一个子节点在边界上
+		if (axis == m_split_axis)
+		{
+			m_children[is_split_pos_smaller ? 1 : 0]->collect_move_split_leafs(axis, is_split_pos_smaller, out_leafs);
+		}
+		else
+		{
+			m_children[0]->collect_move_split_leafs(axis, is_split_pos_smaller, out_leafs);
+			m_children[1]->collect_move_split_leafs(axis, is_split_pos_smaller, out_leafs);
+		}
+	}
 
+	template <typename T, std::uint32_t D>
+	double basic_space_cells<T, D>::space_node::calc_best_shrink_new_split_pos(const cell_load_balance_param& lb_param, const double ghost_radius) const
+	{
+		int cur_axis = m_parent->m_split_axis;
+		bool is_split_pos_smaller = m_parent->m_children[0] == this;
+		auto max_move_length = calc_max_boundary_move_length(cur_axis, is_split_pos_smaller) - 4 * ghost_radius;
+		double min_move_length = ghost_radius;
+		if (max_move_length < min_move_length)
+		{
+			max_move_length = min_move_length;
+		}
+		// 边界坐标 以及边界移动方向
+		double edge_pos = is_split_pos_smaller ? m_boundary.max[cur_axis] : m_boundary.min[cur_axis];
+		double move_sign = is_split_pos_smaller ? -1 : 1;
+
+		std::vector<const space_node*> move_leafs;
+		collect_move_split_leafs(cur_axis, is_split_pos_smaller, move_leafs);
+		// 将每个叶子节点的entity按照到边界的距离从小到大编号 is_split_pos_smaller时需要反向遍历排序数组
+		// 第k个entity到边界的距离
+		auto entity_distance = [&](const space_node* cur_leaf, std::size_t k)
+		{
+			const auto& cur_sorted_idx = cur_leaf->m_sorted_entity_load_idx_by_axis[cur_axis];
+			auto cur_entity_idx = is_split_pos_smaller ? cur_sorted_idx[cur_sorted_idx.size() - k - 1] : cur_sorted_idx[k];
+			return (cur_leaf->m_entity_loads[cur_entity_idx].pos[cur_axis] - edge_pos) * move_sign;
+		};
+		// 到边界的距离小于(is_inclusive时为小于等于)distance的entity数量
+		auto count_entity = [&](const space_node* cur_leaf, std::size_t begin, std::size_t end, double distance, bool is_inclusive)
+		{
+			while (begin < end)
+			{
+				auto mid = (begin + end) / 2;
+				auto mid_distance = entity_distance(cur_leaf, mid);
+				if (mid_distance < distance || (is_inclusive && mid_distance == distance))
+				{
+					begin = mid + 1;
 				}
 				else
 				{
-					m_children[1]->update_boundary_with_new_split(new_split_pos, is_x, is_split_pos_smaller, is_changing_max);
-					m_children[0]->update_boundary_with_new_split(new_split_pos, is_x, is_split_pos_smaller, is_changing_max);
+					end = mid;
+				}
+			}
+			return begin;
+		};
+		// 距离边界最近的k个entity的负载总和
+		auto prefix_load = [&](const space_node* cur_leaf, std::size_t k)
+		{
+			const auto& cur_prefix = cur_leaf->m_sorted_entity_load_prefix_by_axis[cur_axis];
+			if (is_split_pos_smaller)
+			{
+				return cur_prefix.back() - cur_prefix[cur_prefix.size() - k - 1];
+			}
+			else
+			{
+				return cur_prefix[k];
+			}
+		};
+
+		// 在所有叶子节点的entity中二分查找最小的距离 使得这个距离之内的负载总和超过目标
+		// [range_begin, range_end)为每个叶子节点中仍然可能是答案的entity编号
+		// 每次选择剩余范围最大的叶子节点的中间entity作为候选 然后用这个候选的距离同时缩小所有叶子节点的范围
+		// 阈值是利用率 按照当前节点叶子节点的平均game容量换算为负载
+		// 没有执行过update_load_stat时m_child_games为空 此时与未设置容量的game一样按照容量1计算
+		double avg_game_capacity = m_child_games.empty() ? 1.0 : double(m_total_game_capacity) / m_child_games.size();
+		auto target_offload = lb_param.min_sibling_game_load_diff_when_shrink / 2 * avg_game_capacity;
+		std::vector<std::size_t> range_begins(move_leafs.size(), 0);
+		std::vector<std::size_t> range_ends(move_leafs.size(), 0);
+		for (std::size_t i = 0; i < move_leafs.size(); i++)
+		{
+			range_ends[i] = count_entity(move_leafs[i], 0, move_leafs[i]->m_entity_loads.size(), max_move_length, true);
+		}
+		bool is_target_reached = false;
+		double target_distance = 0;
+		while (true)
+		{
+			std::size_t pivot_leaf_idx = 0;
+			for (std::size_t i = 1; i < move_leafs.size(); i++)
+			{
+				if (range_ends[i] - range_begins[i] > range_ends[pivot_leaf_idx] - range_begins[pivot_leaf_idx])
+				{
+					pivot_leaf_idx = i;
+				}
+			}
+			if (move_leafs.empty() || range_ends[pivot_leaf_idx] == range_begins[pivot_leaf_idx])
+			{
+				break;
+			}
+			auto pivot_distance = entity_distance(move_leafs[pivot_leaf_idx], (range_begins[pivot_leaf_idx] + range_ends[pivot_leaf_idx]) / 2);
+			double pivot_offload = 0;
+			for (std::size_t i = 0; i < move_leafs.size(); i++)
+			{
+				pivot_offload += prefix_load(move_leafs[i], count_entity(move_leafs[i], 0, move_leafs[i]->m_entity_loads.size(), pivot_distance, true));
+			}
+			if (pivot_offload > target_offload)
+			{
+				// 答案小于等于pivot_distance
+				is_target_reached = true;
+				target_distance = pivot_distance;
+				for (std::size_t i = 0; i < move_leafs.size(); i++)
+				{
+					range_ends[i] = count_entity(move_leafs[i], range_begins[i], range_ends[i], pivot_distance, false);
 				}
 			}
 			else
 			{
-				if (m_is_split_x)
+				// 答案大于pivot_distance
+				for (std::size_t i = 0; i < move_leafs.size(); i++)
 				{
-					m_children[1]->update_boundary_with_new_split(new_split_pos, is_x, is_split_pos_smaller, is_changing_max);
-					m_children[0]->update_boundary_with_new_split(new_split_pos, is_x, is_split_pos_smaller, is_changing_max);
+					range_begins[i] = count_entity(move_leafs[i], range_begins[i], range_ends[i], pivot_distance, true);
 				}
-				else
+			}
+		}
+		double best_move_length = max_move_length;
+		if (is_target_reached)
+		{
+			// 相同坐标的entity必须一起移出 分割线放在目标entity与下一个不同坐标的entity中间
+			double next_distance = std::numeric_limits<double>::max();
+			for (const auto* one_leaf : move_leafs)
+			{
+				auto next_k = count_entity(one_leaf, 0, one_leaf->m_entity_loads.size(), target_distance, true);
+				if (next_k < one_leaf->m_entity_loads.size())
 				{
-					if (is_changing_max)
-					{
-						return m_children[1]->update_boundary_with_new_split(new_split_pos, is_x, is_split_pos_smaller, is_changing_max);
-					}
-					else
-					{
-						return m_children[0]->update_boundary_with_new_split(new_split_pos, is_x, is_split_pos_smaller, is_changing_max);
-					}
+					next_distance = std::min(next_distance, entity_distance(one_leaf, next_k));
 				}
 			}
-
+			if (next_distance != std::numeric_limits<double>::max())
+			{
+				best_move_length = (target_distance + next_distance) / 2;
+			}
+			else
+			{
+				best_move_length = target_distance + ghost_radius;
+			}
 		}
+		best_move_length = std::max(min_move_length, std::min(best_move_length, max_move_length));
+		return edge_pos + move_sign * best_move_length;
 	}
-	double space_cells::calc_max_shrink_length(const space_node* shrink_node) const
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::update_load_stat(const std::unordered_map<std::string, float>& game_loads)
 	{
-		auto cur_parent = shrink_node->parent();
-		if (!cur_parent)
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
 		{
-			return -4*m_ghost_radius;
+			cur_scope.journal->write_update_load_stat(game_loads);
 		}
-		else
+		// 后序遍历的顺序与递归的顺序一致 直接在递归中记录 clear之后保留上一次的容量
+		m_load_stat_nodes.clear();
+		m_root_node->update_load_stat(game_loads, m_game_capacities, m_load_stat_nodes);
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::collect_rebuild_units(space_node* region_root, rebuild_plan& out_plan, std::vector<space_node*>& nested_roots) const
+	{
+		out_plan.region_root = region_root;
+		std::vector<space_node*> temp_query_buffer;
+		temp_query_buffer.push_back(region_root);
+		while (!temp_query_buffer.empty())
 		{
-			if (cur_parent->is_split_x())
+			auto temp_top = temp_query_buffer.back();
+			temp_query_buffer.pop_back();
+			if (temp_top->is_leaf_cell())
 			{
-				if (shrink_node == cur_parent->children()[0])
-				{
-					return shrink_node->calc_max_boundary_move_length(true, false) - 4 * m_ghost_radius;
-				}
-				else
+				out_plan.units.push_back(rebuild_unit{ temp_top->boundary(), temp_top });
+				continue;
+			}
+			// 正在merge或者还没有ready的叶子依赖当前的兄弟关系 它的父节点整体保留
+			bool is_fixed_parent = false;
+			for (auto one_child : temp_top->m_children)
+			{
+				if (one_child->is_leaf_cell() && (one_child->is_merging() || !one_child->ready()))
 				{
-					return shrink_node->calc_max_boundary_move_length(true, true) - 4 * m_ghost_radius;
+					is_fixed_parent = true;
 				}
 			}
-			else
+			if (is_fixed_parent)
 			{
-				if (shrink_node == cur_parent->children()[0])
+				for (auto one_child : temp_top->m_children)
 				{
-					return shrink_node->calc_max_boundary_move_length(false, false) - 4 * m_ghost_radius;
+					if (!one_child->is_leaf_cell())
+					{
+						nested_roots.push_back(one_child);
+					}
 				}
-				else
+				if (temp_top == region_root)
 				{
-					return shrink_node->calc_max_boundary_move_length(false, true) - 4 * m_ghost_radius;
+					out_plan.units.clear();
+					return;
 				}
+				out_plan.units.push_back(rebuild_unit{ temp_top->boundary(), temp_top });
+				continue;
 			}
+			out_plan.recycle_nodes.push_back(temp_top);
+			temp_query_buffer.push_back(temp_top->m_children[0]);
+			temp_query_buffer.push_back(temp_top->m_children[1]);
 		}
 	}
 
-	bool space_cells::balance(double split_v, const space_cells::space_node* cur_node)
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::plan_rebuild_split(std::vector<rebuild_unit>& units, std::size_t begin, std::size_t end, const cell_bound& bound, std::vector<rebuild_split_step>& out_steps) const
 	{
-		if (!cur_node || cur_node->is_leaf_cell())
+		if (end - begin <= 1)
+		{
+			return true;
+		}
+		// 在每个坐标轴上分别找到一个不穿过任何单元 并且两边单元数量最接近的分割线
+		int best_axis = -1;
+		std::size_t best_mid = begin;
+		std::size_t best_score = end - begin;
+		for (int cur_axis = 0; cur_axis < int(D); cur_axis++)
+		{
+			std::sort(units.begin() + begin, units.begin() + end, [cur_axis](const rebuild_unit& a, const rebuild_unit& b)
+				{
+					return a.bound.min[cur_axis] < b.bound.min[cur_axis];
+				});
+			// 所有min小于分割线的单元的max都不能超过分割线
+			double pre_max = units[begin].bound.max[cur_axis];
+			for (std::size_t i = begin + 1; i < end; i++)
+			{
+				auto cur_split_pos = units[i].bound.min[cur_axis];
+				if (pre_max <= cur_split_pos)
+				{
+					auto cur_score = std::max(i - begin, end - i);
+					if (cur_score < best_score)
+					{
+						best_axis = cur_axis;
+						best_mid = i;
+						best_score = cur_score;
+					}
+				}
+				pre_max = std::max(pre_max, double(units[i].bound.max[cur_axis]));
+			}
+		}
+		if (best_axis < 0)
 		{
 			return false;
 		}
-		double pre_split_pos = cur_node->m_children[0]->boundary().max.x;
-		if (!cur_node->is_split_x())
+		if (best_axis != int(D) - 1)
+		{
+			std::sort(units.begin() + begin, units.begin() + end, [best_axis](const rebuild_unit& a, const rebuild_unit& b)
+				{
+					return a.bound.min[best_axis] < b.bound.min[best_axis];
+				});
+		}
+		rebuild_split_step cur_step;
+		cur_step.begin = begin;
+		cur_step.mid = best_mid;
+		cur_step.end = end;
+		cur_step.axis = best_axis;
+		cur_step.bound = bound;
+		out_steps.push_back(cur_step);
+		auto split_pos = units[best_mid].bound.min[best_axis];
+		auto low_bound = bound;
+		low_bound.max[best_axis] = split_pos;
+		auto high_bound = bound;
+		high_bound.min[best_axis] = split_pos;
+		return plan_rebuild_split(units, begin, best_mid, low_bound, out_steps) && plan_rebuild_split(units, best_mid, end, high_bound, out_steps);
+	}
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::apply_rebuild_plan(const rebuild_plan& cur_plan)
+	{
+		const auto& units = cur_plan.units;
+		const auto& recycle_nodes = cur_plan.recycle_nodes;
+		for (std::size_t i = 1; i < recycle_nodes.size(); i++)
+		{
+			m_internal_nodes.erase(recycle_nodes[i]->space_id());
+		}
+		// split_steps为前序遍历 一个有n个单元的子树对应n-1个分割 因此右子树的分割下标可以直接算出来
+		for (std::size_t i = 0; i < cur_plan.split_steps.size(); i++)
+		{
+			const auto& cur_step = cur_plan.split_steps[i];
+			auto cur_node = recycle_nodes[i];
+			cur_node->m_boundary = cur_step.bound;
+			cur_node->m_split_axis = std::uint8_t(cur_step.axis);
+			if (i != 0)
+			{
+				cur_node->m_game_id.clear();
+				cur_node->m_ready = true;
+				cur_node->m_is_merging = false;
+				cur_node->m_space_id = std::to_string(++m_temp_node_counter);
+				m_internal_nodes[cur_node->m_space_id] = cur_node;
+			}
+			space_node* low_child = cur_step.mid - cur_step.begin == 1 ? units[cur_step.begin].node : recycle_nodes[i + 1];
+			space_node* high_child = cur_step.end - cur_step.mid == 1 ? units[cur_step.mid].node : recycle_nodes[i + cur_step.mid - cur_step.begin];
+			cur_node->m_children[0] = low_child;
+			cur_node->m_children[1] = high_child;
+			low_child->m_parent = cur_node;
+			high_child->m_parent = cur_node;
+		}
+		m_load_stat_nodes.clear();
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::rebuild_internal_nodes()
+	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
 		{
-			pre_split_pos = cur_node->m_children[0]->boundary().max.z;
+			cur_scope.journal->write_cell_op(space_journal_op::rebuild_internal_nodes, std::string());
 		}
-		auto mutable_cur_node = m_internal_nodes[cur_node->space_id()];
-		assert(mutable_cur_node);
-		mutable_cur_node->children()[0]->update_boundary_with_new_split(split_v, cur_node->is_split_x(), split_v < pre_split_pos, true);
-		mutable_cur_node->children()[1]->update_boundary_with_new_split(split_v, cur_node->is_split_x(), split_v < pre_split_pos, false);
+		// 正在merge或者没有ready的cell的父节点在外层region中作为一个整体单元 其内部节点子树作为一个新的region单独重建
+		std::vector<rebuild_plan> all_plans;
+		std::vector<space_node*> region_roots;
+		region_roots.push_back(m_root_node);
+		while (!region_roots.empty())
+		{
+			auto cur_region_root = region_roots.back();
+			region_roots.pop_back();
+			rebuild_plan cur_plan;
+			collect_rebuild_units(cur_region_root, cur_plan, region_roots);
+			if (cur_plan.units.size() <= 1)
+			{
+				continue;
+			}
+			cur_plan.split_steps.reserve(cur_plan.recycle_nodes.size());
+			if (!plan_rebuild_split(cur_plan.units, 0, cur_plan.units.size(), cur_region_root->boundary(), cur_plan.split_steps))
+			{
+				return false;
+			}
+			if (cur_plan.split_steps.size() != cur_plan.recycle_nodes.size())
+			{
+				return false;
+			}
+			all_plans.push_back(std::move(cur_plan));
+		}
+		for (const auto& one_plan : all_plans)
+		{
+			apply_rebuild_plan(one_plan);
+		}
+		m_op_counters.rebuild++;
 		return true;
 	}
 
-	float space_cells::space_node::calc_move_split_offload(double new_split_pos, bool is_x, bool is_split_pos_smaller) const
+	namespace
 	{
-		auto cur_axis = is_x ? 0 : 1;
-		if (is_leaf_cell())
+		// 两个区域共享一个完整的边(三维时为面)时返回垂直于这个边的坐标轴 否则返回-1
+		// 即只有一个坐标轴上的范围不同 并且在这个坐标轴上首尾相接
+		template <typename T, std::uint32_t D>
+		int calc_merge_axis(const basic_cell_bound<T, D>& a, const basic_cell_bound<T, D>& b)
 		{
-			auto cur_sorted_load_idx_copy = vec_iter_wrapper(m_sorted_entity_load_idx_by_axis[cur_axis], is_split_pos_smaller);
-			
-			float temp_gain = 0;
-			while (cur_sorted_load_idx_copy.valid())
+			int result = -1;
+			for (std::uint32_t i = 0; i < D; i++)
 			{
-				auto one_index = cur_sorted_load_idx_copy.get_and_next();
-				if (is_split_pos_smaller)
+				if (a.min[i] == b.min[i] && a.max[i] == b.max[i])
 				{
-					if (m_entity_loads[one_index].pos[cur_axis] < new_split_pos)
-					{
-						break;
-					}
+					continue;
 				}
-				else
+				if (result >= 0)
 				{
-					if (m_entity_loads[one_index].pos[cur_axis] > new_split_pos)
-					{
-						break;
-					}
+					return -1;
 				}
-				temp_gain += m_entity_loads[one_index].load;
+				if (a.max[i] != b.min[i] && b.max[i] != a.min[i])
+				{
+					return -1;
+				}
+				result = int(i);
 			}
-			return temp_gain;
+			return result;
 		}
-		else
+	}
+
+	template <typename T, std::uint32_t D>
+	std::vector<const typename basic_space_cells<T, D>::space_node*> basic_space_cells<T, D>::query_full_edge_neighbors(const std::string& cell_id) const
+	{
+		std::vector<const space_node*> result;
+		auto cur_node = get_leaf(cell_id);
+		if (!cur_node)
+		{
+			return result;
+		}
+		const auto& cur_bound = cur_node->boundary();
+		// 在四条边外侧各查询一个窄条 宽度小于任何cell的宽度 三维时为六个面
+		auto query_width = 0.25 * min_ghost_radius();
+		for (int cur_axis = 0; cur_axis < int(D); cur_axis++)
 		{
-			if (is_x)
+			for (int is_max = 0; is_max < 2; is_max++)
 			{
-				if (m_is_split_x)
+				auto query_bound = cur_bound;
+				if (is_max)
 				{
-					if (is_split_pos_smaller)
-					{
-						return m_children[1]->calc_move_split_offload(new_split_pos, is_x, is_split_pos_smaller);
-					}
-					else
-					{
-						return m_children[0]->calc_move_split_offload(new_split_pos, is_x, is_split_pos_smaller);
-					}
-
+					query_bound.min[cur_axis] = cur_bound.max[cur_axis];
+					query_bound.max[cur_axis] = cur_bound.max[cur_axis] + query_width;
 				}
 				else
 				{
-					return m_children[1]->calc_move_split_offload(new_split_pos, is_x, is_split_pos_smaller) + m_children[0]->calc_move_split_offload(new_split_pos, is_x, is_split_pos_smaller);
-				}
-			}
-			else
-			{
-				if (m_is_split_x)
-				{
-					return m_children[1]->calc_move_split_offload(new_split_pos, is_x, is_split_pos_smaller) + m_children[0]->calc_move_split_offload(new_split_pos, is_x, is_split_pos_smaller);
+					query_bound.max[cur_axis] = cur_bound.min[cur_axis];
+					query_bound.min[cur_axis] = cur_bound.min[cur_axis] - query_width;
 				}
-				else
+				for (auto one_leaf : query_intersect_leafs(query_bound))
 				{
-					if (is_split_pos_smaller)
+					const auto& other_bound = one_leaf->boundary();
+					if (calc_merge_axis(cur_bound, other_bound) != cur_axis)
 					{
-						return m_children[0]->calc_move_split_offload(new_split_pos, is_x, is_split_pos_smaller);
+						continue;
 					}
-					else
+					if (is_max ? other_bound.min[cur_axis] != cur_bound.max[cur_axis] : other_bound.max[cur_axis] != cur_bound.min[cur_axis])
 					{
-						return m_children[1]->calc_move_split_offload(new_split_pos, is_x, is_split_pos_smaller);
+						continue;
 					}
+					result.push_back(one_leaf);
 				}
 			}
-
 		}
+		return result;
 	}
 
-	void space_cells::space_node::update_load_stat(const std::unordered_map<std::string, float>& game_loads)
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::plan_merge_to(space_node* cur_node, space_node* dest_node, rebuild_plan& out_plan) const
 	{
-		if (is_leaf_cell())
+		if (!cur_node || !dest_node || cur_node == dest_node)
 		{
-			m_min_cell_load_report_counter = m_cell_load_report_counter;
-			m_total_cell_load = get_smoothed_load();
-			auto temp_game_iter = game_loads.find(m_game_id);
-			if (temp_game_iter == game_loads.end())
+			return false;
+		}
+		if (!cur_node->is_leaf_cell() || !dest_node->is_leaf_cell())
+		{
+			return false;
+		}
+		if (cur_node->space_id() == m_master_cell_id || cur_node->is_merging() || dest_node->is_merging())
+		{
+			return false;
+		}
+		if (!cur_node->ready() || !dest_node->ready())
+		{
+			return false;
+		}
+		// 需要共享一条完整的边 这样合并之后的区域仍然是矩形
+		const auto& cur_bound = cur_node->boundary();
+		const auto& dest_bound = dest_node->boundary();
+		if (calc_merge_axis(cur_bound, dest_bound) < 0)
+		{
+			return false;
+		}
+		cell_bound merge_bound;
+		for (std::uint32_t i = 0; i < D; i++)
+		{
+			merge_bound.min[i] = std::min(cur_bound.min[i], dest_bound.min[i]);
+			merge_bound.max[i] = std::max(cur_bound.max[i], dest_bound.max[i]);
+		}
+		if (cur_node->parent() == dest_node->parent())
+		{
+			return true;
+		}
+		// 最近公共祖先
+		std::vector<const space_node*> cur_ancestors;
+		for (auto temp_node = cur_node->m_parent; temp_node; temp_node = temp_node->m_parent)
+		{
+			cur_ancestors.push_back(temp_node);
+		}
+		space_node* lca_node = dest_node->m_parent;
+		while (lca_node && std::find(cur_ancestors.begin(), cur_ancestors.end(), lca_node) == cur_ancestors.end())
+		{
+			lca_node = lca_node->m_parent;
+		}
+		if (!lca_node)
+		{
+			return false;
+		}
+		std::vector<space_node*> nested_roots;
+		collect_rebuild_units(lca_node, out_plan, nested_roots);
+		// 两个cell都需要作为独立的单元出现 然后替换为一个待创建的merge节点
+		std::size_t found_count = 0;
+		for (auto iter = out_plan.units.begin(); iter != out_plan.units.end();)
+		{
+			if (iter->node == cur_node || iter->node == dest_node)
 			{
-				m_total_game_load = 0;
+				found_count++;
+				iter = out_plan.units.erase(iter);
 			}
 			else
 			{
-				m_total_game_load = temp_game_iter->second;
+				iter++;
 			}
-			m_child_games.clear();
-			m_child_leaf.clear();
-			m_child_games.push_back(m_game_id);
-			m_child_leaf.push_back(this);
-			
 		}
-		else
+		if (found_count != 2 || out_plan.recycle_nodes.size() < 2)
 		{
-			m_children[0]->update_load_stat(game_loads);
-			m_children[1]->update_load_stat(game_loads);
-			m_total_cell_load = m_children[0]->m_total_cell_load + m_children[1]->m_total_cell_load;
-			m_total_game_load = m_children[0]->m_total_game_load + m_children[1]->m_total_game_load;
-			m_child_games.clear();
-			m_child_leaf.clear();
-			m_min_cell_load_report_counter = std::min(m_children[0]->m_min_cell_load_report_counter, m_children[1]->m_min_cell_load_report_counter);
-			for (const auto& one_node : m_children[0]->m_child_leaf)
+			return false;
+		}
+		out_plan.units.push_back(rebuild_unit{ merge_bound, nullptr });
+		// 最后一个内部节点留给merge节点
+		if (!plan_rebuild_split(out_plan.units, 0, out_plan.units.size(), lca_node->boundary(), out_plan.split_steps))
+		{
+			return false;
+		}
+		return out_plan.split_steps.size() + 1 == out_plan.recycle_nodes.size();
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::check_can_merge_to(const std::string& cell_id, const std::string& dest_cell_id) const
+	{
+		auto cur_iter = m_leaf_nodes.find(cell_id);
+		auto dest_iter = m_leaf_nodes.find(dest_cell_id);
+		if (cur_iter == m_leaf_nodes.end() || dest_iter == m_leaf_nodes.end())
+		{
+			return false;
+		}
+		rebuild_plan temp_plan;
+		return plan_merge_to(cur_iter->second, dest_iter->second, temp_plan);
+	}
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::start_merge_to(const std::string& cell_id, const std::string& dest_cell_id)
+	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
+		{
+			cur_scope.journal->write_start_merge_to(cell_id, dest_cell_id);
+		}
+		auto cur_iter = m_leaf_nodes.find(cell_id);
+		auto dest_iter = m_leaf_nodes.find(dest_cell_id);
+		if (cur_iter == m_leaf_nodes.end() || dest_iter == m_leaf_nodes.end())
+		{
+			return false;
+		}
+		auto cur_node = cur_iter->second;
+		auto dest_node = dest_iter->second;
+		rebuild_plan cur_plan;
+		if (!plan_merge_to(cur_node, dest_node, cur_plan))
+		{
+			return false;
+		}
+		if (!cur_plan.units.empty())
+		{
+			auto merge_node = cur_plan.recycle_nodes.back();
+			cur_plan.recycle_nodes.pop_back();
+			m_internal_nodes.erase(merge_node->space_id());
+			auto cur_axis = calc_merge_axis(cur_node->boundary(), dest_node->boundary());
+			bool is_cur_low = cur_node->boundary().min[cur_axis] < dest_node->boundary().min[cur_axis];
+			merge_node->m_children[0] = is_cur_low ? cur_node : dest_node;
+			merge_node->m_children[1] = is_cur_low ? dest_node : cur_node;
+			merge_node->m_split_axis = std::uint8_t(cur_axis);
+			for (std::uint32_t i = 0; i < D; i++)
+			{
+				merge_node->m_boundary.min[i] = std::min(cur_node->boundary().min[i], dest_node->boundary().min[i]);
+				merge_node->m_boundary.max[i] = std::max(cur_node->boundary().max[i], dest_node->boundary().max[i]);
+			}
+			merge_node->m_game_id.clear();
+			merge_node->m_ready = true;
+			merge_node->m_is_merging = false;
+			merge_node->m_space_id = std::to_string(++m_temp_node_counter);
+			m_internal_nodes[merge_node->m_space_id] = merge_node;
+			cur_node->m_parent = merge_node;
+			dest_node->m_parent = merge_node;
+			for (auto& one_unit : cur_plan.units)
+			{
+				if (!one_unit.node)
+				{
+					one_unit.node = merge_node;
+				}
+			}
+			apply_rebuild_plan(cur_plan);
+		}
+		return start_merge(cell_id);
+	}
+
+	template <typename T, std::uint32_t D>
+	const typename basic_space_cells<T, D>::space_node* basic_space_cells<T, D>::get_best_cell_to_merge_adjacent(const cell_load_balance_param& lb_param, std::string& out_dest_cell_id, const node_filter& filter) const
+	{
+		std::vector<const space_node*> candidates;
+		for (const auto& [one_cell_id, one_cell_node] : m_leaf_nodes)
+		{
+			if (!one_cell_node->is_leaf_cell() || !one_cell_node->ready())
 			{
-				m_child_leaf.push_back(one_node);
+				continue;
 			}
-			for (const auto& one_game : m_children[0]->m_child_games)
+			if (one_cell_node->is_merging())
 			{
-				m_child_games.push_back(one_game);
+				continue;
 			}
-			for (const auto& one_node : m_children[1]->m_child_leaf)
+			if (one_cell_node->space_id() == m_master_cell_id)
 			{
-				m_child_leaf.push_back(one_node);
+				continue;
 			}
-			for (const auto& one_game : m_children[1]->m_child_games)
+			if (one_cell_node->cell_load_report_counter() <= lb_param.min_cell_load_report_counter_when_remove)
 			{
-				m_child_games.push_back(one_game);
+				continue;
+			}
+			if (!one_cell_node->sibling() || one_cell_node->sibling()->is_merging())
+			{
+				continue;
+			}
+			if (cell_utilization(one_cell_node) > lb_param.max_cell_load_when_remove)
+			{
+				continue;
 			}
+			if (filter && !filter(one_cell_node))
+			{
+				continue;
+			}
+			candidates.push_back(one_cell_node);
 		}
-	}
-
-	double space_cells::space_node::calc_best_shrink_new_split_pos(const cell_load_balance_param& lb_param, const double ghost_radius) const
-	{
-		bool is_split_pos_smaller = m_parent->m_children[0] == this;
-		auto max_move_length = calc_max_boundary_move_length(m_parent->is_split_x(), is_split_pos_smaller);
-		max_move_length -= 5 * ghost_radius;
-		auto move_unit = max_move_length / 10;
-		auto cur_split_pos = m_boundary.min.x;
-		for (int i = 0; i < 10; i++)
+		auto load_cmp = [this](const space_node* a, const space_node* b)
 		{
-			if (m_parent->is_split_x())
+			auto a_utilization = cell_utilization(a);
+			auto b_utilization = cell_utilization(b);
+			if (a_utilization != b_utilization)
 			{
-				if (is_split_pos_smaller)
-				{
-					cur_split_pos = m_boundary.max.x - ghost_radius - i * move_unit;
-				}
-				else
-				{
-					cur_split_pos = m_boundary.min.x + ghost_radius + i * move_unit;
-				}
+				return a_utilization < b_utilization;
 			}
-			else
+			return a->space_id() < b->space_id();
+		};
+		std::sort(candidates.begin(), candidates.end(), load_cmp);
+		for (auto one_candidate : candidates)
+		{
+			auto cur_neighbors = query_full_edge_neighbors(one_candidate->space_id());
+			std::sort(cur_neighbors.begin(), cur_neighbors.end(), load_cmp);
+			for (auto one_neighbor : cur_neighbors)
 			{
-				if (is_split_pos_smaller)
+				if (one_neighbor->cell_load_report_counter() <= lb_param.min_cell_load_report_counter_when_remove)
 				{
-					cur_split_pos = m_boundary.max.z - ghost_radius - i * move_unit;
+					continue;
 				}
-				else
+				if (check_can_merge_to(one_candidate->space_id(), one_neighbor->space_id()))
 				{
-					cur_split_pos = m_boundary.min.z + ghost_radius + i * move_unit;
+					out_dest_cell_id = one_neighbor->space_id();
+					return one_candidate;
 				}
 			}
-			auto cur_split_offload = calc_move_split_offload(cur_split_pos, m_parent->is_split_x(), is_split_pos_smaller);
-			if (cur_split_offload > lb_param.min_sibling_game_load_diff_when_shrink / 2)
-			{
-				return cur_split_pos;
-			}
 		}
-		return cur_split_pos;
+		return nullptr;
 	}
 
-	void space_cells::update_load_stat(const std::unordered_map<std::string, float>& game_loads)
+	template <typename T, std::uint32_t D>
+	std::uint32_t basic_space_cells<T, D>::calc_max_depth() const
 	{
-		m_root_node->update_load_stat(game_loads);
+		std::uint32_t result = 0;
+		std::vector<std::pair<const space_node*, std::uint32_t>> temp_query_buffer;
+		temp_query_buffer.emplace_back(m_root_node, 0);
+		while (!temp_query_buffer.empty())
+		{
+			auto [temp_top, cur_depth] = temp_query_buffer.back();
+			temp_query_buffer.pop_back();
+			result = std::max(result, cur_depth);
+			if (!temp_top->is_leaf_cell())
+			{
+				temp_query_buffer.emplace_back(temp_top->children()[0], cur_depth + 1);
+				temp_query_buffer.emplace_back(temp_top->children()[1], cur_depth + 1);
+			}
+		}
+		return result;
 	}
 
-	bool space_cells::start_merge(const std::string& cell_id)
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::start_merge(const std::string& cell_id)
 	{
+		journal_scope cur_scope(*this);
+		if (cur_scope.journal)
+		{
+			cur_scope.journal->write_cell_op(space_journal_op::start_merge, cell_id);
+		}
 		auto temp_node_iter = m_leaf_nodes.find(cell_id);
 		if (temp_node_iter == m_leaf_nodes.end())
 		{
@@ -1490,39 +3319,96 @@ namespace spiritsaway::distributed_space
 		{
 			return false;
 		}
+		m_load_stat_nodes.clear();
 		cur_node->set_is_merging();
 		auto cur_parent = cur_node->parent();
-		auto remain_radius = 0.5 * m_ghost_radius;
-		double new_split_pos = cur_node->boundary().min.x + remain_radius;
+		auto remain_radius = 0.5 * ghost_radius(cur_node);
+		int cur_axis = cur_parent->split_axis();
+		double new_split_pos = 0;
 		double old_split_pos = 0;
-		if (cur_parent->is_split_x())
+		if (cur_node == cur_parent->children()[0])
 		{
-			if (cur_node == cur_parent->children()[0])
-			{
-				old_split_pos = cur_node->boundary().max.x;
-				new_split_pos = cur_node->boundary().min.x + remain_radius;
-			}
-			else
-			{
-				old_split_pos = cur_node->boundary().min.x;
-				new_split_pos = cur_node->boundary().max.x - remain_radius;
-			}
+			old_split_pos = cur_node->boundary().max[cur_axis];
+			new_split_pos = cur_node->boundary().min[cur_axis] + remain_radius;
 		}
 		else
 		{
-			if (cur_node == cur_parent->children()[0])
-			{
-				old_split_pos = cur_node->boundary().max.z;
-				new_split_pos = cur_node->boundary().min.z + remain_radius;
-			}
-			else
-			{
-				old_split_pos = cur_node->boundary().min.z;
-				new_split_pos = cur_node->boundary().max.z - remain_radius;
-			}
+			old_split_pos = cur_node->boundary().min[cur_axis];
+			new_split_pos = cur_node->boundary().max[cur_axis] - remain_radius;
 		}
-		cur_parent->children()[0]->update_boundary_with_new_split(new_split_pos, cur_parent->is_split_x(), new_split_pos < old_split_pos, true);
-		cur_parent->children()[1]->update_boundary_with_new_split(new_split_pos, cur_parent->is_split_x(), new_split_pos < old_split_pos, false);
+		cur_parent->children()[0]->update_boundary_with_new_split(new_split_pos, cur_axis, new_split_pos < old_split_pos, true);
+		cur_parent->children()[1]->update_boundary_with_new_split(new_split_pos, cur_axis, new_split_pos < old_split_pos, false);
+		m_op_counters.start_merge++;
 		return true;
 	}
-}
\ No newline at end of file
+
+	template <typename T, std::uint32_t D>
+	void basic_space_cells<T, D>::calc_metrics(const std::unordered_map<std::string, float>& game_loads, space_metrics& out_metrics) const
+	{
+		out_metrics.leaf_num = std::uint32_t(m_leaf_nodes.size());
+		out_metrics.ready_leaf_num = 0;
+		out_metrics.max_depth = calc_max_depth();
+		out_metrics.real_num = 0;
+		out_metrics.ghost_num = 0;
+		out_metrics.cells.clear();
+		out_metrics.cells.reserve(m_leaf_nodes.size());
+		std::vector<float> cell_loads;
+		cell_loads.reserve(m_leaf_nodes.size());
+		std::unordered_set<std::string> cur_games;
+		for (const auto& [one_cell_id, one_cell] : m_leaf_nodes)
+		{
+			cur_games.insert(one_cell->game_id());
+			if (!one_cell->ready())
+			{
+				continue;
+			}
+			out_metrics.ready_leaf_num++;
+			cell_metrics cur_cell_metrics;
+			cur_cell_metrics.cell_id = one_cell_id;
+			cur_cell_metrics.game_id = one_cell->game_id();
+			cur_cell_metrics.load = one_cell->get_latest_load();
+			cur_cell_metrics.real_num = one_cell->real_entity_num();
+			cur_cell_metrics.ghost_num = one_cell->ghost_entity_num();
+			cur_cell_metrics.ghost_ratio = cur_cell_metrics.real_num ? float(cur_cell_metrics.ghost_num) / cur_cell_metrics.real_num : 0.0f;
+			out_metrics.real_num += cur_cell_metrics.real_num;
+			out_metrics.ghost_num += cur_cell_metrics.ghost_num;
+			cell_loads.push_back(cur_cell_metrics.load);
+			out_metrics.cells.push_back(std::move(cur_cell_metrics));
+		}
+		std::sort(out_metrics.cells.begin(), out_metrics.cells.end(), [](const cell_metrics& a, const cell_metrics& b)
+			{
+				return a.cell_id < b.cell_id;
+			});
+		out_metrics.ghost_ratio = out_metrics.real_num ? float(double(out_metrics.ghost_num) / out_metrics.real_num) : 0.0f;
+		out_metrics.cell_load = load_summary::calc(cell_loads);
+
+		out_metrics.game_num = std::uint32_t(cur_games.size());
+		std::vector<float> cur_game_loads;
+		std::vector<float> cur_game_utilizations;
+		cur_game_loads.reserve(cur_games.size());
+		cur_game_utilizations.reserve(cur_games.size());
+		for (const auto& one_game_id : cur_games)
+		{
+			auto cur_game_iter = game_loads.find(one_game_id);
+			auto cur_game_load = cur_game_iter == game_loads.end() ? 0.0f : cur_game_iter->second;
+			cur_game_loads.push_back(cur_game_load);
+			cur_game_utilizations.push_back(cur_game_load / game_capacity(one_game_id));
+		}
+		out_metrics.game_load = load_summary::calc(cur_game_loads);
+		out_metrics.game_utilization = load_summary::calc(cur_game_utilizations);
+		out_metrics.total_ops = m_op_counters;
+	}
+
+	template struct basic_entity_load<double>;
+	template struct basic_entity_load<float>;
+	template struct basic_entity_load<double, 3>;
+	template struct basic_entity_load<float, 3>;
+	template struct basic_cell_bound<double>;
+	template struct basic_cell_bound<float>;
+	template struct basic_cell_bound<double, 3>;
+	template struct basic_cell_bound<float, 3>;
+	template class basic_space_cells<double>;
+	template class basic_space_cells<float>;
+	template class basic_space_cells<double, 3>;
+	template class basic_space_cells<float, 3>;
+}
@@ -0,0 +1,540 @@
+#include "space_cells.h"
+#include <limits>
+#include <algorithm>
+
+namespace spiritsaway::distributed_space
+{
+	// 把encode格式的json流直接转换为decode_builder的节点 不构造json对象
+	// 每个cell的字段先收集到decode_cell里 cell对象结束时检查必需的字段再添加到builder
+	// 不认识的字段会被跳过 认识的字段类型不对时当作没有出现 最终由必需字段的检查报错
+	template <typename T, std::uint32_t D>
+	class basic_space_cells<T, D>::decode_sax_handler
+	{
+		enum class frame_type
+		{
+			root,
+			cells,
+			cell,
+			bound,
+			bound_point,
+			children,
+			cell_loads,
+			entity_loads,
+			entity,
+			entity_pos,
+			capacities,
+			skip,
+		};
+		struct frame
+		{
+			frame_type type;
+			std::string key; // 对象中当前的key
+			std::uint32_t index = 0; // 数组中当前的下标
+			explicit frame(frame_type in_type)
+				: type(in_type)
+			{
+
+			}
+		};
+		enum field_bit : std::uint32_t
+		{
+			bound_bit = 1 << 0,
+			children_bit = 1 << 1,
+			parent_bit = 1 << 2,
+			space_id_bit = 1 << 3,
+			game_id_bit = 1 << 4,
+			ready_bit = 1 << 5,
+			is_merging_bit = 1 << 6,
+			is_split_x_bit = 1 << 7,
+			cell_loads_bit = 1 << 8,
+			entity_loads_bit = 1 << 9,
+			cell_load_counter_bit = 1 << 10,
+
+			pos_x_bit = 1 << 0,
+			pos_z_bit = 1 << 1,
+			load_bit = 1 << 2,
+			name_bit = 1 << 3,
+			is_real_bit = 1 << 4,
+			pos_y_bit = 1 << 5,
+
+			min_x_bit = 1 << 0,
+			min_z_bit = 1 << 1,
+			max_x_bit = 1 << 2,
+			max_z_bit = 1 << 3,
+			min_y_bit = 1 << 4,
+			max_y_bit = 1 << 5,
+		};
+		static constexpr std::uint32_t common_cell_bits = bound_bit | children_bit | parent_bit | space_id_bit | game_id_bit | ready_bit | is_merging_bit;
+		static constexpr std::uint32_t leaf_cell_bits = common_cell_bits | cell_loads_bit | entity_loads_bit | cell_load_counter_bit;
+		static constexpr std::uint32_t internal_cell_bits = common_cell_bits | is_split_x_bit;
+		// 三维时坐标还需要有y
+		static constexpr std::uint32_t entity_bits = pos_x_bit | pos_z_bit | load_bit | name_bit | is_real_bit | (D == 3 ? pos_y_bit : 0);
+		static constexpr std::uint32_t bound_bits = min_x_bit | min_z_bit | max_x_bit | max_z_bit | (D == 3 ? min_y_bit | max_y_bit : 0);
+
+		decode_builder& m_builder;
+		std::vector<frame> m_frames;
+		decode_cell m_cell;
+		std::uint32_t m_cell_fields = 0;
+		std::uint32_t m_bound_fields = 0;
+		entity_load m_entity;
+		std::uint32_t m_entity_fields = 0;
+
+		std::string m_master_cell_id;
+		bool m_has_master_cell_id = false;
+		double m_ghost_radius = 0;
+		bool m_has_ghost_radius = false;
+		std::uint64_t m_temp_node_counter = 0;
+		std::unordered_map<std::string, float> m_game_capacities;
+		bool m_has_cells = false;
+
+	public:
+		explicit decode_sax_handler(decode_builder& builder)
+			: m_builder(builder)
+		{
+
+		}
+
+		bool finish(basic_space_cells& cur_space)
+		{
+			if (!m_has_cells || !m_has_master_cell_id || !m_has_ghost_radius)
+			{
+				return false;
+			}
+			return m_builder.install(cur_space, std::move(m_master_cell_id), m_ghost_radius, m_temp_node_counter, std::move(m_game_capacities));
+		}
+
+		// 以下为nlohmann::json_sax的接口
+		bool null()
+		{
+			return on_other_value();
+		}
+		bool boolean(bool val)
+		{
+			if (m_frames.empty())
+			{
+				return false;
+			}
+			const auto& cur_frame = m_frames.back();
+			switch (cur_frame.type)
+			{
+			case frame_type::cell:
+				if (cur_frame.key == "ready")
+				{
+					m_cell.ready = val;
+					m_cell_fields |= ready_bit;
+				}
+				else if (cur_frame.key == "is_merging")
+				{
+					m_cell.is_merging = val;
+					m_cell_fields |= is_merging_bit;
+				}
+				else if (cur_frame.key == "is_split_x")
+				{
+					m_cell.is_split_x = val;
+					m_cell_fields |= is_split_x_bit;
+				}
+				return true;
+			case frame_type::entity:
+				if (cur_frame.key == "is_real")
+				{
+					m_entity.is_real = val;
+					m_entity_fields |= is_real_bit;
+				}
+				return true;
+			default:
+				return on_other_value();
+			}
+		}
+		bool number_integer(json::number_integer_t val)
+		{
+			return on_number(double(val), 0, false);
+		}
+		bool number_unsigned(json::number_unsigned_t val)
+		{
+			return on_number(double(val), val, true);
+		}
+		bool number_float(json::number_float_t val, const json::string_t& s)
+		{
+			(void)s;
+			return on_number(val, 0, false);
+		}
+		bool string(json::string_t& val)
+		{
+			if (m_frames.empty())
+			{
+				return false;
+			}
+			auto& cur_frame = m_frames.back();
+			switch (cur_frame.type)
+			{
+			case frame_type::root:
+				if (cur_frame.key == "master_cell_id")
+				{
+					m_master_cell_id = std::move(val);
+					m_has_master_cell_id = true;
+				}
+				return true;
+			case frame_type::cell:
+				if (cur_frame.key == "space_id")
+				{
+					m_cell.space_id = std::move(val);
+					m_cell_fields |= space_id_bit;
+				}
+				else if (cur_frame.key == "game_id")
+				{
+					m_cell.game_id = std::move(val);
+					m_cell_fields |= game_id_bit;
+				}
+				else if (cur_frame.key == "parent")
+				{
+					m_cell.parent = std::move(val);
+					m_cell_fields |= parent_bit;
+				}
+				else if (cur_frame.key == "host")
+				{
+					m_cell.host = std::move(val);
+				}
+				return true;
+			case frame_type::children:
+				if (cur_frame.index >= 2)
+				{
+					return false;
+				}
+				m_cell.children[cur_frame.index++] = std::move(val);
+				return true;
+			case frame_type::entity:
+				if (cur_frame.key == "name")
+				{
+					m_entity.name = std::move(val);
+					m_entity_fields |= name_bit;
+				}
+				return true;
+			default:
+				return on_other_value();
+			}
+		}
+		bool binary(json::binary_t& val)
+		{
+			(void)val;
+			return false;
+		}
+		bool start_object(std::size_t elements)
+		{
+			(void)elements;
+			if (m_frames.empty())
+			{
+				m_frames.emplace_back(frame_type::root);
+				return true;
+			}
+			const auto& cur_frame = m_frames.back();
+			auto next_type = frame_type::skip;
+			switch (cur_frame.type)
+			{
+			case frame_type::cells:
+				m_cell.bound = cell_bound{};
+				m_cell.parent.clear();
+				m_cell.children[0].clear();
+				m_cell.children[1].clear();
+				m_cell.entity_loads.clear();
+				m_cell.host.clear();
+				m_cell.split_axis = -1;
+				m_cell_fields = 0;
+				next_type = frame_type::cell;
+				break;
+			case frame_type::cell:
+				if (cur_frame.key == "bound")
+				{
+					m_bound_fields = 0;
+					next_type = frame_type::bound;
+				}
+				break;
+			case frame_type::bound:
+				if (cur_frame.key == "min" || cur_frame.key == "max")
+				{
+					next_type = frame_type::bound_point;
+				}
+				break;
+			case frame_type::entity_loads:
+				m_entity_fields = 0;
+				next_type = frame_type::entity;
+				break;
+			case frame_type::entity:
+				if (cur_frame.key == "pos")
+				{
+					next_type = frame_type::entity_pos;
+				}
+				break;
+			case frame_type::root:
+				if (cur_frame.key == "game_capacities")
+				{
+					next_type = frame_type::capacities;
+				}
+				break;
+			case frame_type::children:
+			case frame_type::cell_loads:
+				return false;
+			default:
+				break;
+			}
+			m_frames.emplace_back(next_type);
+			return true;
+		}
+		bool key(json::string_t& val)
+		{
+			m_frames.back().key = std::move(val);
+			return true;
+		}
+		bool end_object()
+		{
+			auto cur_type = m_frames.back().type;
+			m_frames.pop_back();
+			switch (cur_type)
+			{
+			case frame_type::cell:
+			{
+				auto required_bits = m_cell.children[0].empty() ? leaf_cell_bits : internal_cell_bits;
+				if ((m_cell_fields & required_bits) != required_bits)
+				{
+					return false;
+				}
+				return m_builder.add_cell(m_cell);
+			}
+			case frame_type::bound:
+				if (m_bound_fields == bound_bits)
+				{
+					m_cell_fields |= bound_bit;
+				}
+				return true;
+			case frame_type::entity:
+				if (m_entity_fields != entity_bits)
+				{
+					return false;
+				}
+				m_cell.entity_loads.push_back(std::move(m_entity));
+				return true;
+			default:
+				return true;
+			}
+		}
+		bool start_array(std::size_t elements)
+		{
+			(void)elements;
+			if (m_frames.empty())
+			{
+				return false;
+			}
+			const auto& cur_frame = m_frames.back();
+			auto next_type = frame_type::skip;
+			switch (cur_frame.type)
+			{
+			case frame_type::root:
+				if (cur_frame.key == "cells")
+				{
+					next_type = frame_type::cells;
+				}
+				break;
+			case frame_type::cell:
+				if (cur_frame.key == "children")
+				{
+					next_type = frame_type::children;
+				}
+				else if (cur_frame.key == "cell_loads")
+				{
+					next_type = frame_type::cell_loads;
+				}
+				else if (cur_frame.key == "entity_loads")
+				{
+					next_type = frame_type::entity_loads;
+				}
+				break;
+			case frame_type::cells:
+			case frame_type::children:
+			case frame_type::cell_loads:
+			case frame_type::entity_loads:
+				return false;
+			default:
+				break;
+			}
+			m_frames.emplace_back(next_type);
+			return true;
+		}
+		bool end_array()
+		{
+			auto cur_frame = std::move(m_frames.back());
+			m_frames.pop_back();
+			switch (cur_frame.type)
+			{
+			case frame_type::cells:
+				m_has_cells = true;
+				return true;
+			case frame_type::children:
+				if (cur_frame.index == 2)
+				{
+					m_cell_fields |= children_bit;
+				}
+				return true;
+			case frame_type::cell_loads:
+				if (cur_frame.index == 4)
+				{
+					m_cell_fields |= cell_loads_bit;
+				}
+				return true;
+			case frame_type::entity_loads:
+				m_cell_fields |= entity_loads_bit;
+				return true;
+			default:
+				return true;
+			}
+		}
+		bool parse_error(std::size_t position, const std::string& last_token, const nlohmann::detail::exception& ex)
+		{
+			(void)position;
+			(void)last_token;
+			(void)ex;
+			return false;
+		}
+
+	private:
+		// 数组中只能出现特定类型的值 对象中不认识的值直接忽略
+		bool on_other_value()
+		{
+			if (m_frames.empty())
+			{
+				return false;
+			}
+			switch (m_frames.back().type)
+			{
+			case frame_type::cells:
+			case frame_type::children:
+			case frame_type::cell_loads:
+			case frame_type::entity_loads:
+				return false;
+			default:
+				return true;
+			}
+		}
+		bool on_number(double val, std::uint64_t unsigned_val, bool is_unsigned)
+		{
+			if (m_frames.empty())
+			{
+				return false;
+			}
+			auto& cur_frame = m_frames.back();
+			switch (cur_frame.type)
+			{
+			case frame_type::root:
+				if (cur_frame.key == "ghost_radius")
+				{
+					m_ghost_radius = val;
+					m_has_ghost_radius = true;
+				}
+				else if (cur_frame.key == "temp_node_counter" && is_unsigned)
+				{
+					m_temp_node_counter = unsigned_val;
+				}
+				return true;
+			case frame_type::cell:
+				if (cur_frame.key == "cell_load_counter" && is_unsigned && unsigned_val <= std::numeric_limits<std::uint32_t>::max())
+				{
+					m_cell.cell_load_counter = std::uint32_t(unsigned_val);
+					m_cell_fields |= cell_load_counter_bit;
+				}
+				else if (D == 3 && cur_frame.key == "split_axis" && is_unsigned)
+				{
+					// 超出范围的值由add_cell报错
+					m_cell.split_axis = int(std::min<std::uint64_t>(unsigned_val, D));
+				}
+				return true;
+			case frame_type::bound_point:
+			{
+				// 上一层bound的key为min或者max
+				bool is_min = m_frames[m_frames.size() - 2].key == "min";
+				auto& cur_point = is_min ? m_cell.bound.min : m_cell.bound.max;
+				if (cur_frame.key == "x")
+				{
+					cur_point.x = val;
+					m_bound_fields |= is_min ? min_x_bit : max_x_bit;
+				}
+				else if (cur_frame.key == "z")
+				{
+					cur_point.z = val;
+					m_bound_fields |= is_min ? min_z_bit : max_z_bit;
+				}
+				else if constexpr (D == 3)
+				{
+					if (cur_frame.key == "y")
+					{
+						cur_point.y = val;
+						m_bound_fields |= is_min ? min_y_bit : max_y_bit;
+					}
+				}
+				return true;
+			}
+			case frame_type::cell_loads:
+				if (cur_frame.index >= 4)
+				{
+					return false;
+				}
+				m_cell.cell_loads[cur_frame.index++] = float(val);
+				return true;
+			case frame_type::entity:
+				if (cur_frame.key == "load")
+				{
+					m_entity.load = float(val);
+					m_entity_fields |= load_bit;
+				}
+				return true;
+			case frame_type::entity_pos:
+				if (cur_frame.key == "x")
+				{
+					m_entity.pos.x = val;
+					m_entity_fields |= pos_x_bit;
+				}
+				else if (cur_frame.key == "z")
+				{
+					m_entity.pos.z = val;
+					m_entity_fields |= pos_z_bit;
+				}
+				else if constexpr (D == 3)
+				{
+					if (cur_frame.key == "y")
+					{
+						m_entity.pos.y = val;
+						m_entity_fields |= pos_y_bit;
+					}
+				}
+				return true;
+			case frame_type::capacities:
+				m_game_capacities[cur_frame.key] = float(val);
+				return true;
+			default:
+				return on_other_value();
+			}
+		}
+	};
+
+	template <typename T, std::uint32_t D>
+	bool basic_space_cells<T, D>::decode_stream(std::istream& is)
+	{
+		decode_builder cur_builder;
+		decode_sax_handler cur_handler(cur_builder);
+		try
+		{
+			if (!json::sax_parse(is, &cur_handler))
+			{
+				return false;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			(void)e;
+			return false;
+		}
+		return cur_handler.finish(*this);
+	}
+
+	template bool basic_space_cells<double>::decode_stream(std::istream& is);
+	template bool basic_space_cells<float>::decode_stream(std::istream& is);
+	template bool basic_space_cells<double, 3>::decode_stream(std::istream& is);
+	template bool basic_space_cells<float, 3>::decode_stream(std::istream& is);
+}
@@ -0,0 +1,552 @@
+#include "space_journal.h"
+#include <cstring>
+
+namespace spiritsaway::distributed_space
+{
+	namespace
+	{
+		template <typename T>
+		void append_pod(std::string& buffer, T value)
+		{
+			auto cur_size = buffer.size();
+			buffer.resize(cur_size + sizeof(T));
+			std::memcpy(buffer.data() + cur_size, &value, sizeof(T));
+		}
+
+		// 长度与数量一般都很小 使用LEB128变长编码 小于128时只占一个字节
+		void append_varint(std::string& buffer, std::uint32_t value)
+		{
+			while (value >= 0x80)
+			{
+				buffer.push_back(char((value & 0x7f) | 0x80));
+				value >>= 7;
+			}
+			buffer.push_back(char(value));
+		}
+
+		void append_string(std::string& buffer, const std::string& value)
+		{
+			append_varint(buffer, std::uint32_t(value.size()));
+			buffer.append(value);
+		}
+
+		// 读取一条记录的payload 任何一次读取越界之后都返回false
+		class journal_reader
+		{
+			std::string_view m_data;
+			std::size_t m_offset = 0;
+		public:
+			explicit journal_reader(std::string_view data)
+				: m_data(data)
+			{
+
+			}
+			template <typename T>
+			bool read_pod(T& out_value)
+			{
+				if (m_data.size() - m_offset < sizeof(T))
+				{
+					return false;
+				}
+				std::memcpy(&out_value, m_data.data() + m_offset, sizeof(T));
+				m_offset += sizeof(T);
+				return true;
+			}
+			bool read_varint(std::uint32_t& out_value)
+			{
+				out_value = 0;
+				for (int shift = 0; shift < 35 && m_offset < m_data.size(); shift += 7)
+				{
+					auto cur_byte = std::uint8_t(m_data[m_offset++]);
+					out_value |= std::uint32_t(cur_byte & 0x7f) << shift;
+					if (!(cur_byte & 0x80))
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+			bool read_string(std::string& out_value)
+			{
+				std::uint32_t cur_size = 0;
+				if (!read_varint(cur_size) || m_data.size() - m_offset < cur_size)
+				{
+					return false;
+				}
+				out_value.assign(m_data.data() + m_offset, cur_size);
+				m_offset += cur_size;
+				return true;
+			}
+			std::string_view left() const
+			{
+				return m_data.substr(m_offset);
+			}
+		};
+
+		// update_cell_load与load_entity_loads共用的entity_load数组编码 坐标统一写成double
+		template <typename T>
+		void append_entity_loads(std::string& buffer, const std::vector<basic_entity_load<T>>& entity_loads)
+		{
+			append_varint(buffer, std::uint32_t(entity_loads.size()));
+			for (const auto& one_entity_load : entity_loads)
+			{
+				append_pod(buffer, double(one_entity_load.pos.x));
+				append_pod(buffer, double(one_entity_load.pos.z));
+				append_pod(buffer, one_entity_load.load);
+				append_pod(buffer, std::uint8_t(one_entity_load.is_real));
+				append_string(buffer, one_entity_load.name);
+			}
+		}
+
+		// 一个entity_load编码之后的最小字节数 两个double坐标 float负载 uint8的is_real 以及名字长度的varint
+		const std::size_t min_entity_load_size = 2 * sizeof(double) + sizeof(float) + sizeof(std::uint8_t) + 1;
+
+		bool read_entity_loads(journal_reader& cur_reader, std::vector<entity_load>& out_entity_loads)
+		{
+			std::uint32_t entity_num = 0;
+			if (!cur_reader.read_varint(entity_num))
+			{
+				return false;
+			}
+			// 损坏的数量可能非常大 先按照剩余字节数检查 避免resize时分配失败
+			if (entity_num > cur_reader.left().size() / min_entity_load_size)
+			{
+				return false;
+			}
+			out_entity_loads.resize(entity_num);
+			for (auto& cur_entity_load : out_entity_loads)
+			{
+				std::uint8_t is_real = 0;
+				if (!cur_reader.read_pod(cur_entity_load.pos.x) || !cur_reader.read_pod(cur_entity_load.pos.z) || !cur_reader.read_pod(cur_entity_load.load) || !cur_reader.read_pod(is_real) || !cur_reader.read_string(cur_entity_load.name))
+				{
+					return false;
+				}
+				cur_entity_load.is_real = is_real != 0;
+			}
+			return true;
+		}
+
+		const std::size_t record_header_size = sizeof(std::uint8_t) + sizeof(std::uint32_t);
+	}
+
+	space_journal_writer::space_journal_writer(std::ostream& os, std::size_t flush_size)
+		: m_os(os)
+		, m_flush_size(flush_size)
+	{
+		if (m_os.tellp() <= 0)
+		{
+			m_buffer.append(magic, sizeof(magic));
+		}
+	}
+
+	space_journal_writer::~space_journal_writer()
+	{
+		flush();
+	}
+
+	void space_journal_writer::flush()
+	{
+		if (m_buffer.empty())
+		{
+			return;
+		}
+		m_os.write(m_buffer.data(), m_buffer.size());
+		m_os.flush();
+		m_buffer.clear();
+	}
+
+	std::size_t space_journal_writer::begin_record(space_journal_op op)
+	{
+		append_pod(m_buffer, std::uint8_t(op));
+		append_pod(m_buffer, std::uint32_t(0));
+		return m_buffer.size();
+	}
+
+	void space_journal_writer::end_record(std::size_t payload_begin)
+	{
+		auto payload_size = std::uint32_t(m_buffer.size() - payload_begin);
+		std::memcpy(m_buffer.data() + payload_begin - sizeof(std::uint32_t), &payload_size, sizeof(payload_size));
+		m_record_num++;
+		if (m_buffer.size() >= m_flush_size)
+		{
+			flush();
+		}
+	}
+
+	void space_journal_writer::write_tick(std::uint32_t tick)
+	{
+		auto payload_begin = begin_record(space_journal_op::tick);
+		append_pod(m_buffer, tick);
+		end_record(payload_begin);
+	}
+
+	template <typename T>
+	void space_journal_writer::write_snapshot(const basic_space_cells<T>& cur_space)
+	{
+		auto payload_begin = begin_record(space_journal_op::snapshot);
+		json::to_msgpack(cur_space.encode(), m_buffer);
+		end_record(payload_begin);
+	}
+	template void space_journal_writer::write_snapshot<double>(const basic_space_cells<double>& cur_space);
+	template void space_journal_writer::write_snapshot<float>(const basic_space_cells<float>& cur_space);
+
+	void space_journal_writer::write_split(space_journal_op op, double split_pos, const std::string& origin_space_id, const std::string& new_space_game_id, const std::string& low_space_id, const std::string& high_space_id)
+	{
+		auto payload_begin = begin_record(op);
+		append_pod(m_buffer, split_pos);
+		append_string(m_buffer, origin_space_id);
+		append_string(m_buffer, new_space_game_id);
+		append_string(m_buffer, low_space_id);
+		append_string(m_buffer, high_space_id);
+		end_record(payload_begin);
+	}
+
+	void space_journal_writer::write_split_k(const std::string& origin_space_id, const std::vector<std::string>& new_space_ids, const std::vector<std::string>& new_game_ids)
+	{
+		auto payload_begin = begin_record(space_journal_op::split_k);
+		append_string(m_buffer, origin_space_id);
+		for (const auto* one_ids : { &new_space_ids, &new_game_ids })
+		{
+			append_varint(m_buffer, std::uint32_t(one_ids->size()));
+			for (const auto& one_id : *one_ids)
+			{
+				append_string(m_buffer, one_id);
+			}
+		}
+		end_record(payload_begin);
+	}
+
+	void space_journal_writer::write_balance(space_journal_op op, double split_v, const std::string& space_id)
+	{
+		auto payload_begin = begin_record(op);
+		append_pod(m_buffer, split_v);
+		append_string(m_buffer, space_id);
+		end_record(payload_begin);
+	}
+
+	void space_journal_writer::write_cell_op(space_journal_op op, const std::string& cell_id)
+	{
+		auto payload_begin = begin_record(op);
+		append_string(m_buffer, cell_id);
+		end_record(payload_begin);
+	}
+
+	void space_journal_writer::write_start_merge_to(const std::string& cell_id, const std::string& dest_cell_id)
+	{
+		auto payload_begin = begin_record(space_journal_op::start_merge_to);
+		append_string(m_buffer, cell_id);
+		append_string(m_buffer, dest_cell_id);
+		end_record(payload_begin);
+	}
+
+	template <typename T>
+	void space_journal_writer::write_update_cell_load(const std::string& cell_id, float cell_load, const std::vector<basic_entity_load<T>>& new_entity_loads)
+	{
+		auto payload_begin = begin_record(space_journal_op::update_cell_load);
+		append_string(m_buffer, cell_id);
+		append_pod(m_buffer, cell_load);
+		append_entity_loads(m_buffer, new_entity_loads);
+		end_record(payload_begin);
+	}
+	template void space_journal_writer::write_update_cell_load<double>(const std::string& cell_id, float cell_load, const std::vector<basic_entity_load<double>>& new_entity_loads);
+	template void space_journal_writer::write_update_cell_load<float>(const std::string& cell_id, float cell_load, const std::vector<basic_entity_load<float>>& new_entity_loads);
+
+	template <typename T>
+	void space_journal_writer::write_load_entity_loads(const std::string& cell_id, const std::vector<basic_entity_load<T>>& entity_loads)
+	{
+		auto payload_begin = begin_record(space_journal_op::load_entity_loads);
+		append_string(m_buffer, cell_id);
+		append_entity_loads(m_buffer, entity_loads);
+		end_record(payload_begin);
+	}
+	template void space_journal_writer::write_load_entity_loads<double>(const std::string& cell_id, const std::vector<basic_entity_load<double>>& entity_loads);
+	template void space_journal_writer::write_load_entity_loads<float>(const std::string& cell_id, const std::vector<basic_entity_load<float>>& entity_loads);
+
+	void space_journal_writer::write_update_load_stat(const std::unordered_map<std::string, float>& game_loads)
+	{
+		auto payload_begin = begin_record(space_journal_op::update_load_stat);
+		append_varint(m_buffer, std::uint32_t(game_loads.size()));
+		for (const auto& [one_game_id, one_game_load] : game_loads)
+		{
+			append_string(m_buffer, one_game_id);
+			append_pod(m_buffer, one_game_load);
+		}
+		end_record(payload_begin);
+	}
+
+	void space_journal_writer::write_set_game_capacity(const std::string& game_id, float capacity)
+	{
+		auto payload_begin = begin_record(space_journal_op::set_game_capacity);
+		append_string(m_buffer, game_id);
+		append_pod(m_buffer, capacity);
+		end_record(payload_begin);
+	}
+
+	void space_journal_writer::write_remove_game_capacity(const std::string& game_id)
+	{
+		auto payload_begin = begin_record(space_journal_op::remove_game_capacity);
+		append_string(m_buffer, game_id);
+		end_record(payload_begin);
+	}
+
+	space_journal_replayer::space_journal_replayer(std::string_view data)
+		: m_data(data)
+	{
+		if (valid())
+		{
+			m_offset = sizeof(space_journal_writer::magic);
+		}
+	}
+
+	bool space_journal_replayer::valid() const
+	{
+		return m_data.size() >= sizeof(space_journal_writer::magic) && std::memcmp(m_data.data(), space_journal_writer::magic, sizeof(space_journal_writer::magic)) == 0;
+	}
+
+	bool space_journal_replayer::step()
+	{
+		if (!m_offset || m_corrupted)
+		{
+			return false;
+		}
+		journal_reader cur_reader(m_data.substr(m_offset));
+		std::uint8_t cur_op = 0;
+		std::uint32_t payload_size = 0;
+		if (!cur_reader.read_pod(cur_op) || !cur_reader.read_pod(payload_size) || cur_reader.left().size() < payload_size)
+		{
+			return false;
+		}
+		m_offset += record_header_size + payload_size;
+		m_record_num++;
+		if (!apply(space_journal_op(cur_op), cur_reader.left().substr(0, payload_size)))
+		{
+			m_failed_num++;
+		}
+		return !m_corrupted;
+	}
+
+	bool space_journal_replayer::peek_tick(std::uint32_t& out_tick) const
+	{
+		journal_reader cur_reader(m_data.substr(m_offset));
+		std::uint8_t cur_op = 0;
+		std::uint32_t payload_size = 0;
+		if (!cur_reader.read_pod(cur_op) || !cur_reader.read_pod(payload_size))
+		{
+			return false;
+		}
+		return space_journal_op(cur_op) == space_journal_op::tick && cur_reader.read_pod(out_tick);
+	}
+
+	bool space_journal_replayer::replay_until(std::uint32_t tick)
+	{
+		if (m_has_tick && m_tick > tick)
+		{
+			return false;
+		}
+		std::uint32_t next_tick = 0;
+		while (true)
+		{
+			if (m_offset && peek_tick(next_tick) && next_tick > tick)
+			{
+				return true;
+			}
+			if (!step())
+			{
+				return m_has_tick && m_tick == tick;
+			}
+		}
+	}
+
+	bool space_journal_replayer::apply(space_journal_op op, std::string_view payload)
+	{
+		journal_reader cur_reader(payload);
+		if (op == space_journal_op::snapshot)
+		{
+			auto cur_json = json::from_msgpack(payload.begin(), payload.end(), true, false);
+			if (cur_json.is_discarded() || !cur_json.contains("master_cell_id") || !cur_json.contains("ghost_radius"))
+			{
+				m_corrupted = true;
+				return false;
+			}
+			m_space = std::make_unique<space_cells>(cell_bound{}, std::string(), cur_json["master_cell_id"].get<std::string>(), cur_json["ghost_radius"].get<double>());
+			if (!m_space->decode(cur_json))
+			{
+				m_corrupted = true;
+				return false;
+			}
+			if (m_space_setup)
+			{
+				m_space_setup(*m_space);
+			}
+			return true;
+		}
+		if (op == space_journal_op::tick)
+		{
+			if (!cur_reader.read_pod(m_tick))
+			{
+				m_corrupted = true;
+				return false;
+			}
+			m_has_tick = true;
+			return true;
+		}
+		if (!m_space)
+		{
+			return false;
+		}
+		std::string cell_id;
+		std::string other_id;
+		double cur_pos = 0;
+		float cur_value = 0;
+		switch (op)
+		{
+		case space_journal_op::split_x:
+		case space_journal_op::split_z:
+		{
+			std::string new_game_id, low_space_id;
+			if (!cur_reader.read_pod(cur_pos) || !cur_reader.read_string(cell_id) || !cur_reader.read_string(new_game_id) || !cur_reader.read_string(low_space_id) || !cur_reader.read_string(other_id))
+			{
+				break;
+			}
+			if (op == space_journal_op::split_x)
+			{
+				return m_space->split_x(cur_pos, cell_id, new_game_id, low_space_id, other_id) != nullptr;
+			}
+			return m_space->split_z(cur_pos, cell_id, new_game_id, low_space_id, other_id) != nullptr;
+		}
+		case space_journal_op::split_k:
+		{
+			std::array<std::vector<std::string>, 2> cur_ids;
+			if (!cur_reader.read_string(cell_id))
+			{
+				break;
+			}
+			bool is_valid = true;
+			for (auto& one_ids : cur_ids)
+			{
+				std::uint32_t cur_size = 0;
+				is_valid = is_valid && cur_reader.read_varint(cur_size);
+				for (std::uint32_t i = 0; is_valid && i < cur_size; i++)
+				{
+					is_valid = cur_reader.read_string(one_ids.emplace_back());
+				}
+			}
+			if (!is_valid)
+			{
+				break;
+			}
+			return !m_space->split_k(cell_id, cur_ids[0], cur_ids[1]).empty();
+		}
+		case space_journal_op::balance_cell:
+		case space_journal_op::balance_node:
+		{
+			if (!cur_reader.read_pod(cur_pos) || !cur_reader.read_string(cell_id))
+			{
+				break;
+			}
+			if (op == space_journal_op::balance_cell)
+			{
+				return m_space->balance(cur_pos, cell_id);
+			}
+			return m_space->balance(cur_pos, m_space->get_internal(cell_id));
+		}
+		case space_journal_op::start_merge:
+		case space_journal_op::finish_merge:
+		case space_journal_op::set_ready:
+		case space_journal_op::rebuild_internal_nodes:
+		{
+			if (!cur_reader.read_string(cell_id))
+			{
+				break;
+			}
+			switch (op)
+			{
+			case space_journal_op::start_merge:
+				return m_space->start_merge(cell_id);
+			case space_journal_op::finish_merge:
+				return !m_space->finish_merge(cell_id).empty();
+			case space_journal_op::set_ready:
+				return m_space->set_ready(cell_id);
+			default:
+				return m_space->rebuild_internal_nodes();
+			}
+		}
+		case space_journal_op::start_merge_to:
+		{
+			if (!cur_reader.read_string(cell_id) || !cur_reader.read_string(other_id))
+			{
+				break;
+			}
+			return m_space->start_merge_to(cell_id, other_id);
+		}
+		case space_journal_op::update_cell_load:
+		{
+			if (!cur_reader.read_string(cell_id) || !cur_reader.read_pod(cur_value) || !read_entity_loads(cur_reader, m_entity_loads))
+			{
+				break;
+			}
+			m_space->update_cell_load(cell_id, cur_value, m_entity_loads);
+			return true;
+		}
+		case space_journal_op::load_entity_loads:
+		{
+			if (!cur_reader.read_string(cell_id) || !read_entity_loads(cur_reader, m_entity_loads))
+			{
+				break;
+			}
+			auto cur_node_iter = m_space->m_leaf_nodes.find(cell_id);
+			if (cur_node_iter == m_space->m_leaf_nodes.end())
+			{
+				return false;
+			}
+			// 与缓冲区交换 叶子原来的entity_load留作下一次回放的缓冲区
+			cur_node_iter->second->m_entity_loads.swap(m_entity_loads);
+			m_space->on_entity_loads_replaced(cur_node_iter->second);
+			return true;
+		}
+		case space_journal_op::update_load_stat:
+		{
+			std::uint32_t game_num = 0;
+			if (!cur_reader.read_varint(game_num))
+			{
+				break;
+			}
+			m_game_loads.clear();
+			bool is_valid = true;
+			for (std::uint32_t i = 0; is_valid && i < game_num; i++)
+			{
+				is_valid = cur_reader.read_string(cell_id) && cur_reader.read_pod(cur_value);
+				m_game_loads[cell_id] = cur_value;
+			}
+			if (!is_valid)
+			{
+				break;
+			}
+			m_space->update_load_stat(m_game_loads);
+			return true;
+		}
+		case space_journal_op::set_game_capacity:
+		{
+			if (!cur_reader.read_string(cell_id) || !cur_reader.read_pod(cur_value))
+			{
+				break;
+			}
+			m_space->set_game_capacity(cell_id, cur_value);
+			return true;
+		}
+		case space_journal_op::remove_game_capacity:
+		{
+			if (!cur_reader.read_string(cell_id))
+			{
+				break;
+			}
+			return m_space->remove_game_capacity(cell_id);
+		}
+		default:
+			// 新版本增加的记录类型 跳过
+			return false;
+		}
+		m_corrupted = true;
+		return false;
+	}
+}
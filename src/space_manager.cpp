@@ -0,0 +1,268 @@
+#include "space_manager.h"
+#include <algorithm>
+
+namespace spiritsaway::distributed_space
+{
+	space_manager::space_manager(const space_manager_param& in_param)
+		: m_param(in_param)
+	{
+
+	}
+
+	space_cells* space_manager::create_space(const std::string& space_id, const cell_bound& bound, const std::string& game_id, const std::string& cell_id, double ghost_radius)
+	{
+		if (m_spaces.count(space_id))
+		{
+			return nullptr;
+		}
+		space_info cur_space_info;
+		cur_space_info.cells = std::make_unique<space_cells>(bound, game_id, cell_id, ghost_radius);
+		if (!cur_space_info.cells->check_valid_space_id(cell_id))
+		{
+			return nullptr;
+		}
+		cur_space_info.cells->set_ready(cell_id);
+		for (const auto& [one_game_id, one_capacity] : m_game_capacities)
+		{
+			cur_space_info.cells->set_game_capacity(one_game_id, one_capacity);
+		}
+		cur_space_info.controller = std::make_unique<load_balance_controller>(m_param.lb_param, m_param.hysteresis_param);
+		auto result = cur_space_info.cells.get();
+		m_spaces.emplace(space_id, std::move(cur_space_info));
+		return result;
+	}
+
+	bool space_manager::destroy_space(const std::string& space_id)
+	{
+		return m_spaces.erase(space_id) != 0;
+	}
+
+	space_cells* space_manager::get_space(const std::string& space_id)
+	{
+		auto cur_iter = m_spaces.find(space_id);
+		if (cur_iter == m_spaces.end())
+		{
+			return nullptr;
+		}
+		return cur_iter->second.cells.get();
+	}
+
+	const space_cells* space_manager::get_space(const std::string& space_id) const
+	{
+		auto cur_iter = m_spaces.find(space_id);
+		if (cur_iter == m_spaces.end())
+		{
+			return nullptr;
+		}
+		return cur_iter->second.cells.get();
+	}
+
+	void space_manager::register_game(const std::string& game_id, float capacity)
+	{
+		if (capacity <= 0)
+		{
+			return;
+		}
+		m_game_capacities[game_id] = capacity;
+		m_game_loads.emplace(game_id, 0.0f);
+		for (auto& [one_space_id, one_space_info] : m_spaces)
+		{
+			one_space_info.cells->set_game_capacity(game_id, capacity);
+		}
+	}
+
+	bool space_manager::unregister_game(const std::string& game_id)
+	{
+		m_game_loads.erase(game_id);
+		if (m_game_capacities.erase(game_id) == 0)
+		{
+			return false;
+		}
+		for (auto& [one_space_id, one_space_info] : m_spaces)
+		{
+			one_space_info.cells->remove_game_capacity(game_id);
+		}
+		return true;
+	}
+
+	void space_manager::update_game_load(const std::string& game_id, float game_load)
+	{
+		auto cur_iter = m_game_loads.find(game_id);
+		if (cur_iter == m_game_loads.end())
+		{
+			return;
+		}
+		cur_iter->second = game_load;
+	}
+
+	float space_manager::game_utilization(const std::string& game_id) const
+	{
+		auto cur_load_iter = m_game_loads.find(game_id);
+		if (cur_load_iter == m_game_loads.end())
+		{
+			return 0;
+		}
+		auto cur_capacity_iter = m_game_capacities.find(game_id);
+		if (cur_capacity_iter == m_game_capacities.end())
+		{
+			return cur_load_iter->second;
+		}
+		return cur_load_iter->second / cur_capacity_iter->second;
+	}
+
+	bool space_manager::update_cell_load(const std::string& space_id, const std::string& cell_id, float cell_load, const std::vector<entity_load>& new_entity_loads)
+	{
+		auto cur_space = get_space(space_id);
+		if (!cur_space || !cur_space->get_leaf(cell_id))
+		{
+			return false;
+		}
+		cur_space->update_cell_load(cell_id, cell_load, new_entity_loads);
+		return true;
+	}
+
+	bool space_manager::finish_merge(const std::string& space_id, const std::string& cell_id)
+	{
+		auto cur_space = get_space(space_id);
+		if (!cur_space)
+		{
+			return false;
+		}
+		return !cur_space->finish_merge(cell_id).empty();
+	}
+
+	float space_manager::calc_decision_priority(const load_balance_decision& cur_decision) const
+	{
+		switch (cur_decision.op)
+		{
+		case cell_load_balance_operation::split:
+			return game_utilization(cur_decision.node->game_id());
+		case cell_load_balance_operation::shrink:
+			return cur_decision.node->avg_game_utilization();
+		default:
+			return 0;
+		}
+	}
+
+	std::vector<space_balance_operation> space_manager::tick()
+	{
+		m_tick++;
+		struct space_candidate
+		{
+			float priority;
+			std::string space_id;
+			load_balance_decision decision;
+		};
+		std::vector<space_candidate> all_candidates;
+		for (auto& [one_space_id, one_space_info] : m_spaces)
+		{
+			one_space_info.controller->tick();
+			one_space_info.cells->update_load_stat(m_game_loads);
+			auto cur_decision = one_space_info.controller->decide(*one_space_info.cells, m_game_loads);
+			if (cur_decision.node)
+			{
+				all_candidates.push_back(space_candidate{ calc_decision_priority(cur_decision), one_space_id, cur_decision });
+			}
+		}
+		// 优先级相同的时候按照space_id排序 保证结果稳定
+		std::sort(all_candidates.begin(), all_candidates.end(), [](const space_candidate& a, const space_candidate& b)
+			{
+				if (a.priority != b.priority)
+				{
+					return a.priority > b.priority;
+				}
+				return a.space_id < b.space_id;
+			});
+		std::vector<space_balance_operation> result;
+		for (const auto& one_candidate : all_candidates)
+		{
+			if (result.size() >= m_param.max_operations_per_tick)
+			{
+				break;
+			}
+			// 不同space之间的操作互不影响 因此tick开始时选出的候选仍然有效 只有split选择game时使用最新的game负载
+			space_balance_operation cur_operation;
+			if (execute_decision(one_candidate.space_id, m_spaces[one_candidate.space_id], one_candidate.decision, cur_operation))
+			{
+				result.push_back(cur_operation);
+			}
+		}
+		m_operation_count += result.size();
+		return result;
+	}
+
+	bool space_manager::execute_decision(const std::string& space_id, space_info& cur_space_info, const load_balance_decision& cur_decision, space_balance_operation& out_operation)
+	{
+		auto& cur_space = *cur_space_info.cells;
+		auto& cur_controller = *cur_space_info.controller;
+		out_operation.space_id = space_id;
+		out_operation.op = cur_decision.op;
+		out_operation.cell_id = cur_decision.node->space_id();
+		switch (cur_decision.op)
+		{
+		case cell_load_balance_operation::shrink:
+		{
+			out_operation.related_cell_id = cur_decision.node->sibling()->space_id();
+			auto new_split_pos = cur_decision.node->calc_best_shrink_new_split_pos(m_param.lb_param, cur_space.ghost_radius(cur_decision.node->parent()));
+			if (!cur_space.balance(new_split_pos, cur_decision.node->parent()))
+			{
+				return false;
+			}
+			cur_controller.on_shrink(cur_decision.node);
+			return true;
+		}
+		case cell_load_balance_operation::split:
+		{
+			auto cur_split_direction = cur_decision.node->calc_best_split_direction(cur_space.ghost_radius(cur_decision.node));
+			auto new_game_id = cur_space.choose_game_for_new_cell(out_operation.cell_id, cur_split_direction, m_game_loads, m_param.assign_param);
+			if (new_game_id.empty())
+			{
+				return false;
+			}
+			std::string new_cell_id;
+			do
+			{
+				new_cell_id = space_id + "_cell" + std::to_string(++cur_space_info.cell_counter);
+			} while (cur_space.get_leaf(new_cell_id) || cur_space.get_internal(new_cell_id));
+			auto new_cell = cur_space.split_at_direction(out_operation.cell_id, cur_split_direction, new_cell_id, new_game_id);
+			if (!new_cell)
+			{
+				return false;
+			}
+			auto origin_cell = cur_space.get_leaf(out_operation.cell_id);
+			cur_controller.on_split(origin_cell, new_cell);
+			// 预先把新cell的负载从原来的game转移到新game 使得同一个tick内后面的space能看到这次分配
+			float new_cell_load = 0;
+			const auto& origin_entity_loads = origin_cell->get_entity_loads();
+			for (std::size_t i = 0; i < origin_entity_loads.size(); i++)
+			{
+				if (origin_entity_loads[i].is_real && new_cell->boundary().cover(origin_entity_loads[i].pos.x, origin_entity_loads[i].pos.z))
+				{
+					new_cell_load += origin_cell->get_entity_costs()[i];
+				}
+			}
+			auto origin_game_iter = m_game_loads.find(origin_cell->game_id());
+			if (origin_game_iter != m_game_loads.end())
+			{
+				origin_game_iter->second = std::max(0.0f, origin_game_iter->second - new_cell_load);
+			}
+			m_game_loads[new_game_id] += new_cell_load;
+			out_operation.related_cell_id = new_cell_id;
+			out_operation.game_id = new_game_id;
+			return true;
+		}
+		case cell_load_balance_operation::remove:
+		{
+			out_operation.related_cell_id = cur_decision.node->sibling()->space_id();
+			if (!cur_space.start_merge(out_operation.cell_id))
+			{
+				return false;
+			}
+			cur_controller.on_start_merge(cur_decision.node);
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+}
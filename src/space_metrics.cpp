@@ -0,0 +1,171 @@
+#include "space_metrics.h"
+#include <cmath>
+#include <sstream>
+
+namespace spiritsaway::distributed_space
+{
+	space_op_counters space_op_counters::operator-(const space_op_counters& other) const
+	{
+		space_op_counters result;
+		result.split = split - other.split;
+		result.shrink = shrink - other.shrink;
+		result.start_merge = start_merge - other.start_merge;
+		result.finish_merge = finish_merge - other.finish_merge;
+		result.rebuild = rebuild - other.rebuild;
+		result.migrated_entities = migrated_entities - other.migrated_entities;
+		return result;
+	}
+
+	load_summary load_summary::calc(const std::vector<float>& values)
+	{
+		load_summary result;
+		if (values.empty())
+		{
+			return result;
+		}
+		double total = 0;
+		for (auto one_value : values)
+		{
+			total += one_value;
+			result.max = std::max(result.max, one_value);
+		}
+		auto cur_mean = total / values.size();
+		double total_square_diff = 0;
+		for (auto one_value : values)
+		{
+			total_square_diff += (one_value - cur_mean) * (one_value - cur_mean);
+		}
+		result.mean = float(cur_mean);
+		result.stddev = float(std::sqrt(total_square_diff / values.size()));
+		return result;
+	}
+
+	json space_metrics::encode() const
+	{
+		return json(*this);
+	}
+
+	namespace
+	{
+		// 标签值中的反斜杠 双引号与换行需要转义
+		std::string escape_label(const std::string& value)
+		{
+			std::string result;
+			result.reserve(value.size());
+			for (auto one_char : value)
+			{
+				switch (one_char)
+				{
+				case '\\':
+					result += "\\\\";
+					break;
+				case '"':
+					result += "\\\"";
+					break;
+				case '\n':
+					result += "\\n";
+					break;
+				default:
+					result += one_char;
+				}
+			}
+			return result;
+		}
+
+		class prometheus_writer
+		{
+			std::ostringstream m_oss;
+			std::string m_space_label;
+		public:
+			explicit prometheus_writer(const std::string& space_name)
+				: m_space_label("space=\"" + escape_label(space_name) + "\"")
+			{
+
+			}
+			void type(const std::string& name, const char* metric_type)
+			{
+				m_oss << "# TYPE distributed_space_" << name << " " << metric_type << "\n";
+			}
+			template <typename T>
+			void value(const std::string& name, T cur_value, const std::string& extra_labels = {})
+			{
+				m_oss << "distributed_space_" << name << "{" << m_space_label << extra_labels << "} " << cur_value << "\n";
+			}
+			template <typename T>
+			void gauge(const std::string& name, T cur_value)
+			{
+				type(name, "gauge");
+				value(name, cur_value);
+			}
+			void summary(const std::string& name, const load_summary& cur_summary)
+			{
+				gauge(name + "_max", cur_summary.max);
+				gauge(name + "_mean", cur_summary.mean);
+				gauge(name + "_stddev", cur_summary.stddev);
+			}
+			void ops(const std::string& name, const char* metric_type, const space_op_counters& cur_ops)
+			{
+				type(name, metric_type);
+				value(name, cur_ops.split, ",op=\"split\"");
+				value(name, cur_ops.shrink, ",op=\"shrink\"");
+				value(name, cur_ops.start_merge, ",op=\"start_merge\"");
+				value(name, cur_ops.finish_merge, ",op=\"finish_merge\"");
+				value(name, cur_ops.rebuild, ",op=\"rebuild\"");
+			}
+			std::string str() const
+			{
+				return m_oss.str();
+			}
+		};
+	}
+
+	std::string space_metrics::to_prometheus(const std::string& space_name) const
+	{
+		prometheus_writer writer(space_name);
+		writer.gauge("leaf_num", leaf_num);
+		writer.gauge("ready_leaf_num", ready_leaf_num);
+		writer.gauge("max_depth", max_depth);
+		writer.gauge("game_num", game_num);
+		writer.summary("cell_load", cell_load);
+		writer.summary("game_load", game_load);
+		writer.summary("game_utilization", game_utilization);
+		writer.gauge("real_num", real_num);
+		writer.gauge("ghost_num", ghost_num);
+		writer.gauge("ghost_ratio", ghost_ratio);
+		writer.ops("ops_total", "counter", total_ops);
+		writer.type("migrated_entities_total", "counter");
+		writer.value("migrated_entities_total", total_ops.migrated_entities);
+		writer.gauge("window_ticks", window_ticks);
+		writer.ops("window_ops", "gauge", window_ops);
+		writer.gauge("window_migrated_entities", window_ops.migrated_entities);
+		writer.type("cell_load", "gauge");
+		for (const auto& one_cell : cells)
+		{
+			writer.value("cell_load", one_cell.load, ",cell=\"" + escape_label(one_cell.cell_id) + "\",game=\"" + escape_label(one_cell.game_id) + "\"");
+		}
+		writer.type("cell_ghost_ratio", "gauge");
+		for (const auto& one_cell : cells)
+		{
+			writer.value("cell_ghost_ratio", one_cell.ghost_ratio, ",cell=\"" + escape_label(one_cell.cell_id) + "\",game=\"" + escape_label(one_cell.game_id) + "\"");
+		}
+		return writer.str();
+	}
+
+	space_metrics_window::space_metrics_window(std::uint32_t window_ticks)
+		: m_window_ticks(window_ticks)
+	{
+
+	}
+
+	void space_metrics_window::on_tick(const space_cells& cur_space, space_metrics& metrics)
+	{
+		m_history.push_back(cur_space.op_counters());
+		// 保留window_ticks + 1个记录 首尾之差为最近window_ticks个tick内的数量
+		while (m_history.size() > std::size_t(m_window_ticks) + 1)
+		{
+			m_history.pop_front();
+		}
+		metrics.window_ticks = std::uint32_t(m_history.size() - 1);
+		metrics.window_ops = m_history.back() - m_history.front();
+	}
+}
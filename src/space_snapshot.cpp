@@ -0,0 +1,248 @@
+#include "space_snapshot.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace spiritsaway::distributed_space
+{
+	static_assert(std::is_trivially_copyable_v<space_snapshot_header> && sizeof(space_snapshot_header) % 8 == 0);
+	static_assert(std::is_trivially_copyable_v<space_snapshot_node> && sizeof(space_snapshot_node) % 8 == 0);
+	static_assert(std::is_trivially_copyable_v<space_snapshot_entity_load> && sizeof(space_snapshot_entity_load) % 8 == 0);
+	static_assert(std::is_trivially_copyable_v<space_snapshot_capacity> && std::is_trivially_copyable_v<space_snapshot_string>);
+
+	namespace
+	{
+		// [offset, offset + num * item_size)是否在[0, size)之内 并且offset按照align对齐
+		bool check_snapshot_range(std::uint64_t offset, std::uint64_t num, std::size_t item_size, std::size_t align, std::size_t size)
+		{
+			if (offset % align != 0 || offset > size)
+			{
+				return false;
+			}
+			return num <= (size - offset) / item_size;
+		}
+	}
+
+	bool space_snapshot_view::init(const char* data, std::size_t size)
+	{
+		m_header = nullptr;
+		m_node_idxes.clear();
+		if (!data || size < sizeof(space_snapshot_header) || reinterpret_cast<std::uintptr_t>(data) % 8 != 0)
+		{
+			return false;
+		}
+		auto cur_header = reinterpret_cast<const space_snapshot_header*>(data);
+		if (std::memcmp(cur_header->magic, space_snapshot_header::magic_value, sizeof(cur_header->magic)) != 0)
+		{
+			return false;
+		}
+		if (cur_header->version != space_snapshot_header::current_version || cur_header->total_size > size)
+		{
+			return false;
+		}
+		size = std::size_t(cur_header->total_size);
+		if (!check_snapshot_range(cur_header->node_offset, cur_header->node_num, sizeof(space_snapshot_node), 8, size)
+			|| !check_snapshot_range(cur_header->entity_offset, cur_header->entity_num, sizeof(space_snapshot_entity_load), 8, size)
+			|| !check_snapshot_range(cur_header->capacity_offset, cur_header->capacity_num, sizeof(space_snapshot_capacity), 4, size)
+			|| !check_snapshot_range(cur_header->string_index_offset, cur_header->string_num, sizeof(space_snapshot_string), 4, size)
+			|| cur_header->string_data_offset > size)
+		{
+			return false;
+		}
+		auto cur_nodes = reinterpret_cast<const space_snapshot_node*>(data + cur_header->node_offset);
+		auto cur_capacities = reinterpret_cast<const space_snapshot_capacity*>(data + cur_header->capacity_offset);
+		auto cur_strings = reinterpret_cast<const space_snapshot_string*>(data + cur_header->string_index_offset);
+		auto string_data_size = size - cur_header->string_data_offset;
+		for (std::uint32_t i = 0; i < cur_header->string_num; i++)
+		{
+			if (cur_strings[i].offset > string_data_size || cur_strings[i].size > string_data_size - cur_strings[i].offset)
+			{
+				return false;
+			}
+		}
+		if (cur_header->node_num == 0 || cur_header->master_cell_id >= cur_header->string_num)
+		{
+			return false;
+		}
+		// 根节点是第一个节点 其余节点的父节点在它之前 子节点在它之后并且反过来指向它
+		for (std::uint32_t i = 0; i < cur_header->node_num; i++)
+		{
+			const auto& cur_node = cur_nodes[i];
+			if (cur_node.space_id >= cur_header->string_num || cur_node.game_id >= cur_header->string_num)
+			{
+				return false;
+			}
+			if (cur_node.host != space_snapshot_node::invalid_idx && cur_node.host >= cur_header->string_num)
+			{
+				return false;
+			}
+			if ((i == 0) != (cur_node.parent == space_snapshot_node::invalid_idx))
+			{
+				return false;
+			}
+			if (i != 0)
+			{
+				if (cur_node.parent >= i)
+				{
+					return false;
+				}
+				const auto& parent_children = cur_nodes[cur_node.parent].children;
+				if (parent_children[0] != i && parent_children[1] != i)
+				{
+					return false;
+				}
+			}
+			if (cur_node.is_leaf())
+			{
+				if (cur_node.children[1] != space_snapshot_node::invalid_idx)
+				{
+					return false;
+				}
+				if (cur_node.entity_begin > cur_header->entity_num || cur_node.entity_num > cur_header->entity_num - cur_node.entity_begin)
+				{
+					return false;
+				}
+				continue;
+			}
+			for (auto one_child : cur_node.children)
+			{
+				if (one_child <= i || one_child >= cur_header->node_num || cur_nodes[one_child].parent != i)
+				{
+					return false;
+				}
+			}
+			if (cur_node.children[0] == cur_node.children[1])
+			{
+				return false;
+			}
+		}
+		for (std::uint32_t i = 0; i < cur_header->capacity_num; i++)
+		{
+			if (cur_capacities[i].game_id >= cur_header->string_num)
+			{
+				return false;
+			}
+		}
+		// entity_load的name在to_entity_loads时才检查 这样init不需要访问entity_load数组 mmap时这部分数据可以按需换入
+		m_data = data;
+		m_size = size;
+		m_header = cur_header;
+		m_nodes = cur_nodes;
+		m_entity_loads = reinterpret_cast<const space_snapshot_entity_load*>(data + cur_header->entity_offset);
+		m_capacities = cur_capacities;
+		m_strings = cur_strings;
+		m_node_idxes.reserve(cur_header->node_num);
+		for (std::uint32_t i = 0; i < cur_header->node_num; i++)
+		{
+			m_node_idxes.emplace(str(cur_nodes[i].space_id), i);
+		}
+		return true;
+	}
+
+	std::uint32_t space_snapshot_view::find_node(std::string_view space_id) const
+	{
+		auto cur_iter = m_node_idxes.find(space_id);
+		if (cur_iter == m_node_idxes.end())
+		{
+			return space_snapshot_node::invalid_idx;
+		}
+		return cur_iter->second;
+	}
+
+	template <typename T>
+	void space_snapshot_view::to_entity_loads(const space_snapshot_node& cur_node, std::vector<basic_entity_load<T>>& out_entity_loads) const
+	{
+		out_entity_loads.clear();
+		if (!cur_node.is_leaf())
+		{
+			return;
+		}
+		out_entity_loads.reserve(cur_node.entity_num);
+		auto cur_entity_loads = entity_loads(cur_node);
+		for (std::uint32_t i = 0; i < cur_node.entity_num; i++)
+		{
+			const auto& one_entity_load = cur_entity_loads[i];
+			out_entity_loads.emplace_back();
+			auto& new_entity_load = out_entity_loads.back();
+			new_entity_load.pos.x = T(one_entity_load.pos.x);
+			new_entity_load.pos.z = T(one_entity_load.pos.z);
+			new_entity_load.load = one_entity_load.load;
+			new_entity_load.is_real = one_entity_load.is_real != 0;
+			// 非法的name下标当作空字符串
+			if (one_entity_load.name < m_header->string_num)
+			{
+				new_entity_load.name = std::string(str(one_entity_load.name));
+			}
+		}
+	}
+	template void space_snapshot_view::to_entity_loads<double>(const space_snapshot_node& cur_node, std::vector<basic_entity_load<double>>& out_entity_loads) const;
+	template void space_snapshot_view::to_entity_loads<float>(const space_snapshot_node& cur_node, std::vector<basic_entity_load<float>>& out_entity_loads) const;
+
+	space_snapshot_file::~space_snapshot_file()
+	{
+		close();
+	}
+
+	bool space_snapshot_file::open(const std::string& file_path)
+	{
+		close();
+#ifndef _WIN32
+		auto cur_fd = ::open(file_path.c_str(), O_RDONLY);
+		if (cur_fd < 0)
+		{
+			return false;
+		}
+		struct stat cur_stat;
+		if (::fstat(cur_fd, &cur_stat) != 0 || cur_stat.st_size <= 0)
+		{
+			::close(cur_fd);
+			return false;
+		}
+		auto cur_size = std::size_t(cur_stat.st_size);
+		auto cur_addr = ::mmap(nullptr, cur_size, PROT_READ, MAP_PRIVATE, cur_fd, 0);
+		// 映射建立之后关闭文件描述符不影响映射
+		::close(cur_fd);
+		if (cur_addr == MAP_FAILED)
+		{
+			return false;
+		}
+		m_data = static_cast<const char*>(cur_addr);
+		m_size = cur_size;
+		m_is_mapped = true;
+		return true;
+#else
+		std::ifstream ifs(file_path, std::ios::binary);
+		if (!ifs)
+		{
+			return false;
+		}
+		std::ostringstream oss;
+		oss << ifs.rdbuf();
+		m_buffer = oss.str();
+		m_data = m_buffer.data();
+		m_size = m_buffer.size();
+		return true;
+#endif
+	}
+
+	void space_snapshot_file::close()
+	{
+#ifndef _WIN32
+		if (m_is_mapped)
+		{
+			::munmap(const_cast<char*>(m_data), m_size);
+		}
+#endif
+		m_is_mapped = false;
+		m_buffer.clear();
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
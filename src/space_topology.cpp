@@ -0,0 +1,409 @@
+#include "space_topology.h"
+#include <cstring>
+
+namespace spiritsaway::distributed_space
+{
+	namespace
+	{
+		void add_bound(const cell_bound& bound, json::array_t& out_record)
+		{
+			out_record.push_back(bound.min.x);
+			out_record.push_back(bound.min.z);
+			out_record.push_back(bound.max.x);
+			out_record.push_back(bound.max.z);
+		}
+
+		cell_bound read_bound(const json& record, std::size_t begin)
+		{
+			cell_bound result;
+			record.at(begin).get_to(result.min.x);
+			record.at(begin + 1).get_to(result.min.z);
+			record.at(begin + 2).get_to(result.max.x);
+			record.at(begin + 3).get_to(result.max.z);
+			return result;
+		}
+
+		bool same_bound(const cell_bound& a, const cell_bound& b)
+		{
+			return a.min.x == b.min.x && a.min.z == b.min.z && a.max.x == b.max.x && a.max.z == b.max.z;
+		}
+	}
+
+	void space_topology_encoder::collect(const space_cells& cur_space, std::unordered_map<std::string, topology_node>& out_nodes, std::vector<std::string>& out_order)
+	{
+		out_nodes.clear();
+		out_order.clear();
+		std::vector<const space_cells::space_node*> temp_query_buffer;
+		temp_query_buffer.push_back(cur_space.root_node());
+		while (!temp_query_buffer.empty())
+		{
+			auto temp_top = temp_query_buffer.back();
+			temp_query_buffer.pop_back();
+			out_order.push_back(temp_top->space_id());
+			auto& cur_node = out_nodes[temp_top->space_id()];
+			cur_node.bound = temp_top->boundary();
+			cur_node.game_id = temp_top->game_id();
+			cur_node.ready = temp_top->ready();
+			cur_node.is_merging = temp_top->is_merging();
+			if (temp_top->is_leaf_cell())
+			{
+				cur_node.host = temp_top->host_space_id();
+				continue;
+			}
+			cur_node.is_split_x = temp_top->is_split_x();
+			cur_node.children[0] = temp_top->children()[0]->space_id();
+			cur_node.children[1] = temp_top->children()[1]->space_id();
+			temp_query_buffer.push_back(temp_top->children()[1]);
+			temp_query_buffer.push_back(temp_top->children()[0]);
+		}
+	}
+
+	void space_topology_encoder::add_full_records(const std::unordered_map<std::string, topology_node>& nodes, const std::vector<std::string>& order, json::array_t& out_records)
+	{
+		for (const auto& one_id : order)
+		{
+			const auto& cur_node = nodes.at(one_id);
+			json::array_t cur_record{ std::uint8_t(space_topology_op::create), one_id, cur_node.game_id };
+			add_bound(cur_node.bound, cur_record);
+			cur_record.push_back(cur_node.ready);
+			cur_record.push_back(cur_node.is_merging);
+			out_records.push_back(std::move(cur_record));
+			if (!cur_node.host.empty())
+			{
+				out_records.push_back(json::array_t{ std::uint8_t(space_topology_op::host), one_id, cur_node.host });
+			}
+		}
+		for (const auto& one_id : order)
+		{
+			const auto& cur_node = nodes.at(one_id);
+			if (cur_node.children[0].empty())
+			{
+				continue;
+			}
+			out_records.push_back(json::array_t{ std::uint8_t(space_topology_op::children), one_id, cur_node.is_split_x, cur_node.children[0], cur_node.children[1] });
+		}
+	}
+
+	json space_topology_encoder::make_reset(json::array_t&& records) const
+	{
+		json result;
+		result["version"] = m_version;
+		result["reset"] = true;
+		result["root"] = m_root_id;
+		result["master_cell_id"] = m_master_cell_id;
+		result["ghost_radius"] = m_ghost_radius;
+		result["records"] = std::move(records);
+		return result;
+	}
+
+	bool space_topology_encoder::make_delta(const space_cells& cur_space, json& out_delta)
+	{
+		std::unordered_map<std::string, topology_node> cur_nodes;
+		std::vector<std::string> cur_order;
+		collect(cur_space, cur_nodes, cur_order);
+		json::array_t records;
+		// 根节点变化时无法表示为增量 直接发送完整拓扑
+		if (m_version == 0 || cur_space.root_node()->space_id() != m_root_id || cur_space.master_cell_id() != m_master_cell_id || cur_space.ghost_radius() != m_ghost_radius)
+		{
+			m_nodes = std::move(cur_nodes);
+			m_node_order = std::move(cur_order);
+			m_root_id = cur_space.root_node()->space_id();
+			m_master_cell_id = cur_space.master_cell_id();
+			m_ghost_radius = cur_space.ghost_radius();
+			m_version++;
+			add_full_records(m_nodes, m_node_order, records);
+			out_delta = make_reset(std::move(records));
+			return true;
+		}
+		// 先创建新节点 然后修改父子关系 最后删除已经脱离树的节点 这样每条记录执行时引用的节点都存在
+		for (const auto& one_id : cur_order)
+		{
+			if (m_nodes.count(one_id))
+			{
+				continue;
+			}
+			const auto& cur_node = cur_nodes[one_id];
+			json::array_t cur_record{ std::uint8_t(space_topology_op::create), one_id, cur_node.game_id };
+			add_bound(cur_node.bound, cur_record);
+			cur_record.push_back(cur_node.ready);
+			cur_record.push_back(cur_node.is_merging);
+			records.push_back(std::move(cur_record));
+			if (!cur_node.host.empty())
+			{
+				records.push_back(json::array_t{ std::uint8_t(space_topology_op::host), one_id, cur_node.host });
+			}
+		}
+		for (const auto& one_id : cur_order)
+		{
+			const auto& cur_node = cur_nodes[one_id];
+			auto pre_iter = m_nodes.find(one_id);
+			if (pre_iter == m_nodes.end())
+			{
+				if (!cur_node.children[0].empty())
+				{
+					records.push_back(json::array_t{ std::uint8_t(space_topology_op::children), one_id, cur_node.is_split_x, cur_node.children[0], cur_node.children[1] });
+				}
+				continue;
+			}
+			const auto& pre_node = pre_iter->second;
+			if (cur_node.children != pre_node.children || (!cur_node.children[0].empty() && cur_node.is_split_x != pre_node.is_split_x))
+			{
+				records.push_back(json::array_t{ std::uint8_t(space_topology_op::children), one_id, cur_node.is_split_x, cur_node.children[0], cur_node.children[1] });
+			}
+			if (!same_bound(cur_node.bound, pre_node.bound))
+			{
+				json::array_t cur_record{ std::uint8_t(space_topology_op::bound), one_id };
+				add_bound(cur_node.bound, cur_record);
+				records.push_back(std::move(cur_record));
+			}
+			if (cur_node.ready != pre_node.ready || cur_node.is_merging != pre_node.is_merging)
+			{
+				records.push_back(json::array_t{ std::uint8_t(space_topology_op::state), one_id, cur_node.ready, cur_node.is_merging });
+			}
+			if (cur_node.game_id != pre_node.game_id)
+			{
+				records.push_back(json::array_t{ std::uint8_t(space_topology_op::game), one_id, cur_node.game_id });
+			}
+			if (cur_node.host != pre_node.host)
+			{
+				records.push_back(json::array_t{ std::uint8_t(space_topology_op::host), one_id, cur_node.host });
+			}
+		}
+		for (const auto& one_id : m_node_order)
+		{
+			if (!cur_nodes.count(one_id))
+			{
+				records.push_back(json::array_t{ std::uint8_t(space_topology_op::remove), one_id });
+			}
+		}
+		if (records.empty())
+		{
+			return false;
+		}
+		m_nodes = std::move(cur_nodes);
+		m_node_order = std::move(cur_order);
+		m_version++;
+		out_delta = json();
+		out_delta["version"] = m_version;
+		out_delta["base_version"] = m_version - 1;
+		out_delta["records"] = std::move(records);
+		return true;
+	}
+
+	json space_topology_encoder::make_full() const
+	{
+		json::array_t records;
+		add_full_records(m_nodes, m_node_order, records);
+		return make_reset(std::move(records));
+	}
+
+	space_topology_apply_result space_topology_replica::apply(const json& delta)
+	{
+		try
+		{
+			auto cur_version = delta.at("version").get<std::uint64_t>();
+			if (delta.value("reset", false))
+			{
+				if (!m_need_resync && cur_version <= m_version)
+				{
+					return space_topology_apply_result::stale;
+				}
+				if (!apply_reset(delta))
+				{
+					m_space.reset();
+					m_need_resync = true;
+					return space_topology_apply_result::invalid;
+				}
+				m_version = cur_version;
+				m_need_resync = false;
+				return space_topology_apply_result::ok;
+			}
+			if (m_need_resync)
+			{
+				return space_topology_apply_result::gap;
+			}
+			if (cur_version <= m_version)
+			{
+				return space_topology_apply_result::stale;
+			}
+			if (delta.at("base_version").get<std::uint64_t>() != m_version)
+			{
+				m_need_resync = true;
+				return space_topology_apply_result::gap;
+			}
+			if (!apply_records(delta.at("records"), std::string()))
+			{
+				m_space.reset();
+				m_need_resync = true;
+				return space_topology_apply_result::invalid;
+			}
+			m_version = cur_version;
+			return space_topology_apply_result::ok;
+		}
+		catch (const std::exception& e)
+		{
+			(void)e;
+			m_space.reset();
+			m_need_resync = true;
+			return space_topology_apply_result::invalid;
+		}
+	}
+
+	bool space_topology_replica::apply_reset(const json& delta)
+	{
+		auto root_id = delta.at("root").get<std::string>();
+		cell_bound temp_bound;
+		std::memset(&temp_bound, 0, sizeof(temp_bound));
+		m_space = std::make_unique<space_cells>(temp_bound, std::string(), root_id, delta.at("ghost_radius").get<double>());
+		m_space->destroy_nodes();
+		delta.at("master_cell_id").get_to(m_space->m_master_cell_id);
+		return apply_records(delta.at("records"), root_id);
+	}
+
+	bool space_topology_replica::apply_records(const json& records, const std::string& reset_root_id)
+	{
+		auto& cur_space = *m_space;
+		auto find_node = [&cur_space](const std::string& space_id) -> space_cells::space_node*
+		{
+			auto cur_iter = cur_space.m_leaf_nodes.find(space_id);
+			if (cur_iter != cur_space.m_leaf_nodes.end())
+			{
+				return cur_iter->second;
+			}
+			cur_iter = cur_space.m_internal_nodes.find(space_id);
+			if (cur_iter != cur_space.m_internal_nodes.end())
+			{
+				return cur_iter->second;
+			}
+			return nullptr;
+		};
+		// 删除的节点在检查完整棵树之后才释放 避免其他节点残留的指针在检查时访问已经释放的内存
+		std::vector<std::unique_ptr<space_cells::space_node>> removed_nodes;
+		std::string space_id;
+		for (const auto& one_record : records)
+		{
+			auto cur_op = space_topology_op(one_record.at(0).get<std::uint8_t>());
+			one_record.at(1).get_to(space_id);
+			if (cur_op == space_topology_op::create)
+			{
+				if (find_node(space_id))
+				{
+					return false;
+				}
+				auto new_node = new space_cells::space_node(read_bound(one_record, 3), one_record.at(2).get<std::string>(), space_id, nullptr);
+				new_node->m_ready = one_record.at(7).get<bool>();
+				new_node->m_is_merging = one_record.at(8).get<bool>();
+				new_node->make_sorted_loads();
+				cur_space.m_leaf_nodes[space_id] = new_node;
+				continue;
+			}
+			auto cur_node = find_node(space_id);
+			if (!cur_node)
+			{
+				return false;
+			}
+			switch (cur_op)
+			{
+			case space_topology_op::children:
+			{
+				auto child_0_id = one_record.at(3).get<std::string>();
+				auto child_1_id = one_record.at(4).get<std::string>();
+				if (child_0_id.empty() != child_1_id.empty())
+				{
+					return false;
+				}
+				if (child_0_id.empty())
+				{
+					if (!cur_node->is_leaf_cell())
+					{
+						cur_node->m_children[0] = nullptr;
+						cur_node->m_children[1] = nullptr;
+						cur_space.m_internal_nodes.erase(space_id);
+						cur_space.m_leaf_nodes[space_id] = cur_node;
+					}
+					break;
+				}
+				auto child_0 = find_node(child_0_id);
+				auto child_1 = find_node(child_1_id);
+				if (!child_0 || !child_1 || child_0 == child_1 || child_0 == cur_node || child_1 == cur_node)
+				{
+					return false;
+				}
+				if (cur_node->is_leaf_cell())
+				{
+					cur_space.m_leaf_nodes.erase(space_id);
+					cur_space.m_internal_nodes[space_id] = cur_node;
+				}
+				cur_node->m_split_axis = one_record.at(2).get<bool>() ? 0 : 1;
+				cur_node->m_children[0] = child_0;
+				cur_node->m_children[1] = child_1;
+				child_0->m_parent = cur_node;
+				child_1->m_parent = cur_node;
+				break;
+			}
+			case space_topology_op::bound:
+				cur_node->m_boundary = read_bound(one_record, 2);
+				break;
+			case space_topology_op::state:
+				cur_node->m_ready = one_record.at(2).get<bool>();
+				cur_node->m_is_merging = one_record.at(3).get<bool>();
+				break;
+			case space_topology_op::game:
+				one_record.at(2).get_to(cur_node->m_game_id);
+				break;
+			case space_topology_op::host:
+				one_record.at(2).get_to(cur_node->m_host_space_id);
+				break;
+			case space_topology_op::remove:
+				cur_space.m_leaf_nodes.erase(space_id);
+				cur_space.m_internal_nodes.erase(space_id);
+				removed_nodes.emplace_back(cur_node);
+				break;
+			default:
+				return false;
+			}
+		}
+		if (!reset_root_id.empty())
+		{
+			cur_space.m_root_node = find_node(reset_root_id);
+		}
+		return check_tree();
+	}
+
+	bool space_topology_replica::check_tree() const
+	{
+		const auto& cur_space = *m_space;
+		if (!cur_space.m_root_node)
+		{
+			return false;
+		}
+		std::size_t visited_num = 0;
+		std::vector<const space_cells::space_node*> temp_query_buffer;
+		temp_query_buffer.push_back(cur_space.m_root_node);
+		while (!temp_query_buffer.empty())
+		{
+			auto temp_top = temp_query_buffer.back();
+			temp_query_buffer.pop_back();
+			visited_num++;
+			const auto& cur_index = temp_top->is_leaf_cell() ? cur_space.m_leaf_nodes : cur_space.m_internal_nodes;
+			auto cur_iter = cur_index.find(temp_top->space_id());
+			if (cur_iter == cur_index.end() || cur_iter->second != temp_top || visited_num > cur_space.m_leaf_nodes.size() + cur_space.m_internal_nodes.size())
+			{
+				return false;
+			}
+			if (temp_top->is_leaf_cell())
+			{
+				continue;
+			}
+			for (auto one_child : temp_top->m_children)
+			{
+				if (one_child->m_parent != temp_top)
+				{
+					return false;
+				}
+				temp_query_buffer.push_back(one_child);
+			}
+		}
+		return cur_space.m_root_node->m_parent == nullptr && visited_num == cur_space.m_leaf_nodes.size() + cur_space.m_internal_nodes.size();
+	}
+}
@@ -0,0 +1,79 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace spiritsaway::distributed_space
+{
+	thread_pool::thread_pool(std::uint32_t thread_num)
+	{
+		if (thread_num == 0)
+		{
+			thread_num = 1;
+		}
+		for (std::uint32_t i = 0; i < thread_num; i++)
+		{
+			m_workers.emplace_back([this]()
+				{
+					worker_loop();
+				});
+		}
+	}
+
+	thread_pool::~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> cur_lock(m_task_mutex);
+			m_stopped = true;
+		}
+		m_task_cv.notify_all();
+		for (auto& one_worker : m_workers)
+		{
+			one_worker.join();
+		}
+	}
+
+	void thread_pool::worker_loop()
+	{
+		while (true)
+		{
+			std::function<void()> cur_task;
+			{
+				std::unique_lock<std::mutex> cur_lock(m_task_mutex);
+				m_task_cv.wait(cur_lock, [this]()
+					{
+						return m_stopped || !m_tasks.empty();
+					});
+				if (m_tasks.empty())
+				{
+					return;
+				}
+				cur_task = std::move(m_tasks.front());
+				m_tasks.pop();
+			}
+			cur_task();
+		}
+	}
+
+	void thread_pool::parallel_for(std::size_t total, const std::function<void(std::size_t, std::size_t)>& func)
+	{
+		if (total == 0)
+		{
+			return;
+		}
+		std::size_t batch_num = std::min<std::size_t>(m_workers.size(), total);
+		std::size_t batch_size = (total + batch_num - 1) / batch_num;
+		std::vector<std::future<void>> batch_futures;
+		batch_futures.reserve(batch_num);
+		for (std::size_t i = 0; i < total; i += batch_size)
+		{
+			auto cur_end = std::min(total, i + batch_size);
+			batch_futures.push_back(submit([&func, i, cur_end]()
+				{
+					func(i, cur_end);
+				}));
+		}
+		for (auto& one_future : batch_futures)
+		{
+			one_future.get();
+		}
+	}
+}
@@ -0,0 +1,137 @@
+#include "space_cells.h"
+#include <random>
+#include <iostream>
+#include <cmath>
+
+using namespace spiritsaway::distributed_space;
+
+// 混合容量的game上shrink收敛之后的利用率对比
+// space被均匀切分为8个竖条 每个竖条在一个单独的game上 entity均匀分布
+// 1. unaware: 不设置game容量 负载均衡把所有game当作相同的机器
+// 2. aware: 通过set_game_capacity设置容量 负载均衡使用利用率
+// 统计时都使用真实容量计算每个game的利用率
+
+struct scenario
+{
+	std::string name;
+	std::vector<float> capacities;
+};
+
+void build_strips(space_cells& cur_space, const std::string& cell_id, double min_x, double max_x, std::uint32_t begin, std::uint32_t end)
+{
+	if (end - begin <= 1)
+	{
+		return;
+	}
+	auto mid = (begin + end) / 2;
+	auto split_x = min_x + (max_x - min_x) * (mid - begin) / (end - begin);
+	auto new_cell_id = "cell" + std::to_string(mid);
+	cur_space.split_x(split_x, cell_id, "game" + std::to_string(mid), cell_id, new_cell_id);
+	cur_space.set_ready(new_cell_id);
+	build_strips(cur_space, cell_id, min_x, split_x, begin, mid);
+	build_strips(cur_space, new_cell_id, split_x, max_x, mid, end);
+}
+
+void run_case(const scenario& cur_scenario, bool is_capacity_aware)
+{
+	std::uint32_t cell_num = std::uint32_t(cur_scenario.capacities.size());
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 1000.0 * cell_num;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 2000;
+	space_cells cur_space(temp_bound, "game0", "cell0", 50);
+	cur_space.set_ready("cell0");
+	build_strips(cur_space, "cell0", temp_bound.min.x, temp_bound.max.x, 0, cell_num);
+	if (is_capacity_aware)
+	{
+		for (std::uint32_t i = 0; i < cell_num; i++)
+		{
+			cur_space.set_game_capacity("game" + std::to_string(i), cur_scenario.capacities[i]);
+		}
+	}
+
+	std::mt19937 e1(1);
+	std::uniform_real_distribution<double> x_dist(temp_bound.min.x, temp_bound.max.x);
+	std::uniform_real_distribution<double> z_dist(temp_bound.min.z, temp_bound.max.z);
+	std::vector<entity_load> all_entity_loads(500 * cell_num);
+	for (auto& one_entity_load : all_entity_loads)
+	{
+		one_entity_load.pos.x = x_dist(e1);
+		one_entity_load.pos.z = z_dist(e1);
+		one_entity_load.load = 1;
+		one_entity_load.is_real = true;
+	}
+
+	cell_load_balance_param lb_param;
+	lb_param.load_to_offset = 20;
+	lb_param.max_cell_load_when_remove = 0;
+	lb_param.min_cell_load_report_counter_when_remove = 1000;
+	lb_param.min_cell_load_report_counter_when_shrink = 2;
+	lb_param.min_cell_load_report_counter_when_split = 1000;
+	lb_param.min_cell_load_when_shrink = 50;
+	lb_param.min_cell_load_when_split = 100000;
+	lb_param.min_game_load_when_split = 100000;
+	lb_param.min_sibling_game_load_diff_when_shrink = 40;
+
+	std::uint32_t shrink_num = 0;
+	std::unordered_map<std::string, float> game_loads;
+	for (std::uint32_t tick = 0; tick < 600; tick++)
+	{
+		std::unordered_map<std::string, std::vector<entity_load>> cell_entity_loads;
+		for (const auto& one_entity_load : all_entity_loads)
+		{
+			cell_entity_loads[cur_space.query_leaf_for_point(one_entity_load.pos.x, one_entity_load.pos.z)->space_id()].push_back(one_entity_load);
+		}
+		game_loads.clear();
+		for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+		{
+			const auto& cur_entity_loads = cell_entity_loads[one_cell_id];
+			cur_space.update_cell_load(one_cell_id, float(cur_entity_loads.size()), cur_entity_loads);
+			game_loads[one_cell->game_id()] += float(cur_entity_loads.size());
+		}
+		cur_space.update_load_stat(game_loads);
+		auto cur_shrink_node = cur_space.get_best_node_to_shrink_parallel(lb_param, nullptr);
+		if (cur_shrink_node)
+		{
+			cur_space.balance(cur_shrink_node->calc_best_shrink_new_split_pos(lb_param, cur_space.ghost_radius()), cur_shrink_node->parent());
+			shrink_num++;
+		}
+	}
+	float min_utilization = 0;
+	float max_utilization = 0;
+	for (std::uint32_t i = 0; i < cell_num; i++)
+	{
+		auto cur_utilization = game_loads["game" + std::to_string(i)] / cur_scenario.capacities[i];
+		if (i == 0 || cur_utilization < min_utilization)
+		{
+			min_utilization = cur_utilization;
+		}
+		if (i == 0 || cur_utilization > max_utilization)
+		{
+			max_utilization = cur_utilization;
+		}
+	}
+	float total_capacity = 0;
+	for (auto one_capacity : cur_scenario.capacities)
+	{
+		total_capacity += one_capacity;
+	}
+	std::cout << cur_scenario.name << "\t" << (is_capacity_aware ? "aware  " : "unaware") << "\tideal " << all_entity_loads.size() / total_capacity << "\tmin_utilization " << min_utilization << "\tmax_utilization " << max_utilization << "\tshrinks " << shrink_num << std::endl;
+}
+
+int main()
+{
+	std::vector<scenario> all_scenarios;
+	all_scenarios.push_back(scenario{ "uniform    ", { 1, 1, 1, 1, 1, 1, 1, 1 } });
+	// 8核与32核机器交替
+	all_scenarios.push_back(scenario{ "interleaved", { 4, 1, 4, 1, 4, 1, 4, 1 } });
+	// 左侧全是32核机器 右侧全是8核机器
+	all_scenarios.push_back(scenario{ "grouped    ", { 4, 4, 4, 4, 1, 1, 1, 1 } });
+	for (const auto& one_scenario : all_scenarios)
+	{
+		run_case(one_scenario, false);
+		run_case(one_scenario, true);
+	}
+	return 0;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include "space_cells.h"
+#include <chrono>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// benchmark之间共用的构造 计时以及模拟entity迁移的工具
+
+// 沿着较长的边递归二分 得到一个有leaf_num个叶子的平衡树 每个叶子在单独的game上
+// 切分位置使用double计算之后再转换为坐标类型 边界能被均分时double与float的space切分位置相同
+template <typename S>
+void split_balanced(S& cur_space, const std::string& cell_id, const typename S::cell_bound& bound, std::uint32_t leaf_num, std::uint32_t& cell_counter)
+{
+	if (leaf_num <= 1)
+	{
+		return;
+	}
+	auto low_leaf_num = leaf_num / 2;
+	bool is_x = bound.max.x - bound.min.x >= bound.max.z - bound.min.z;
+	int axis = is_x ? 0 : 1;
+	auto split_pos = double(bound.min[axis]) + double(bound.max[axis] - bound.min[axis]) * low_leaf_num / leaf_num;
+	auto new_cell_id = "cell" + std::to_string(++cell_counter);
+	auto new_game_id = "game" + std::to_string(cell_counter);
+	if (is_x)
+	{
+		cur_space.split_x(split_pos, cell_id, new_game_id, cell_id, new_cell_id);
+	}
+	else
+	{
+		cur_space.split_z(split_pos, cell_id, new_game_id, cell_id, new_cell_id);
+	}
+	cur_space.set_ready(new_cell_id);
+	auto low_bound = bound;
+	low_bound.max[axis] = typename S::coord_type(split_pos);
+	auto high_bound = bound;
+	high_bound.min[axis] = typename S::coord_type(split_pos);
+	split_balanced(cur_space, cell_id, low_bound, low_leaf_num, cell_counter);
+	split_balanced(cur_space, new_cell_id, high_bound, leaf_num - low_leaf_num, cell_counter);
+}
+
+template <typename F>
+double measure_ms(F&& func)
+{
+	auto begin_ts = std::chrono::steady_clock::now();
+	func();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin_ts).count();
+}
+
+// 连续执行repeat次 返回每次的平均毫秒数
+template <typename F>
+double measure_ms(F&& func, int repeat)
+{
+	auto begin_ts = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeat; i++)
+	{
+		func();
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin_ts).count() / repeat;
+}
+
+// 模拟负载迁移的benchmark中的entity host_cell_id为entity当前所在的cell
+struct bench_entity
+{
+	spiritsaway::distributed_space::point_xz pos;
+	float load = 1;
+	std::string host_cell_id;
+};
+
+// query_leaf_for_point对于未ready的cell会返回其host cell 这里需要的是位置所在的叶子节点本身
+template <typename S>
+const typename S::space_node* find_leaf(const S& cur_space, double x, double z)
+{
+	auto cur_node = cur_space.root_node();
+	while (!cur_node->is_leaf_cell())
+	{
+		cur_node = cur_node->children()[0]->boundary().cover(x, z) ? cur_node->children()[0] : cur_node->children()[1];
+	}
+	return cur_node;
+}
+
+// 切分出来的新cell需要等新的game创建完成之后才能ready 按照加入的顺序记录每个cell的ready tick
+class pending_ready_cells
+{
+	std::vector<std::tuple<std::uint32_t, spiritsaway::distributed_space::space_cells*, std::string>> m_cells;
+public:
+	void add(std::uint32_t ready_tick, spiritsaway::distributed_space::space_cells* cur_space, const std::string& cell_id)
+	{
+		m_cells.emplace_back(ready_tick, cur_space, cell_id);
+	}
+	// 把ready tick不大于tick的cell设置为ready
+	void update(std::uint32_t tick)
+	{
+		for (auto iter = m_cells.begin(); iter != m_cells.end();)
+		{
+			if (std::get<0>(*iter) <= tick)
+			{
+				std::get<1>(*iter)->set_ready(std::get<2>(*iter));
+				iter = m_cells.erase(iter);
+			}
+			else
+			{
+				iter++;
+			}
+		}
+	}
+	bool empty() const
+	{
+		return m_cells.empty();
+	}
+};
+
+// entity只有在所在位置的cell ready之后才会迁移过去 返回按照host_cell_id统计的cell负载
+// 位置仍然在host cell内的entity加入out_cell_entity_loads 离开了host cell但是目标cell还没有ready的entity只计入负载
+inline std::unordered_map<std::string, float> migrate_entities(const spiritsaway::distributed_space::space_cells& cur_space, std::vector<bench_entity>& entities, std::unordered_map<std::string, std::vector<spiritsaway::distributed_space::entity_load>>& out_cell_entity_loads)
+{
+	std::unordered_map<std::string, float> cell_loads;
+	for (auto& one_entity : entities)
+	{
+		auto cur_cell = find_leaf(cur_space, one_entity.pos.x, one_entity.pos.z);
+		if (cur_cell->ready())
+		{
+			one_entity.host_cell_id = cur_cell->space_id();
+		}
+		cell_loads[one_entity.host_cell_id] += one_entity.load;
+		if (one_entity.host_cell_id == cur_cell->space_id())
+		{
+			spiritsaway::distributed_space::entity_load cur_entity_load;
+			cur_entity_load.pos = one_entity.pos;
+			cur_entity_load.load = one_entity.load;
+			cur_entity_load.is_real = true;
+			out_cell_entity_loads[one_entity.host_cell_id].push_back(cur_entity_load);
+		}
+	}
+	return cell_loads;
+}
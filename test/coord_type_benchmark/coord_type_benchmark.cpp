@@ -0,0 +1,133 @@
+#include "space_cells.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+using namespace spiritsaway::distributed_space;
+
+// 对比double与float坐标的basic_space_cells
+// 坐标都是小于2^24的整数 两种类型都可以精确表示 因此查询结果与split方向需要完全相同
+// 每个坐标类型的结果以一行json输出 entity_load_bytes为单个entity_load的大小 entity_array_bytes为所有叶子entity_load数组占用的内存
+// 最后一行对比两种类型的查询结果
+
+const std::uint32_t leaf_num = 1024;
+const std::uint32_t entity_per_cell = 1000;
+const std::uint32_t query_num = 200000;
+
+template <typename T>
+json run_case(const std::string& name, std::vector<std::string>& out_query_results)
+{
+	basic_cell_bound<T> temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 1000000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 1000000;
+	basic_space_cells<T> cur_space(temp_bound, "game0", "cell0", 100);
+	cur_space.set_ready("cell0");
+	std::uint32_t cell_counter = 0;
+	split_balanced(cur_space, "cell0", temp_bound, leaf_num, cell_counter);
+
+	// 相同的随机数种子 两种类型得到相同的entity
+	std::mt19937 e1(1);
+	std::vector<std::pair<std::string, std::vector<basic_entity_load<T>>>> cell_entity_loads;
+	for (const auto& one_pair : cur_space.all_leafs())
+	{
+		const auto& cur_bound = one_pair.second->boundary();
+		std::uniform_int_distribution<std::int32_t> x_dist(std::int32_t(cur_bound.min.x), std::int32_t(cur_bound.max.x) - 1);
+		std::uniform_int_distribution<std::int32_t> z_dist(std::int32_t(cur_bound.min.z), std::int32_t(cur_bound.max.z) - 1);
+		std::vector<basic_entity_load<T>> temp_entity_loads(entity_per_cell);
+		for (auto& one_entity : temp_entity_loads)
+		{
+			one_entity.pos.x = T(x_dist(e1));
+			one_entity.pos.z = T(z_dist(e1));
+			one_entity.load = 1.0f;
+			one_entity.is_real = true;
+		}
+		cell_entity_loads.emplace_back(one_pair.first, std::move(temp_entity_loads));
+	}
+	std::sort(cell_entity_loads.begin(), cell_entity_loads.end(), [](const auto& a, const auto& b)
+		{
+			return a.first < b.first;
+		});
+	auto update_ms = measure_ms([&]()
+		{
+			for (const auto& [one_cell_id, one_entity_loads] : cell_entity_loads)
+			{
+				cur_space.update_cell_load(one_cell_id, float(one_entity_loads.size()), one_entity_loads);
+			}
+		});
+	std::size_t entity_array_bytes = 0;
+	for (const auto& one_pair : cur_space.all_leafs())
+	{
+		entity_array_bytes += one_pair.second->get_entity_loads().capacity() * sizeof(basic_entity_load<T>);
+	}
+
+	std::mt19937 e2(2);
+	std::uniform_int_distribution<std::int32_t> pos_dist(0, 999999);
+	std::vector<std::array<double, 2>> query_points(query_num);
+	for (auto& one_point : query_points)
+	{
+		one_point[0] = pos_dist(e2);
+		one_point[1] = pos_dist(e2);
+	}
+	out_query_results.clear();
+	out_query_results.reserve(query_num);
+	auto point_query_ms = measure_ms([&]()
+		{
+			for (const auto& one_point : query_points)
+			{
+				auto cur_leaf = cur_space.query_leaf_for_point(one_point[0], one_point[1]);
+				out_query_results.push_back(cur_leaf ? cur_leaf->space_id() : std::string());
+			}
+		});
+	std::size_t intersect_num = 0;
+	auto intersect_query_ms = measure_ms([&]()
+		{
+			for (const auto& one_point : query_points)
+			{
+				basic_cell_bound<T> query_bound;
+				query_bound.min.x = T(one_point[0] - 500);
+				query_bound.min.z = T(one_point[1] - 500);
+				query_bound.max.x = T(one_point[0] + 500);
+				query_bound.max.z = T(one_point[1] + 500);
+				intersect_num += cur_space.query_intersect_leafs(query_bound).size();
+			}
+		});
+	std::string split_directions;
+	auto split_direction_ms = measure_ms([&]()
+		{
+			for (const auto& [one_cell_id, one_entity_loads] : cell_entity_loads)
+			{
+				split_directions.push_back(char('0' + int(cur_space.get_leaf(one_cell_id)->calc_best_split_direction(100))));
+			}
+		});
+	out_query_results.push_back(split_directions);
+	out_query_results.push_back(std::to_string(intersect_num));
+
+	json result;
+	result["coord_type"] = name;
+	result["leafs"] = leaf_num;
+	result["entity_per_cell"] = entity_per_cell;
+	result["entity_load_bytes"] = sizeof(basic_entity_load<T>);
+	result["cell_bound_bytes"] = sizeof(basic_cell_bound<T>);
+	result["entity_array_bytes"] = entity_array_bytes;
+	result["update_cell_load_ms"] = update_ms;
+	result["point_query_ms"] = point_query_ms;
+	result["intersect_query_ms"] = intersect_query_ms;
+	result["split_direction_ms"] = split_direction_ms;
+	std::cout << result.dump() << std::endl;
+	return result;
+}
+
+int main()
+{
+	std::vector<std::string> double_results;
+	std::vector<std::string> float_results;
+	run_case<double>("double", double_results);
+	run_case<float>("float", float_results);
+	json compare_result;
+	compare_result["same_result"] = double_results == float_results;
+	std::cout << compare_result.dump() << std::endl;
+	return double_results == float_results ? 0 : 1;
+}
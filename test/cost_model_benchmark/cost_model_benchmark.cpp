@@ -0,0 +1,185 @@
+#include "entity_cost_model.h"
+#include <random>
+#include <iostream>
+#include <chrono>
+#include <memory>
+
+using namespace spiritsaway::distributed_space;
+
+// 1. 在50k entity的cell上测量aoi_density_cost_model的估计耗时 并与暴力统计的邻居数量对比
+// 2. 一个密集人群cell与一个entity数量更多的稀疏cell 对比线性开销与aoi开销下split选择的cell
+
+const double aoi_radius = 50;
+
+std::vector<entity_load> generate_uniform(std::uint32_t entity_num, const cell_bound& bound, std::mt19937& e1)
+{
+	std::uniform_real_distribution<double> x_dist(bound.min.x, bound.max.x);
+	std::uniform_real_distribution<double> z_dist(bound.min.z, bound.max.z);
+	std::vector<entity_load> result(entity_num);
+	for (auto& one_entity_load : result)
+	{
+		one_entity_load.pos.x = x_dist(e1);
+		one_entity_load.pos.z = z_dist(e1);
+		one_entity_load.load = 1;
+		one_entity_load.is_real = true;
+	}
+	return result;
+}
+
+// 若干个正态分布的人群
+std::vector<entity_load> generate_crowds(std::uint32_t entity_num, std::uint32_t crowd_num, double crowd_radius, const cell_bound& bound, std::mt19937& e1)
+{
+	auto crowd_centers = generate_uniform(crowd_num, bound, e1);
+	std::normal_distribution<double> offset_dist(0, crowd_radius);
+	std::vector<entity_load> result(entity_num);
+	for (std::uint32_t i = 0; i < entity_num; i++)
+	{
+		const auto& cur_center = crowd_centers[i % crowd_num].pos;
+		result[i].pos.x = std::clamp(cur_center.x + offset_dist(e1), bound.min.x, bound.max.x);
+		result[i].pos.z = std::clamp(cur_center.z + offset_dist(e1), bound.min.z, bound.max.z);
+		result[i].load = 1;
+		result[i].is_real = true;
+	}
+	return result;
+}
+
+std::uint32_t brute_force_neighbors(const std::vector<entity_load>& entity_loads, std::size_t index)
+{
+	std::uint32_t result = 0;
+	for (std::size_t i = 0; i < entity_loads.size(); i++)
+	{
+		auto diff_x = entity_loads[i].pos.x - entity_loads[index].pos.x;
+		auto diff_z = entity_loads[i].pos.z - entity_loads[index].pos.z;
+		if (i != index && diff_x * diff_x + diff_z * diff_z <= aoi_radius * aoi_radius)
+		{
+			result++;
+		}
+	}
+	return result;
+}
+
+void bench_estimator(const std::string& name, const std::vector<entity_load>& entity_loads, std::mt19937& e1)
+{
+	linear_cost_model cur_linear_model;
+	aoi_density_cost_model cur_aoi_model(aoi_radius, 0.01f);
+	std::vector<float> temp_costs;
+	const int repeat_num = 10;
+	double cost_sum = 0;
+	auto begin_ts = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeat_num; i++)
+	{
+		cur_linear_model.estimate(entity_loads, temp_costs);
+	}
+	auto linear_ts = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeat_num; i++)
+	{
+		cur_aoi_model.estimate(entity_loads, temp_costs);
+	}
+	auto aoi_ts = std::chrono::steady_clock::now();
+	for (auto one_cost : temp_costs)
+	{
+		cost_sum += one_cost;
+	}
+	// 随机抽取一部分entity与暴力统计对比
+	std::vector<std::uint32_t> neighbor_nums;
+	cur_aoi_model.count_neighbors(entity_loads, neighbor_nums);
+	std::uniform_int_distribution<std::size_t> idx_dist(0, entity_loads.size() - 1);
+	std::uint32_t mismatch_num = 0;
+	double neighbor_sum = 0;
+	for (int i = 0; i < 200; i++)
+	{
+		auto cur_idx = idx_dist(e1);
+		if (brute_force_neighbors(entity_loads, cur_idx) != neighbor_nums[cur_idx])
+		{
+			mismatch_num++;
+		}
+	}
+	for (auto one_num : neighbor_nums)
+	{
+		neighbor_sum += one_num;
+	}
+	std::cout << name << "\tentities " << entity_loads.size() << "\tavg_neighbors " << neighbor_sum / entity_loads.size();
+	std::cout << "\tlinear_us " << std::chrono::duration_cast<std::chrono::microseconds>(linear_ts - begin_ts).count() / repeat_num;
+	std::cout << "\taoi_us " << std::chrono::duration_cast<std::chrono::microseconds>(aoi_ts - linear_ts).count() / repeat_num;
+	std::cout << "\taoi_cost " << cost_sum << "\tmismatch " << mismatch_num << "/200" << std::endl;
+}
+
+void bench_update_cell_load(const std::vector<entity_load>& entity_loads, std::shared_ptr<const entity_cost_model> cost_model, const std::string& name)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 2000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 2000;
+	space_cells cur_space(temp_bound, "game0", "cell0", aoi_radius);
+	cur_space.set_ready("cell0");
+	cur_space.set_entity_cost_model(cost_model);
+	const int repeat_num = 10;
+	auto begin_ts = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeat_num; i++)
+	{
+		cur_space.update_cell_load("cell0", float(entity_loads.size()), entity_loads);
+	}
+	auto end_ts = std::chrono::steady_clock::now();
+	std::cout << "update_cell_load " << name << "\tentities " << entity_loads.size() << "\tus " << std::chrono::duration_cast<std::chrono::microseconds>(end_ts - begin_ts).count() / repeat_num << std::endl;
+}
+
+// 左侧cell为3000人的密集人群 右侧cell为6000人均匀分布
+void compare_split_choice(std::shared_ptr<const entity_cost_model> cost_model, const std::string& name, std::mt19937& e1)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 4000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 2000;
+	space_cells cur_space(temp_bound, "game0", "dense", aoi_radius);
+	cur_space.set_ready("dense");
+	cur_space.split_x(2000, "dense", "game1", "dense", "sparse");
+	cur_space.set_ready("sparse");
+	cur_space.set_entity_cost_model(cost_model);
+	auto dense_loads = generate_crowds(3000, 3, 60, cur_space.get_leaf("dense")->boundary(), e1);
+	auto sparse_loads = generate_uniform(6000, cur_space.get_leaf("sparse")->boundary(), e1);
+	std::unordered_map<std::string, float> game_loads;
+	for (int i = 0; i < 5; i++)
+	{
+		cur_space.update_cell_load("dense", 3000, dense_loads);
+		cur_space.update_cell_load("sparse", 6000, sparse_loads);
+	}
+	game_loads["game0"] = cur_space.get_leaf("dense")->get_smoothed_load();
+	game_loads["game1"] = cur_space.get_leaf("sparse")->get_smoothed_load();
+	cur_space.update_load_stat(game_loads);
+	cell_load_balance_param lb_param;
+	lb_param.min_cell_load_report_counter_when_split = 3;
+	lb_param.min_cell_load_when_split = 100;
+	lb_param.min_game_load_when_split = 100;
+	auto cur_split_cell = cur_space.get_best_cell_to_split(game_loads, lb_param);
+	std::cout << name << "\tdense_load " << game_loads["game0"] << "\tsparse_load " << game_loads["game1"] << "\tsplit " << (cur_split_cell ? cur_split_cell->space_id() : std::string("none"));
+	if (cur_split_cell)
+	{
+		std::cout << "\tdirection " << int(cur_split_cell->calc_best_split_direction(cur_space.ghost_radius()));
+	}
+	std::cout << std::endl;
+}
+
+int main()
+{
+	std::mt19937 e1(1);
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 2000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 2000;
+	auto uniform_loads = generate_uniform(50000, temp_bound, e1);
+	auto crowd_loads = generate_crowds(50000, 20, 80, temp_bound, e1);
+	bench_estimator("uniform", uniform_loads, e1);
+	bench_estimator("crowds ", crowd_loads, e1);
+
+	auto aoi_model = std::make_shared<aoi_density_cost_model>(aoi_radius, 0.01f);
+	bench_update_cell_load(crowd_loads, nullptr, "reported");
+	bench_update_cell_load(crowd_loads, aoi_model, "aoi     ");
+
+	compare_split_choice(nullptr, "reported", e1);
+	compare_split_choice(std::make_shared<linear_cost_model>(), "linear  ", e1);
+	compare_split_choice(aoi_model, "aoi     ", e1);
+	return 0;
+}
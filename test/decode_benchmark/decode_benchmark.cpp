@@ -0,0 +1,163 @@
+#include "space_cells.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+using namespace spiritsaway::distributed_space;
+
+// 从encode的结果恢复大量节点的space_cells
+// json解析与decode分开计时 decode在同一个space_cells上重复执行repeat次 包含释放上一次恢复的树的开销
+// 每一项结果以一行json输出 同时检查恢复之后的encode结果与原来相同 并且叶子与内部节点的索引数量正确
+// rss_growth_kb为第一次decode之后 再重复decode前后的常驻内存差 用来发现旧的树没有被释放的问题 无法读取时为0
+// stream_decode_ms为decode_stream直接从文本恢复的耗时 对应的json路径耗时为parse_ms + decode_ms
+// 用法: decode_benchmark [dom|stream input.json]
+// 有参数时只用对应的方式恢复一个文件 输出进程的峰值内存 每种方式需要在单独的进程中运行才能对比峰值内存
+
+// VmRSS为当前的常驻内存 VmHWM为峰值
+std::uint64_t read_status_kb(const std::string& field)
+{
+	std::ifstream ifs("/proc/self/status");
+	std::string cur_line;
+	while (std::getline(ifs, cur_line))
+	{
+		if (cur_line.rfind(field, 0) == 0)
+		{
+			return std::stoull(cur_line.substr(field.size()));
+		}
+	}
+	return 0;
+}
+
+std::uint64_t read_rss_kb()
+{
+	return read_status_kb("VmRSS:");
+}
+
+bool run_case(std::uint32_t leaf_num, std::uint32_t entity_per_cell, std::uint32_t repeat)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 100000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 100000;
+	space_cells cur_space(temp_bound, "game0", "cell0", 10);
+	cur_space.set_ready("cell0");
+	std::uint32_t cell_counter = 0;
+	split_balanced(cur_space, "cell0", temp_bound, leaf_num, cell_counter);
+
+	std::mt19937 e1(leaf_num * 7 + entity_per_cell);
+	std::uniform_real_distribution<double> unit_dist(0, 1);
+	std::vector<entity_load> temp_entity_loads;
+	for (const auto& one_pair : cur_space.all_leafs())
+	{
+		const auto& cur_bound = one_pair.second->boundary();
+		temp_entity_loads.resize(entity_per_cell);
+		for (auto& one_entity : temp_entity_loads)
+		{
+			one_entity.pos.x = cur_bound.min.x + (cur_bound.max.x - cur_bound.min.x) * unit_dist(e1);
+			one_entity.pos.z = cur_bound.min.z + (cur_bound.max.z - cur_bound.min.z) * unit_dist(e1);
+			one_entity.load = float(unit_dist(e1));
+			one_entity.is_real = true;
+		}
+		cur_space.update_cell_load(one_pair.first, float(entity_per_cell), temp_entity_loads);
+	}
+	auto origin_json = cur_space.encode();
+	auto origin_data = origin_json.dump();
+
+	json parsed_json;
+	auto parse_ms = measure_ms([&]()
+		{
+			parsed_json = json::parse(origin_data);
+		});
+	space_cells restored_space(temp_bound, "game0", "cell0", 10);
+	// 先恢复一次 之后重复decode时内存应该保持稳定
+	bool decode_ok = restored_space.decode(parsed_json);
+	auto before_rss = read_rss_kb();
+	auto decode_ms = measure_ms([&]()
+		{
+			for (std::uint32_t i = 0; i < repeat; i++)
+			{
+				decode_ok = restored_space.decode(parsed_json) && decode_ok;
+			}
+		});
+	auto after_rss = read_rss_kb();
+	space_cells stream_space(temp_bound, "game0", "cell0", 10);
+	std::istringstream iss(origin_data);
+	bool stream_ok = false;
+	auto stream_decode_ms = measure_ms([&]()
+		{
+			stream_ok = stream_space.decode_stream(iss);
+		});
+	std::size_t internal_num = 0;
+	for (const auto& one_pair : restored_space.all_leafs())
+	{
+		internal_num += one_pair.second->is_leaf_cell() ? 0 : 1;
+	}
+	bool is_same = decode_ok && restored_space.encode() == origin_json && restored_space.all_leafs().size() == leaf_num && internal_num == 0 && restored_space.get_internal(restored_space.root_node()->space_id()) != nullptr;
+	is_same = is_same && stream_ok && stream_space.encode() == origin_json;
+	json cur_result;
+	cur_result["leafs"] = leaf_num;
+	cur_result["nodes"] = 2 * leaf_num - 1;
+	cur_result["entity_per_cell"] = entity_per_cell;
+	cur_result["json_bytes"] = origin_data.size();
+	cur_result["parse_ms"] = parse_ms;
+	cur_result["decode_ms"] = decode_ms / repeat;
+	cur_result["repeat"] = repeat;
+	cur_result["stream_decode_ms"] = stream_decode_ms;
+	cur_result["rss_growth_kb"] = after_rss > before_rss ? after_rss - before_rss : 0;
+	cur_result["index_leafs"] = restored_space.all_leafs().size();
+	cur_result["same_result"] = is_same;
+	std::cout << cur_result.dump() << std::endl;
+	return is_same;
+}
+
+int decode_file(const std::string& mode, const std::string& file_path)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 1;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 1;
+	space_cells cur_space(temp_bound, "game0", "cell0", 10);
+	auto begin_rss = read_rss_kb();
+	bool decode_ok = false;
+	auto decode_ms = measure_ms([&]()
+		{
+			std::ifstream ifs(file_path, std::ios::binary);
+			if (mode == "stream")
+			{
+				decode_ok = cur_space.decode_stream(ifs);
+			}
+			else
+			{
+				auto cur_json = json::parse(ifs, nullptr, false);
+				decode_ok = !cur_json.is_discarded() && cur_space.decode(cur_json);
+			}
+		});
+	json cur_result;
+	cur_result["mode"] = mode;
+	cur_result["decode_ok"] = decode_ok;
+	cur_result["leafs"] = cur_space.all_leafs().size();
+	cur_result["decode_ms"] = decode_ms;
+	cur_result["begin_rss_kb"] = begin_rss;
+	cur_result["tree_rss_kb"] = read_rss_kb();
+	cur_result["peak_rss_kb"] = read_status_kb("VmHWM:");
+	std::cout << cur_result.dump() << std::endl;
+	return decode_ok ? 0 : 1;
+}
+
+int main(int argc, const char** argv)
+{
+	if (argc >= 3)
+	{
+		return decode_file(argv[1], argv[2]);
+	}
+	bool all_same = true;
+	for (std::uint32_t entity_per_cell : { 0, 10, 100 })
+	{
+		all_same = run_case(5000, entity_per_cell, 10) && all_same;
+	}
+	return all_same ? 0 : 1;
+}
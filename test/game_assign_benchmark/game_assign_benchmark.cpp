@@ -0,0 +1,264 @@
+#include "space_cells.h"
+#include <random>
+#include <iostream>
+#include <unordered_set>
+#include <algorithm>
+
+using namespace spiritsaway::distributed_space;
+
+// 对比新cell的game选择策略 统计最终的跨game ghost数量与game峰值负载
+
+enum class game_choose_strategy
+{
+	min_load_unused_game, // load_balance_test里的做法 选择没有承载cell的负载最小的game
+	min_load_game, // 只看负载 选择负载最小的game
+	assign_optimizer, // space_cells::choose_game_for_new_cell
+};
+
+const char* strategy_name(game_choose_strategy strategy)
+{
+	switch (strategy)
+	{
+	case game_choose_strategy::min_load_unused_game:
+		return "min_load_unused_game";
+	case game_choose_strategy::min_load_game:
+		return "min_load_game";
+	default:
+		return "assign_optimizer";
+	}
+}
+
+struct benchmark_scenario
+{
+	std::string name;
+	std::vector<float> game_capacities;
+	std::uint32_t entity_num;
+	std::uint32_t hotspot_num;
+	std::uint32_t seed;
+};
+
+std::vector<point_xz> generate_hotspot_points(const cell_bound& cur_boundary, const benchmark_scenario& scenario)
+{
+	std::mt19937 e1(scenario.seed);
+	std::uniform_real_distribution<double> uniform_dist_x(cur_boundary.min.x, cur_boundary.max.x);
+	std::uniform_real_distribution<double> uniform_dist_z(cur_boundary.min.z, cur_boundary.max.z);
+	std::vector<point_xz> hotspots;
+	for (std::uint32_t i = 0; i < scenario.hotspot_num; i++)
+	{
+		point_xz temp_pos;
+		temp_pos.x = uniform_dist_x(e1);
+		temp_pos.z = uniform_dist_z(e1);
+		hotspots.push_back(temp_pos);
+	}
+	std::normal_distribution<double> hotspot_dist(0, 1500);
+	std::vector<point_xz> result;
+	for (std::uint32_t i = 0; i < scenario.entity_num; i++)
+	{
+		point_xz temp_pos;
+		// 一半的entity聚集在热点附近 另外一半均匀分布
+		if (i % 2 == 0 && !hotspots.empty())
+		{
+			const auto& cur_hotspot = hotspots[i / 2 % hotspots.size()];
+			temp_pos.x = std::clamp(cur_hotspot.x + hotspot_dist(e1), cur_boundary.min.x + 1, cur_boundary.max.x - 1);
+			temp_pos.z = std::clamp(cur_hotspot.z + hotspot_dist(e1), cur_boundary.min.z + 1, cur_boundary.max.z - 1);
+		}
+		else
+		{
+			temp_pos.x = uniform_dist_x(e1);
+			temp_pos.z = uniform_dist_z(e1);
+		}
+		result.push_back(temp_pos);
+	}
+	return result;
+}
+
+struct ghost_stat
+{
+	std::uint64_t total_ghost_num = 0;
+	std::uint64_t cross_game_ghost_num = 0;
+};
+
+// 根据entity位置重新计算每个cell的entity_load 并返回每个game的负载
+std::unordered_map<std::string, float> update_entity_loads(space_cells& cur_space, const std::vector<point_xz>& entity_poses, ghost_stat& out_ghost_stat)
+{
+	std::unordered_map<std::string, std::vector<entity_load>> cell_entity_loads;
+	out_ghost_stat = ghost_stat{};
+	for (std::uint32_t i = 0; i < entity_poses.size(); i++)
+	{
+		const auto& one_point = entity_poses[i];
+		auto cur_real_cell = cur_space.query_leaf_for_point(one_point.x, one_point.z);
+		cell_bound temp_bound;
+		temp_bound.min = one_point;
+		temp_bound.max = one_point;
+		temp_bound.min.x -= cur_space.ghost_radius();
+		temp_bound.min.z -= cur_space.ghost_radius();
+		temp_bound.max.x += cur_space.ghost_radius();
+		temp_bound.max.z += cur_space.ghost_radius();
+		for (auto one_cell : cur_space.query_intersect_leafs(temp_bound))
+		{
+			entity_load temp_entity_load;
+			temp_entity_load.name = std::to_string(i);
+			temp_entity_load.pos = one_point;
+			if (one_cell == cur_real_cell)
+			{
+				temp_entity_load.is_real = true;
+				temp_entity_load.load = 1.0f;
+			}
+			else
+			{
+				temp_entity_load.is_real = false;
+				temp_entity_load.load = 0.2f;
+				out_ghost_stat.total_ghost_num++;
+				if (cur_real_cell && cur_real_cell->game_id() != one_cell->game_id())
+				{
+					out_ghost_stat.cross_game_ghost_num++;
+				}
+			}
+			cell_entity_loads[one_cell->space_id()].push_back(temp_entity_load);
+		}
+	}
+	std::unordered_map<std::string, float> game_loads;
+	for (const auto& [one_space_id, one_cell] : cur_space.all_leafs())
+	{
+		if (!one_cell->is_leaf_cell())
+		{
+			continue;
+		}
+		float total_load = 4.0f;
+		const auto& cur_entity_loads = cell_entity_loads[one_space_id];
+		for (const auto& one_entity_load : cur_entity_loads)
+		{
+			total_load += one_entity_load.load;
+		}
+		cur_space.update_cell_load(one_space_id, total_load, cur_entity_loads);
+		game_loads[one_cell->game_id()] += total_load;
+	}
+	return game_loads;
+}
+
+std::string choose_game(game_choose_strategy strategy, const space_cells& cur_space, const space_cells::space_node* split_node, cell_split_direction split_direction, const std::unordered_map<std::string, float>& game_loads, const game_assign_param& assign_param)
+{
+	if (strategy == game_choose_strategy::assign_optimizer)
+	{
+		return cur_space.choose_game_for_new_cell(split_node->space_id(), split_direction, game_loads, assign_param);
+	}
+	std::unordered_set<std::string> used_games;
+	if (strategy == game_choose_strategy::min_load_unused_game)
+	{
+		for (const auto& [one_cell_id, one_cell_ptr] : cur_space.all_leafs())
+		{
+			used_games.insert(one_cell_ptr->game_id());
+		}
+	}
+	used_games.insert(split_node->game_id());
+	std::string best_game;
+	float best_load = 0;
+	for (const auto& [one_game_id, one_load] : game_loads)
+	{
+		if (used_games.count(one_game_id))
+		{
+			continue;
+		}
+		auto cur_load = one_load / cur_space.game_capacity(one_game_id);
+		if (best_game.empty() || cur_load < best_load || (cur_load == best_load && one_game_id < best_game))
+		{
+			best_load = cur_load;
+			best_game = one_game_id;
+		}
+	}
+	return best_game;
+}
+
+void run_scenario(const benchmark_scenario& scenario, game_choose_strategy strategy)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 20000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 20000;
+	cell_load_balance_param cur_lb_param;
+	cur_lb_param.load_to_offset = 10;
+	cur_lb_param.max_cell_load_when_remove = 6;
+	cur_lb_param.min_cell_load_report_counter_when_remove = 10;
+	cur_lb_param.min_cell_load_report_counter_when_shrink = 2;
+	cur_lb_param.min_cell_load_report_counter_when_split = 2;
+	cur_lb_param.min_cell_load_when_shrink = 20;
+	cur_lb_param.min_cell_load_when_split = 200;
+	cur_lb_param.min_game_load_when_split = 300;
+	cur_lb_param.min_sibling_game_load_diff_when_shrink = 20;
+
+	game_assign_param cur_assign_param;
+	float total_capacity = 0;
+	for (auto one_capacity : scenario.game_capacities)
+	{
+		total_capacity += one_capacity;
+	}
+	// 允许game的负载比例达到平均值的三倍 否则最开始的几次切分就找不到game
+	cur_assign_param.max_game_load_per_capacity = 1.2f * scenario.entity_num / total_capacity * 3.0f;
+	cur_assign_param.adjacent_game_weight = 0.5f;
+
+	std::string root_space_id = "space0";
+	space_cells cur_space(temp_bound, "game0", root_space_id, 400);
+	cur_space.set_ready(root_space_id);
+	for (std::uint32_t i = 0; i < scenario.game_capacities.size(); i++)
+	{
+		cur_space.set_game_capacity("game" + std::to_string(i), scenario.game_capacities[i]);
+	}
+	auto entity_poses = generate_hotspot_points(temp_bound, scenario);
+	ghost_stat cur_ghost_stat;
+	std::uint32_t split_counter = 0;
+	float peak_game_load = 0;
+	for (std::uint32_t i = 0; i < 60; i++)
+	{
+		auto cur_game_loads = update_entity_loads(cur_space, entity_poses, cur_ghost_stat);
+		for (std::uint32_t j = 0; j < scenario.game_capacities.size(); j++)
+		{
+			// 空闲的game也需要出现在负载表中 否则无法被选中
+			cur_game_loads.emplace("game" + std::to_string(j), 0.0f);
+		}
+		peak_game_load = 0;
+		for (const auto& [one_game_id, one_load] : cur_game_loads)
+		{
+			peak_game_load = std::max(peak_game_load, one_load / cur_space.game_capacity(one_game_id));
+		}
+		cur_space.update_load_stat(cur_game_loads);
+		auto cur_split_node = cur_space.get_best_cell_to_split(cur_game_loads, cur_lb_param);
+		if (!cur_split_node)
+		{
+			continue;
+		}
+		auto cur_split_direction = cur_split_node->calc_best_split_direction(cur_space.ghost_radius());
+		auto cur_best_game = choose_game(strategy, cur_space, cur_split_node, cur_split_direction, cur_game_loads, cur_assign_param);
+		if (cur_best_game.empty())
+		{
+			continue;
+		}
+		auto new_space_id = "space" + std::to_string(++split_counter);
+		if (cur_space.split_at_direction(cur_split_node->space_id(), cur_split_direction, new_space_id, cur_best_game))
+		{
+			cur_space.set_ready(new_space_id);
+		}
+	}
+	std::unordered_set<std::string> used_games;
+	for (const auto& [one_cell_id, one_cell_ptr] : cur_space.all_leafs())
+	{
+		used_games.insert(one_cell_ptr->game_id());
+	}
+	std::cout << scenario.name << "\t" << strategy_name(strategy) << "\tcells " << cur_space.all_leafs().size() << "\tused_games " << used_games.size() << "\ttotal_ghost " << cur_ghost_stat.total_ghost_num << "\tcross_game_ghost " << cur_ghost_stat.cross_game_ghost_num << "\tpeak_game_load_per_capacity " << peak_game_load << std::endl;
+}
+
+int main()
+{
+	std::vector<benchmark_scenario> scenarios;
+	scenarios.push_back(benchmark_scenario{ "uniform_capacity", std::vector<float>(8, 1.0f), 4000, 4, 1 });
+	scenarios.push_back(benchmark_scenario{ "mixed_capacity", {1.0f, 1.0f, 4.0f, 1.0f, 4.0f, 1.0f, 1.0f, 4.0f}, 4000, 4, 2 });
+	scenarios.push_back(benchmark_scenario{ "many_games", std::vector<float>(32, 1.0f), 8000, 8, 3 });
+	for (const auto& one_scenario : scenarios)
+	{
+		for (auto one_strategy : { game_choose_strategy::min_load_unused_game, game_choose_strategy::min_load_game, game_choose_strategy::assign_optimizer })
+		{
+			run_scenario(one_scenario, one_strategy);
+		}
+	}
+	return 0;
+}
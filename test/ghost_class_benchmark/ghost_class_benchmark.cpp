@@ -0,0 +1,167 @@
+#include "ghost_engine.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+using namespace spiritsaway::distributed_space;
+
+// 小视野npc密集区域中 ghost_class与ghost_radius区域对切分与ghost数量的影响
+// 地图为2000*2000 全局ghost_radius为100 中间400*400的区域内有8000个视野为10的npc 全图另外有200个使用全局半径的boss
+// global: 所有entity都使用全局半径 也没有设置区域 npc区域最多只能切到边长400
+// class: npc使用ghost_class 1 半径为10 并且把npc区域的ghost_radius设置为10 区域内的cell最小边长为40
+// 每次选择负载最大并且还能切分的叶子 按照calc_best_split_direction切分 之后使用ghost_engine重新计算ghost并汇报负载
+// 每种配置输出一行json 同时检查逐个cell调用query_ghost_entities得到的ghost数量与ghost_engine相同
+
+std::vector<entity_load> make_entities(bool use_class)
+{
+	std::mt19937 e1(50);
+	std::uniform_real_distribution<double> npc_dist(800, 1200);
+	std::uniform_real_distribution<double> boss_dist(0, 2000);
+	std::vector<entity_load> result;
+	entity_load temp_load;
+	temp_load.load = 1;
+	temp_load.is_real = true;
+	for (int i = 0; i < 8000; i++)
+	{
+		temp_load.pos.x = npc_dist(e1);
+		temp_load.pos.z = npc_dist(e1);
+		temp_load.ghost_class = use_class ? 1 : 0;
+		result.push_back(temp_load);
+	}
+	for (int i = 0; i < 200; i++)
+	{
+		temp_load.pos.x = boss_dist(e1);
+		temp_load.pos.z = boss_dist(e1);
+		temp_load.ghost_class = 0;
+		result.push_back(temp_load);
+	}
+	return result;
+}
+
+void report_loads(space_cells& cur_space, const ghost_engine& cur_engine, const std::vector<entity_load>& entities, ghost_compute_result& result)
+{
+	cur_engine.compute(cur_space, entities, nullptr, result);
+	for (std::size_t i = 0; i < result.cells.size(); i++)
+	{
+		cur_space.update_cell_load(result.cells[i]->space_id(), result.cell_loads[i], result.cell_entity_loads[i]);
+	}
+}
+
+bool run_case(const char* name, bool use_class, std::uint32_t max_cell_num)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 2000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 2000;
+	space_cells cur_space(temp_bound, "game0", "cell0", 100);
+	cur_space.set_ready("cell0");
+	if (use_class)
+	{
+		cell_bound npc_bound;
+		npc_bound.min.x = 800;
+		npc_bound.max.x = 1200;
+		npc_bound.min.z = 800;
+		npc_bound.max.z = 1200;
+		cur_space.add_ghost_radius_region(npc_bound, 10);
+		cur_space.set_ghost_class_radius(1, 10);
+	}
+	auto entities = make_entities(use_class);
+	ghost_engine cur_engine(0.2f, ghost_shape::circle);
+	ghost_compute_result ghost_result;
+	report_loads(cur_space, cur_engine, entities, ghost_result);
+	std::uint32_t cell_counter = 0;
+	while (cur_space.all_leafs().size() < max_cell_num)
+	{
+		const space_cells::space_node* best_leaf = nullptr;
+		cell_split_direction best_direction = cell_split_direction::left_x;
+		for (const auto& one_pair : cur_space.all_leafs())
+		{
+			auto cur_leaf = one_pair.second;
+			if (best_leaf && cur_leaf->get_latest_load() <= best_leaf->get_latest_load())
+			{
+				continue;
+			}
+			auto cur_ghost_radius = cur_space.ghost_radius(cur_leaf);
+			auto cur_direction = cur_leaf->calc_best_split_direction(float(cur_ghost_radius));
+			auto axis = int(cur_direction) / 2;
+			const auto& cur_bound = cur_leaf->boundary();
+			if (cur_bound.max[axis] - cur_bound.min[axis] < 8 * cur_ghost_radius)
+			{
+				continue;
+			}
+			best_leaf = cur_leaf;
+			best_direction = cur_direction;
+		}
+		if (!best_leaf)
+		{
+			break;
+		}
+		cell_counter++;
+		auto new_cell_id = "cell" + std::to_string(cell_counter);
+		if (!cur_space.split_at_direction(best_leaf->space_id(), best_direction, new_cell_id, "game" + std::to_string(cell_counter)))
+		{
+			break;
+		}
+		cur_space.set_ready(new_cell_id);
+		report_loads(cur_space, cur_engine, entities, ghost_result);
+	}
+
+	// 每个cell用自己的real entity批量查询ghost
+	std::vector<std::vector<entity_load>> cell_entities(ghost_result.cells.size());
+	for (std::size_t i = 0; i < entities.size(); i++)
+	{
+		cell_entities[ghost_result.real_cell_idxes[i]].push_back(entities[i]);
+	}
+	std::vector<space_cells::leaf_ghost_entities> temp_ghosts;
+	std::uint32_t batch_ghost_num = 0;
+	auto batch_ms = measure_ms([&]()
+		{
+			for (std::size_t i = 0; i < ghost_result.cells.size(); i++)
+			{
+				cur_space.query_ghost_entities(ghost_result.cells[i]->space_id(), cell_entities[i], temp_ghosts);
+				for (const auto& one_ghost : temp_ghosts)
+				{
+					batch_ghost_num += std::uint32_t(one_ghost.entity_indexes.size());
+				}
+			}
+		});
+	auto engine_ms = measure_ms([&]()
+		{
+			cur_engine.compute(cur_space, entities, nullptr, ghost_result);
+		});
+
+	float max_cell_load = 0;
+	double min_cell_length = temp_bound.max.x;
+	for (const auto& one_pair : cur_space.all_leafs())
+	{
+		const auto& cur_bound = one_pair.second->boundary();
+		max_cell_load = std::max(max_cell_load, one_pair.second->get_latest_load());
+		min_cell_length = std::min({ min_cell_length, cur_bound.max.x - cur_bound.min.x, cur_bound.max.z - cur_bound.min.z });
+	}
+	bool is_same = batch_ghost_num == ghost_result.ghost_num();
+	json cur_result;
+	cur_result["config"] = name;
+	cur_result["entities"] = entities.size();
+	cur_result["cells"] = cur_space.all_leafs().size();
+	cur_result["max_cell_load"] = max_cell_load;
+	cur_result["min_cell_length"] = min_cell_length;
+	cur_result["ghosts"] = ghost_result.ghost_num();
+	cur_result["engine_ms"] = engine_ms;
+	cur_result["batch_ms"] = batch_ms;
+	cur_result["same_result"] = is_same;
+	std::cout << cur_result.dump() << std::endl;
+	return is_same;
+}
+
+int main()
+{
+	bool all_same = true;
+	for (std::uint32_t max_cell_num : { 16, 64 })
+	{
+		all_same = run_case("global", false, max_cell_num) && all_same;
+		all_same = run_case("class", true, max_cell_num) && all_same;
+	}
+	return all_same ? 0 : 1;
+}
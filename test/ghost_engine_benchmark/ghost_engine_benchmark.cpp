@@ -0,0 +1,159 @@
+#include "ghost_engine.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+using namespace spiritsaway::distributed_space;
+
+// ghost_engine与逐个entity逐个cell做相交测试的对比
+// 每一项结果以一行json输出 同时检查ghost_engine在串行与并行时的结果都与逐个测试的结果相同
+// 逐个测试的耗时为O(entity数量 * cell数量) 超过max_naive_tests时跳过
+// 用法: ghost_engine_benchmark [thread_num] 默认使用std::thread::hardware_concurrency()个线程
+
+const std::uint64_t max_naive_tests = 2000000000;
+
+// 每个entity与每个叶子逐个测试 cell下标与cells一致
+void naive_compute(const std::vector<const space_cells::space_node*>& cells, const std::vector<entity_load>& entities, double ghost_radius, std::vector<std::uint32_t>& real_cell_idxes, std::vector<std::vector<std::uint32_t>>& ghost_cell_idxes)
+{
+	real_cell_idxes.assign(entities.size(), ghost_compute_result::invalid_cell_idx);
+	ghost_cell_idxes.assign(entities.size(), {});
+	for (std::size_t i = 0; i < entities.size(); i++)
+	{
+		const auto& cur_pos = entities[i].pos;
+		cell_bound ghost_bound;
+		ghost_bound.min.x = cur_pos.x - ghost_radius;
+		ghost_bound.min.z = cur_pos.z - ghost_radius;
+		ghost_bound.max.x = cur_pos.x + ghost_radius;
+		ghost_bound.max.z = cur_pos.z + ghost_radius;
+		for (std::uint32_t j = 0; j < cells.size(); j++)
+		{
+			const auto& cur_bound = cells[j]->boundary();
+			if (cur_bound.cover(cur_pos.x, cur_pos.z))
+			{
+				real_cell_idxes[i] = j;
+			}
+			else if (cur_bound.intersect(ghost_bound))
+			{
+				ghost_cell_idxes[i].push_back(j);
+			}
+		}
+	}
+}
+
+bool same_result(const ghost_compute_result& result, const std::vector<std::uint32_t>& real_cell_idxes, const std::vector<std::vector<std::uint32_t>>& ghost_cell_idxes)
+{
+	if (result.real_cell_idxes != real_cell_idxes)
+	{
+		return false;
+	}
+	for (std::size_t i = 0; i < real_cell_idxes.size(); i++)
+	{
+		std::vector<std::uint32_t> cur_ghosts(result.ghost_cell_idxes.begin() + result.ghost_begins[i], result.ghost_cell_idxes.begin() + result.ghost_begins[i + 1]);
+		std::sort(cur_ghosts.begin(), cur_ghosts.end());
+		if (cur_ghosts != ghost_cell_idxes[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool same_result(const ghost_compute_result& a, const ghost_compute_result& b)
+{
+	if (a.real_cell_idxes != b.real_cell_idxes || a.ghost_begins != b.ghost_begins || a.ghost_cell_idxes != b.ghost_cell_idxes || a.cell_loads != b.cell_loads)
+	{
+		return false;
+	}
+	for (std::size_t i = 0; i < a.cell_entity_loads.size(); i++)
+	{
+		if (a.cell_entity_loads[i].size() != b.cell_entity_loads[i].size())
+		{
+			return false;
+		}
+		for (std::size_t j = 0; j < a.cell_entity_loads[i].size(); j++)
+		{
+			const auto& load_a = a.cell_entity_loads[i][j];
+			const auto& load_b = b.cell_entity_loads[i][j];
+			if (load_a.pos.x != load_b.pos.x || load_a.pos.z != load_b.pos.z || load_a.load != load_b.load || load_a.is_real != load_b.is_real)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool run_case(std::uint32_t leaf_num, std::uint32_t entity_num, thread_pool& pool)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 100000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 100000;
+	double ghost_radius = 100;
+	space_cells cur_space(temp_bound, "game0", "cell0", ghost_radius);
+	cur_space.set_ready("cell0");
+	std::uint32_t cell_counter = 0;
+	split_balanced(cur_space, "cell0", temp_bound, leaf_num, cell_counter);
+
+	std::mt19937 e1(leaf_num * 7 + entity_num);
+	std::uniform_real_distribution<double> pos_dist(0, 100000);
+	std::vector<entity_load> entities(entity_num);
+	for (auto& one_entity : entities)
+	{
+		one_entity.pos.x = pos_dist(e1);
+		one_entity.pos.z = pos_dist(e1);
+		one_entity.load = 1;
+		one_entity.is_real = true;
+	}
+	ghost_engine cur_engine(0.2f);
+	ghost_compute_result serial_result;
+	ghost_compute_result parallel_result;
+	auto serial_ms = measure_ms([&]()
+		{
+			cur_engine.compute(cur_space, entities, nullptr, serial_result);
+		});
+	auto parallel_ms = measure_ms([&]()
+		{
+			cur_engine.compute(cur_space, entities, &pool, parallel_result);
+		});
+	bool is_same = same_result(serial_result, parallel_result);
+	json cur_result;
+	cur_result["leafs"] = leaf_num;
+	cur_result["entities"] = entity_num;
+	cur_result["ghosts"] = serial_result.ghost_num();
+	cur_result["engine_serial_ms"] = serial_ms;
+	cur_result["engine_parallel_ms"] = parallel_ms;
+	cur_result["thread_num"] = pool.thread_num();
+	if (std::uint64_t(leaf_num) * entity_num <= max_naive_tests)
+	{
+		std::vector<std::uint32_t> naive_real_cell_idxes;
+		std::vector<std::vector<std::uint32_t>> naive_ghost_cell_idxes;
+		auto naive_ms = measure_ms([&]()
+			{
+				naive_compute(serial_result.cells, entities, ghost_radius, naive_real_cell_idxes, naive_ghost_cell_idxes);
+			});
+		cur_result["naive_ms"] = naive_ms;
+		cur_result["speedup"] = naive_ms / serial_ms;
+		is_same = is_same && same_result(serial_result, naive_real_cell_idxes, naive_ghost_cell_idxes);
+	}
+	cur_result["same_result"] = is_same;
+	std::cout << cur_result.dump() << std::endl;
+	return is_same;
+}
+
+int main(int argc, const char** argv)
+{
+	std::uint32_t thread_num = argc > 1 ? std::uint32_t(std::stoul(argv[1])) : std::max(1u, std::thread::hardware_concurrency());
+	thread_pool cur_pool(thread_num);
+	bool all_same = true;
+	for (std::uint32_t leaf_num : { 16, 256, 1024, 4096 })
+	{
+		for (std::uint32_t entity_num : { 10000, 100000, 1000000 })
+		{
+			all_same = run_case(leaf_num, entity_num, cur_pool) && all_same;
+		}
+	}
+	return all_same ? 0 : 1;
+}
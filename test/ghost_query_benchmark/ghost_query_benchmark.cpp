@@ -0,0 +1,210 @@
+#include "ghost_engine.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+using namespace spiritsaway::distributed_space;
+
+// 正方形ghost区域与圆形ghost区域的对比
+// square与circle分别为ghost_engine使用两种ghost_shape时的ghost数量与耗时
+// corner为entity在cell的两个坐标轴上都在区域之外的ghost 即只与cell角落相交的部分 正方形多出来的ghost都在这里
+// point_query为逐个entity调用query_leafs_in_radius batch为每个cell对自己的real entity调用query_ghost_entities
+// float_batch为float坐标的space_cells上的batch 只输出耗时与数量 不参与结果检查
+// 每一项结果以一行json输出 同时检查point_query与batch的结果都与circle相同
+
+// entity与cell在两个坐标轴上都不重叠
+bool is_corner_ghost(const cell_bound& bound, const point_xz& pos)
+{
+	return (pos.x < bound.min.x || pos.x > bound.max.x) && (pos.z < bound.min.z || pos.z > bound.max.z);
+}
+
+std::uint32_t count_corner_ghosts(const ghost_compute_result& result, const std::vector<entity_load>& entities)
+{
+	std::uint32_t corner_num = 0;
+	for (std::size_t i = 0; i < entities.size(); i++)
+	{
+		for (auto j = result.ghost_begins[i]; j < result.ghost_begins[i + 1]; j++)
+		{
+			corner_num += is_corner_ghost(result.cells[result.ghost_cell_idxes[j]]->boundary(), entities[i].pos) ? 1 : 0;
+		}
+	}
+	return corner_num;
+}
+
+// 每个entity排好序的ghost cell id
+std::vector<std::vector<std::string>> collect_ghost_ids(const ghost_compute_result& result, std::size_t entity_num)
+{
+	std::vector<std::vector<std::string>> ghost_ids(entity_num);
+	for (std::size_t i = 0; i < entity_num; i++)
+	{
+		for (auto j = result.ghost_begins[i]; j < result.ghost_begins[i + 1]; j++)
+		{
+			ghost_ids[i].push_back(result.cells[result.ghost_cell_idxes[j]]->space_id());
+		}
+		std::sort(ghost_ids[i].begin(), ghost_ids[i].end());
+	}
+	return ghost_ids;
+}
+
+bool run_case(std::uint32_t leaf_num, std::uint32_t entity_num, double ghost_radius)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 10000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 10000;
+	space_cells cur_space(temp_bound, "game0", "cell0", ghost_radius);
+	cur_space.set_ready("cell0");
+	std::uint32_t cell_counter = 0;
+	split_balanced(cur_space, "cell0", temp_bound, leaf_num, cell_counter);
+
+	std::mt19937 e1(leaf_num * 7 + entity_num);
+	std::uniform_real_distribution<double> pos_dist(0, 10000);
+	std::vector<entity_load> entities(entity_num);
+	for (auto& one_entity : entities)
+	{
+		one_entity.pos.x = pos_dist(e1);
+		one_entity.pos.z = pos_dist(e1);
+		one_entity.load = 1;
+		one_entity.is_real = true;
+	}
+
+	ghost_engine square_engine(0.2f, ghost_shape::square);
+	ghost_engine circle_engine(0.2f, ghost_shape::circle);
+	ghost_compute_result square_result;
+	ghost_compute_result circle_result;
+	auto square_ms = measure_ms([&]()
+		{
+			square_engine.compute(cur_space, entities, nullptr, square_result);
+		});
+	auto circle_ms = measure_ms([&]()
+		{
+			circle_engine.compute(cur_space, entities, nullptr, circle_result);
+		});
+	auto circle_ghost_ids = collect_ghost_ids(circle_result, entity_num);
+
+	// 逐个entity查询 排除自己所在的real cell
+	std::vector<std::vector<std::string>> point_ghost_ids(entity_num);
+	auto point_query_ms = measure_ms([&]()
+		{
+			for (std::uint32_t i = 0; i < entity_num; i++)
+			{
+				auto cur_real = circle_result.cells[circle_result.real_cell_idxes[i]];
+				for (auto one_leaf : cur_space.query_leafs_in_radius(entities[i].pos, ghost_radius))
+				{
+					if (one_leaf != cur_real)
+					{
+						point_ghost_ids[i].push_back(one_leaf->space_id());
+					}
+				}
+			}
+		});
+	for (auto& one_ids : point_ghost_ids)
+	{
+		std::sort(one_ids.begin(), one_ids.end());
+	}
+
+	// 按照real cell分组之后每个cell批量查询
+	std::vector<std::vector<entity_load>> cell_entities(circle_result.cells.size());
+	std::vector<std::vector<std::uint32_t>> cell_entity_idxes(circle_result.cells.size());
+	for (std::uint32_t i = 0; i < entity_num; i++)
+	{
+		auto cur_real_idx = circle_result.real_cell_idxes[i];
+		cell_entities[cur_real_idx].push_back(entities[i]);
+		cell_entity_idxes[cur_real_idx].push_back(i);
+	}
+	std::vector<std::vector<std::string>> batch_ghost_ids(entity_num);
+	std::vector<space_cells::leaf_ghost_entities> temp_ghosts;
+	std::uint32_t batch_ghost_num = 0;
+	double batch_ms = 0;
+	for (std::size_t i = 0; i < circle_result.cells.size(); i++)
+	{
+		batch_ms += measure_ms([&]()
+			{
+				cur_space.query_ghost_entities(circle_result.cells[i]->space_id(), cell_entities[i], ghost_radius, temp_ghosts);
+			});
+		for (const auto& one_ghost : temp_ghosts)
+		{
+			batch_ghost_num += std::uint32_t(one_ghost.entity_indexes.size());
+			for (auto one_idx : one_ghost.entity_indexes)
+			{
+				batch_ghost_ids[cell_entity_idxes[i][one_idx]].push_back(one_ghost.leaf->space_id());
+			}
+		}
+	}
+	for (auto& one_ids : batch_ghost_ids)
+	{
+		std::sort(one_ids.begin(), one_ids.end());
+	}
+
+	// 同样的切分与entity 使用float坐标
+	basic_space_cells<float> float_space(temp_bound.cast<float>(), "game0", "cell0", ghost_radius);
+	float_space.set_ready("cell0");
+	cell_counter = 0;
+	split_balanced(float_space, "cell0", temp_bound.cast<float>(), leaf_num, cell_counter);
+	std::vector<std::vector<basic_entity_load<float>>> float_cell_entities(cell_entities.size());
+	for (std::size_t i = 0; i < cell_entities.size(); i++)
+	{
+		for (const auto& one_entity : cell_entities[i])
+		{
+			basic_entity_load<float> cur_load;
+			cur_load.pos.x = float(one_entity.pos.x);
+			cur_load.pos.z = float(one_entity.pos.z);
+			cur_load.load = one_entity.load;
+			cur_load.is_real = true;
+			float_cell_entities[i].push_back(cur_load);
+		}
+	}
+	std::vector<basic_space_cells<float>::leaf_ghost_entities> float_ghosts;
+	std::uint32_t float_batch_ghost_num = 0;
+	double float_batch_ms = 0;
+	for (std::size_t i = 0; i < circle_result.cells.size(); i++)
+	{
+		float_batch_ms += measure_ms([&]()
+			{
+				float_space.query_ghost_entities(circle_result.cells[i]->space_id(), float_cell_entities[i], ghost_radius, float_ghosts);
+			});
+		for (const auto& one_ghost : float_ghosts)
+		{
+			float_batch_ghost_num += std::uint32_t(one_ghost.entity_indexes.size());
+		}
+	}
+
+	auto square_corner_num = count_corner_ghosts(square_result, entities);
+	auto circle_corner_num = count_corner_ghosts(circle_result, entities);
+	bool is_same = point_ghost_ids == circle_ghost_ids && batch_ghost_ids == circle_ghost_ids;
+	json cur_result;
+	cur_result["leafs"] = leaf_num;
+	cur_result["entities"] = entity_num;
+	cur_result["ghost_radius"] = ghost_radius;
+	cur_result["square_ghosts"] = square_result.ghost_num();
+	cur_result["circle_ghosts"] = circle_result.ghost_num();
+	cur_result["ghost_reduction"] = 1.0 - double(circle_result.ghost_num()) / std::max(1u, square_result.ghost_num());
+	cur_result["square_corner_ghosts"] = square_corner_num;
+	cur_result["circle_corner_ghosts"] = circle_corner_num;
+	cur_result["corner_reduction"] = 1.0 - double(circle_corner_num) / std::max(1u, square_corner_num);
+	cur_result["square_ms"] = square_ms;
+	cur_result["circle_ms"] = circle_ms;
+	cur_result["point_query_ms"] = point_query_ms;
+	cur_result["batch_ms"] = batch_ms;
+	cur_result["batch_ghosts"] = batch_ghost_num;
+	cur_result["float_batch_ms"] = float_batch_ms;
+	cur_result["float_batch_ghosts"] = float_batch_ghost_num;
+	cur_result["same_result"] = is_same;
+	std::cout << cur_result.dump() << std::endl;
+	return is_same;
+}
+
+int main()
+{
+	bool all_same = true;
+	for (std::uint32_t leaf_num : { 64, 1024 })
+	{
+		for (double ghost_radius : { 25.0, 100.0 })
+		{
+			all_same = run_case(leaf_num, 200000, ghost_radius) && all_same;
+		}
+	}
+	return all_same ? 0 : 1;
+}
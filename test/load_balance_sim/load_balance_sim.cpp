@@ -0,0 +1,223 @@
+#include "sim_world.h"
+#include "space_topology.h"
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#ifdef WITH_SPACE_DRAW
+#include "../space_draw/space_draw.h"
+#endif
+
+using namespace spiritsaway::distributed_space;
+
+// 无界面的负载均衡模拟
+// 用法: load_balance_sim scenario.json [output_dir] [draw_config.json]
+// 没有output_dir时 每个tick的统计信息以json行的格式输出到标准输出
+// 有output_dir时 统计信息输出到output_dir/metrics.jsonl snapshot_ticks对应的space_cells::encode输出到output_dir/tick_{n}.json
+// 同时把prometheus格式的space_metrics输出到output_dir/tick_{n}.prom 结束时的space_metrics会放在汇总信息中
+// 场景开启write_journal时 space_cells上的所有修改记录在output_dir/journal.bin 可以使用space_journal_replay回放到任意tick
+// 场景开启check_topology_delta时 每个tick把拓扑增量同步给一个副本 汇总信息中的topology_delta对比增量与每次发送encode结果的大小
+// 每个tick的alloc_num为全局分配器的申请次数 space_alloc_num为其中汇报负载与负载均衡操作的部分 汇总信息中为每个tick的平均值
+// 只有在构建时找到了space_draw依赖并且提供了draw_config时 才会在snapshot_ticks绘制png
+
+// 以完整拓扑的记录作为比较的依据 两个拓扑相同时记录也相同
+json topology_records(const space_cells& cur_space)
+{
+	space_topology_encoder temp_encoder;
+	json temp_delta;
+	temp_encoder.make_delta(cur_space, temp_delta);
+	return temp_delta["records"];
+}
+
+json load_json(const std::string& file_path)
+{
+	std::ifstream ifs(file_path);
+	if (!ifs)
+	{
+		return {};
+	}
+	return json::parse(ifs, nullptr, false);
+}
+
+int main(int argc, const char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "usage: load_balance_sim scenario.json [output_dir] [draw_config.json]" << std::endl;
+		return 1;
+	}
+	auto scenario_json = load_json(argv[1]);
+	sim_scenario cur_scenario;
+	if (scenario_json.is_discarded() || !cur_scenario.decode(scenario_json))
+	{
+		std::cout << "fail to load scenario from " << argv[1] << std::endl;
+		return 1;
+	}
+	std::string output_dir;
+	std::ofstream metrics_ofs;
+	if (argc >= 3)
+	{
+		output_dir = argv[2];
+		std::filesystem::create_directories(output_dir);
+		metrics_ofs.open(output_dir + "/metrics.jsonl");
+	}
+	std::ostream& metrics_os = metrics_ofs.is_open() ? static_cast<std::ostream&>(metrics_ofs) : std::cout;
+#ifdef WITH_SPACE_DRAW
+	bool with_draw = false;
+	space_draw_config cur_draw_config;
+	if (argc >= 4 && !output_dir.empty())
+	{
+		auto draw_config_json = load_json(argv[3]);
+		try
+		{
+			draw_config_json.get_to(cur_draw_config);
+			with_draw = true;
+		}
+		catch (std::exception& e)
+		{
+			std::cout << "fail to decode space_draw_config from " << argv[3] << " exception " << e.what() << std::endl;
+			return 1;
+		}
+	}
+#endif
+
+	std::ofstream journal_ofs;
+	std::unique_ptr<space_journal_writer> cur_journal;
+	if (!output_dir.empty() && cur_scenario.write_journal)
+	{
+		journal_ofs.open(output_dir + "/journal.bin", std::ios::binary | std::ios::trunc);
+		cur_journal = std::make_unique<space_journal_writer>(journal_ofs);
+	}
+	sim_world cur_world(cur_scenario, cur_journal.get());
+	auto begin_ts = std::chrono::steady_clock::now();
+	float max_game_utilization = 0;
+	float peak_cell_load = 0;
+	std::unordered_map<std::string, std::uint32_t> op_counts;
+	// 最大cell负载连续超过overload_cell_load的一段tick记为一次过载 过载持续的tick数即为负载均衡的反应时间
+	std::uint32_t overload_ticks = 0;
+	std::vector<std::uint32_t> reaction_ticks;
+	std::uint32_t cur_overload_begin = 0;
+	bool is_overloaded = false;
+	std::uint64_t total_alloc_num = 0;
+	std::uint64_t total_space_alloc_num = 0;
+	space_topology_encoder topology_encoder;
+	space_topology_replica topology_replica;
+	json topology_stat;
+	std::uint64_t delta_num = 0;
+	std::uint64_t dropped_delta_num = 0;
+	std::uint64_t resync_num = 0;
+	std::uint64_t delta_bytes = 0;
+	std::uint64_t resync_bytes = 0;
+	std::uint64_t full_encode_bytes = 0;
+	std::uint32_t topology_mismatch_ticks = 0;
+	for (std::uint32_t i = 0; i < cur_scenario.ticks; i++)
+	{
+		auto cur_metrics = cur_world.step();
+		json cur_delta;
+		if (cur_scenario.check_topology_delta && topology_encoder.make_delta(cur_world.space(), cur_delta))
+		{
+			delta_num++;
+			delta_bytes += json::to_msgpack(cur_delta).size();
+			full_encode_bytes += json::to_msgpack(cur_world.space().encode()).size();
+			auto drop_interval = cur_scenario.topology_delta_drop_interval;
+			if (drop_interval && delta_num % drop_interval == 0)
+			{
+				dropped_delta_num++;
+			}
+			else if (topology_replica.apply(cur_delta) != space_topology_apply_result::ok)
+			{
+				auto cur_full = topology_encoder.make_full();
+				resync_num++;
+				resync_bytes += json::to_msgpack(cur_full).size();
+				topology_replica.apply(cur_full);
+			}
+		}
+		if (cur_scenario.check_topology_delta && (!topology_replica.space() || topology_records(*topology_replica.space()) != topology_records(cur_world.space())))
+		{
+			topology_mismatch_ticks++;
+		}
+		metrics_os << json(cur_metrics).dump() << "\n";
+		max_game_utilization = std::max(max_game_utilization, cur_metrics.max_game_utilization);
+		peak_cell_load = std::max(peak_cell_load, cur_metrics.max_cell_load);
+		op_counts[cur_metrics.op]++;
+		total_alloc_num += cur_metrics.alloc_num;
+		total_space_alloc_num += cur_metrics.space_alloc_num;
+		if (cur_metrics.max_cell_load > cur_scenario.overload_cell_load)
+		{
+			overload_ticks++;
+			if (!is_overloaded)
+			{
+				is_overloaded = true;
+				cur_overload_begin = cur_metrics.tick;
+			}
+		}
+		else if (is_overloaded)
+		{
+			is_overloaded = false;
+			reaction_ticks.push_back(cur_metrics.tick - cur_overload_begin);
+		}
+		if (output_dir.empty() || std::find(cur_scenario.snapshot_ticks.begin(), cur_scenario.snapshot_ticks.end(), cur_metrics.tick) == cur_scenario.snapshot_ticks.end())
+		{
+			continue;
+		}
+		std::ofstream snapshot_ofs(output_dir + "/tick_" + std::to_string(cur_metrics.tick) + ".json");
+		snapshot_ofs << cur_world.space().encode().dump();
+		std::ofstream prometheus_ofs(output_dir + "/tick_" + std::to_string(cur_metrics.tick) + ".prom");
+		prometheus_ofs << cur_world.latest_space_metrics().to_prometheus(cur_scenario.name);
+#ifdef WITH_SPACE_DRAW
+		if (with_draw)
+		{
+			draw_cell_region(cur_world.space(), cur_draw_config, output_dir, "tick_" + std::to_string(cur_metrics.tick));
+		}
+#endif
+	}
+	auto total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin_ts).count();
+	if (cur_journal)
+	{
+		cur_journal->flush();
+	}
+	json summary;
+	summary["scenario"] = cur_scenario.name;
+	summary["seed"] = cur_scenario.seed;
+	summary["ticks"] = cur_scenario.ticks;
+	summary["leaf_num"] = cur_world.space().all_leafs().size();
+	summary["operation_count"] = cur_world.controller().operation_count();
+	summary["oscillation_count"] = cur_world.controller().oscillation_count();
+	summary["total_migrated_num"] = cur_world.total_migrated_num();
+	summary["avg_migrated_per_tick"] = double(cur_world.total_migrated_num()) / cur_scenario.ticks;
+	summary["max_game_utilization"] = max_game_utilization;
+	summary["peak_cell_load"] = peak_cell_load;
+	op_counts.erase("nothing");
+	summary["op_counts"] = op_counts;
+	summary["overload_ticks"] = overload_ticks;
+	summary["overload_episodes"] = reaction_ticks.size() + (is_overloaded ? 1 : 0);
+	// 模拟结束时仍然过载的那一次不计入反应时间
+	summary["unresolved_overload"] = is_overloaded;
+	summary["max_reaction_ticks"] = reaction_ticks.empty() ? 0 : *std::max_element(reaction_ticks.begin(), reaction_ticks.end());
+	double total_reaction_ticks = 0;
+	for (auto one_reaction_ticks : reaction_ticks)
+	{
+		total_reaction_ticks += one_reaction_ticks;
+	}
+	summary["avg_reaction_ticks"] = reaction_ticks.empty() ? 0 : total_reaction_ticks / reaction_ticks.size();
+	summary["avg_alloc_per_tick"] = double(total_alloc_num) / cur_scenario.ticks;
+	summary["avg_space_alloc_per_tick"] = double(total_space_alloc_num) / cur_scenario.ticks;
+	summary["space_metrics"] = cur_world.latest_space_metrics().encode();
+	if (cur_scenario.check_topology_delta)
+	{
+		// 丢弃增量之后 副本在下一个增量到达之前与原来不一致 这些tick也会计入mismatch_ticks
+		topology_stat["version"] = topology_encoder.version();
+		topology_stat["delta_num"] = delta_num;
+		topology_stat["dropped_delta_num"] = dropped_delta_num;
+		topology_stat["resync_num"] = resync_num;
+		topology_stat["delta_bytes"] = delta_bytes;
+		topology_stat["resync_bytes"] = resync_bytes;
+		topology_stat["full_encode_bytes"] = full_encode_bytes;
+		topology_stat["mismatch_ticks"] = topology_mismatch_ticks;
+		summary["topology_delta"] = topology_stat;
+	}
+	summary["total_ms"] = total_ms;
+	std::cerr << summary.dump() << std::endl;
+	return 0;
+}
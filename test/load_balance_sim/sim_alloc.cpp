@@ -0,0 +1,38 @@
+#include "sim_alloc.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<std::uint64_t> g_alloc_count{ 0 };
+}
+
+namespace spiritsaway::distributed_space
+{
+	std::uint64_t sim_alloc_count()
+	{
+		return g_alloc_count.load(std::memory_order_relaxed);
+	}
+}
+
+// 数组与nothrow版本默认会转发到这里 对齐版本的申请不计入
+void* operator new(std::size_t size)
+{
+	g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+	if (auto result = std::malloc(size ? size : 1))
+	{
+		return result;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
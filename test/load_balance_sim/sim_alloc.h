@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+
+namespace spiritsaway::distributed_space
+{
+	// 替换了全局的operator new 统计进程内通过全局分配器申请内存的次数 包括线程池中的申请
+	// 用来对比一段逻辑前后的差值 得到这段逻辑中申请内存的次数
+	std::uint64_t sim_alloc_count();
+}
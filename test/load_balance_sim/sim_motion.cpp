@@ -0,0 +1,210 @@
+#include "sim_motion.h"
+#include <algorithm>
+#include <cmath>
+
+namespace spiritsaway::distributed_space
+{
+	const double sim_pi = 3.14159265358979323846;
+
+	double sim_random::normal(double mean, double sigma)
+	{
+		if (m_has_cached_normal)
+		{
+			m_has_cached_normal = false;
+			return mean + sigma * m_cached_normal;
+		}
+		// 1 - uniform()在(0, 1]之间 避免log(0)
+		auto radius = std::sqrt(-2.0 * std::log(1.0 - uniform()));
+		auto angle = 2.0 * sim_pi * uniform();
+		m_cached_normal = radius * std::sin(angle);
+		m_has_cached_normal = true;
+		return mean + sigma * radius * std::cos(angle);
+	}
+
+	void sim_motion_model::random_direction(sim_entity& cur_entity, sim_random& random) const
+	{
+		auto cur_angle = random.uniform(0, 2 * sim_pi);
+		cur_entity.velocity.x = m_config.speed * std::cos(cur_angle);
+		cur_entity.velocity.z = m_config.speed * std::sin(cur_angle);
+	}
+
+	void sim_motion_model::on_spawn(sim_entity& cur_entity, sim_random& random)
+	{
+		random_direction(cur_entity, random);
+	}
+
+	void sim_motion_model::wander(sim_entity& cur_entity, sim_random& random) const
+	{
+		if (random.uniform() < m_config.turn_probability)
+		{
+			random_direction(cur_entity, random);
+		}
+		// 碰到边界时反弹
+		for (int i = 0; i < 2; i++)
+		{
+			auto new_pos = cur_entity.pos[i] + cur_entity.velocity[i];
+			if (new_pos < m_bound.min[i] || new_pos > m_bound.max[i])
+			{
+				cur_entity.velocity[i] = -cur_entity.velocity[i];
+				new_pos = std::clamp(cur_entity.pos[i] + cur_entity.velocity[i], m_bound.min[i], m_bound.max[i]);
+			}
+			cur_entity.pos[i] = new_pos;
+		}
+	}
+
+	bool sim_motion_model::move_toward(sim_entity& cur_entity, const point_xz& dest, double speed) const
+	{
+		auto diff_x = dest.x - cur_entity.pos.x;
+		auto diff_z = dest.z - cur_entity.pos.z;
+		auto cur_distance = std::sqrt(diff_x * diff_x + diff_z * diff_z);
+		if (cur_distance <= speed)
+		{
+			cur_entity.pos.x = std::clamp(dest.x, m_bound.min.x, m_bound.max.x);
+			cur_entity.pos.z = std::clamp(dest.z, m_bound.min.z, m_bound.max.z);
+			return true;
+		}
+		cur_entity.pos.x = std::clamp(cur_entity.pos.x + diff_x / cur_distance * speed, m_bound.min.x, m_bound.max.x);
+		cur_entity.pos.z = std::clamp(cur_entity.pos.z + diff_z / cur_distance * speed, m_bound.min.z, m_bound.max.z);
+		return false;
+	}
+
+	void static_motion_model::move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random)
+	{
+		(void)cur_entity;
+		(void)tick;
+		(void)random;
+	}
+
+	void random_walk_motion_model::move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random)
+	{
+		(void)tick;
+		wander(cur_entity, random);
+	}
+
+	gather_motion_model::gather_motion_model(const sim_motion& in_config, const cell_bound& in_bound)
+		: sim_motion_model(in_config, in_bound)
+	{
+		double total_weight = 0;
+		for (const auto& one_point : m_config.points)
+		{
+			total_weight += one_point.weight;
+			m_weight_prefix.push_back(total_weight);
+		}
+	}
+
+	void gather_motion_model::on_spawn(sim_entity& cur_entity, sim_random& random)
+	{
+		random_direction(cur_entity, random);
+		auto cur_weight = random.uniform(0, m_weight_prefix.back());
+		auto cur_iter = std::upper_bound(m_weight_prefix.begin(), m_weight_prefix.end(), cur_weight);
+		cur_entity.offset.x = double(std::min<std::size_t>(cur_iter - m_weight_prefix.begin(), m_weight_prefix.size() - 1));
+		cur_entity.offset.z = 0;
+	}
+
+	void gather_motion_model::move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random)
+	{
+		if (tick < m_config.start_tick)
+		{
+			wander(cur_entity, random);
+			return;
+		}
+		const auto& cur_center = m_config.points[std::size_t(cur_entity.offset.x)].center;
+		auto diff_x = cur_entity.pos.x - cur_center.x;
+		auto diff_z = cur_entity.pos.z - cur_center.z;
+		if (diff_x * diff_x + diff_z * diff_z > m_config.radius * m_config.radius)
+		{
+			move_toward(cur_entity, cur_center, m_config.speed);
+			return;
+		}
+		// 到达之后在兴趣点附近闲逛 走出radius之后会在下一个tick重新朝兴趣点移动
+		wander(cur_entity, random);
+	}
+
+	herd_motion_model::herd_motion_model(const sim_motion& in_config, const cell_bound& in_bound)
+		: sim_motion_model(in_config, in_bound)
+		, m_herd_center(in_config.waypoints[0])
+		, m_next_waypoint(in_config.waypoints.size() > 1 ? 1 : 0)
+	{
+
+	}
+
+	void herd_motion_model::on_spawn(sim_entity& cur_entity, sim_random& random)
+	{
+		random_direction(cur_entity, random);
+		cur_entity.offset.x = random.normal(0, m_config.radius);
+		cur_entity.offset.z = random.normal(0, m_config.radius);
+	}
+
+	void herd_motion_model::on_tick(std::uint32_t tick, sim_random& random)
+	{
+		(void)random;
+		if (tick < m_config.start_tick)
+		{
+			return;
+		}
+		// 兽群中心沿着waypoints循环移动 一个tick内可能经过多个路点
+		auto left_distance = m_config.herd_speed;
+		while (left_distance > 0 && m_config.waypoints.size() > 1)
+		{
+			const auto& cur_dest = m_config.waypoints[m_next_waypoint];
+			auto diff_x = cur_dest.x - m_herd_center.x;
+			auto diff_z = cur_dest.z - m_herd_center.z;
+			auto cur_distance = std::sqrt(diff_x * diff_x + diff_z * diff_z);
+			if (cur_distance > left_distance)
+			{
+				m_herd_center.x += diff_x / cur_distance * left_distance;
+				m_herd_center.z += diff_z / cur_distance * left_distance;
+				break;
+			}
+			m_herd_center = cur_dest;
+			left_distance -= cur_distance;
+			m_next_waypoint = (m_next_waypoint + 1) % m_config.waypoints.size();
+		}
+	}
+
+	void herd_motion_model::move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random)
+	{
+		(void)tick;
+		(void)random;
+		point_xz cur_dest;
+		cur_dest.x = m_herd_center.x + cur_entity.offset.x;
+		cur_dest.z = m_herd_center.z + cur_entity.offset.z;
+		move_toward(cur_entity, cur_dest, m_config.speed);
+	}
+
+	void teleport_motion_model::move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random)
+	{
+		if (tick == m_config.start_tick)
+		{
+			cur_entity.pos.x = std::clamp(random.normal(m_config.center.x, m_config.radius), m_bound.min.x, m_bound.max.x);
+			cur_entity.pos.z = std::clamp(random.normal(m_config.center.z, m_config.radius), m_bound.min.z, m_bound.max.z);
+			return;
+		}
+		wander(cur_entity, random);
+	}
+
+	std::unique_ptr<sim_motion_model> create_motion_model(const sim_motion& config, const cell_bound& bound)
+	{
+		if (config.type == "static")
+		{
+			return std::make_unique<static_motion_model>(config, bound);
+		}
+		if (config.type == "random_walk")
+		{
+			return std::make_unique<random_walk_motion_model>(config, bound);
+		}
+		if (config.type == "gather" && !config.points.empty())
+		{
+			return std::make_unique<gather_motion_model>(config, bound);
+		}
+		if (config.type == "herd" && !config.waypoints.empty())
+		{
+			return std::make_unique<herd_motion_model>(config, bound);
+		}
+		if (config.type == "teleport")
+		{
+			return std::make_unique<teleport_motion_model>(config, bound);
+		}
+		return nullptr;
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include "sim_scenario.h"
+#include <random>
+#include <memory>
+
+namespace spiritsaway::distributed_space
+{
+	// 标准库的分布在不同的实现下结果不同 这里自己实现到[0, 1)与正态分布的转换 保证同一个seed在不同平台上得到相同的序列
+	class sim_random
+	{
+		std::mt19937_64 m_engine;
+		bool m_has_cached_normal = false;
+		double m_cached_normal = 0;
+	public:
+		explicit sim_random(std::uint64_t seed)
+			: m_engine(seed)
+		{
+
+		}
+		// [0, 1)
+		double uniform()
+		{
+			return (m_engine() >> 11) * (1.0 / 9007199254740992.0);
+		}
+		double uniform(double min_v, double max_v)
+		{
+			return min_v + (max_v - min_v) * uniform();
+		}
+		// Box-Muller 每次生成两个 缓存其中一个
+		double normal(double mean, double sigma);
+	};
+
+	struct sim_entity
+	{
+		point_xz pos;
+		point_xz velocity;
+		point_xz offset; // 由移动模型自己解释 gather时为兴趣点下标 herd时为相对兽群中心的偏移
+		float load;
+		std::uint32_t host_cell; // real cell在sim_world中的下标
+		std::uint32_t motion_idx; // 使用的移动模型下标
+	};
+
+	// entity移动模型 每个模型实例对应sim_scenario::motions中的一项
+	// 新增一种移动方式时 继承这个类 然后在create_motion_model中根据type创建
+	class sim_motion_model
+	{
+	protected:
+		const sim_motion& m_config;
+		const cell_bound& m_bound;
+	public:
+		sim_motion_model(const sim_motion& in_config, const cell_bound& in_bound)
+			: m_config(in_config)
+			, m_bound(in_bound)
+		{
+
+		}
+		virtual ~sim_motion_model() = default;
+		// entity出生之后调用一次 初始化速度以及模型相关的状态
+		virtual void on_spawn(sim_entity& cur_entity, sim_random& random);
+		// 每个tick移动entity之前调用一次 更新模型自身的状态
+		virtual void on_tick(std::uint32_t tick, sim_random& random)
+		{
+			(void)tick;
+			(void)random;
+		}
+		virtual void move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random) = 0;
+	protected:
+		// 以turn_probability的概率随机选择新方向 然后沿速度方向移动 碰到边界时反弹
+		void wander(sim_entity& cur_entity, sim_random& random) const;
+		// 朝dest移动最多speed的距离 返回是否已经到达
+		bool move_toward(sim_entity& cur_entity, const point_xz& dest, double speed) const;
+		void random_direction(sim_entity& cur_entity, sim_random& random) const;
+	};
+
+	class static_motion_model : public sim_motion_model
+	{
+	public:
+		using sim_motion_model::sim_motion_model;
+		void move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random) override;
+	};
+
+	class random_walk_motion_model : public sim_motion_model
+	{
+	public:
+		using sim_motion_model::sim_motion_model;
+		void move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random) override;
+	};
+
+	// 人群聚集到兴趣点 用来模拟活动开启之后玩家从各处赶往活动地点形成的热点
+	class gather_motion_model : public sim_motion_model
+	{
+		std::vector<double> m_weight_prefix;
+	public:
+		gather_motion_model(const sim_motion& in_config, const cell_bound& in_bound);
+		void on_spawn(sim_entity& cur_entity, sim_random& random) override;
+		void move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random) override;
+	};
+
+	// 兽群沿着路径迁移 用来模拟大规模的怪物潮或者护送队伍形成的移动热点
+	class herd_motion_model : public sim_motion_model
+	{
+		point_xz m_herd_center;
+		std::size_t m_next_waypoint = 0;
+	public:
+		herd_motion_model(const sim_motion& in_config, const cell_bound& in_bound);
+		void on_spawn(sim_entity& cur_entity, sim_random& random) override;
+		void on_tick(std::uint32_t tick, sim_random& random) override;
+		void move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random) override;
+	};
+
+	// 在start_tick瞬间传送到同一个区域 用来模拟集体传送进入副本入口或者战场的突发热点
+	class teleport_motion_model : public sim_motion_model
+	{
+	public:
+		using sim_motion_model::sim_motion_model;
+		void move(sim_entity& cur_entity, std::uint32_t tick, sim_random& random) override;
+	};
+
+	// type不合法时返回nullptr
+	std::unique_ptr<sim_motion_model> create_motion_model(const sim_motion& config, const cell_bound& bound);
+}
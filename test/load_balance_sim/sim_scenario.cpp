@@ -0,0 +1,178 @@
+#include "sim_scenario.h"
+
+namespace spiritsaway::distributed_space
+{
+	bool sim_spawn::decode(const json& data, const cell_bound& space_bound)
+	{
+		try
+		{
+			tick = data.value("tick", 0u);
+			data.at("num").get_to(num);
+			shape = data.value("shape", std::string("uniform"));
+			load = data.value("load", 1.0f);
+			if (shape == "uniform")
+			{
+				region = space_bound;
+				if (data.contains("region"))
+				{
+					data.at("region").get_to(region);
+				}
+				return region.min.x <= region.max.x && region.min.z <= region.max.z;
+			}
+			else if (shape == "gaussian")
+			{
+				data.at("center").get_to(center);
+				data.at("sigma").get_to(sigma);
+				return sigma >= 0;
+			}
+			return false;
+		}
+		catch (const std::exception& e)
+		{
+			(void)e;
+			return false;
+		}
+	}
+
+	bool sim_motion::decode(const json& data)
+	{
+		try
+		{
+			type = data.value("type", std::string("static"));
+			speed = data.value("speed", 0.0);
+			turn_probability = data.value("turn_probability", 0.0);
+			start_tick = data.value("start_tick", 0u);
+			radius = data.value("radius", 0.0);
+			herd_speed = data.value("herd_speed", 0.0);
+			points.clear();
+			if (data.contains("points"))
+			{
+				for (const auto& one_point_json : data.at("points"))
+				{
+					sim_point_of_interest cur_point;
+					one_point_json.at("center").get_to(cur_point.center);
+					cur_point.weight = one_point_json.value("weight", 1.0);
+					points.push_back(cur_point);
+				}
+			}
+			waypoints = data.value("waypoints", std::vector<point_xz>());
+			if (data.contains("center"))
+			{
+				data.at("center").get_to(center);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			(void)e;
+			return false;
+		}
+		if (type == "static" || type == "random_walk")
+		{
+			return true;
+		}
+		if (type == "gather")
+		{
+			return !points.empty();
+		}
+		if (type == "herd")
+		{
+			return !waypoints.empty();
+		}
+		if (type == "teleport")
+		{
+			return data.contains("center");
+		}
+		return false;
+	}
+
+	bool sim_scenario::decode(const json& data)
+	{
+		try
+		{
+			name = data.value("name", std::string());
+			seed = data.value("seed", std::uint64_t(1));
+			data.at("ticks").get_to(ticks);
+			data.at("bound").get_to(bound);
+			data.at("ghost_radius").get_to(ghost_radius);
+			games.clear();
+			if (data.contains("games"))
+			{
+				for (const auto& one_game_json : data.at("games"))
+				{
+					sim_game cur_game;
+					one_game_json.at("game_id").get_to(cur_game.game_id);
+					cur_game.capacity = one_game_json.value("capacity", 1.0f);
+					games.push_back(cur_game);
+				}
+			}
+			else
+			{
+				auto game_num = data.at("game_num").get<std::uint32_t>();
+				auto game_capacity = data.value("game_capacity", 1.0f);
+				for (std::uint32_t i = 0; i < game_num; i++)
+				{
+					games.push_back(sim_game{ "game" + std::to_string(i), game_capacity });
+				}
+			}
+			initial_grid = data.value("initial_grid", std::array<std::uint32_t, 2>{ 1, 1 });
+			data.at("lb_param").get_to(lb_param);
+			data.at("hysteresis_param").get_to(hysteresis_param);
+			data.at("assign_param").get_to(assign_param);
+			report_interval = data.value("report_interval", 1u);
+			game_ready_delay = data.value("game_ready_delay", 0u);
+			max_migrate_per_cell = data.value("max_migrate_per_cell", 0u);
+			cell_base_load = data.value("cell_base_load", 0.0f);
+			ghost_load = data.value("ghost_load", 0.0f);
+			circle_ghost = data.value("circle_ghost", false);
+			thread_num = data.value("thread_num", 0u);
+			motions.assign(1, sim_motion());
+			if (data.contains("motion") && !motions[0].decode(data.at("motion")))
+			{
+				return false;
+			}
+			spawns.clear();
+			for (const auto& one_spawn_json : data.at("spawns"))
+			{
+				sim_spawn cur_spawn;
+				if (!cur_spawn.decode(one_spawn_json, bound))
+				{
+					return false;
+				}
+				if (one_spawn_json.contains("motion"))
+				{
+					sim_motion cur_motion;
+					if (!cur_motion.decode(one_spawn_json.at("motion")))
+					{
+						return false;
+					}
+					cur_spawn.motion_idx = std::uint32_t(motions.size());
+					motions.push_back(cur_motion);
+				}
+				spawns.push_back(cur_spawn);
+			}
+			overload_cell_load = data.value("overload_cell_load", 1.5f * lb_param.min_cell_load_when_split);
+			snapshot_ticks = data.value("snapshot_ticks", std::vector<std::uint32_t>());
+			metrics_window_ticks = data.value("metrics_window_ticks", 100u);
+			write_journal = data.value("write_journal", false);
+			check_topology_delta = data.value("check_topology_delta", false);
+			topology_delta_drop_interval = data.value("topology_delta_drop_interval", 0u);
+		}
+		catch (const std::exception& e)
+		{
+			(void)e;
+			return false;
+		}
+		if (!ticks || ghost_radius <= 0 || games.empty() || !report_interval || !initial_grid[0] || !initial_grid[1])
+		{
+			return false;
+		}
+		for (const auto& one_game : games)
+		{
+			if (one_game.capacity <= 0)
+			{
+				return false;
+			}
+		}
+		return (bound.max.x - bound.min.x) / initial_grid[0] >= 4 * ghost_radius && (bound.max.z - bound.min.z) / initial_grid[1] >= 4 * ghost_radius;
+	}
+}
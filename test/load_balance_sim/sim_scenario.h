@@ -0,0 +1,97 @@
+#pragma once
+#include "load_balance_controller.h"
+
+namespace spiritsaway::distributed_space
+{
+	// 一批entity的出生配置
+	struct sim_spawn
+	{
+		std::uint32_t tick = 0; // 在这个tick开始时出生
+		std::uint32_t num = 0;
+		// uniform: 在region内均匀分布 region没有配置时为整个space
+		// gaussian: 以center为中心 sigma为标准差的正态分布 超出space的部分截断到边界上
+		std::string shape = "uniform";
+		cell_bound region;
+		point_xz center;
+		double sigma = 0;
+		float load = 1;
+		// 这批entity使用的移动配置在sim_scenario::motions中的下标 没有配置motion时为0 即场景默认的motion
+		std::uint32_t motion_idx = 0;
+
+		bool decode(const json& data, const cell_bound& space_bound);
+	};
+
+	// 一个兴趣点 gather时entity按照weight的比例选择聚集的兴趣点
+	struct sim_point_of_interest
+	{
+		point_xz center;
+		double weight = 1;
+	};
+
+	// entity的移动配置 每种type对应sim_motion.h中的一个sim_motion_model
+	struct sim_motion
+	{
+		// static: 不移动
+		// random_walk: 每个tick以turn_probability的概率随机选择一个新方向 然后沿当前方向移动speed的距离
+		// gather: start_tick之前random_walk 之后以speed朝选择的兴趣点移动 进入radius之内后在radius内random_walk
+		// herd: 所有entity组成一个兽群 兽群中心以herd_speed沿着waypoints循环移动 entity以speed追赶兽群中心加上出生时随机的偏移 偏移的标准差为radius
+		// teleport: random_walk 在start_tick时所有entity瞬移到以center为中心 radius为标准差的正态分布位置
+		std::string type = "static";
+		double speed = 0; // 每个tick的移动距离
+		double turn_probability = 0;
+		std::uint32_t start_tick = 0;
+		double radius = 0;
+		std::vector<sim_point_of_interest> points; // gather使用
+		std::vector<point_xz> waypoints; // herd使用
+		double herd_speed = 0;
+		point_xz center; // teleport使用
+
+		bool decode(const json& data);
+	};
+
+	struct sim_game
+	{
+		std::string game_id;
+		float capacity = 1;
+	};
+
+	// 一个负载均衡模拟场景 从json文件中读取
+	// 相同的场景与seed在同一个平台上总是得到相同的结果
+	struct sim_scenario
+	{
+		std::string name;
+		std::uint64_t seed = 1;
+		std::uint32_t ticks = 0;
+		cell_bound bound;
+		double ghost_radius = 0;
+		// 第一个game承载初始的master cell
+		// 可以直接配置games数组 也可以配置game_num与game_capacity生成game0到game{n-1}
+		std::vector<sim_game> games;
+		// 初始时把space均匀切分为x_num * z_num的网格 第i个cell放在第i % games.size()个game上 默认只有一个master cell
+		std::array<std::uint32_t, 2> initial_grid = { 1, 1 };
+		cell_load_balance_param lb_param;
+		load_balance_hysteresis_param hysteresis_param;
+		game_assign_param assign_param;
+
+		std::uint32_t report_interval = 1; // 每隔多少个tick汇报一次cell负载并执行一次负载均衡
+		std::uint32_t game_ready_delay = 0; // 新cell创建之后经过多少个tick才ready
+		std::uint32_t max_migrate_per_cell = 0; // 每个cell每个tick最多迁出的entity数量 0代表不限制
+		float cell_base_load = 0; // 每个cell在entity之外的固定负载
+		float ghost_load = 0; // ghost entity给所在cell带来的负载为real负载乘以这个比例
+		bool circle_ghost = false; // ghost区域使用半径为ghost_radius的圆 默认为边长2*ghost_radius的正方形
+		std::uint32_t thread_num = 0; // 计算ghost使用的线程数 0代表在当前线程计算 不影响模拟结果
+
+		// 第一个为场景默认的motion 之后为spawns中单独配置的motion
+		std::vector<sim_motion> motions;
+		std::vector<sim_spawn> spawns;
+		// 最大cell负载超过这个值的tick认为处于过载状态 用来统计负载均衡的反应时间 默认为1.5 * min_cell_load_when_split
+		float overload_cell_load = 0;
+		std::vector<std::uint32_t> snapshot_ticks; // 在这些tick结束之后输出space_cells::encode与prometheus格式的space_metrics 开启绘图时同时绘制
+		std::uint32_t metrics_window_ticks = 100; // space_metrics中统计操作与迁移数量的窗口长度
+		bool write_journal = false; // 有output_dir时 是否把space_cells上的所有修改写入output_dir/journal.bin 每次汇报都会记录所有entity_load 文件会很大
+		bool check_topology_delta = false; // 每个tick通过space_topology_encoder的增量同步一个副本 并检查副本的拓扑与原来的相同
+		std::uint32_t topology_delta_drop_interval = 0; // 每隔多少个增量丢弃一个 用来模拟副本发现丢失之后的重新同步 0为不丢弃
+
+		bool decode(const json& data);
+	};
+}
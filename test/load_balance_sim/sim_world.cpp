@@ -0,0 +1,367 @@
+#include "sim_world.h"
+#include "sim_alloc.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace spiritsaway::distributed_space
+{
+	sim_world::sim_world(const sim_scenario& in_scenario, space_journal_writer* journal)
+		: m_scenario(in_scenario)
+		, m_random(in_scenario.seed)
+		, m_space(in_scenario.bound, in_scenario.games[0].game_id, "cell0", in_scenario.ghost_radius)
+		, m_controller(in_scenario.lb_param, in_scenario.hysteresis_param)
+		, m_ghost_engine(in_scenario.ghost_load, in_scenario.circle_ghost ? ghost_shape::circle : ghost_shape::square)
+		, m_metrics_window(in_scenario.metrics_window_ticks)
+		, m_journal(journal)
+	{
+		m_space.set_journal(m_journal);
+		if (m_scenario.thread_num)
+		{
+			m_thread_pool = std::make_unique<thread_pool>(m_scenario.thread_num);
+		}
+		m_space.set_ready("cell0");
+		for (const auto& one_motion : m_scenario.motions)
+		{
+			m_motion_models.push_back(create_motion_model(one_motion, m_scenario.bound));
+		}
+		for (const auto& one_game : m_scenario.games)
+		{
+			m_space.set_game_capacity(one_game.game_id, one_game.capacity);
+			m_game_loads[one_game.game_id] = 0;
+		}
+		// 先切分出所有的列 然后把每一列切分为多行 新的cell总是位于坐标较大的一侧
+		const auto& cur_bound = m_scenario.bound;
+		auto grid_width = (cur_bound.max.x - cur_bound.min.x) / m_scenario.initial_grid[0];
+		auto grid_height = (cur_bound.max.z - cur_bound.min.z) / m_scenario.initial_grid[1];
+		std::vector<std::string> column_ids = { "cell0" };
+		for (std::uint32_t i = m_scenario.initial_grid[0] - 1; i > 0; i--)
+		{
+			auto new_cell_id = "cell" + std::to_string(++m_cell_counter);
+			m_space.split_x(cur_bound.min.x + grid_width * i, "cell0", m_scenario.games[m_cell_counter % m_scenario.games.size()].game_id, "cell0", new_cell_id);
+			m_space.set_ready(new_cell_id);
+			column_ids.push_back(new_cell_id);
+		}
+		for (const auto& one_column_id : column_ids)
+		{
+			for (std::uint32_t i = m_scenario.initial_grid[1] - 1; i > 0; i--)
+			{
+				auto new_cell_id = "cell" + std::to_string(++m_cell_counter);
+				m_space.split_z(cur_bound.min.z + grid_height * i, one_column_id, m_scenario.games[m_cell_counter % m_scenario.games.size()].game_id, one_column_id, new_cell_id);
+				m_space.set_ready(new_cell_id);
+			}
+		}
+		refresh_cell_nodes();
+	}
+
+	std::uint32_t sim_world::intern_cell(const std::string& cell_id)
+	{
+		auto cur_iter = m_cell_idxes.find(cell_id);
+		if (cur_iter != m_cell_idxes.end())
+		{
+			return cur_iter->second;
+		}
+		auto new_idx = std::uint32_t(m_cell_ids.size());
+		m_cell_ids.push_back(cell_id);
+		m_cell_idxes[cell_id] = new_idx;
+		m_cell_nodes.push_back(nullptr);
+		m_cell_real_nums.push_back(0);
+		return new_idx;
+	}
+
+	void sim_world::refresh_cell_nodes()
+	{
+		std::fill(m_cell_nodes.begin(), m_cell_nodes.end(), nullptr);
+		m_node_idxes.clear();
+		for (const auto& [one_cell_id, one_cell] : m_space.all_leafs())
+		{
+			auto cur_idx = intern_cell(one_cell_id);
+			m_cell_nodes[cur_idx] = one_cell;
+			m_node_idxes[one_cell] = cur_idx;
+		}
+	}
+
+	const space_cells::space_node* sim_world::resolve_real_cell(const point_xz& pos) const
+	{
+		auto cur_node = m_space.root_node();
+		while (!cur_node->is_leaf_cell())
+		{
+			cur_node = cur_node->children()[0]->boundary().cover(pos.x, pos.z) ? cur_node->children()[0] : cur_node->children()[1];
+		}
+		if (cur_node->ready() && !cur_node->is_merging())
+		{
+			return cur_node;
+		}
+		auto cur_real = cur_node->ready() ? cur_node->sibling() : m_space.get_real_leaf(cur_node);
+		if (cur_real && cur_real->is_leaf_cell() && cur_real->ready() && !cur_real->is_merging())
+		{
+			return cur_real;
+		}
+		return nullptr;
+	}
+
+	void sim_world::spawn_entities()
+	{
+		for (const auto& one_spawn : m_scenario.spawns)
+		{
+			if (one_spawn.tick != m_tick)
+			{
+				continue;
+			}
+			m_entities.reserve(m_entities.size() + one_spawn.num);
+			for (std::uint32_t i = 0; i < one_spawn.num; i++)
+			{
+				sim_entity cur_entity;
+				if (one_spawn.shape == "gaussian")
+				{
+					cur_entity.pos.x = std::clamp(m_random.normal(one_spawn.center.x, one_spawn.sigma), m_scenario.bound.min.x, m_scenario.bound.max.x);
+					cur_entity.pos.z = std::clamp(m_random.normal(one_spawn.center.z, one_spawn.sigma), m_scenario.bound.min.z, m_scenario.bound.max.z);
+				}
+				else
+				{
+					cur_entity.pos.x = m_random.uniform(one_spawn.region.min.x, one_spawn.region.max.x);
+					cur_entity.pos.z = m_random.uniform(one_spawn.region.min.z, one_spawn.region.max.z);
+				}
+				cur_entity.load = one_spawn.load;
+				cur_entity.motion_idx = one_spawn.motion_idx;
+				m_motion_models[cur_entity.motion_idx]->on_spawn(cur_entity, m_random);
+				auto cur_cell = resolve_real_cell(cur_entity.pos);
+				cur_entity.host_cell = cur_cell ? m_node_idxes[cur_cell] : m_cell_idxes[m_space.master_cell_id()];
+				m_cell_real_nums[cur_entity.host_cell]++;
+				m_entities.push_back(cur_entity);
+			}
+		}
+	}
+
+	void sim_world::move_entities()
+	{
+		for (auto& one_model : m_motion_models)
+		{
+			one_model->on_tick(m_tick, m_random);
+		}
+		for (auto& one_entity : m_entities)
+		{
+			m_motion_models[one_entity.motion_idx]->move(one_entity, m_tick, m_random);
+		}
+	}
+
+	void sim_world::update_ready_cells()
+	{
+		for (auto iter = m_pending_ready_ticks.begin(); iter != m_pending_ready_ticks.end();)
+		{
+			if (iter->second <= m_tick)
+			{
+				m_space.set_ready(iter->first);
+				iter = m_pending_ready_ticks.erase(iter);
+			}
+			else
+			{
+				iter++;
+			}
+		}
+	}
+
+	std::uint32_t sim_world::migrate_entities()
+	{
+		std::vector<std::uint32_t> cell_migrate_nums(m_cell_ids.size(), 0);
+		std::uint32_t result = 0;
+		for (auto& one_entity : m_entities)
+		{
+			auto cur_host = m_cell_nodes[one_entity.host_cell];
+			// 绝大部分entity仍然在原来的cell内 不需要遍历树
+			if (cur_host && cur_host->ready() && !cur_host->is_merging() && cur_host->boundary().cover(one_entity.pos.x, one_entity.pos.z))
+			{
+				continue;
+			}
+			auto dest_cell = resolve_real_cell(one_entity.pos);
+			if (!dest_cell)
+			{
+				if (cur_host)
+				{
+					continue;
+				}
+				dest_cell = m_space.get_leaf(m_space.master_cell_id());
+			}
+			if (dest_cell == cur_host)
+			{
+				continue;
+			}
+			if (cur_host && m_scenario.max_migrate_per_cell && cell_migrate_nums[one_entity.host_cell] >= m_scenario.max_migrate_per_cell)
+			{
+				continue;
+			}
+			cell_migrate_nums[one_entity.host_cell]++;
+			m_cell_real_nums[one_entity.host_cell]--;
+			one_entity.host_cell = m_node_idxes[dest_cell];
+			m_cell_real_nums[one_entity.host_cell]++;
+			result++;
+		}
+		m_total_migrated_num += result;
+		return result;
+	}
+
+	void sim_world::report_loads()
+	{
+		// entity的real cell由迁移逻辑维护 这里只需要计算ghost
+		m_report_entities.resize(m_entities.size());
+		m_report_real_cells.resize(m_entities.size());
+		for (std::size_t i = 0; i < m_entities.size(); i++)
+		{
+			m_report_entities[i].pos = m_entities[i].pos;
+			m_report_entities[i].load = m_entities[i].load;
+			m_report_real_cells[i] = m_cell_nodes[m_entities[i].host_cell];
+		}
+		m_ghost_engine.compute(m_space, m_report_entities, m_report_real_cells, m_thread_pool.get(), m_ghost_result);
+		m_ghost_num = m_ghost_result.ghost_num();
+		for (auto& [one_game_id, one_game_load] : m_game_loads)
+		{
+			one_game_load = 0;
+		}
+		auto begin_alloc_num = sim_alloc_count();
+		for (std::size_t i = 0; i < m_ghost_result.cells.size(); i++)
+		{
+			auto cur_cell = m_ghost_result.cells[i];
+			if (!cur_cell->ready())
+			{
+				continue;
+			}
+			auto cur_cell_load = m_scenario.cell_base_load + m_ghost_result.cell_loads[i];
+			m_space.update_cell_load(cur_cell->space_id(), cur_cell_load, m_ghost_result.cell_entity_loads[i]);
+			m_game_loads[cur_cell->game_id()] += cur_cell_load;
+		}
+		m_space.update_load_stat(m_game_loads);
+		m_space_alloc_num += sim_alloc_count() - begin_alloc_num;
+	}
+
+	std::string sim_world::do_balance()
+	{
+		for (std::uint32_t i = 0; i < m_cell_ids.size(); i++)
+		{
+			if (m_cell_nodes[i] && m_cell_nodes[i]->is_merging() && !m_cell_real_nums[i])
+			{
+				if (!m_space.finish_merge(m_cell_ids[i]).empty())
+				{
+					return "finish_merge";
+				}
+			}
+		}
+		auto cur_decision = m_controller.decide(m_space, m_game_loads);
+		switch (cur_decision.op)
+		{
+		case cell_load_balance_operation::shrink:
+		{
+			auto new_split_pos = cur_decision.node->calc_best_shrink_new_split_pos(m_scenario.lb_param, m_space.ghost_radius(cur_decision.node->parent()));
+			if (!m_space.balance(new_split_pos, cur_decision.node->parent()))
+			{
+				return "nothing";
+			}
+			m_controller.on_shrink(cur_decision.node);
+			return "shrink";
+		}
+		case cell_load_balance_operation::split:
+		{
+			auto origin_cell_id = cur_decision.node->space_id();
+			auto cur_split_direction = cur_decision.node->calc_best_split_direction(m_space.ghost_radius(cur_decision.node));
+			auto new_game_id = m_space.choose_game_for_new_cell(origin_cell_id, cur_split_direction, m_game_loads, m_scenario.assign_param);
+			if (new_game_id.empty())
+			{
+				return "nothing";
+			}
+			auto new_cell_id = "cell" + std::to_string(++m_cell_counter);
+			auto new_cell = m_space.split_at_direction(origin_cell_id, cur_split_direction, new_cell_id, new_game_id);
+			if (!new_cell)
+			{
+				return "nothing";
+			}
+			if (m_scenario.game_ready_delay)
+			{
+				m_pending_ready_ticks[new_cell_id] = m_tick + m_scenario.game_ready_delay;
+			}
+			else
+			{
+				m_space.set_ready(new_cell_id);
+			}
+			m_controller.on_split(m_space.get_leaf(origin_cell_id), new_cell);
+			return "split";
+		}
+		case cell_load_balance_operation::remove:
+		{
+			if (!m_space.start_merge(cur_decision.node->space_id()))
+			{
+				return "nothing";
+			}
+			m_controller.on_start_merge(cur_decision.node);
+			return "remove";
+		}
+		default:
+			return "nothing";
+		}
+	}
+
+	sim_tick_metrics sim_world::step()
+	{
+		auto begin_ts = std::chrono::steady_clock::now();
+		auto begin_alloc_num = sim_alloc_count();
+		m_space_alloc_num = 0;
+		sim_tick_metrics result;
+		result.tick = m_tick;
+		if (m_journal)
+		{
+			m_journal->write_tick(m_tick);
+		}
+		m_controller.tick();
+		spawn_entities();
+		move_entities();
+		update_ready_cells();
+		refresh_cell_nodes();
+		result.migrated_num = migrate_entities();
+		m_space.record_migrated_entities(result.migrated_num);
+		if (m_tick % m_scenario.report_interval == 0)
+		{
+			report_loads();
+			auto balance_begin_alloc_num = sim_alloc_count();
+			result.op = do_balance();
+			m_space_alloc_num += sim_alloc_count() - balance_begin_alloc_num;
+			if (result.op != "nothing")
+			{
+				refresh_cell_nodes();
+			}
+		}
+
+		result.entity_num = std::uint32_t(m_entities.size());
+		result.ghost_num = m_ghost_num;
+		result.leaf_num = std::uint32_t(m_space.all_leafs().size());
+		std::uint32_t ready_leaf_num = 0;
+		for (const auto& [one_cell_id, one_cell] : m_space.all_leafs())
+		{
+			if (!one_cell->ready())
+			{
+				continue;
+			}
+			ready_leaf_num++;
+			result.max_cell_load = std::max(result.max_cell_load, one_cell->get_latest_load());
+			result.avg_cell_load += one_cell->get_latest_load();
+		}
+		if (ready_leaf_num)
+		{
+			result.avg_cell_load /= ready_leaf_num;
+		}
+		float total_game_load = 0;
+		float total_game_capacity = 0;
+		for (const auto& [one_game_id, one_game_load] : m_game_loads)
+		{
+			auto cur_capacity = m_space.game_capacity(one_game_id);
+			result.max_game_utilization = std::max(result.max_game_utilization, one_game_load / cur_capacity);
+			total_game_load += one_game_load;
+			total_game_capacity += cur_capacity;
+		}
+		result.avg_game_utilization = total_game_load / total_game_capacity;
+		m_space.calc_metrics(m_game_loads, m_space_metrics);
+		m_metrics_window.on_tick(m_space, m_space_metrics);
+		m_tick++;
+		result.alloc_num = sim_alloc_count() - begin_alloc_num;
+		result.space_alloc_num = m_space_alloc_num;
+		result.step_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin_ts).count();
+		return result;
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "sim_motion.h"
+#include "ghost_engine.h"
+#include "space_metrics.h"
+#include "space_journal.h"
+
+namespace spiritsaway::distributed_space
+{
+	// 一个tick结束之后的统计信息
+	// cell负载与ghost数量来自最近一次汇报
+	struct sim_tick_metrics
+	{
+		std::uint32_t tick = 0;
+		std::uint32_t entity_num = 0;
+		std::uint32_t leaf_num = 0;
+		std::uint32_t migrated_num = 0; // 这个tick内切换了real cell的entity数量
+		std::uint32_t ghost_num = 0;
+		float max_cell_load = 0;
+		float avg_cell_load = 0;
+		float max_game_utilization = 0;
+		float avg_game_utilization = 0; // 所有game的负载总和除以容量总和
+		std::string op = "nothing"; // 这个tick执行的负载均衡操作 nothing split shrink remove finish_merge
+		double step_ms = 0;
+		std::uint64_t alloc_num = 0; // 这个tick内通过全局分配器申请内存的次数
+		std::uint64_t space_alloc_num = 0; // 其中汇报负载与执行负载均衡时space_cells相关调用的申请次数
+		NLOHMANN_DEFINE_TYPE_INTRUSIVE(sim_tick_metrics, tick, entity_num, leaf_num, migrated_num, ghost_num, max_cell_load, avg_cell_load, max_game_utilization, avg_game_utilization, op, step_ms, alloc_num, space_alloc_num)
+	};
+
+	// 无界面的负载均衡模拟 每个tick依次执行
+	// 1. 按照spawns生成entity 每个entity使用所在spawn对应的移动模型移动
+	// 2. 到达game_ready_delay的新cell设置为ready
+	// 3. 离开real cell的entity迁移到所在位置的ready cell 受max_migrate_per_cell限制
+	// 4. 每隔report_interval个tick 汇报所有ready cell的entity_load与负载 然后通过load_balance_controller执行最多一次操作
+	class sim_world
+	{
+		const sim_scenario& m_scenario;
+		sim_random m_random;
+		std::vector<std::unique_ptr<sim_motion_model>> m_motion_models; // 与sim_scenario::motions一一对应
+		space_cells m_space;
+		load_balance_controller m_controller;
+		ghost_engine m_ghost_engine;
+		std::unique_ptr<thread_pool> m_thread_pool; // thread_num为0时为nullptr
+		ghost_compute_result m_ghost_result;
+		std::vector<entity_load> m_report_entities;
+		std::vector<const space_cells::space_node*> m_report_real_cells;
+		space_metrics_window m_metrics_window;
+		space_metrics m_space_metrics;
+		std::vector<sim_entity> m_entities;
+		// 出现过的所有cell的id 只增不减 entity通过下标记录所在的real cell 避免每个entity保存字符串
+		std::vector<std::string> m_cell_ids;
+		std::unordered_map<std::string, std::uint32_t> m_cell_idxes;
+		// 与m_cell_ids一一对应的当前叶子节点 已经不是叶子节点的为nullptr 每次拓扑修改之后刷新
+		std::vector<const space_cells::space_node*> m_cell_nodes;
+		std::unordered_map<const space_cells::space_node*, std::uint32_t> m_node_idxes;
+		std::vector<std::uint32_t> m_cell_real_nums;
+		std::unordered_map<std::string, std::uint32_t> m_pending_ready_ticks; // 新cell在这个tick之后ready
+		std::unordered_map<std::string, float> m_game_loads;
+		std::uint64_t m_cell_counter = 0;
+		std::uint32_t m_tick = 0;
+		std::uint32_t m_ghost_num = 0;
+		std::uint64_t m_total_migrated_num = 0;
+		std::uint64_t m_space_alloc_num = 0; // 当前tick内space_cells相关调用的申请次数
+		space_journal_writer* m_journal;
+	public:
+		// in_scenario需要是decode成功的 其生命周期要覆盖sim_world
+		// journal非空时 space_cells上的所有修改都会写入journal 每个tick开始时写入tick记录
+		explicit sim_world(const sim_scenario& in_scenario, space_journal_writer* journal = nullptr);
+		sim_world(const sim_world& other) = delete;
+		sim_world& operator=(const sim_world& other) = delete;
+
+		sim_tick_metrics step();
+
+		const space_cells& space() const
+		{
+			return m_space;
+		}
+		const load_balance_controller& controller() const
+		{
+			return m_controller;
+		}
+		std::uint32_t current_tick() const
+		{
+			return m_tick;
+		}
+		std::uint64_t total_migrated_num() const
+		{
+			return m_total_migrated_num;
+		}
+		// 每个tick结束时计算 窗口长度为metrics_window_ticks
+		const space_metrics& latest_space_metrics() const
+		{
+			return m_space_metrics;
+		}
+	private:
+		void spawn_entities();
+		void move_entities();
+		void update_ready_cells();
+		void refresh_cell_nodes();
+		std::uint32_t migrate_entities();
+		void report_loads();
+		// 返回执行的操作名字
+		std::string do_balance();
+		// pos所在的可以作为real cell的叶子节点 未ready时使用get_real_leaf 正在merge时使用其兄弟叶子节点 都不可用时返回nullptr
+		const space_cells::space_node* resolve_real_cell(const point_xz& pos) const;
+		std::uint32_t intern_cell(const std::string& cell_id);
+	};
+}
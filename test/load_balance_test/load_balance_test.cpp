@@ -1,4 +1,5 @@
 #include "../space_draw/space_draw.h"
+#include "load_balance_controller.h"
 #include <random>
 #include <fstream>
 #include <unordered_set>
@@ -290,8 +291,21 @@ std::string choose_min_load_game(const std::unordered_map<std::string, float>& g
 	}
 	return best_game;
 }
-void do_balance(space_cells& cur_space, const cell_load_balance_param& lb_param, const std::unordered_map<std::string, float>& game_loads, int iteration, std::shared_ptr<spdlog::logger> cur_logger)
+load_balance_hysteresis_param create_hysteresis_param()
 {
+	load_balance_hysteresis_param result;
+	result.cell_cooldown_ticks = 3;
+	result.game_cooldown_ticks = 1;
+	result.min_cell_lifetime_ticks = 10;
+	result.max_merged_load_ratio_when_remove = 0.7f;
+	result.oscillation_window_ticks = 10;
+	return result;
+}
+
+void do_balance(space_cells& cur_space, load_balance_controller& lb_controller, const std::unordered_map<std::string, float>& game_loads, int iteration, std::shared_ptr<spdlog::logger> cur_logger)
+{
+	lb_controller.tick();
+	const auto& lb_param = lb_controller.lb_param();
 	for (const auto& [one_cell_id, one_cell] : cur_space.cells())
 	{
 		if (one_cell->is_merging())
@@ -318,7 +332,7 @@ void do_balance(space_cells& cur_space, const cell_load_balance_param& lb_param,
 			
 		}
 	}
-	auto cur_shrink_node = cur_space.get_best_node_to_shrink(game_loads, lb_param);
+	auto cur_shrink_node = lb_controller.get_best_node_to_shrink(cur_space);
 	if (cur_shrink_node)
 	{
 		double out_split_axis = cur_shrink_node->calc_best_shrink_new_split_pos(lb_param, cur_space.ghost_radius());
@@ -327,14 +341,19 @@ void do_balance(space_cells& cur_space, const cell_load_balance_param& lb_param,
 		cur_logger->info("before balance space {} has boundary {}", cur_shrink_node->space_id(), json(cur_shrink_node->boundary()).dump());
 		cur_logger->info("before balance space {} has boundary {}", cur_sibling_node->space_id(), json(cur_sibling_node->boundary()).dump());
 
-		cur_space.balance(out_split_axis, cur_shrink_node->parent());
+		if (!cur_space.balance(out_split_axis, cur_shrink_node->parent()))
+		{
+			cur_logger->info("balance {} at {} failed", cur_shrink_node->space_id(), out_split_axis);
+			return;
+		}
+		lb_controller.on_shrink(cur_shrink_node);
 
 		cur_logger->info("after balance space {} has boundary {}", cur_shrink_node->space_id(), json(cur_shrink_node->boundary()).dump());
 
 		cur_logger->info("after balance space {} has boundary {}", cur_sibling_node->space_id(), json(cur_sibling_node->boundary()).dump());
 		return;
 	}
-	auto cur_split_node = cur_space.get_best_cell_to_split(game_loads, lb_param);
+	auto cur_split_node = lb_controller.get_best_cell_to_split(cur_space, game_loads);
 	if (cur_split_node)
 	{
 		auto cur_split_direction = cur_split_node->calc_best_split_direction(cur_space.ghost_radius());
@@ -349,11 +368,12 @@ void do_balance(space_cells& cur_space, const cell_load_balance_param& lb_param,
 			cur_logger->info("space {} has boundary {}", sibling_node->space_id(), json(sibling_node->boundary()).dump());
 			cur_logger->info("space {} has boundary {}", new_space_node->space_id(), json(new_space_node->boundary()).dump());
 			cur_space.set_ready(new_space_id);
+			lb_controller.on_split(cur_space.get_leaf(cur_split_space_id), new_space_node);
 			return;
 		}
 	}
 	
-	auto cur_merge_node = cur_space.get_best_cell_to_merge(game_loads, lb_param);
+	auto cur_merge_node = lb_controller.get_best_cell_to_merge(cur_space);
 	if (cur_merge_node)
 	{
 		auto cur_sibling_node = cur_merge_node->sibling();
@@ -362,7 +382,12 @@ void do_balance(space_cells& cur_space, const cell_load_balance_param& lb_param,
 		cur_logger->info("merging space {}", cur_remove_space_id);
 		cur_logger->info("before merge space {} has boundary {}", cur_merge_node->space_id(), json(cur_merge_node->boundary()).dump());
 		cur_logger->info("before merge space {} has boundary {}", cur_sibling_node->space_id(), json(cur_sibling_node->boundary()).dump());
-		cur_space.start_merge(cur_remove_space_id);
+		if (!cur_space.start_merge(cur_remove_space_id))
+		{
+			cur_logger->info("start_merge {} failed", cur_remove_space_id);
+			return;
+		}
+		lb_controller.on_start_merge(cur_merge_node);
 		cur_logger->info("after merge space {} has boundary {}", cur_merge_node->space_id(), json(cur_merge_node->boundary()).dump());
 
 		cur_logger->info("after merge space {} has boundary {}", cur_sibling_node->space_id(), json(cur_sibling_node->boundary()).dump());
@@ -388,6 +413,7 @@ void lb_case_1(const space_draw_config& draw_config, const std::string& dest_dir
 	cur_lb_param.min_game_load_when_split = 80;
 	cur_lb_param.min_sibling_game_load_diff_when_shrink = 20;
 	
+	load_balance_controller cur_lb_controller(cur_lb_param, create_hysteresis_param());
 	std::string root_space_id = "space1";
 	std::vector<std::string> games = { "game1", "game2", "game3", "game4" };
 	space_cells cur_space(temp_bound, "game0", root_space_id, 400);
@@ -422,12 +448,13 @@ void lb_case_1(const space_draw_config& draw_config, const std::string& dest_dir
 		}
 		logger->info("game_loads {}", json(cur_game_loads).dump());
 		cur_space.update_load_stat(cur_game_loads);
-		do_balance(cur_space, cur_lb_param, cur_game_loads, i, logger);
+		do_balance(cur_space, cur_lb_controller, cur_game_loads, i, logger);
 		logger->info("balance finish");
 		draw_cell_region(cur_space, draw_config, cur_result_dir, "iter_" + std::to_string(i+1));
 		dump_json_to_file(cur_space.encode(), cur_result_dir + "/" + "iter_" + std::to_string(i + 1) + ".json");
 	}
 
+	logger->warn("lb_case_1 operation_count {} oscillation_count {}", cur_lb_controller.operation_count(), cur_lb_controller.oscillation_count());
 }
 
 // 预先划分 然后等待自动调节到稳态
@@ -449,6 +476,7 @@ void lb_case_2(const space_draw_config& draw_config, const std::string& dest_dir
 	cur_lb_param.min_game_load_when_split = 80;
 	cur_lb_param.min_sibling_game_load_diff_when_shrink = 15;
 
+	load_balance_controller cur_lb_controller(cur_lb_param, create_hysteresis_param());
 	std::string root_space_id = "space1";
 	std::vector<std::string> games = { "game0", "game1", "game2", "game3", "game4" };
 	space_cells cur_space(temp_bound, "game0", root_space_id, 400);
@@ -491,12 +519,13 @@ void lb_case_2(const space_draw_config& draw_config, const std::string& dest_dir
 		}
 		logger->info("game_loads {}", json(cur_game_loads).dump());
 		cur_space.update_load_stat(cur_game_loads);
-		do_balance(cur_space, cur_lb_param, cur_game_loads, i, logger);
+		do_balance(cur_space, cur_lb_controller, cur_game_loads, i, logger);
 		logger->info("balance finish");
 		draw_cell_region(cur_space, draw_config, cur_result_dir, "iter_" + std::to_string(i + 1));
 		dump_json_to_file(cur_space.encode(), cur_result_dir + "/" + "iter_" + std::to_string(i + 1) + ".json");
 	}
 
+	logger->warn("lb_case_2 operation_count {} oscillation_count {}", cur_lb_controller.operation_count(), cur_lb_controller.oscillation_count());
 }
 
 // 均衡划分 然后删除一些entity 等待均衡
@@ -518,6 +547,7 @@ void lb_case_3(const space_draw_config& draw_config, const std::string& dest_dir
 	cur_lb_param.min_game_load_when_split = 80;
 	cur_lb_param.min_sibling_game_load_diff_when_shrink = 15;
 
+	load_balance_controller cur_lb_controller(cur_lb_param, create_hysteresis_param());
 	std::string root_space_id = "space1";
 	std::vector<std::string> games = { "game0", "game1", "game2", "game3", "game4" };
 	space_cells cur_space(temp_bound, "game0", root_space_id, 400);
@@ -560,7 +590,7 @@ void lb_case_3(const space_draw_config& draw_config, const std::string& dest_dir
 		}
 		logger->info("game_loads {}", json(cur_game_loads).dump());
 		cur_space.update_load_stat(cur_game_loads);
-		do_balance(cur_space, cur_lb_param, cur_game_loads, i, logger);
+		do_balance(cur_space, cur_lb_controller, cur_game_loads, i, logger);
 		logger->info("balance finish");
 		draw_cell_region(cur_space, draw_config, cur_result_dir, "iter_" + std::to_string(i + 1));
 		dump_json_to_file(cur_space.encode(), cur_result_dir + "/" + "iter_" + std::to_string(i + 1) + ".json");
@@ -588,11 +618,12 @@ void lb_case_3(const space_draw_config& draw_config, const std::string& dest_dir
 		}
 		logger->info("game_loads {}", json(cur_game_loads).dump());
 		cur_space.update_load_stat(cur_game_loads);
-		do_balance(cur_space, cur_lb_param, cur_game_loads, i, logger);
+		do_balance(cur_space, cur_lb_controller, cur_game_loads, i, logger);
 		logger->info("balance finish");
 		draw_cell_region(cur_space, draw_config, cur_result_dir, "iter_" + std::to_string(i + 1));
 		dump_json_to_file(cur_space.encode(), cur_result_dir + "/" + "iter_" + std::to_string(i + 1) + ".json");
 	}
+	logger->warn("lb_case_3 operation_count {} oscillation_count {}", cur_lb_controller.operation_count(), cur_lb_controller.oscillation_count());
 }
 
 // 均衡划分 然后删除绝大部分entity 等待删除
@@ -614,6 +645,7 @@ void lb_case_4(const space_draw_config& draw_config, const std::string& dest_dir
 	cur_lb_param.min_game_load_when_split = 80;
 	cur_lb_param.min_sibling_game_load_diff_when_shrink = 15;
 
+	load_balance_controller cur_lb_controller(cur_lb_param, create_hysteresis_param());
 	std::string root_space_id = "space1";
 	std::vector<std::string> games = { "game0", "game1", "game2", "game3", "game4" };
 	space_cells cur_space(temp_bound, "game0", root_space_id, 400);
@@ -656,7 +688,7 @@ void lb_case_4(const space_draw_config& draw_config, const std::string& dest_dir
 		}
 		logger->info("game_loads {}", json(cur_game_loads).dump());
 		cur_space.update_load_stat(cur_game_loads);
-		do_balance(cur_space, cur_lb_param, cur_game_loads, i, logger);
+		do_balance(cur_space, cur_lb_controller, cur_game_loads, i, logger);
 		logger->info("balance finish");
 		draw_cell_region(cur_space, draw_config, cur_result_dir, "iter_" + std::to_string(i + 1));
 		dump_json_to_file(cur_space.encode(), cur_result_dir + "/" + "iter_" + std::to_string(i + 1) + ".json");
@@ -684,11 +716,12 @@ void lb_case_4(const space_draw_config& draw_config, const std::string& dest_dir
 		}
 		logger->info("game_loads {}", json(cur_game_loads).dump());
 		cur_space.update_load_stat(cur_game_loads);
-		do_balance(cur_space, cur_lb_param, cur_game_loads, i, logger);
+		do_balance(cur_space, cur_lb_controller, cur_game_loads, i, logger);
 		logger->info("balance finish");
 		draw_cell_region(cur_space, draw_config, cur_result_dir, "iter_" + std::to_string(i + 1));
 		dump_json_to_file(cur_space.encode(), cur_result_dir + "/" + "iter_" + std::to_string(i + 1) + ".json");
 	}
+	logger->warn("lb_case_4 operation_count {} oscillation_count {}", cur_lb_controller.operation_count(), cur_lb_controller.oscillation_count());
 }
 
 // 生成封面的case
@@ -0,0 +1,240 @@
+#include "space_cells.h"
+#include <random>
+#include <iostream>
+#include <deque>
+#include <unordered_set>
+
+using namespace spiritsaway::distributed_space;
+
+// 负载下降之后回收空闲cell的数量对比
+// 1. sibling: 只使用get_best_cell_to_merge 把cell合并到兄弟节点
+// 2. adjacent: 使用get_best_cell_to_merge_adjacent 可以把cell合并到共享完整边的任意叶子节点
+// 繁忙区域每个tick都会做shrink 导致繁忙的叶子节点汇报次数一直很低 兄弟子树包含繁忙cell的冷cell无法合并到兄弟子树
+// 场景random: 整个space先被随机切分 之后z较小的一半区域负载降为接近0 另一半区域仍然繁忙
+// 场景strip: 一直从master cell的左侧切出等宽的窄条 之后左侧一半的窄条负载降为接近0 右侧仍然繁忙
+// pending: 五个cell的x链中 从中间的cell切出一个没有ready的cell 然后把左侧第二个cell合并到最左侧的master cell
+// 最近公共祖先为根节点 检查重组之后没有ready的cell的兄弟节点与点查询结果不变 并且两次merge都可以完成
+
+void build_space(space_cells& cur_space, std::uint32_t leaf_num, std::mt19937& e1)
+{
+	std::deque<std::string> split_queue;
+	split_queue.push_back(cur_space.master_cell_id());
+	std::uint32_t cell_counter = 0;
+	std::uniform_real_distribution<double> ratio_dist(0.35, 0.65);
+	while (cur_space.all_leafs().size() < leaf_num)
+	{
+		auto cur_cell_id = split_queue.front();
+		split_queue.pop_front();
+		auto cur_bound = cur_space.get_leaf(cur_cell_id)->boundary();
+		auto new_cell_id = "cell" + std::to_string(++cell_counter);
+		auto new_game_id = "game" + std::to_string(cell_counter);
+		// 交替的方向切分 使得冷热区域的分界线穿过很多子树
+		if ((cell_counter % 3) != 0 && cur_bound.max.x - cur_bound.min.x > cur_bound.max.z - cur_bound.min.z)
+		{
+			cur_space.split_x(cur_bound.min.x + (cur_bound.max.x - cur_bound.min.x) * ratio_dist(e1), cur_cell_id, new_game_id, cur_cell_id, new_cell_id);
+		}
+		else
+		{
+			cur_space.split_z(cur_bound.min.z + (cur_bound.max.z - cur_bound.min.z) * ratio_dist(e1), cur_cell_id, new_game_id, cur_cell_id, new_cell_id);
+		}
+		cur_space.set_ready(new_cell_id);
+		split_queue.push_back(cur_cell_id);
+		split_queue.push_back(new_cell_id);
+	}
+}
+
+// 负载下降时z较小一半区域内的cell变为冷cell 之后接收了冷cell区域的热cell仍然是热cell
+std::unordered_set<std::string> hot_cell_ids;
+
+void build_strip_space(space_cells& cur_space, std::uint32_t leaf_num)
+{
+	auto strip_width = (cur_space.root_node()->boundary().max.x - cur_space.root_node()->boundary().min.x) / leaf_num;
+	for (std::uint32_t i = 1; i < leaf_num; i++)
+	{
+		auto master_bound = cur_space.get_leaf(cur_space.master_cell_id())->boundary();
+		auto new_cell_id = "cell" + std::to_string(i);
+		cur_space.split_x(master_bound.min.x + strip_width, cur_space.master_cell_id(), "game" + std::to_string(i), new_cell_id, cur_space.master_cell_id());
+		cur_space.set_ready(new_cell_id);
+	}
+}
+
+bool is_hot_cell(const space_cells::space_node* cur_cell)
+{
+	return hot_cell_ids.count(cur_cell->space_id()) != 0;
+}
+
+// 在繁忙区域内找到所有叶子节点都繁忙的内部节点 将其分割线来回移动一点 模拟持续的shrink
+void shrink_hot_nodes(space_cells& cur_space, std::uint32_t tick)
+{
+	std::vector<const space_cells::space_node*> hot_nodes;
+	std::vector<const space_cells::space_node*> temp_query_buffer;
+	temp_query_buffer.push_back(cur_space.root_node());
+	while (!temp_query_buffer.empty())
+	{
+		auto temp_top = temp_query_buffer.back();
+		temp_query_buffer.pop_back();
+		if (temp_top->is_leaf_cell())
+		{
+			continue;
+		}
+		if (is_hot_cell(temp_top->children()[0]) && is_hot_cell(temp_top->children()[1]) && temp_top->children()[0]->is_leaf_cell() && temp_top->children()[1]->is_leaf_cell())
+		{
+			hot_nodes.push_back(temp_top);
+			continue;
+		}
+		temp_query_buffer.push_back(temp_top->children()[0]);
+		temp_query_buffer.push_back(temp_top->children()[1]);
+	}
+	double offset = tick % 2 ? 1 : -1;
+	for (auto one_node : hot_nodes)
+	{
+		auto split_pos = one_node->is_split_x() ? one_node->children()[0]->boundary().max.x : one_node->children()[0]->boundary().max.z;
+		cur_space.balance(split_pos + offset, one_node);
+	}
+}
+
+std::unordered_map<std::string, float> report_loads(space_cells& cur_space)
+{
+	std::unordered_map<std::string, float> game_loads;
+	std::vector<entity_load> empty_loads;
+	for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+	{
+		float cur_load = is_hot_cell(one_cell) ? 80.0f : 0.5f;
+		cur_space.update_cell_load(one_cell_id, cur_load, empty_loads);
+		game_loads[one_cell->game_id()] += cur_load;
+	}
+	cur_space.update_load_stat(game_loads);
+	return game_loads;
+}
+
+std::uint32_t count_cold_cells(const space_cells& cur_space)
+{
+	std::uint32_t result = 0;
+	for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+	{
+		if (!is_hot_cell(one_cell))
+		{
+			result++;
+		}
+	}
+	return result;
+}
+
+void run_case(std::uint32_t leaf_num, bool is_strip, bool use_adjacent)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 100000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 100000;
+	std::mt19937 e1(leaf_num);
+	space_cells cur_space(temp_bound, "game0", "cell0", 10);
+	cur_space.set_ready("cell0");
+	if (is_strip)
+	{
+		build_strip_space(cur_space, leaf_num);
+	}
+	else
+	{
+		build_space(cur_space, leaf_num, e1);
+	}
+	hot_cell_ids.clear();
+	for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+	{
+		auto cur_axis = is_strip ? 0 : 1;
+		if ((one_cell->boundary().min[cur_axis] + one_cell->boundary().max[cur_axis]) / 2 > 50000)
+		{
+			hot_cell_ids.insert(one_cell_id);
+		}
+	}
+
+	cell_load_balance_param lb_param;
+	lb_param.max_cell_load_when_remove = 6;
+	lb_param.min_cell_load_report_counter_when_remove = 5;
+
+	std::cout << (is_strip ? "strip " : "random") << "\t" << (use_adjacent ? "adjacent" : "sibling ") << "\tleafs " << leaf_num << "\tcold_cells " << count_cold_cells(cur_space);
+	std::string merging_cell_id;
+	std::uint32_t reclaimed_num = 0;
+	for (std::uint32_t tick = 1; tick <= 400; tick++)
+	{
+		shrink_hot_nodes(cur_space, tick);
+		auto game_loads = report_loads(cur_space);
+		if (!merging_cell_id.empty())
+		{
+			if (!cur_space.finish_merge(merging_cell_id).empty())
+			{
+				reclaimed_num++;
+			}
+			merging_cell_id.clear();
+		}
+		else if (use_adjacent)
+		{
+			std::string dest_cell_id;
+			auto cur_cell = cur_space.get_best_cell_to_merge_adjacent(lb_param, dest_cell_id);
+			if (cur_cell && cur_space.start_merge_to(cur_cell->space_id(), dest_cell_id))
+			{
+				merging_cell_id = cur_cell->space_id();
+			}
+		}
+		else
+		{
+			auto cur_cell = cur_space.get_best_cell_to_merge(lb_param);
+			if (cur_cell)
+			{
+				auto cur_cell_id = cur_cell->space_id();
+				if (cur_space.start_merge(cur_cell_id))
+				{
+					merging_cell_id = cur_cell_id;
+				}
+			}
+		}
+		if (tick == 50 || tick == 100 || tick == 400)
+		{
+			std::cout << "\ttick_" << tick << "_cold_cells " << count_cold_cells(cur_space);
+		}
+	}
+	std::cout << "\treclaimed " << reclaimed_num << "\tdepth " << cur_space.calc_max_depth() << std::endl;
+}
+
+void run_pending_case()
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 1000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 1000;
+	space_cells cur_space(temp_bound, "game0", "c0", 10);
+	cur_space.set_ready("c0");
+	for (int i = 1; i < 5; i++)
+	{
+		auto pre_cell_id = "c" + std::to_string(i - 1);
+		auto new_cell_id = "c" + std::to_string(i);
+		cur_space.split_x(200 * i, pre_cell_id, "game" + std::to_string(i), pre_cell_id, new_cell_id);
+		cur_space.set_ready(new_cell_id);
+	}
+	cur_space.split_x(450, "c2", "game_u", "c2", "u");
+	auto pre_sibling = cur_space.get_leaf("u")->sibling();
+	auto pre_query_result = cur_space.query_leaf_for_point(500, 500);
+
+	bool is_merge_started = cur_space.start_merge_to("c1", "c0");
+	bool is_sibling_kept = cur_space.get_leaf("u")->sibling() == pre_sibling;
+	bool is_same_query = cur_space.query_leaf_for_point(500, 500) == pre_query_result;
+	bool is_merge_finished = !cur_space.finish_merge("c1").empty();
+	cur_space.set_ready("u");
+	is_merge_finished = cur_space.start_merge("u") && !cur_space.finish_merge("u").empty() && is_merge_finished;
+	std::cout << "pending\tmerge_to " << is_merge_started << "\tsibling_kept " << is_sibling_kept << "\tsame_query " << is_same_query << "\tfinish_merge " << is_merge_finished << std::endl;
+}
+
+int main()
+{
+	for (std::uint32_t leaf_num : { 64, 256 })
+	{
+		for (bool is_strip : { false, true })
+		{
+			run_case(leaf_num, is_strip, false);
+			run_case(leaf_num, is_strip, true);
+		}
+	}
+	run_pending_case();
+	return 0;
+}
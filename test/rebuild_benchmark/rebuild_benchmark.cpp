@@ -0,0 +1,150 @@
+#include "space_cells.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+
+using namespace spiritsaway::distributed_space;
+
+// 对比rebuild_internal_nodes前后树的深度 点查询与encode的耗时
+// 同时检查重建之后叶子节点的区域以及点查询结果不变 并且正在merge的cell依然可以finish_merge
+// pending: 五个cell的x链中 从中间的cell切出一个没有ready的cell 按照数量对半分时分割线正好在它与兄弟节点之间
+// 检查重建之后它的兄弟节点与点查询结果不变 并且ready之后可以与兄弟节点完成merge
+
+// 一直从master cell的左侧切出窄条 得到一个深度为strip_num的链状树
+// 然后将每四个窄条中的一个从下方再切一次
+void build_chain_space(space_cells& cur_space, std::uint32_t strip_num)
+{
+	std::vector<entity_load> empty_loads;
+	std::vector<std::string> strip_ids;
+	for (std::uint32_t i = 0; i < strip_num; i++)
+	{
+		cur_space.update_cell_load(cur_space.master_cell_id(), 1, empty_loads);
+		auto new_cell_id = "strip" + std::to_string(i);
+		cur_space.split_at_direction(cur_space.master_cell_id(), cell_split_direction::left_x, new_cell_id, "game" + std::to_string(i % 16));
+		cur_space.set_ready(new_cell_id);
+		strip_ids.push_back(new_cell_id);
+	}
+	for (std::uint32_t i = 0; i < strip_num; i += 4)
+	{
+		cur_space.update_cell_load(strip_ids[i], 1, empty_loads);
+		auto new_cell_id = "low" + std::to_string(i);
+		cur_space.split_at_direction(strip_ids[i], cell_split_direction::low_z, new_cell_id, "game" + std::to_string(i % 16));
+		cur_space.set_ready(new_cell_id);
+	}
+}
+
+bool is_same_bound(const cell_bound& a, const cell_bound& b)
+{
+	return a.min.x == b.min.x && a.min.z == b.min.z && a.max.x == b.max.x && a.max.z == b.max.z;
+}
+
+void run_case(std::uint32_t strip_num)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 100000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 100000;
+	double ghost_radius = 10;
+	space_cells cur_space(temp_bound, "game_master", "master", ghost_radius);
+	cur_space.set_ready("master");
+	build_chain_space(cur_space, strip_num);
+	// 让一个叶子节点处于merge中 重建时它与兄弟节点的父节点需要整体保留
+	auto merge_cell_id = "strip" + std::to_string(strip_num / 2 + 1);
+	cur_space.start_merge(merge_cell_id);
+
+	std::mt19937 e1(strip_num);
+	std::uniform_real_distribution<double> x_dist(temp_bound.max.x - strip_num * 4 * ghost_radius - 100, temp_bound.max.x);
+	std::uniform_real_distribution<double> z_dist(temp_bound.min.z, temp_bound.max.z);
+	std::vector<std::pair<double, double>> query_points;
+	for (int i = 0; i < 10000; i++)
+	{
+		query_points.emplace_back(x_dist(e1), z_dist(e1));
+	}
+	std::vector<const space_cells::space_node*> query_results(query_points.size());
+	auto run_queries = [&]()
+	{
+		for (std::size_t i = 0; i < query_points.size(); i++)
+		{
+			query_results[i] = cur_space.query_leaf_for_point(query_points[i].first, query_points[i].second);
+		}
+	};
+	std::unordered_map<std::string, cell_bound> pre_leaf_bounds;
+	for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+	{
+		pre_leaf_bounds[one_cell_id] = one_cell->boundary();
+	}
+	auto pre_depth = cur_space.calc_max_depth();
+	auto pre_query_us = measure_ms(run_queries, 5) * 1000 / query_points.size();
+	auto pre_query_results = query_results;
+	auto pre_encode_us = measure_ms([&]()
+		{
+			cur_space.encode();
+		}, 5) * 1000;
+
+	bool rebuild_result = false;
+	auto rebuild_us = measure_ms([&]()
+		{
+			rebuild_result = cur_space.rebuild_internal_nodes();
+		}, 1) * 1000;
+
+	auto post_depth = cur_space.calc_max_depth();
+	auto post_query_us = measure_ms(run_queries, 5) * 1000 / query_points.size();
+	auto post_encode_us = measure_ms([&]()
+		{
+			cur_space.encode();
+		}, 5) * 1000;
+	bool is_same = pre_leaf_bounds.size() == cur_space.all_leafs().size() && pre_query_results == query_results;
+	for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+	{
+		auto cur_iter = pre_leaf_bounds.find(one_cell_id);
+		if (cur_iter == pre_leaf_bounds.end() || !is_same_bound(cur_iter->second, one_cell->boundary()))
+		{
+			is_same = false;
+		}
+	}
+	bool is_merge_finished = !cur_space.finish_merge(merge_cell_id).empty();
+	std::cout << "leafs " << pre_leaf_bounds.size() << "\trebuild " << (rebuild_result ? "ok" : "fail") << "\trebuild_us " << rebuild_us;
+	std::cout << "\tdepth " << pre_depth << " -> " << post_depth;
+	std::cout << "\tquery_ns " << pre_query_us * 1000 << " -> " << post_query_us * 1000;
+	std::cout << "\tencode_us " << pre_encode_us << " -> " << post_encode_us;
+	std::cout << "\tsame_geometry " << is_same << "\tfinish_merge " << is_merge_finished << std::endl;
+}
+
+void run_pending_case()
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 1000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 1000;
+	space_cells cur_space(temp_bound, "game0", "c0", 10);
+	cur_space.set_ready("c0");
+	for (int i = 1; i < 5; i++)
+	{
+		auto pre_cell_id = "c" + std::to_string(i - 1);
+		auto new_cell_id = "c" + std::to_string(i);
+		cur_space.split_x(200 * i, pre_cell_id, "game" + std::to_string(i), pre_cell_id, new_cell_id);
+		cur_space.set_ready(new_cell_id);
+	}
+	cur_space.split_x(450, "c2", "game_u", "c2", "u");
+	auto pre_sibling = cur_space.get_leaf("u")->sibling();
+	auto pre_query_result = cur_space.query_leaf_for_point(500, 500);
+
+	bool rebuild_result = cur_space.rebuild_internal_nodes();
+	bool is_sibling_kept = cur_space.get_leaf("u")->sibling() == pre_sibling;
+	bool is_same_query = cur_space.query_leaf_for_point(500, 500) == pre_query_result;
+	cur_space.set_ready("u");
+	bool is_merge_finished = cur_space.start_merge("u") && !cur_space.finish_merge("u").empty();
+	std::cout << "pending\trebuild " << (rebuild_result ? "ok" : "fail") << "\tsibling_kept " << is_sibling_kept << "\tsame_query " << is_same_query << "\tfinish_merge " << is_merge_finished << std::endl;
+}
+
+int main()
+{
+	for (std::uint32_t strip_num : { 64, 512, 2048 })
+	{
+		run_case(strip_num);
+	}
+	run_pending_case();
+	return 0;
+}
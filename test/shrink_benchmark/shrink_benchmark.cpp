@@ -0,0 +1,170 @@
+#include "space_cells.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <deque>
+
+using namespace spiritsaway::distributed_space;
+
+// 对比get_best_node_to_shrink的深度优先逐个检查 与get_best_node_to_shrink_parallel的缓存并行评估
+
+// 每次都切分面积最大的叶子节点 构造一个有leaf_num个叶子的树
+void build_space(space_cells& cur_space, std::uint32_t leaf_num, std::uint32_t game_num, std::mt19937& e1)
+{
+	std::deque<std::string> split_queue;
+	split_queue.push_back(cur_space.master_cell_id());
+	std::uint32_t cell_counter = 0;
+	while (cur_space.all_leafs().size() < leaf_num)
+	{
+		auto cur_cell_id = split_queue.front();
+		split_queue.pop_front();
+		auto cur_bound = cur_space.get_leaf(cur_cell_id)->boundary();
+		auto new_cell_id = "cell" + std::to_string(++cell_counter);
+		auto new_game_id = "game" + std::to_string(cell_counter % game_num);
+		std::uniform_real_distribution<double> ratio_dist(0.4, 0.6);
+		if (cur_bound.max.x - cur_bound.min.x > cur_bound.max.z - cur_bound.min.z)
+		{
+			auto split_pos = cur_bound.min.x + (cur_bound.max.x - cur_bound.min.x) * ratio_dist(e1);
+			cur_space.split_x(split_pos, cur_cell_id, new_game_id, cur_cell_id, new_cell_id);
+		}
+		else
+		{
+			auto split_pos = cur_bound.min.z + (cur_bound.max.z - cur_bound.min.z) * ratio_dist(e1);
+			cur_space.split_z(split_pos, cur_cell_id, new_game_id, cur_cell_id, new_cell_id);
+		}
+		cur_space.set_ready(new_cell_id);
+		split_queue.push_back(cur_cell_id);
+		split_queue.push_back(new_cell_id);
+	}
+}
+
+// 依次从剩余区域的左 下 右 上四个方向切出窄条 构造一个深度接近leaf_num的螺旋状树
+void build_spiral_space(space_cells& cur_space, std::uint32_t leaf_num, std::uint32_t game_num)
+{
+	std::uint32_t cell_counter = 0;
+	auto cur_cell_id = cur_space.master_cell_id();
+	while (cur_space.all_leafs().size() < leaf_num)
+	{
+		auto cur_bound = cur_space.get_leaf(cur_cell_id)->boundary();
+		auto new_cell_id = "cell" + std::to_string(++cell_counter);
+		auto new_game_id = "game" + std::to_string(cell_counter % game_num);
+		// 每一圈四个方向各切一次 保证剩余区域在每个方向上都足够切完
+		double strip_ratio = 2.0 / (leaf_num - cur_space.all_leafs().size() + 4);
+		auto strip_x = (cur_bound.max.x - cur_bound.min.x) * strip_ratio;
+		auto strip_z = (cur_bound.max.z - cur_bound.min.z) * strip_ratio;
+		switch (cell_counter % 4)
+		{
+		case 0:
+			cur_space.split_x(cur_bound.min.x + strip_x, cur_cell_id, new_game_id, new_cell_id, cur_cell_id);
+			break;
+		case 1:
+			cur_space.split_z(cur_bound.min.z + strip_z, cur_cell_id, new_game_id, new_cell_id, cur_cell_id);
+			break;
+		case 2:
+			cur_space.split_x(cur_bound.max.x - strip_x, cur_cell_id, new_game_id, cur_cell_id, new_cell_id);
+			break;
+		default:
+			cur_space.split_z(cur_bound.max.z - strip_z, cur_cell_id, new_game_id, cur_cell_id, new_cell_id);
+			break;
+		}
+		cur_space.set_ready(new_cell_id);
+	}
+}
+
+std::unordered_map<std::string, float> report_loads(space_cells& cur_space, std::uint32_t game_num, std::mt19937& e1)
+{
+	std::uniform_real_distribution<float> load_dist(0, 100);
+	std::unordered_map<std::string, float> game_loads;
+	for (std::uint32_t i = 0; i < game_num; i++)
+	{
+		game_loads["game" + std::to_string(i)] = load_dist(e1) * 10;
+	}
+	std::vector<entity_load> empty_loads;
+	for (int i = 0; i < 4; i++)
+	{
+		for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+		{
+			cur_space.update_cell_load(one_cell_id, load_dist(e1), empty_loads);
+		}
+	}
+	cur_space.update_load_stat(game_loads);
+	return game_loads;
+}
+
+void run_case(const std::string& case_name, std::uint32_t leaf_num, bool is_spiral, const cell_load_balance_param& lb_param, double ghost_radius)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 100000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 100000;
+	std::mt19937 e1(leaf_num);
+	std::uint32_t game_num = std::max<std::uint32_t>(4, leaf_num / 8);
+	space_cells cur_space(temp_bound, "game0", "cell0", ghost_radius);
+	cur_space.set_ready("cell0");
+	if (is_spiral)
+	{
+		build_spiral_space(cur_space, leaf_num, game_num);
+	}
+	else
+	{
+		build_space(cur_space, leaf_num, game_num, e1);
+	}
+	auto game_loads = report_loads(cur_space, game_num, e1);
+	int repeat = leaf_num >= 10000 ? 3 : 20;
+
+	const space_cells::space_node* dfs_result = nullptr;
+	auto dfs_ms = measure_ms([&]()
+		{
+			dfs_result = cur_space.get_best_node_to_shrink(lb_param);
+		}, repeat);
+	const space_cells::space_node* cached_result = nullptr;
+	auto cached_ms = measure_ms([&]()
+		{
+			cached_result = cur_space.get_best_node_to_shrink_parallel(lb_param, nullptr);
+		}, repeat);
+	std::cout << case_name << (is_spiral ? "_spiral" : "_balanced") << "\tleafs " << leaf_num << "\tdfs_ms " << dfs_ms << "\tcached_ms " << cached_ms;
+	for (std::uint32_t thread_num : { 1, 2, 4, 8 })
+	{
+		thread_pool cur_pool(thread_num);
+		const space_cells::space_node* parallel_result = nullptr;
+		auto parallel_ms = measure_ms([&]()
+			{
+				parallel_result = cur_space.get_best_node_to_shrink_parallel(lb_param, &cur_pool);
+			}, repeat);
+		std::cout << "\tthreads_" << thread_num << "_ms " << parallel_ms;
+		if (parallel_result != cached_result)
+		{
+			std::cout << "(mismatch)";
+		}
+	}
+	std::cout << "\tdfs_result " << (dfs_result ? dfs_result->space_id() : "null") << "\tbest_result " << (cached_result ? cached_result->space_id() : "null") << std::endl;
+}
+
+int main()
+{
+	cell_load_balance_param cur_lb_param;
+	cur_lb_param.load_to_offset = 10;
+	cur_lb_param.max_cell_load_when_remove = 6;
+	cur_lb_param.min_cell_load_report_counter_when_remove = 10;
+	cur_lb_param.min_cell_load_report_counter_when_shrink = 2;
+	cur_lb_param.min_cell_load_report_counter_when_split = 4;
+	cur_lb_param.min_cell_load_when_shrink = 20;
+	cur_lb_param.min_cell_load_when_split = 40;
+	cur_lb_param.min_game_load_when_split = 80;
+	cur_lb_param.min_sibling_game_load_diff_when_shrink = 200;
+
+	// 所有节点都通过负载检查 但是都因为边界长度不足无法shrink 此时两种方式都需要检查所有节点
+	cell_load_balance_param full_scan_lb_param = cur_lb_param;
+	full_scan_lb_param.min_cell_load_when_shrink = 0;
+	full_scan_lb_param.min_sibling_game_load_diff_when_shrink = -1000000;
+	for (std::uint32_t leaf_num : { 100, 1000, 10000 })
+	{
+		for (bool is_spiral : { false, true })
+		{
+			run_case("full_scan", leaf_num, is_spiral, full_scan_lb_param, 100000);
+			run_case("with_candidates", leaf_num, is_spiral, cur_lb_param, 1);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,210 @@
+#include "space_cells.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <deque>
+
+using namespace spiritsaway::distributed_space;
+
+// 对比shrink时旧的十等分采样与新的排序累加两种方式计算新分割位置的耗时与精度
+// 精度使用|实际移出的负载 - 目标负载| / 目标负载来衡量
+
+// 旧版本的实现 在可移动范围内等间距的尝试10个位置 返回第一个移出负载超过目标的位置
+double sample_shrink_split_pos(const space_cells::space_node* cur_node, const cell_load_balance_param& lb_param, const double ghost_radius)
+{
+	auto cur_axis = cur_node->parent()->split_axis();
+	bool is_split_pos_smaller = cur_node->parent()->children()[0] == cur_node;
+	auto max_move_length = cur_node->calc_max_boundary_move_length(cur_axis, is_split_pos_smaller);
+	max_move_length -= 5 * ghost_radius;
+	auto move_unit = max_move_length / 10;
+	double cur_split_pos = 0;
+	for (int i = 0; i < 10; i++)
+	{
+		if (is_split_pos_smaller)
+		{
+			cur_split_pos = cur_node->boundary().max[cur_axis] - ghost_radius - i * move_unit;
+		}
+		else
+		{
+			cur_split_pos = cur_node->boundary().min[cur_axis] + ghost_radius + i * move_unit;
+		}
+		auto cur_offload = cur_node->calc_move_split_offload(cur_split_pos, cur_axis, is_split_pos_smaller);
+		if (cur_offload > lb_param.min_sibling_game_load_diff_when_shrink / 2)
+		{
+			break;
+		}
+	}
+	return cur_split_pos;
+}
+
+// 每次都切分面积最大的叶子节点 构造一个有leaf_num个叶子的树
+void build_space(space_cells& cur_space, std::uint32_t leaf_num, std::mt19937& e1)
+{
+	std::deque<std::string> split_queue;
+	split_queue.push_back(cur_space.master_cell_id());
+	std::uint32_t cell_counter = 0;
+	std::uniform_real_distribution<double> ratio_dist(0.4, 0.6);
+	while (cur_space.all_leafs().size() < leaf_num)
+	{
+		auto cur_cell_id = split_queue.front();
+		split_queue.pop_front();
+		auto cur_bound = cur_space.get_leaf(cur_cell_id)->boundary();
+		auto new_cell_id = "cell" + std::to_string(++cell_counter);
+		auto new_game_id = "game" + std::to_string(cell_counter);
+		if (cur_bound.max.x - cur_bound.min.x > cur_bound.max.z - cur_bound.min.z)
+		{
+			cur_space.split_x(cur_bound.min.x + (cur_bound.max.x - cur_bound.min.x) * ratio_dist(e1), cur_cell_id, new_game_id, cur_cell_id, new_cell_id);
+		}
+		else
+		{
+			cur_space.split_z(cur_bound.min.z + (cur_bound.max.z - cur_bound.min.z) * ratio_dist(e1), cur_cell_id, new_game_id, cur_cell_id, new_cell_id);
+		}
+		cur_space.set_ready(new_cell_id);
+		split_queue.push_back(cur_cell_id);
+		split_queue.push_back(new_cell_id);
+	}
+}
+
+// 每个叶子节点内随机放置entity_num个entity 一半均匀分布 一半聚集在一个随机中心附近
+// 汇报完所有叶子之后执行update_load_stat 计算shrink位置依赖其中统计的game容量
+void report_entity_loads(space_cells& cur_space, std::uint32_t entity_num, std::mt19937& e1)
+{
+	std::uniform_real_distribution<float> load_dist(0.5f, 2.0f);
+	std::uniform_real_distribution<double> ratio_dist(0, 1);
+	std::vector<entity_load> cur_entity_loads;
+	std::unordered_map<std::string, float> game_loads;
+	for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+	{
+		auto cur_bound = one_cell->boundary();
+		auto width = cur_bound.max.x - cur_bound.min.x;
+		auto height = cur_bound.max.z - cur_bound.min.z;
+		point_xz cluster_center;
+		cluster_center.x = cur_bound.min.x + width * ratio_dist(e1);
+		cluster_center.z = cur_bound.min.z + height * ratio_dist(e1);
+		std::normal_distribution<double> cluster_dist(0, 0.05);
+		cur_entity_loads.clear();
+		float total_load = 0;
+		for (std::uint32_t i = 0; i < entity_num; i++)
+		{
+			entity_load cur_load;
+			if (i % 2)
+			{
+				cur_load.pos.x = cur_bound.min.x + width * ratio_dist(e1);
+				cur_load.pos.z = cur_bound.min.z + height * ratio_dist(e1);
+			}
+			else
+			{
+				cur_load.pos.x = std::clamp(cluster_center.x + width * cluster_dist(e1), cur_bound.min.x, cur_bound.max.x);
+				cur_load.pos.z = std::clamp(cluster_center.z + height * cluster_dist(e1), cur_bound.min.z, cur_bound.max.z);
+			}
+			cur_load.load = load_dist(e1);
+			cur_load.is_real = true;
+			cur_load.name = "entity" + std::to_string(i);
+			total_load += cur_load.load;
+			cur_entity_loads.push_back(cur_load);
+		}
+		cur_space.update_cell_load(one_cell_id, total_load, cur_entity_loads);
+		game_loads[one_cell->game_id()] += total_load;
+	}
+	cur_space.update_load_stat(game_loads);
+}
+
+// 精确求解的平均误差不小于采样方式时返回false
+bool run_case(std::uint32_t leaf_num, std::uint32_t entity_num, float target_ratio, double ghost_radius)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 100000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 100000;
+	std::mt19937 e1(leaf_num * 7 + entity_num);
+	space_cells cur_space(temp_bound, "game0", "cell0", ghost_radius);
+	cur_space.set_ready("cell0");
+	build_space(cur_space, leaf_num, e1);
+	report_entity_loads(cur_space, entity_num, e1);
+
+	// 收集所有非根节点 以其为shrink节点计算新的分割位置
+	std::vector<const space_cells::space_node*> shrink_nodes;
+	std::vector<const space_cells::space_node*> temp_query_buffer;
+	temp_query_buffer.push_back(cur_space.root_node());
+	while (!temp_query_buffer.empty())
+	{
+		auto temp_top = temp_query_buffer.back();
+		temp_query_buffer.pop_back();
+		if (temp_top->parent())
+		{
+			shrink_nodes.push_back(temp_top);
+		}
+		if (!temp_top->is_leaf_cell())
+		{
+			temp_query_buffer.push_back(temp_top->children()[0]);
+			temp_query_buffer.push_back(temp_top->children()[1]);
+		}
+	}
+
+	// 每个节点的目标负载为边界移动到最大距离时能移出负载的target_ratio倍
+	// target_ratio越大 采样的方式需要尝试的位置越多 每次尝试都要从边界重新扫描
+	std::vector<cell_load_balance_param> node_lb_params(shrink_nodes.size());
+	for (std::size_t i = 0; i < shrink_nodes.size(); i++)
+	{
+		auto cur_node = shrink_nodes[i];
+		auto cur_axis = cur_node->parent()->split_axis();
+		bool is_split_pos_smaller = cur_node->parent()->children()[0] == cur_node;
+		auto max_move_length = cur_node->calc_max_boundary_move_length(cur_axis, is_split_pos_smaller) - 4 * ghost_radius;
+		auto max_split_pos = is_split_pos_smaller ? cur_node->boundary().max[cur_axis] - max_move_length : cur_node->boundary().min[cur_axis] + max_move_length;
+		node_lb_params[i].min_sibling_game_load_diff_when_shrink = cur_node->calc_move_split_offload(max_split_pos, cur_axis, is_split_pos_smaller) * target_ratio * 2;
+	}
+	std::vector<double> sample_pos(shrink_nodes.size());
+	std::vector<double> exact_pos(shrink_nodes.size());
+	int repeat = 5;
+	auto sample_us = measure_ms([&]()
+		{
+			for (std::size_t i = 0; i < shrink_nodes.size(); i++)
+			{
+				sample_pos[i] = sample_shrink_split_pos(shrink_nodes[i], node_lb_params[i], ghost_radius);
+			}
+		}, repeat) * 1000 / shrink_nodes.size();
+	auto exact_us = measure_ms([&]()
+		{
+			for (std::size_t i = 0; i < shrink_nodes.size(); i++)
+			{
+				exact_pos[i] = shrink_nodes[i]->calc_best_shrink_new_split_pos(node_lb_params[i], ghost_radius);
+			}
+		}, repeat) * 1000 / shrink_nodes.size();
+	double sample_error = 0;
+	double exact_error = 0;
+	for (std::size_t i = 0; i < shrink_nodes.size(); i++)
+	{
+		auto cur_node = shrink_nodes[i];
+		auto cur_axis = cur_node->parent()->split_axis();
+		bool is_split_pos_smaller = cur_node->parent()->children()[0] == cur_node;
+		auto target_offload = node_lb_params[i].min_sibling_game_load_diff_when_shrink / 2;
+		sample_error += std::abs(cur_node->calc_move_split_offload(sample_pos[i], cur_axis, is_split_pos_smaller) - target_offload) / target_offload;
+		exact_error += std::abs(cur_node->calc_move_split_offload(exact_pos[i], cur_axis, is_split_pos_smaller) - target_offload) / target_offload;
+	}
+	std::cout << "leafs " << leaf_num << "\tentities_per_leaf " << entity_num << "\ttarget_ratio " << target_ratio << "\tnodes " << shrink_nodes.size();
+	std::cout << "\tsample_us " << sample_us << "\texact_us " << exact_us;
+	std::cout << "\tsample_avg_error " << sample_error / shrink_nodes.size() << "\texact_avg_error " << exact_error / shrink_nodes.size() << std::endl;
+	if (exact_error >= sample_error)
+	{
+		std::cout << "exact_avg_error is not smaller than sample_avg_error" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main()
+{
+	bool is_all_passed = true;
+	for (std::uint32_t leaf_num : { 16, 256 })
+	{
+		for (std::uint32_t entity_num : { 100, 1000, 10000 })
+		{
+			for (float target_ratio : { 0.1f, 0.5f, 0.9f })
+			{
+				is_all_passed = run_case(leaf_num, entity_num, target_ratio, 10) && is_all_passed;
+			}
+		}
+	}
+	return is_all_passed ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+#include "space_cells.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <map>
+#include <iomanip>
+
+using namespace spiritsaway::distributed_space;
+
+// space_cells核心接口的耗时 叶子数量从1到10000 每个cell的entity数量从0到100000
+// 为了控制内存与耗时 叶子数量乘以entity数量不超过max_total_entities
+// 每一项结果以一行json输出 bench leafs entities_per_cell唯一确定一项 ns_per_op为单次操作的平均耗时
+// 用法:
+// space_cells_benchmark [--quick] [output.jsonl] 没有output时输出到标准输出
+// space_cells_benchmark --compare base.jsonl new.jsonl [threshold] 对比两次的结果 新的耗时超过旧耗时的threshold倍时标记为regression 默认1.1
+
+const std::uint64_t max_total_entities = 1000000;
+double min_measure_seconds = 0.2;
+
+struct bench_result
+{
+	std::string bench;
+	std::uint32_t leafs;
+	std::uint32_t entities_per_cell;
+	std::uint64_t ops;
+	double ns_per_op;
+	NLOHMANN_DEFINE_TYPE_INTRUSIVE(bench_result, bench, leafs, entities_per_cell, ops, ns_per_op)
+};
+
+// 重复执行func直到耗时超过min_measure_seconds 每次执行包含ops_per_call次操作
+template <typename F>
+bench_result measure(const std::string& bench, std::uint32_t leafs, std::uint32_t entities_per_cell, std::uint64_t ops_per_call, F&& func)
+{
+	std::uint64_t call_num = 0;
+	auto begin_ts = std::chrono::steady_clock::now();
+	double elapsed_seconds = 0;
+	do
+	{
+		func();
+		call_num++;
+		elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_ts).count();
+	} while (elapsed_seconds < min_measure_seconds);
+	bench_result result;
+	result.bench = bench;
+	result.leafs = leafs;
+	result.entities_per_cell = entities_per_cell;
+	result.ops = call_num * ops_per_call;
+	result.ns_per_op = elapsed_seconds * 1e9 / result.ops;
+	return result;
+}
+
+void run_case(std::uint32_t leaf_num, std::uint32_t entities_per_cell, std::ostream& os)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 100000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 100000;
+	double ghost_radius = 10;
+	space_cells cur_space(temp_bound, "game0", "cell0", ghost_radius);
+	cur_space.set_ready("cell0");
+	std::uint32_t cell_counter = 0;
+	split_balanced(cur_space, "cell0", temp_bound, leaf_num, cell_counter);
+
+	// 不同的cell使用不同的entity负载 使得shrink与split有候选
+	std::mt19937 e1(leaf_num * 7 + entities_per_cell);
+	std::vector<std::string> cell_ids;
+	std::vector<float> cell_loads;
+	std::vector<std::vector<entity_load>> cell_entity_loads;
+	std::unordered_map<std::string, float> game_loads;
+	for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+	{
+		const auto& cur_bound = one_cell->boundary();
+		std::uniform_real_distribution<double> x_dist(cur_bound.min.x, cur_bound.max.x);
+		std::uniform_real_distribution<double> z_dist(cur_bound.min.z, cur_bound.max.z);
+		std::vector<entity_load> cur_entity_loads(entities_per_cell);
+		float cur_entity_load = 1.0f + 0.5f * (cell_ids.size() % 4);
+		for (auto& one_entity_load : cur_entity_loads)
+		{
+			one_entity_load.pos.x = x_dist(e1);
+			one_entity_load.pos.z = z_dist(e1);
+			one_entity_load.load = cur_entity_load;
+			one_entity_load.is_real = true;
+		}
+		cell_ids.push_back(one_cell_id);
+		cell_loads.push_back(1 + cur_entity_load * entities_per_cell);
+		game_loads[one_cell->game_id()] = cell_loads.back();
+		cell_entity_loads.push_back(std::move(cur_entity_loads));
+	}
+	auto report_all = [&]()
+	{
+		for (std::size_t i = 0; i < cell_ids.size(); i++)
+		{
+			cur_space.update_cell_load(cell_ids[i], cell_loads[i], cell_entity_loads[i]);
+		}
+	};
+	report_all();
+	report_all();
+	cur_space.update_load_stat(game_loads);
+
+	cell_load_balance_param lb_param;
+	lb_param.load_to_offset = 10;
+	lb_param.max_cell_load_when_remove = 0;
+	lb_param.min_cell_load_report_counter_when_remove = 1000;
+	lb_param.min_cell_load_report_counter_when_shrink = 1;
+	lb_param.min_cell_load_report_counter_when_split = 1;
+	lb_param.min_cell_load_when_shrink = 1;
+	lb_param.min_cell_load_when_split = 1;
+	lb_param.min_game_load_when_split = 1;
+	lb_param.min_sibling_game_load_diff_when_shrink = 1;
+
+	const std::uint32_t query_num = 10000;
+	std::uniform_real_distribution<double> pos_dist(0, 100000);
+	std::vector<point_xz> query_points(query_num);
+	std::vector<cell_bound> query_bounds(query_num);
+	for (std::uint32_t i = 0; i < query_num; i++)
+	{
+		query_points[i].x = pos_dist(e1);
+		query_points[i].z = pos_dist(e1);
+		query_bounds[i].min.x = query_points[i].x - 2 * ghost_radius;
+		query_bounds[i].min.z = query_points[i].z - 2 * ghost_radius;
+		query_bounds[i].max.x = query_points[i].x + 2 * ghost_radius;
+		query_bounds[i].max.z = query_points[i].z + 2 * ghost_radius;
+	}
+	// 防止结果被优化掉
+	std::uint64_t sink = 0;
+	std::vector<bench_result> results;
+	results.push_back(measure("query_leaf_for_point", leaf_num, entities_per_cell, query_num, [&]()
+		{
+			for (const auto& one_point : query_points)
+			{
+				sink += cur_space.query_leaf_for_point(one_point.x, one_point.z) != nullptr;
+			}
+		}));
+	results.push_back(measure("query_intersect_leafs", leaf_num, entities_per_cell, query_num, [&]()
+		{
+			for (const auto& one_bound : query_bounds)
+			{
+				sink += cur_space.query_intersect_leafs(one_bound).size();
+			}
+		}));
+	results.push_back(measure("update_cell_load", leaf_num, entities_per_cell, cell_ids.size(), report_all));
+	results.push_back(measure("update_load_stat", leaf_num, entities_per_cell, 1, [&]()
+		{
+			cur_space.update_load_stat(game_loads);
+		}));
+	results.push_back(measure("get_best_cell_to_split", leaf_num, entities_per_cell, 1, [&]()
+		{
+			sink += cur_space.get_best_cell_to_split(game_loads, lb_param) != nullptr;
+		}));
+	results.push_back(measure("get_best_node_to_shrink", leaf_num, entities_per_cell, 1, [&]()
+		{
+			sink += cur_space.get_best_node_to_shrink(lb_param) != nullptr;
+		}));
+	results.push_back(measure("calc_best_split_direction", leaf_num, entities_per_cell, cell_ids.size(), [&]()
+		{
+			for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+			{
+				sink += int(one_cell->calc_best_split_direction(ghost_radius));
+			}
+		}));
+	json encode_result;
+	results.push_back(measure("encode", leaf_num, entities_per_cell, 1, [&]()
+		{
+			encode_result = cur_space.encode();
+		}));
+	results.push_back(measure("decode", leaf_num, entities_per_cell, 1, [&]()
+		{
+			space_cells temp_space(temp_bound, "game0", "cell0", ghost_radius);
+			sink += temp_space.decode(encode_result);
+		}));
+	for (const auto& one_result : results)
+	{
+		os << json(one_result).dump() << std::endl;
+	}
+	if (sink == 0)
+	{
+		std::cerr << "unexpected empty result" << std::endl;
+	}
+}
+
+std::map<std::string, bench_result> load_results(const std::string& file_path)
+{
+	std::map<std::string, bench_result> result;
+	std::ifstream ifs(file_path);
+	std::string cur_line;
+	while (std::getline(ifs, cur_line))
+	{
+		auto cur_json = json::parse(cur_line, nullptr, false);
+		if (cur_json.is_discarded())
+		{
+			continue;
+		}
+		try
+		{
+			auto cur_result = cur_json.get<bench_result>();
+			result[cur_result.bench + " " + std::to_string(cur_result.leafs) + " " + std::to_string(cur_result.entities_per_cell)] = cur_result;
+		}
+		catch (const std::exception& e)
+		{
+			(void)e;
+		}
+	}
+	return result;
+}
+
+int compare_results(const std::string& base_path, const std::string& new_path, double threshold)
+{
+	auto base_results = load_results(base_path);
+	auto new_results = load_results(new_path);
+	std::uint32_t regression_num = 0;
+	std::cout << std::left << std::setw(60) << "bench leafs entities_per_cell" << std::setw(14) << "base_ns" << std::setw(14) << "new_ns" << "ratio" << std::endl;
+	for (const auto& [one_key, one_new_result] : new_results)
+	{
+		auto base_iter = base_results.find(one_key);
+		if (base_iter == base_results.end())
+		{
+			continue;
+		}
+		auto cur_ratio = one_new_result.ns_per_op / base_iter->second.ns_per_op;
+		std::cout << std::left << std::setw(60) << one_key << std::setw(14) << base_iter->second.ns_per_op << std::setw(14) << one_new_result.ns_per_op << cur_ratio;
+		if (cur_ratio > threshold)
+		{
+			std::cout << "\tregression";
+			regression_num++;
+		}
+		std::cout << std::endl;
+	}
+	std::cout << "regression_num " << regression_num << std::endl;
+	return regression_num ? 1 : 0;
+}
+
+int main(int argc, const char** argv)
+{
+	std::vector<std::string> args(argv + 1, argv + argc);
+	if (!args.empty() && args[0] == "--compare")
+	{
+		if (args.size() < 3)
+		{
+			std::cout << "usage: space_cells_benchmark --compare base.jsonl new.jsonl [threshold]" << std::endl;
+			return 1;
+		}
+		return compare_results(args[1], args[2], args.size() > 3 ? std::stod(args[3]) : 1.1);
+	}
+	if (!args.empty() && args[0] == "--quick")
+	{
+		min_measure_seconds = 0.02;
+		args.erase(args.begin());
+	}
+	std::ofstream ofs;
+	if (!args.empty())
+	{
+		ofs.open(args[0]);
+	}
+	std::ostream& os = ofs.is_open() ? static_cast<std::ostream&>(ofs) : std::cout;
+	for (std::uint32_t leaf_num : { 1, 16, 256, 1024, 10000 })
+	{
+		for (std::uint32_t entities_per_cell : { 0, 100, 1000, 10000, 100000 })
+		{
+			if (std::uint64_t(leaf_num) * entities_per_cell > max_total_entities)
+			{
+				continue;
+			}
+			run_case(leaf_num, entities_per_cell, os);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,127 @@
+#include "space_journal.h"
+#include "entity_cost_model.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+using namespace spiritsaway::distributed_space;
+
+// 回放space_journal_writer写入的journal
+// 用法: space_journal_replay journal.bin [tick] [output.json] [setup.json]
+// 没有tick时回放所有记录 有tick时停在这个tick结束的状态
+// 有output时把回放之后的space_cells::encode写入output 可以与原来的快照对比 或者对两个tick的结果二分查找问题出现的位置
+// 只需要后面的参数时 tick与output可以使用-占位
+// setup为journal没有记录的配置 每次回放snapshot之后设置到新的space_cells上 所有字段都是可选的
+// {"aoi_cost_model": {"aoi_radius": 50, "neighbor_weight": 0.01}, "ghost_class_radiuses": [[1, 10]], "ghost_radius_regions": [{"bound": {...}, "radius": 10}]}
+// 回放的统计信息以json输出到标准输出
+
+// 读取setup文件 格式错误时返回false
+bool load_space_setup(const char* path, space_journal_replayer& cur_replayer)
+{
+	std::ifstream ifs(path);
+	auto setup_json = json::parse(ifs, nullptr, false);
+	if (setup_json.is_discarded() || !setup_json.is_object())
+	{
+		return false;
+	}
+	std::shared_ptr<const entity_cost_model> cost_model;
+	std::vector<std::pair<std::uint8_t, double>> class_radiuses;
+	std::vector<std::pair<cell_bound, double>> radius_regions;
+	try
+	{
+		if (setup_json.contains("aoi_cost_model"))
+		{
+			const auto& model_json = setup_json.at("aoi_cost_model");
+			cost_model = std::make_shared<aoi_density_cost_model>(model_json.at("aoi_radius").get<double>(), model_json.at("neighbor_weight").get<float>());
+		}
+		if (setup_json.contains("ghost_class_radiuses"))
+		{
+			setup_json.at("ghost_class_radiuses").get_to(class_radiuses);
+		}
+		if (setup_json.contains("ghost_radius_regions"))
+		{
+			for (const auto& one_region : setup_json.at("ghost_radius_regions"))
+			{
+				radius_regions.emplace_back(one_region.at("bound").get<cell_bound>(), one_region.at("radius").get<double>());
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		(void)e;
+		return false;
+	}
+	cur_replayer.set_space_setup([=](space_cells& cur_space)
+		{
+			cur_space.set_entity_cost_model(cost_model);
+			for (const auto& [one_class, one_radius] : class_radiuses)
+			{
+				cur_space.set_ghost_class_radius(one_class, one_radius);
+			}
+			for (const auto& [one_bound, one_radius] : radius_regions)
+			{
+				cur_space.add_ghost_radius_region(one_bound, one_radius);
+			}
+		});
+	return true;
+}
+
+int main(int argc, const char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "usage: space_journal_replay journal.bin [tick] [output.json] [setup.json]" << std::endl;
+		return 1;
+	}
+	std::ifstream ifs(argv[1], std::ios::binary);
+	if (!ifs)
+	{
+		std::cout << "fail to open " << argv[1] << std::endl;
+		return 1;
+	}
+	std::ostringstream oss;
+	oss << ifs.rdbuf();
+	auto journal_data = oss.str();
+	space_journal_replayer cur_replayer(journal_data);
+	if (!cur_replayer.valid())
+	{
+		std::cout << "invalid journal " << argv[1] << std::endl;
+		return 1;
+	}
+	if (argc >= 5 && !load_space_setup(argv[4], cur_replayer))
+	{
+		std::cout << "invalid setup " << argv[4] << std::endl;
+		return 1;
+	}
+	auto begin_ts = std::chrono::steady_clock::now();
+	bool reach_tick = true;
+	if (argc >= 3 && std::string(argv[2]) != "-")
+	{
+		reach_tick = cur_replayer.replay_until(std::uint32_t(std::stoul(argv[2])));
+	}
+	else
+	{
+		while (cur_replayer.step())
+		{
+		}
+	}
+	auto total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_ts).count();
+	json result;
+	result["journal_bytes"] = journal_data.size();
+	result["record_num"] = cur_replayer.record_num();
+	result["failed_num"] = cur_replayer.failed_num();
+	result["corrupted"] = cur_replayer.corrupted();
+	result["tick"] = cur_replayer.current_tick();
+	result["reach_tick"] = reach_tick;
+	result["replay_ms"] = total_seconds * 1000;
+	result["records_per_second"] = total_seconds > 0 ? cur_replayer.record_num() / total_seconds : 0;
+	result["leaf_num"] = cur_replayer.space() ? cur_replayer.space()->all_leafs().size() : 0;
+	std::cout << result.dump() << std::endl;
+	if (argc >= 4 && std::string(argv[3]) != "-" && cur_replayer.space())
+	{
+		std::ofstream ofs(argv[3]);
+		ofs << cur_replayer.space()->encode().dump();
+	}
+	return reach_tick && !cur_replayer.corrupted() ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+#include "space_manager.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+using namespace spiritsaway::distributed_space;
+
+// 大量副本共享一个game池时 一个game上的副本同时出现负载突增之后的恢复情况对比
+// 所有副本的负载都略高于split阈值 game0上的副本额外涌入大量玩家
+// 1. isolated: 每个space有自己的load_balance_controller 都使用tick开始时的game负载快照
+//    同一个tick内的多个space看不到彼此的分配 预算非0时按照轮转的顺序执行 直到用完预算
+// 2. manager: 使用space_manager 共用一张game负载表 每个tick最多执行max_operations_per_tick个操作 优先处理利用率最高的game上的space
+// split出来的cell在game_ready_delay个tick之后才ready 在此之前其中的entity仍然计入原cell所在的game
+// 所以game负载的下降总是比操作晚game_ready_delay个tick 两种方式的time_to_relief都包含这个延迟
+
+const std::uint32_t space_num = 120;
+const std::uint32_t game_num = 8;
+const std::uint32_t game_ready_delay = 5;
+
+struct space_sim
+{
+	std::string space_id;
+	space_cells* cells;
+	std::vector<bench_entity> entities;
+};
+
+struct bench_env
+{
+	std::vector<space_sim> spaces;
+	pending_ready_cells pending_cells;
+	std::unordered_map<std::string, float> game_loads;
+	std::uint32_t max_ops_per_tick = 0;
+	std::uint32_t total_ops = 0;
+};
+
+// 汇报所有cell的负载 返回真实的game负载
+void report_loads(bench_env& cur_env, std::uint32_t tick)
+{
+	cur_env.pending_cells.update(tick);
+	for (auto& one_game_load : cur_env.game_loads)
+	{
+		one_game_load.second = 0;
+	}
+	for (auto& one_space : cur_env.spaces)
+	{
+		std::unordered_map<std::string, std::vector<entity_load>> cell_entity_loads;
+		auto cell_loads = migrate_entities(*one_space.cells, one_space.entities, cell_entity_loads);
+		for (const auto& [one_cell_id, one_cell] : one_space.cells->all_leafs())
+		{
+			cur_env.game_loads[one_cell->game_id()] += cell_loads[one_cell_id];
+			if (one_cell->ready())
+			{
+				one_space.cells->update_cell_load(one_cell_id, cell_loads[one_cell_id], cell_entity_loads[one_cell_id]);
+			}
+		}
+	}
+}
+
+float max_game_load(const bench_env& cur_env)
+{
+	float result = 0;
+	for (const auto& [one_game_id, one_game_load] : cur_env.game_loads)
+	{
+		result = std::max(result, one_game_load);
+	}
+	return result;
+}
+
+space_manager_param create_param()
+{
+	space_manager_param result;
+	result.lb_param.load_to_offset = 20;
+	result.lb_param.max_cell_load_when_remove = 0;
+	result.lb_param.min_cell_load_report_counter_when_remove = 1000;
+	result.lb_param.min_cell_load_report_counter_when_shrink = 2;
+	result.lb_param.min_cell_load_report_counter_when_split = 3;
+	result.lb_param.min_cell_load_when_shrink = 1000;
+	result.lb_param.min_cell_load_when_split = 60;
+	result.lb_param.min_game_load_when_split = 1000;
+	result.lb_param.min_sibling_game_load_diff_when_shrink = 1000;
+	result.hysteresis_param.cell_cooldown_ticks = 3;
+	result.hysteresis_param.game_cooldown_ticks = 0;
+	result.hysteresis_param.min_cell_lifetime_ticks = 10;
+	result.hysteresis_param.max_merged_load_ratio_when_remove = 0.7f;
+	result.hysteresis_param.oscillation_window_ticks = 10;
+	result.assign_param.max_game_load_per_capacity = 1100;
+	result.assign_param.adjacent_game_weight = 0;
+	return result;
+}
+
+void init_entities(bench_env& cur_env, std::mt19937& e1)
+{
+	std::uniform_real_distribution<double> pos_dist(1, 1599);
+	std::normal_distribution<double> spike_dist(0, 300);
+	for (std::uint32_t i = 0; i < cur_env.spaces.size(); i++)
+	{
+		auto& cur_space = cur_env.spaces[i];
+		for (std::uint32_t j = 0; j < 70; j++)
+		{
+			bench_entity cur_entity;
+			cur_entity.pos.x = pos_dist(e1);
+			cur_entity.pos.z = pos_dist(e1);
+			cur_entity.host_cell_id = cur_space.cells->master_cell_id();
+			cur_space.entities.push_back(cur_entity);
+		}
+		// game0上的所有副本同时涌入大量玩家
+		if (i % game_num == 0)
+		{
+			for (std::uint32_t j = 0; j < 200; j++)
+			{
+				bench_entity cur_entity;
+				cur_entity.pos.x = std::clamp(800 + spike_dist(e1), 1.0, 1599.0);
+				cur_entity.pos.z = std::clamp(800 + spike_dist(e1), 1.0, 1599.0);
+				cur_entity.host_cell_id = cur_space.cells->master_cell_id();
+				cur_space.entities.push_back(cur_entity);
+			}
+		}
+	}
+}
+
+cell_bound space_bound()
+{
+	cell_bound result;
+	result.min.x = 0;
+	result.max.x = 1600;
+	result.min.z = 0;
+	result.max.z = 1600;
+	return result;
+}
+
+void print_result(const std::string& name, const bench_env& cur_env, std::uint32_t relief_tick, float peak_game_load)
+{
+	std::cout << name << "\tpeak_game_load " << peak_game_load << "\tfinal_max_game_load " << max_game_load(cur_env);
+	std::cout << "\ttime_to_relief " << (relief_tick ? std::to_string(relief_tick) : std::string(">400"));
+	std::cout << "\ttotal_ops " << cur_env.total_ops << "\tmax_ops_per_tick " << cur_env.max_ops_per_tick << std::endl;
+}
+
+void run_isolated(float relief_load, std::uint32_t max_operations_per_tick)
+{
+	auto cur_param = create_param();
+	bench_env cur_env;
+	std::vector<std::unique_ptr<space_cells>> all_cells;
+	std::vector<std::unique_ptr<load_balance_controller>> all_controllers;
+	std::vector<std::uint32_t> cell_counters(space_num, 0);
+	for (std::uint32_t i = 0; i < space_num; i++)
+	{
+		auto space_id = "space" + std::to_string(i);
+		all_cells.push_back(std::make_unique<space_cells>(space_bound(), "game" + std::to_string(i % game_num), space_id + "_cell0", 25));
+		all_cells.back()->set_ready(space_id + "_cell0");
+		all_controllers.push_back(std::make_unique<load_balance_controller>(cur_param.lb_param, cur_param.hysteresis_param));
+		cur_env.spaces.push_back(space_sim{ space_id, all_cells.back().get(), {} });
+	}
+	for (std::uint32_t i = 0; i < game_num; i++)
+	{
+		cur_env.game_loads["game" + std::to_string(i)] = 0;
+	}
+	std::mt19937 e1(1);
+	init_entities(cur_env, e1);
+	std::uint32_t relief_tick = 0;
+	float peak_game_load = 0;
+	for (std::uint32_t tick = 0; tick < 400; tick++)
+	{
+		report_loads(cur_env, tick);
+		peak_game_load = std::max(peak_game_load, max_game_load(cur_env));
+		if (tick > 0 && !relief_tick && max_game_load(cur_env) <= relief_load)
+		{
+			relief_tick = tick;
+		}
+		// 所有space都使用同一个快照
+		auto game_load_snapshot = cur_env.game_loads;
+		std::uint32_t cur_ops = 0;
+		for (std::uint32_t j = 0; j < space_num; j++)
+		{
+			if (max_operations_per_tick && cur_ops >= max_operations_per_tick)
+			{
+				break;
+			}
+			auto i = (j + tick * max_operations_per_tick) % space_num;
+			auto& cur_space = *all_cells[i];
+			auto& cur_controller = *all_controllers[i];
+			cur_controller.tick();
+			cur_space.update_load_stat(game_load_snapshot);
+			auto cur_split_node = cur_controller.get_best_cell_to_split(cur_space, game_load_snapshot);
+			if (!cur_split_node)
+			{
+				continue;
+			}
+			auto cur_split_direction = cur_split_node->calc_best_split_direction(cur_space.ghost_radius());
+			auto cur_split_cell_id = cur_split_node->space_id();
+			auto new_game_id = cur_space.choose_game_for_new_cell(cur_split_cell_id, cur_split_direction, game_load_snapshot, cur_param.assign_param);
+			auto new_cell_id = cur_env.spaces[i].space_id + "_cell" + std::to_string(++cell_counters[i]);
+			auto new_cell = cur_space.split_at_direction(cur_split_cell_id, cur_split_direction, new_cell_id, new_game_id);
+			if (!new_cell)
+			{
+				continue;
+			}
+			cur_controller.on_split(cur_space.get_leaf(cur_split_cell_id), new_cell);
+			cur_env.pending_cells.add(tick + game_ready_delay, &cur_space, new_cell_id);
+			cur_ops++;
+		}
+		cur_env.total_ops += cur_ops;
+		cur_env.max_ops_per_tick = std::max(cur_env.max_ops_per_tick, cur_ops);
+	}
+	print_result("isolated budget " + (max_operations_per_tick ? std::to_string(max_operations_per_tick) : std::string("-")) + (max_operations_per_tick < 10 ? " " : ""), cur_env, relief_tick, peak_game_load);
+}
+
+void run_manager(float relief_load, std::uint32_t max_operations_per_tick)
+{
+	auto cur_param = create_param();
+	cur_param.max_operations_per_tick = max_operations_per_tick;
+	space_manager cur_manager(cur_param);
+	bench_env cur_env;
+	for (std::uint32_t i = 0; i < game_num; i++)
+	{
+		cur_manager.register_game("game" + std::to_string(i), 1);
+		cur_env.game_loads["game" + std::to_string(i)] = 0;
+	}
+	for (std::uint32_t i = 0; i < space_num; i++)
+	{
+		auto space_id = "space" + std::to_string(i);
+		auto cur_cells = cur_manager.create_space(space_id, space_bound(), "game" + std::to_string(i % game_num), space_id + "_cell0", 25);
+		cur_env.spaces.push_back(space_sim{ space_id, cur_cells, {} });
+	}
+	std::mt19937 e1(1);
+	init_entities(cur_env, e1);
+	std::uint32_t relief_tick = 0;
+	float peak_game_load = 0;
+	for (std::uint32_t tick = 0; tick < 400; tick++)
+	{
+		report_loads(cur_env, tick);
+		peak_game_load = std::max(peak_game_load, max_game_load(cur_env));
+		if (tick > 0 && !relief_tick && max_game_load(cur_env) <= relief_load)
+		{
+			relief_tick = tick;
+		}
+		for (const auto& [one_game_id, one_game_load] : cur_env.game_loads)
+		{
+			cur_manager.update_game_load(one_game_id, one_game_load);
+		}
+		auto cur_operations = cur_manager.tick();
+		for (const auto& one_operation : cur_operations)
+		{
+			if (one_operation.op == cell_load_balance_operation::split)
+			{
+				cur_env.pending_cells.add(tick + game_ready_delay, cur_manager.get_space(one_operation.space_id), one_operation.related_cell_id);
+			}
+		}
+		cur_env.total_ops += std::uint32_t(cur_operations.size());
+		cur_env.max_ops_per_tick = std::max(cur_env.max_ops_per_tick, std::uint32_t(cur_operations.size()));
+	}
+	print_result("manager  budget " + std::to_string(max_operations_per_tick) + (max_operations_per_tick < 10 ? " " : ""), cur_env, relief_tick, peak_game_load);
+}
+
+int main()
+{
+	// 每个game的平均负载为(70 * 120 + 200 * 15) / 8 = 1425
+	float relief_load = 1.2f * 1425;
+	run_isolated(relief_load, 0);
+	for (std::uint32_t one_budget : { 2, 4, 8 })
+	{
+		run_isolated(relief_load, one_budget);
+		run_manager(relief_load, one_budget);
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+#include "space_snapshot.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <fstream>
+
+using namespace spiritsaway::distributed_space;
+
+// encode/decode的json路径与二进制快照的对比
+// 每一项结果以一行json输出 同时检查二进制快照恢复之后的encode结果与原来的完全相同
+// json路径为 encode + dump 与 parse + decode
+// 二进制路径为 encode_binary 写文件之后mmap打开 decode_binary分别测试全部恢复与只恢复拓扑
+// view_iterate_ms为直接在mmap的数据上遍历所有entity_load求和 不创建任何对象
+// 用法: space_snapshot_benchmark [temp_file] 默认写到当前目录下的space_snapshot_benchmark.bin
+
+bool run_case(std::uint32_t leaf_num, std::uint32_t entity_per_cell, const std::string& temp_file)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 100000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 100000;
+	space_cells cur_space(temp_bound, "game0", "cell0", 100);
+	cur_space.set_ready("cell0");
+	std::uint32_t cell_counter = 0;
+	split_balanced(cur_space, "cell0", temp_bound, leaf_num, cell_counter);
+
+	std::mt19937 e1(leaf_num * 7 + entity_per_cell);
+	std::uniform_real_distribution<double> unit_dist(0, 1);
+	std::uint32_t entity_counter = 0;
+	std::vector<entity_load> temp_entity_loads;
+	for (const auto& one_pair : cur_space.all_leafs())
+	{
+		const auto& cur_bound = one_pair.second->boundary();
+		temp_entity_loads.resize(entity_per_cell);
+		for (auto& one_entity : temp_entity_loads)
+		{
+			one_entity.pos.x = cur_bound.min.x + (cur_bound.max.x - cur_bound.min.x) * unit_dist(e1);
+			one_entity.pos.z = cur_bound.min.z + (cur_bound.max.z - cur_bound.min.z) * unit_dist(e1);
+			one_entity.load = float(unit_dist(e1));
+			one_entity.is_real = unit_dist(e1) < 0.8;
+			one_entity.name = "entity" + std::to_string(entity_counter++);
+		}
+		cur_space.update_cell_load(one_pair.first, float(entity_per_cell), temp_entity_loads);
+		cur_space.set_game_capacity(one_pair.second->game_id(), 1.0f);
+	}
+	auto origin_json = cur_space.encode();
+
+	std::string json_data;
+	auto json_encode_ms = measure_ms([&]()
+		{
+			json_data = cur_space.encode().dump();
+		});
+	space_cells json_space(temp_bound, "game0", "cell0", 100);
+	auto json_decode_ms = measure_ms([&]()
+		{
+			json_space.decode(json::parse(json_data));
+		});
+
+	std::string binary_data;
+	auto binary_encode_ms = measure_ms([&]()
+		{
+			cur_space.encode_binary(binary_data);
+		});
+	{
+		std::ofstream ofs(temp_file, std::ios::binary);
+		ofs.write(binary_data.data(), binary_data.size());
+	}
+	space_snapshot_file cur_file;
+	space_snapshot_view cur_view;
+	bool is_valid = false;
+	auto mmap_open_ms = measure_ms([&]()
+		{
+			is_valid = cur_file.open(temp_file) && cur_view.init(cur_file.data(), cur_file.size());
+		});
+	if (!is_valid)
+	{
+		std::cout << "fail to open snapshot " << temp_file << std::endl;
+		return false;
+	}
+	double total_load = 0;
+	auto view_iterate_ms = measure_ms([&]()
+		{
+			for (std::uint32_t i = 0; i < cur_view.node_num(); i++)
+			{
+				const auto& cur_node = cur_view.node(i);
+				auto cur_entity_loads = cur_view.entity_loads(cur_node);
+				for (std::uint32_t j = 0; j < cur_node.entity_num; j++)
+				{
+					total_load += cur_entity_loads[j].load;
+				}
+			}
+		});
+	space_cells binary_space(temp_bound, "game0", "cell0", 100);
+	bool decode_ok = false;
+	auto binary_decode_ms = measure_ms([&]()
+		{
+			decode_ok = binary_space.decode_binary(cur_view);
+		});
+	space_cells lazy_space(temp_bound, "game0", "cell0", 100);
+	bool lazy_decode_ok = false;
+	auto lazy_decode_ms = measure_ms([&]()
+		{
+			lazy_decode_ok = lazy_space.decode_binary(cur_view, false);
+		});
+	auto lazy_load_one_ms = measure_ms([&]()
+		{
+			lazy_decode_ok = lazy_space.load_entity_loads(cur_view, "cell0") && lazy_decode_ok;
+		});
+	for (const auto& one_pair : cur_space.all_leafs())
+	{
+		lazy_decode_ok = lazy_space.load_entity_loads(cur_view, one_pair.first) && lazy_decode_ok;
+	}
+
+	bool is_same = decode_ok && lazy_decode_ok && json_space.encode() == origin_json && binary_space.encode() == origin_json && lazy_space.encode() == origin_json;
+	json cur_result;
+	cur_result["leafs"] = leaf_num;
+	cur_result["entity_per_cell"] = entity_per_cell;
+	cur_result["json_bytes"] = json_data.size();
+	cur_result["binary_bytes"] = binary_data.size();
+	cur_result["json_encode_ms"] = json_encode_ms;
+	cur_result["json_decode_ms"] = json_decode_ms;
+	cur_result["binary_encode_ms"] = binary_encode_ms;
+	cur_result["binary_decode_ms"] = binary_decode_ms;
+	cur_result["lazy_decode_ms"] = lazy_decode_ms;
+	cur_result["lazy_load_one_cell_ms"] = lazy_load_one_ms;
+	cur_result["mmap_open_ms"] = mmap_open_ms;
+	cur_result["view_iterate_ms"] = view_iterate_ms;
+	cur_result["view_total_load"] = total_load;
+	cur_result["decode_speedup"] = json_decode_ms / binary_decode_ms;
+	cur_result["same_result"] = is_same;
+	std::cout << cur_result.dump() << std::endl;
+	return is_same;
+}
+
+int main(int argc, const char** argv)
+{
+	std::string temp_file = argc > 1 ? argv[1] : "space_snapshot_benchmark.bin";
+	bool all_same = true;
+	for (std::uint32_t leaf_num : { 16, 256, 1024 })
+	{
+		for (std::uint32_t entity_per_cell : { 0, 100, 1000 })
+		{
+			all_same = run_case(leaf_num, entity_per_cell, temp_file) && all_same;
+		}
+	}
+	std::remove(temp_file.c_str());
+	return all_same ? 0 : 1;
+}
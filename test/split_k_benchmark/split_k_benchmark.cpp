@@ -0,0 +1,236 @@
+#include "space_cells.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+using namespace spiritsaway::distributed_space;
+
+// 负载突增5倍之后 恢复到所有cell负载都低于1.1 * min_cell_load_when_split所需的tick数量对比
+// 1. single: 与load_balance_test中的do_balance相同 每个tick最多执行一次shrink或者split_at_direction
+// 2. split_k: shrink的逻辑不变 split时使用split_k一次切分为ceil(load / target_cell_load)个cell
+// 切分出来的cell要等game_ready_delay个tick才能ready 在此之前热点内的entity仍然留在原cell
+// single需要多轮切分 每一轮都要等待一次 split_k只需要等待一次 恢复时间的差距主要来自这里
+
+struct bench_env
+{
+	space_cells* space;
+	std::vector<bench_entity> entities;
+	pending_ready_cells pending_cells;
+	std::uint32_t game_counter = 0;
+	std::uint32_t operation_count = 0;
+};
+
+const std::uint32_t game_ready_delay = 5;
+
+std::unordered_map<std::string, float> report_loads(bench_env& cur_env, std::uint32_t tick)
+{
+	auto& cur_space = *cur_env.space;
+	cur_env.pending_cells.update(tick);
+	std::unordered_map<std::string, std::vector<entity_load>> cell_entity_loads;
+	auto cell_loads = migrate_entities(cur_space, cur_env.entities, cell_entity_loads);
+	std::unordered_map<std::string, float> game_loads;
+	for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+	{
+		if (!one_cell->ready())
+		{
+			continue;
+		}
+		auto cur_load = cell_loads[one_cell_id];
+		cur_space.update_cell_load(one_cell_id, cur_load, cell_entity_loads[one_cell_id]);
+		game_loads[one_cell->game_id()] += cur_load;
+	}
+	cur_space.update_load_stat(game_loads);
+	return game_loads;
+}
+
+float max_host_load(const bench_env& cur_env)
+{
+	std::unordered_map<std::string, float> cell_loads;
+	for (const auto& one_entity : cur_env.entities)
+	{
+		cell_loads[one_entity.host_cell_id] += one_entity.load;
+	}
+	float result = 0;
+	for (const auto& [one_cell_id, one_load] : cell_loads)
+	{
+		result = std::max(result, one_load);
+	}
+	return result;
+}
+
+void do_balance(bench_env& cur_env, const cell_load_balance_param& lb_param, const std::unordered_map<std::string, float>& game_loads, bool use_split_k, std::uint32_t tick)
+{
+	auto& cur_space = *cur_env.space;
+	auto cur_shrink_node = cur_space.get_best_node_to_shrink(lb_param);
+	if (cur_shrink_node)
+	{
+		auto cur_split_pos = cur_shrink_node->calc_best_shrink_new_split_pos(lb_param, cur_space.ghost_radius());
+		cur_space.balance(cur_split_pos, cur_shrink_node->parent());
+		cur_env.operation_count++;
+		return;
+	}
+	auto cur_split_node = cur_space.get_best_cell_to_split(game_loads, lb_param);
+	if (!cur_split_node || !cur_split_node->ready())
+	{
+		return;
+	}
+	auto cur_split_space_id = cur_split_node->space_id();
+	if (!use_split_k)
+	{
+		auto cur_split_direction = cur_split_node->calc_best_split_direction(cur_space.ghost_radius());
+		auto new_space_id = "cell" + std::to_string(++cur_env.game_counter);
+		if (cur_space.split_at_direction(cur_split_space_id, cur_split_direction, new_space_id, "game" + std::to_string(cur_env.game_counter)))
+		{
+			cur_env.pending_cells.add(tick + game_ready_delay, &cur_space, new_space_id);
+			cur_env.operation_count++;
+		}
+		return;
+	}
+	// 切分之后每个cell的负载期望在target之下 放不下时逐步减小切分数量
+	auto target_cell_load = lb_param.min_cell_load_when_split * 0.8f;
+	auto piece_num = std::uint32_t(std::ceil(cur_split_node->get_smoothed_load() / target_cell_load));
+	for (; piece_num >= 2; piece_num--)
+	{
+		std::vector<std::string> new_space_ids;
+		std::vector<std::string> new_game_ids;
+		for (std::uint32_t i = 1; i < piece_num; i++)
+		{
+			new_space_ids.push_back("cell" + std::to_string(cur_env.game_counter + i));
+			new_game_ids.push_back("game" + std::to_string(cur_env.game_counter + i));
+		}
+		auto new_cells = cur_space.split_k(cur_split_space_id, new_space_ids, new_game_ids);
+		if (!new_cells.empty())
+		{
+			cur_env.game_counter += piece_num - 1;
+			for (const auto& one_space_id : new_space_ids)
+			{
+				cur_env.pending_cells.add(tick + game_ready_delay, &cur_space, one_space_id);
+			}
+			cur_env.operation_count++;
+			return;
+		}
+	}
+}
+
+void run_case(std::uint32_t seed, bool use_split_k)
+{
+	cell_bound temp_bound;
+	temp_bound.min.x = 0;
+	temp_bound.max.x = 4000;
+	temp_bound.min.z = 0;
+	temp_bound.max.z = 4000;
+	space_cells cur_space(temp_bound, "game0", "cell0", 50);
+	cur_space.set_ready("cell0");
+	bench_env cur_env;
+	cur_env.space = &cur_space;
+	// 预先划分为4*4的网格
+	for (std::uint32_t i = 1; i < 4; i++)
+	{
+		auto new_space_id = "cell" + std::to_string(++cur_env.game_counter);
+		cur_space.split_x(1000.0 * (4 - i), "cell0", "game" + std::to_string(cur_env.game_counter), "cell0", new_space_id);
+		cur_space.set_ready(new_space_id);
+	}
+	std::vector<std::string> column_ids;
+	for (const auto& [one_cell_id, one_cell] : cur_space.all_leafs())
+	{
+		column_ids.push_back(one_cell_id);
+	}
+	for (const auto& one_column_id : column_ids)
+	{
+		for (std::uint32_t i = 1; i < 4; i++)
+		{
+			auto new_space_id = "cell" + std::to_string(++cur_env.game_counter);
+			cur_space.split_z(1000.0 * (4 - i), one_column_id, "game" + std::to_string(cur_env.game_counter), one_column_id, new_space_id);
+			cur_space.set_ready(new_space_id);
+		}
+	}
+
+	std::mt19937 e1(seed);
+	std::uniform_real_distribution<double> pos_dist(1, 3999);
+	for (std::uint32_t i = 0; i < 640; i++)
+	{
+		bench_entity cur_entity;
+		cur_entity.pos.x = pos_dist(e1);
+		cur_entity.pos.z = pos_dist(e1);
+		cur_entity.load = 1;
+		cur_entity.host_cell_id = find_leaf(cur_space, cur_entity.pos.x, cur_entity.pos.z)->space_id();
+		cur_env.entities.push_back(cur_entity);
+	}
+
+	cell_load_balance_param lb_param;
+	lb_param.load_to_offset = 20;
+	lb_param.max_cell_load_when_remove = 0;
+	lb_param.min_cell_load_report_counter_when_remove = 1000;
+	lb_param.min_cell_load_report_counter_when_shrink = 2;
+	lb_param.min_cell_load_report_counter_when_split = 3;
+	lb_param.min_cell_load_when_shrink = 60;
+	lb_param.min_cell_load_when_split = 100;
+	lb_param.min_game_load_when_split = 100;
+	lb_param.min_sibling_game_load_diff_when_shrink = 30;
+
+	std::uint32_t tick = 0;
+	for (; tick < 20; tick++)
+	{
+		report_loads(cur_env, tick);
+	}
+	// 在一个cell的中心附近增加负载 使其变为min_cell_load_when_split的5倍
+	std::normal_distribution<double> spike_dist(0, 150);
+	auto spike_cell = find_leaf(cur_space, 1500, 2500);
+	auto spike_bound = spike_cell->boundary();
+	point_xz spike_center;
+	spike_center.x = (spike_bound.min.x + spike_bound.max.x) / 2;
+	spike_center.z = (spike_bound.min.z + spike_bound.max.z) / 2;
+	float spike_cell_load = 0;
+	for (const auto& one_entity : cur_env.entities)
+	{
+		if (one_entity.host_cell_id == spike_cell->space_id())
+		{
+			spike_cell_load += one_entity.load;
+		}
+	}
+	while (spike_cell_load < 5 * lb_param.min_cell_load_when_split)
+	{
+		bench_entity cur_entity;
+		cur_entity.pos.x = std::clamp(spike_center.x + spike_dist(e1), spike_cell->boundary().min.x + 1, spike_cell->boundary().max.x - 1);
+		cur_entity.pos.z = std::clamp(spike_center.z + spike_dist(e1), spike_cell->boundary().min.z + 1, spike_cell->boundary().max.z - 1);
+		cur_entity.load = 1;
+		cur_entity.host_cell_id = spike_cell->space_id();
+		cur_env.entities.push_back(cur_entity);
+		spike_cell_load += cur_entity.load;
+	}
+	auto spike_tick = tick;
+	std::uint32_t relief_tick = 0;
+	for (; tick < spike_tick + 300; tick++)
+	{
+		auto game_loads = report_loads(cur_env, tick);
+		// 热点内的cell可能已经达到最小尺寸无法继续切分 因此留出10%的余量
+		if (max_host_load(cur_env) <= 1.1f * lb_param.min_cell_load_when_split && cur_env.pending_cells.empty())
+		{
+			relief_tick = tick;
+			break;
+		}
+		do_balance(cur_env, lb_param, game_loads, use_split_k, tick);
+	}
+	std::cout << (use_split_k ? "split_k" : "single ") << "\tseed " << seed << "\tspike_load " << spike_cell_load;
+	if (relief_tick)
+	{
+		std::cout << "\ttime_to_relief " << relief_tick - spike_tick;
+	}
+	else
+	{
+		std::cout << "\ttime_to_relief >" << tick - spike_tick;
+	}
+	std::cout << "\toperations " << cur_env.operation_count << "\tcells " << cur_space.all_leafs().size() << "\tmax_cell_load " << max_host_load(cur_env) << std::endl;
+}
+
+int main()
+{
+	for (std::uint32_t seed : { 1, 2, 3, 4, 5, 6, 7, 8 })
+	{
+		run_case(seed, false);
+		run_case(seed, true);
+	}
+	return 0;
+}
@@ -0,0 +1,159 @@
+#include "space_cells.h"
+#include "benchmark_utils.h"
+#include <random>
+#include <iostream>
+
+using namespace spiritsaway::distributed_space;
+
+// 对比二维与三维切分在高楼场景下的负载分布
+// 地图为1000*1000 高度为1000 中间的100*100区域有一栋10层的楼 每层1000个entity 地面上另外有2000个均匀分布的entity
+// 两种space使用相同的entity 二维时忽略y 每次选择负载最大的叶子 按照calc_best_split_direction切分 直到cell数量达到上限
+// 切分方向上的长度小于8*ghost_radius的cell不再切分 因此二维时楼所在的区域最多只能切到200*200
+// 每种space输出一行json max_cell_load为最终负载最大的cell ideal_cell_load为总负载除以cell数量 y_splits为沿竖直方向切分的次数
+
+struct tower_entity
+{
+	double x;
+	double z;
+	double y;
+};
+
+std::vector<tower_entity> make_entities()
+{
+	std::mt19937 e1(48);
+	std::uniform_real_distribution<double> tower_dist(450, 550);
+	std::uniform_real_distribution<double> ground_dist(0, 1000);
+	std::uniform_real_distribution<double> floor_dist(0, 5);
+	std::vector<tower_entity> result;
+	for (int i = 0; i < 10; i++)
+	{
+		for (int j = 0; j < 1000; j++)
+		{
+			result.push_back(tower_entity{ tower_dist(e1), tower_dist(e1), 50 + 100 * i + floor_dist(e1) });
+		}
+	}
+	for (int j = 0; j < 2000; j++)
+	{
+		result.push_back(tower_entity{ ground_dist(e1), ground_dist(e1), floor_dist(e1) });
+	}
+	return result;
+}
+
+// 把所有entity按照所在的叶子汇报一次负载 每个entity的负载为1
+template <typename S>
+void report_loads(S& cur_space, const std::vector<tower_entity>& entities)
+{
+	std::unordered_map<std::string, std::vector<typename S::entity_load>> leaf_loads;
+	for (const auto& one_pair : cur_space.all_leafs())
+	{
+		leaf_loads[one_pair.first];
+	}
+	typename S::entity_load temp_load;
+	temp_load.load = 1;
+	temp_load.is_real = true;
+	for (const auto& one_entity : entities)
+	{
+		temp_load.pos.x = one_entity.x;
+		temp_load.pos.z = one_entity.z;
+		if constexpr (S::dim == 3)
+		{
+			temp_load.pos.y = one_entity.y;
+		}
+		auto cur_leaf = cur_space.query_leaf_for_point(temp_load.pos);
+		if (cur_leaf)
+		{
+			leaf_loads[cur_leaf->space_id()].push_back(temp_load);
+		}
+	}
+	for (const auto& one_pair : leaf_loads)
+	{
+		cur_space.update_cell_load(one_pair.first, float(one_pair.second.size()), one_pair.second);
+	}
+}
+
+template <typename S>
+void run_case(const char* name, const std::vector<tower_entity>& entities, std::uint32_t max_cell_num)
+{
+	typename S::cell_bound temp_bound;
+	for (std::uint32_t i = 0; i < S::dim; i++)
+	{
+		temp_bound.min[i] = 0;
+		temp_bound.max[i] = 1000;
+	}
+	const double ghost_radius = 25;
+	S cur_space(temp_bound, "game0", "cell0", ghost_radius);
+	cur_space.set_ready("cell0");
+	std::uint32_t cell_counter = 0;
+	std::uint32_t y_split_num = 0;
+	double report_ms = 0;
+	report_ms += measure_ms([&]()
+		{
+			report_loads(cur_space, entities);
+		});
+	while (cur_space.all_leafs().size() < max_cell_num)
+	{
+		const typename S::space_node* best_leaf = nullptr;
+		cell_split_direction best_direction = cell_split_direction::left_x;
+		for (const auto& one_pair : cur_space.all_leafs())
+		{
+			auto cur_leaf = one_pair.second;
+			if (best_leaf && cur_leaf->get_latest_load() <= best_leaf->get_latest_load())
+			{
+				continue;
+			}
+			auto cur_direction = cur_leaf->calc_best_split_direction(float(ghost_radius));
+			auto axis = int(cur_direction) / 2;
+			const auto& cur_bound = cur_leaf->boundary();
+			if (cur_bound.max[axis] - cur_bound.min[axis] < 8 * ghost_radius)
+			{
+				continue;
+			}
+			best_leaf = cur_leaf;
+			best_direction = cur_direction;
+		}
+		if (!best_leaf)
+		{
+			break;
+		}
+		cell_counter++;
+		auto new_cell_id = "cell" + std::to_string(cell_counter);
+		if (!cur_space.split_at_direction(best_leaf->space_id(), best_direction, new_cell_id, "game" + std::to_string(cell_counter)))
+		{
+			break;
+		}
+		if (int(best_direction) / 2 == 2)
+		{
+			y_split_num++;
+		}
+		cur_space.set_ready(new_cell_id);
+		report_ms += measure_ms([&]()
+			{
+				report_loads(cur_space, entities);
+			});
+	}
+	float max_cell_load = 0;
+	for (const auto& one_pair : cur_space.all_leafs())
+	{
+		max_cell_load = std::max(max_cell_load, one_pair.second->get_latest_load());
+	}
+	json cur_result;
+	cur_result["space"] = name;
+	cur_result["entities"] = entities.size();
+	cur_result["cells"] = cur_space.all_leafs().size();
+	cur_result["max_cell_load"] = max_cell_load;
+	cur_result["ideal_cell_load"] = double(entities.size()) / cur_space.all_leafs().size();
+	cur_result["y_splits"] = y_split_num;
+	cur_result["report_ms"] = report_ms;
+	std::cout << cur_result.dump() << std::endl;
+}
+
+int main()
+{
+	auto entities = make_entities();
+	for (std::uint32_t max_cell_num : { 16, 32 })
+	{
+		run_case<space_cells>("2d", entities, max_cell_num);
+		run_case<space_cells_3d>("3d", entities, max_cell_num);
+	}
+	return 0;
+}